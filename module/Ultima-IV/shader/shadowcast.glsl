@@ -14,14 +14,17 @@ void main() {
 #elif defined(FRAGMENT)
 
 uniform vec4 vport;			// Viewport pixel (x, y, width, height)
-uniform vec3 viewer;	    // World (x, y, scale)
+uniform vec4 viewer;	    // World (x, y, columns, rows)
 uniform ivec3 shape_count;	// (left, center, right)
-uniform vec3 shapes[128];	// (x, y, type) for each shape.
+uniform sampler2D shapes;	// (x, y, type) for each shape, 64 per row.
 out vec4 fragColor;
 
 vec3 shapeCube = vec3(0.5, 0.5, 0.5);
 const float farClip = 20.0;
 
+// Enough for a ray to cross the largest view one tile at a time.
+#define MAX_STEPS	64
+
 float sdSphere(vec3 p, float r) {
 	return length(p) - r;
 }
@@ -42,7 +45,7 @@ float sceneSDF(vec3 pnt, ivec4 group) {
 		it = group.zw;
 
 	for ( ; it.x < it.y; it.x++) {
-		vec3 spos = shapes[it.x];
+		vec3 spos = texelFetch(shapes, ivec2(it.x & 63, it.x >> 6), 0).xyz;
 		if (spos.z == 1.0)
 			d = sdBox(pnt - vec3(spos.x, 0.0, spos.y), shapeCube);
 		else
@@ -60,7 +63,7 @@ void main() {
 	vec2 uv = (gl_FragCoord.xy - vport.xy - vport.zw * 0.5) / vport.zw;
 	vec2 vp = viewer.xy;
 
-	uv *= viewer.z;
+	uv *= viewer.zw;
 
 	vec3 rayStart = vec3(uv.s, 0.0,-uv.t);
 	vec3 toViewer = vec3(vp.x, 0.0, vp.y) - rayStart;
@@ -82,7 +85,7 @@ void main() {
 		inside = 1.0;
 	}
 
-	for (i = 0; i < 32; i++) {
+	for (i = 0; i < MAX_STEPS; i++) {
 		if (rpos >= rayLen)
 			break;                  // Reached viewer.
 		pnt = rayStart + rayDir * rpos;
@@ -96,7 +99,7 @@ void main() {
 
 	// If the ray is "slowed" travelling parallel to a series of blocks
 	// and reaches the loop limit just mark the fragment as shadowed.
-	if (i == 32)
+	if (i == MAX_STEPS)
 		visible = 0.0;
 
 	fragColor = vec4(0.0, inside, 0.0, visible);
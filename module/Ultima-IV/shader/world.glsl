@@ -6,15 +6,31 @@
 
 uniform mat4 transform;
 layout(location = 0) in vec3 position;
+#ifdef INSTANCED
+// Sprites are drawn as instances of the unit quad.
+uniform sampler2D uvTable;		// Tile UV rectangles, 64 per row.
+uniform vec2 spriteSize;
+layout(location = 2) in vec4 sprite;	// x, y, uv index, flags
+#else
 layout(location = 1) in vec4 uv;
+#endif
 out vec3 vertex;
 out vec4 texCoord;
 out vec2 shadowCoord;
 
 void main() {
+#ifdef INSTANCED
+	int index = int(sprite.z);
+	vec4 uvRect = texelFetch(uvTable, ivec2(index & 63, index >> 6), 0);
+	vec2 corner = position.xy * 0.5 + 0.5;
+	vertex = vec3(sprite.xy + corner * spriteSize, 0.0);
+	texCoord = vec4(mix(uvRect.x, uvRect.z, corner.x),
+					mix(uvRect.w, uvRect.y, corner.y), sprite.w, 0.0);
+#else
 	vertex = position;
 	texCoord = uv;
-	gl_Position = transform * vec4(position, 1.0);
+#endif
+	gl_Position = transform * vec4(vertex, 1.0);
 	shadowCoord = (gl_Position.xy + 1.0) * 0.5;
 };
 
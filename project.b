@@ -1,9 +1,10 @@
 options [
-	os_api: 'allegro	"Platform API ('allegro 'sdl)"
+	os_api: 'allegro	"Platform API ('allegro 'sdl 'headless)"
 	use_gl: true
 	use_boron: true
 	boron_sdk: none		"Path to Boron headers and libraries"
 	gpu_render: false
+	profile: false		"Enable per-frame profiler (writes xu4-profile.json)"
 	make_util: true
 ]
 
@@ -32,10 +33,10 @@ exe %xu4 [
 	switch os_api [
 		allegro [
 			unix [
-				libs [%allegro_acodec %allegro_audio %allegro]
+				libs [%allegro_acodec %allegro_audio %allegro_memfile %allegro]
 			]
 			win32 [
-				libs_from %../usr/lib [%allegro_acodec %allegro_audio %allegro]
+				libs_from %../usr/lib [%allegro_acodec %allegro_audio %allegro_memfile %allegro]
 			]
 			sources_from %src [
 				%event_allegro.cpp
@@ -52,6 +53,14 @@ exe %xu4 [
 				%sound_sdl.cpp
 			]
 		]
+		headless [
+			cflags "-DHEADLESS -DDEBUG"
+			sources_from %src [
+				%event_headless.cpp
+				%screen_headless.cpp
+				%sound_headless.cpp
+			]
+		]
 	]
 
 	either use_boron [
@@ -91,7 +100,7 @@ exe %xu4 [
 
 	unix [
 		cflags "-Wno-unused-parameter"
-		libs [%png %z]
+		libs [%png %z %pthread]
 	]
 	win32 [
 		either msvc [
@@ -106,11 +115,13 @@ exe %xu4 [
 		include_from %src/win32
 		sources/flags [%src/win32/xu4.rc] "-I src/win32"
 	]
+	if profile [cflags "-DENABLE_PROFILE"]
 	cflags {-DVERSION=\"KR-1.0\"}
 
 	sources_from %src [
 		%anim.c
 		%annotation.cpp
+		%assetloader.cpp
 		%aura.cpp
 		%camp.cpp
 		%cheat.cpp
@@ -141,6 +152,7 @@ exe %xu4 [
 		%intro.cpp
 		%item.cpp
 		%location.cpp
+		%los.cpp
 		%map.cpp
 		%maploader.cpp
 		%menu.cpp
@@ -149,6 +161,7 @@ exe %xu4 [
 		%names.cpp
 		%object.cpp
 		%party.cpp
+		%pathfind.cpp
 		%person.cpp
 		%portal.cpp
 		%progress_bar.cpp
@@ -176,7 +189,11 @@ exe %xu4 [
 		%lzw/u6decode.cpp
 		%lzw/u4decode.cpp
 
+		%support/fileMap.c
 		%support/notify.c
+		%support/profile.c
+		%support/profileAlloc.cpp
+		%support/threadPool.c
 	]
 ]
 
@@ -191,4 +208,71 @@ if make_util [
 			%src/util/dumpsavegame.cpp
 		]
 	]
+	exe %losbench [
+		console
+		include_from [%src %src/support]
+		sources [
+			%src/util/losbench.cpp
+		]
+	]
+	exe %lzwbench [
+		console
+		include_from %src
+		sources [
+			%src/util/lzwbench.cpp
+			%src/util/lzwref.cpp
+			%src/lzw/lzw.c
+			%src/lzw/u6decode.cpp
+			%src/lzw/hash.c
+		]
+	]
+	exe %scalebench [
+		console
+		include_from [%src %src/support]
+		unix [libs %pthread]
+		sources [
+			%src/util/scalebench.cpp
+			%src/support/threadPool.c
+		]
+	]
+	exe %scalecheck [
+		console
+		include_from [%src %src/support]
+		unix [libs %pthread]
+		sources [
+			%src/util/scalecheck.cpp
+			%src/support/threadPool.c
+		]
+	]
+	exe %simdcheck [
+		console
+		include_from %src/support
+		sources [
+			%src/util/simdcheck.c
+		]
+	]
+	if use_boron [
+		exe %confbench [
+			console
+			include_from %src/support
+			unix [
+				either [boron_sdk] [
+					include_from join boron_sdk %/include
+					libs_from    join boron_sdk %/lib %boron
+					libs %pthread
+				][
+					libs %boron
+				]
+			]
+			win32 [
+				libs_from %../usr/lib either msvc %libboron %boron
+				libs %ws2_32
+			]
+			sources [
+				%src/util/confbench.cpp
+				%src/support/cdi.c
+				%src/support/fileMap.c
+			]
+		]
+	]
 ]
@@ -4,6 +4,15 @@
 
 #include "annotation.h"
 
+/**
+ * Sets a function to be called when a non-visual annotation is added or
+ * removed.  The pos passed to the function is that of the annotation.
+ */
+void AnnotationList::setChangeHook(ChangeFunc func, void* user) {
+    changeFunc = func;
+    changeUser = user;
+}
+
 /**
  * Adds an annotation to the current map
  */
@@ -17,6 +26,7 @@ Annotation *AnnotationList::add(const Coords& coords, const MapTile& tile,
     ann.visualOnly = visual;
     ann.coverUp = isCoverUp;
     push_front(ann);
+    changed(ann);
     return &front();
 }
 
@@ -36,18 +46,22 @@ AnnotationList AnnotationList::allAt(Coords coords) {
 }
 
 /**
- * Returns pointers to all annotations found at the given map coordinates
+ * Stores pointers to the annotations found at the given map coordinates
+ * into a caller supplied array.  No more than max pointers are stored.
+ *
+ * Returns the number of pointers stored.
  */
-std::list<Annotation *> AnnotationList::ptrsToAllAt(const Coords& coords) {
-    std::list<Annotation *> list;
-    iterator i;
+int AnnotationList::ptrsToAllAt(const Coords& coords, const Annotation** list,
+                                int max) const {
+    const_iterator i;
+    int count = 0;
 
-    for (i = begin(); i != end(); i++) {
+    for (i = begin(); i != end() && count < max; i++) {
         if (i->coords == coords)
-            list.push_back(&(*i));
+            list[count++] = &(*i);
     }
 
-    return list;
+    return count;
 }
 
 /**
@@ -58,7 +72,9 @@ void AnnotationList::passTurn() {
     iterator i = begin();
     while (i != end()) {
         if (i->ttl == 0) {
+            Annotation expired = *i;
             i = erase(i);
+            changed(expired);
         } else {
             if (i->ttl > 0)
                 --i->ttl;       // Passes a turn for the annotation.
@@ -74,7 +90,9 @@ void AnnotationList::remove(const Coords& coords, const MapTile& tile) {
     iterator i;
     for (i = begin(); i != end(); i++) {
         if (i->coords == coords && i->tile == tile) {
+            Annotation removed = *i;
             erase(i);
+            changed(removed);
             break;
         }
     }
@@ -85,10 +103,26 @@ void AnnotationList::remove(const Coords& coords, const MapTile& tile) {
  */
 void AnnotationList::removeAllAt(const Coords& pos) {
     iterator it = begin();
+    bool terrain = false;
     while (it != end()) {
-        if (it->coords == pos)
+        if (it->coords == pos) {
+            if (! it->visualOnly)
+                terrain = true;
             it = erase(it);
-        else
+        } else
             ++it;
     }
+    if (terrain && changeFunc)
+        changeFunc(changeUser, pos);
+}
+
+/**
+ * Removes all annotations.
+ */
+void AnnotationList::clear() {
+    while (! empty()) {
+        Annotation removed = front();
+        pop_front();
+        changed(removed);
+    }
 }
@@ -5,6 +5,7 @@
 #ifndef ANNOTATION_H
 #define ANNOTATION_H
 
+#include <cstddef>
 #include <list>
 
 #include "coords.h"
@@ -32,14 +33,31 @@ struct Annotation {
  */
 class AnnotationList : public std::list<Annotation> {
 public:
+    typedef void (*ChangeFunc)(void* user, const Coords& pos);
+
+    AnnotationList() : changeFunc(NULL) {}
+    AnnotationList(const AnnotationList& other)
+        : std::list<Annotation>(other), changeFunc(NULL) {}
+
+    void setChangeHook(ChangeFunc func, void* user);
     Annotation* add(const Coords& coords, const MapTile& tile,
                     bool visual = false, bool isCoverUp = false);
     AnnotationList allAt(Coords pos);
-    std::list<Annotation *> ptrsToAllAt(const Coords& pos);
+    int ptrsToAllAt(const Coords& pos, const Annotation** list, int max) const;
     void passTurn();
     void remove(const Coords& pos, const MapTile& tile);
     void remove(const Annotation& a) { remove(a.coords, a.tile); }
     void removeAllAt(const Coords& pos);
+    void clear();
+
+private:
+    void changed(const Annotation& a) {
+        if (changeFunc && ! a.visualOnly)
+            changeFunc(changeUser, a.coords);
+    }
+
+    ChangeFunc changeFunc;
+    void* changeUser;
 };
 
 #endif
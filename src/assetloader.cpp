@@ -0,0 +1,271 @@
+/*
+ * assetloader.cpp
+ */
+
+#include "assetloader.h"
+#include "thread.h"
+#include "xu4.h"
+
+/*
+ * Images & map files are read and decoded on a single loader thread so
+ * that slow storage does not stall the game loop.  Requests are queued in
+ * order and the main thread finishes them in EventHandler::run() (or
+ * immediately if it needs the result before then).
+ */
+
+#define MAX_JOBS    32
+
+enum AssetJobState {
+    JOB_FREE,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE
+};
+
+struct AssetLoaderThread {
+    Mutex mutex;
+    MutexCond wake;         // Signals the loader that a job is queued.
+    MutexCond done;         // Signals the main thread that a job is done.
+    Thread thread;
+    int quit;
+    int used;               // Number of non-free jobs (main thread only).
+    uint32_t serial;        // Incremented for each request.
+    uint32_t order[MAX_JOBS];
+    AssetJob jobs[MAX_JOBS];
+};
+
+/*
+ * Return the oldest queued job or NULL if there are none.
+ * The mutex must be locked.
+ */
+static AssetJob* nextQueued(AssetLoaderThread* lt) {
+    AssetJob* next = NULL;
+    uint32_t age, maxAge = 0;
+    for (int i = 0; i < MAX_JOBS; ++i) {
+        if (lt->jobs[i].state == JOB_QUEUED) {
+            age = lt->serial - lt->order[i];
+            if (! next || age > maxAge) {
+                next = lt->jobs + i;
+                maxAge = age;
+            }
+        }
+    }
+    return next;
+}
+
+static ThreadReturn THREAD_CALL loaderThread(void* arg) {
+    AssetLoaderThread* lt = (AssetLoaderThread*) arg;
+    AssetJob* job;
+
+    mutex_lock(&lt->mutex);
+    for (;;) {
+        while (! lt->quit && ! (job = nextQueued(lt)))
+            condition_wait(&lt->wake, &lt->mutex);
+        if (lt->quit)
+            break;
+
+        job->state = JOB_RUNNING;
+        mutex_unlock(&lt->mutex);
+        // No PROFILE_ZONE here; the profiler is only for the main thread.
+        job->work(job);
+        mutex_lock(&lt->mutex);
+        job->state = JOB_DONE;
+        condition_broadcast(&lt->done);
+    }
+    mutex_unlock(&lt->mutex);
+    return 0;
+}
+
+AssetLoader::AssetLoader() {
+    lt = new AssetLoaderThread;
+    lt->quit = 0;
+    lt->used = 0;
+    lt->serial = 0;
+    for (int i = 0; i < MAX_JOBS; ++i)
+        lt->jobs[i].state = JOB_FREE;
+
+    mutex_init(&lt->mutex);
+    condition_init(&lt->wake);
+    condition_init(&lt->done);
+
+    // Without a thread, jobs are done when they are waited on or dispatched.
+    if (thread_create(&lt->thread, loaderThread, lt) != 0)
+        lt->quit = -1;
+}
+
+AssetLoader::~AssetLoader() {
+    cancel(ASSET_IMAGE);
+    cancel(ASSET_MAP);
+    cancel(ASSET_CHUNK);
+
+    if (lt->quit == 0) {
+        mutex_lock(&lt->mutex);
+        lt->quit = 1;
+        condition_signal(&lt->wake);
+        mutex_unlock(&lt->mutex);
+        thread_join(lt->thread);
+    }
+
+    condition_free(&lt->done);
+    condition_free(&lt->wake);
+    mutex_free(&lt->mutex);
+    delete lt;
+}
+
+/*
+ * Queue a job for the loader thread.
+ *
+ * \return false if the queue is full.  The caller must then do the work
+ *         itself.
+ */
+bool AssetLoader::request(const AssetJob& job) {
+    AssetJob* it;
+    AssetJob* end = lt->jobs + MAX_JOBS;
+
+    mutex_lock(&lt->mutex);
+    for (it = lt->jobs; it != end; ++it) {
+        if (it->state == JOB_FREE) {
+            *it = job;
+            it->state = JOB_QUEUED;
+            it->ok = false;
+            lt->order[it - lt->jobs] = lt->serial++;
+            ++lt->used;
+            condition_signal(&lt->wake);
+            break;
+        }
+    }
+    mutex_unlock(&lt->mutex);
+    return it != end;
+}
+
+/*
+ * Return the outstanding job for an object or NULL if there is none.
+ * This must only be called from the main thread.
+ */
+AssetJob* AssetLoader::find(int kind, const void* key) {
+    AssetJob* found = NULL;
+    if (lt->used) {
+        AssetJob* it  = lt->jobs;
+        AssetJob* end = it + MAX_JOBS;
+        mutex_lock(&lt->mutex);
+        for (; it != end; ++it) {
+            if (it->state != JOB_FREE && it->key == key && it->kind == kind) {
+                found = it;
+                break;
+            }
+        }
+        mutex_unlock(&lt->mutex);
+    }
+    return found;
+}
+
+/*
+ * Finish a job immediately.  If the loader thread has not started on it
+ * yet then the work is done by the calling (main) thread.
+ */
+void AssetLoader::wait(AssetJob* job) {
+    mutex_lock(&lt->mutex);
+    if (job->state == JOB_QUEUED) {
+        job->state = JOB_RUNNING;
+        mutex_unlock(&lt->mutex);
+        job->work(job);
+        mutex_lock(&lt->mutex);
+        job->state = JOB_DONE;
+    } else {
+        while (job->state != JOB_DONE)
+            condition_wait(&lt->done, &lt->mutex);
+    }
+    mutex_unlock(&lt->mutex);
+
+    complete(job);
+}
+
+/*
+ * Call the finish function of a done job, notify listeners, and free it.
+ */
+void AssetLoader::complete(AssetJob* job) {
+    AssetEvent event;
+
+    job->finish(job);
+
+    event.kind = job->kind;
+    event.id   = job->id;
+    event.ok   = job->ok;
+
+    mutex_lock(&lt->mutex);
+    job->state = JOB_FREE;
+    --lt->used;
+    mutex_unlock(&lt->mutex);
+
+    gs_emitMessage(SENDER_ASSET, &event);
+}
+
+/*
+ * Finish all jobs that the loader thread has done.  This is called once
+ * per frame by the EventHandler.
+ */
+void AssetLoader::dispatch() {
+    AssetJob* it;
+    AssetJob* end;
+
+    if (! lt->used)
+        return;
+
+    if (lt->quit) {
+        // No loader thread; do one job per frame.
+        mutex_lock(&lt->mutex);
+        it = nextQueued(lt);
+        mutex_unlock(&lt->mutex);
+        if (it)
+            wait(it);
+        return;
+    }
+
+    AssetJob* done[MAX_JOBS];
+    int i, count = 0;
+
+    mutex_lock(&lt->mutex);
+    end = lt->jobs + MAX_JOBS;
+    for (it = lt->jobs; it != end; ++it) {
+        if (it->state == JOB_DONE)
+            done[count++] = it;
+    }
+    mutex_unlock(&lt->mutex);
+
+    // A finish function may have waited on one of the other jobs.
+    for (i = 0; i < count; ++i) {
+        mutex_lock(&lt->mutex);
+        bool stillDone = (done[i]->state == JOB_DONE);
+        mutex_unlock(&lt->mutex);
+        if (stillDone)
+            complete(done[i]);
+    }
+}
+
+/*
+ * Discard all jobs of the given kind without finishing them.
+ */
+void AssetLoader::cancel(int kind) {
+    AssetJob* it;
+    AssetJob* end = lt->jobs + MAX_JOBS;
+
+    mutex_lock(&lt->mutex);
+    for (it = lt->jobs; it != end; ++it) {
+        if (it->state == JOB_FREE || it->kind != kind)
+            continue;
+        while (it->state == JOB_RUNNING)
+            condition_wait(&lt->done, &lt->mutex);
+        if (it->discard)
+            it->discard(it);
+        it->state = JOB_FREE;
+        --lt->used;
+    }
+    mutex_unlock(&lt->mutex);
+}
+
+/*
+ * Return the number of jobs which have not been finished.
+ */
+int AssetLoader::pending() const {
+    return lt->used;
+}
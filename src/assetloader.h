@@ -0,0 +1,71 @@
+/*
+ * assetloader.h
+ */
+
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <stdint.h>
+
+enum AssetKind {
+    ASSET_IMAGE,
+    ASSET_MAP,
+    ASSET_CHUNK         // GPU map chunk geometry.
+};
+
+/*
+ * The SENDER_ASSET message emitted when a background request completes.
+ */
+struct AssetEvent {
+    int kind;           // AssetKind
+    uint32_t id;        // Image Symbol, MapId, or chunk column & row.
+    bool ok;
+};
+
+struct AssetJob;
+typedef void (*AssetJobFunc)(AssetJob*);
+
+/*
+ * A request to the loader thread.
+ *
+ * The work function is called on the loader thread and must not touch any
+ * game state.  The finish function is called on the main thread once work
+ * is done, and discard is called instead if the job is cancelled.
+ */
+struct AssetJob {
+    AssetJobFunc work;
+    AssetJobFunc finish;
+    AssetJobFunc discard;
+    const void* key;        // Object being loaded (ImageInfo*, Map*).
+    void* file;             // Input from the requester (U4FILE*, name).
+    void* result;           // Output of work (Image*, buffer, etc.).
+    long size;
+    uint32_t id;
+    uint16_t group;         // Resource group at the time of the request.
+    uint8_t kind;
+    uint8_t state;
+    bool ok;
+    bool flag;              // Requester defined.
+};
+
+struct AssetLoaderThread;
+
+class AssetLoader {
+public:
+    AssetLoader();
+    ~AssetLoader();
+
+    bool request(const AssetJob& job);
+    AssetJob* find(int kind, const void* key);
+    void wait(AssetJob* job);
+    void dispatch();
+    void cancel(int kind);
+    int pending() const;
+
+private:
+    void complete(AssetJob* job);
+
+    AssetLoaderThread* lt;
+};
+
+#endif /* ASSETLOADER_H */
@@ -5,9 +5,11 @@
 #include "cheat.h"
 #include "config.h"
 #include "game.h"
+#include "imagemgr.h"
 #include "portal.h"
 #include "party.h"
 #include "screen.h"
+#include "settings.h"
 #include "stats.h"
 #include "tileset.h"
 #include "utils.h"
@@ -58,6 +60,22 @@ bool CheatMenuController::keyPressed(int key) {
         screenMessage("Collision detection %s!\n", collisionOverride ? "off" : "on");
         break;
 
+    case 'd': {
+        ImageGroupStats stats[8];
+        uint32_t total = 0;
+        int n = xu4.imageMgr->groupStats(stats, 8);
+
+        screenMessage("Image Memory:\n");
+        for (i = 0; i < n; ++i) {
+            screenMessage(" Group %d: %dK (%d)\n", stats[i].group,
+                          stats[i].bytes / 1024, stats[i].images);
+            total += stats[i].bytes;
+        }
+        screenMessage(" Total %dK of %dK\n", total / 1024,
+                      xu4.settings->imageBudget);
+        break;
+    }
+
     case 'e':
         screenMessage("Equipment!\n");
         for (i = ARMR_NONE + 1; i < ARMR_MAX; i++)
@@ -123,12 +141,12 @@ bool CheatMenuController::keyPressed(int key) {
                       "F1-F8 - +Virtue\n"
                       "a - Adv. Moons\n"
                       "c - Collision\n"
+                      "d - Image Memory\n"
                       "e - Equipment\n"
                       "f - Full Stats\n"
                       "g - Goto\n"
                       "h - Help\n"
                       "i - Items\n"
-                      "j - Join Compan.\n"
                       "(more)");
 
         ReadChoiceController pauseController("");
@@ -136,6 +154,7 @@ bool CheatMenuController::keyPressed(int key) {
         pauseController.waitFor();
 
         screenMessage("\n"
+                      "j - Join Compan.\n"
                       "k - Show Karma\n"
                       "l - Location\n"
                       "m - Mixtures\n"
@@ -146,13 +165,13 @@ bool CheatMenuController::keyPressed(int key) {
                       "t - Transports\n"
                       "v - Full Virtues\n"
                       "w - Change Wind\n"
-                      "x - Exit Map\n"
                       "(more)");
 
         xu4.eventHandler->pushController(&pauseController);
         pauseController.waitFor();
 
         screenMessage("\n"
+                      "x - Exit Map\n"
                       "y - Y-up\n"
                       "z - Z-down\n"
                   );
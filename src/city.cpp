@@ -43,9 +43,7 @@ Person *City::addPerson(Person *person) {
     Person *p = new Person(person);
 
     /* set the start coordinates for the person */
-    p->placeOnMap(this, p->getStart());
-
-    objects.push_back(p);
+    addObject(p, p->getStart());
     return p;
 }
 
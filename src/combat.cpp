@@ -445,8 +445,7 @@ void CombatController::placePartyMembers() {
         /* don't place dead party members */
         if (p->getStatus() != STAT_DEAD) {
             /* add the party member to the map */
-            p->placeOnMap(map, map->player_start[i]);
-            map->objects.push_back(p);
+            map->addObject(p, map->player_start[i]);
             party[i] = p;
         }
     }
@@ -1286,15 +1285,26 @@ PartyMember *CombatMap::partyMemberAt(Coords coords) {
  * Returns the creature at the given coords, if there is one,
  * NULL if otherwise.
  */
-Creature *CombatMap::creatureAt(Coords coords) {
-    CreatureVector creatures = getCreatures();
-    CreatureVector::iterator i;
+struct CreatureQuery {
+    Coords pos;
+    Creature* found;
+};
 
-    for (i = creatures.begin(); i != creatures.end(); i++) {
-        if ((*i)->coords == coords)
-            return *i;
+static int matchCreature(Object* obj, void* user) {
+    CreatureQuery* cq = (CreatureQuery*) user;
+    if (obj->coords == cq->pos && isCreature(obj) && ! isPartyMember(obj)) {
+        cq->found = dynamic_cast<Creature*>(obj);
+        return Map::QueryDone;
     }
-    return NULL;
+    return Map::QueryContinue;
+}
+
+Creature *CombatMap::creatureAt(Coords coords) {
+    CreatureQuery cq;
+    cq.pos = coords;
+    cq.found = NULL;
+    queryObjects(coords, 0, matchCreature, &cq);
+    return cq.found;
 }
 
 // These coincide with Tile::sym.dungeonMaps[]
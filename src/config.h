@@ -57,6 +57,7 @@ public:
     const void* scriptEvalArg(const char* fmt, ...);
 #endif
     const char* modulePath() const;
+    const uint8_t* moduleData( const CDIEntry* ent ) const;
     const CDIEntry* fileEntry( const char* sourceFilename ) const;
     const CDIEntry* imageFile( const char* id ) const;
     const CDIEntry* mapFile( uint32_t id ) const;
@@ -82,6 +83,7 @@ public:
     const UltimaSaveIds* usaveIds() const;
     Map* map(uint32_t id);
     Map* restoreMap(uint32_t id);
+    void prefetchMap(uint32_t id);
     const Coords* moongateCoords(int phase) const;
 
 protected:
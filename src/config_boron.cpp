@@ -92,6 +92,13 @@ struct ConfigData
     uint16_t armorCount;
 };
 
+// Script text which has been tokenized & bound for reuse.
+struct ScriptCall
+{
+    string text;
+    UIndex blkN;
+};
+
 struct ConfigBoron : public Config {
     ConfigBoron(const char* modulePath);
     ~ConfigBoron();
@@ -100,14 +107,15 @@ struct ConfigBoron : public Config {
     //const UBuffer* blockBuffer(int value, uint32_t n, int dataType) const;
 
     UThread* ut;
-    CDIEntry* toc;
-    uint8_t* fnamBuf;
+    CDIMapping pak;         // Module file mapped into memory.
+    const CDIEntry* toc;
     CDIStringTable fnam;
     UIndex configN;
     UIndex itemIdN;         // item-id context!
     size_t tocUsed;
     ConfigData xcd;
     UBuffer evalBuf;
+    vector<ScriptCall> evalCache;
     Symbol sym_hitFlash;
     Symbol sym_missFlash;
     Symbol sym_random;
@@ -816,9 +824,14 @@ static Weapon* conf_weapon(const ConfigBoron* cfg, int type, UBlockIt& bi) {
 
 #include "script_boron.cpp"
 
+/*
+ * Evaluate a script command built from a printf style format.
+ * Each distinct command is only tokenized the first time it is run.
+ */
 const void* Config::scriptEvalArg(const char* fmt, ...)
 {
-    UBuffer* buf = &static_cast<ConfigBoron*>(this)->evalBuf;
+    ConfigBoron* cb = static_cast<ConfigBoron*>(this);
+    UBuffer* buf = &cb->evalBuf;
     int bufSize = ur_avail(buf);
     va_list arg;
     int n;
@@ -828,7 +841,7 @@ const void* Config::scriptEvalArg(const char* fmt, ...)
     va_end(arg);
 
     if (n > 0 && n < bufSize)
-        return script_eval(CX->ut, buf->ptr.c, n);
+        return script_evalCached(cb->ut, cb->evalCache, buf->ptr.c, n);
     return NULL;
 }
 
@@ -839,7 +852,7 @@ ConfigBoron::ConfigBoron(const char* modulePath)
     UBlockIt bi;
     const char* error = NULL;
     const CDIEntry* ent;
-    FILE* fp;
+    const uint8_t* chunk;
 
 #define NO_PTR(ptr, msg) \
     if (! ptr) { \
@@ -867,45 +880,39 @@ ConfigBoron::ConfigBoron(const char* modulePath)
                        " imageset tileanims _cel rect", &sym_hitFlash);
 
 
-    // Read package table of contents.
-    {
-    CDIEntry pakHead;
-
-    fp = cdi_openPak(modulePath, &pakHead);
-    if (! fp)
+    // Map the package and get the table of contents.  The module stays
+    // mapped so that all assets are read directly from memory.
+    if (! cdi_mapPak(&pak, modulePath))
         errorFatal("Cannot open module %s", modulePath);
 
-    if (pakHead.appId != CDI32('x','u','4', 1)) {
+    if (pak.header.appId != CDI32('x','u','4', 1)) {
         error = "Invalid module id";
         goto fail;
     }
 
-    toc = cdi_loadPakTOC(fp, &pakHead);
-    NO_PTR(toc, "No module TOC");
-    tocUsed = CDI_TOC_SIZE((&pakHead));
-    }
+    toc = pak.toc;
+    tocUsed = CDI_TOC_SIZE((&pak.header));
 
 
-    // Load filename string table.
+    // Get filename string table.
     ent = cdi_findAppId(toc, tocUsed, CDI32('F','N','A','M'));
     NO_PTR(ent, "Module FNAM not found");
-    fnamBuf = cdi_loadPakChunk(fp, ent);
-    NO_PTR(fnamBuf, "Read FNAM failed");
-    cdi_initStringTable(&fnam, fnamBuf);
+    chunk = cdi_mappedChunk(&pak, ent);
+    NO_PTR(chunk, "Read FNAM failed");
+    cdi_initStringTable(&fnam, chunk);
 
 
     // Load config.
     {
     UCell* res;
-    uint8_t* confBuf;
 
     ent = cdi_findAppId(toc, tocUsed, CDI32('C','O','N','F'));
     NO_PTR(ent, "Module CONF not found");
-    confBuf = cdi_loadPakChunk(fp, ent);
-    NO_PTR(confBuf, "Read CONF failed");
+    chunk = cdi_mappedChunk(&pak, ent);
+    NO_PTR(chunk, "Read CONF failed");
 
     res = ur_stackTop(ut);
-    if (ur_unserialize(ut, confBuf, confBuf + ent->bytes, res) == UR_OK) {
+    if (ur_unserialize(ut, chunk, chunk + ent->bytes, res) == UR_OK) {
         res = ur_buffer(res->series.buf)->ptr.cell;
         if (ur_is(res, UT_CONTEXT)) {
             configN = res->series.buf;
@@ -914,12 +921,9 @@ ConfigBoron::ConfigBoron(const char* modulePath)
             error = "Serialized context not found";
     } else
         error = "Unserialize CONF failed";
-
-    free(confBuf);
     }
 
 fail:
-    fclose(fp);
     if (error)
         errorFatal(error);
 
@@ -1069,8 +1073,7 @@ ConfigBoron::~ConfigBoron()
     ur_binFree(&evalBuf);
 
     boron_freeEnv( ut );
-    free(fnamBuf);
-    free(toc);
+    cdi_unmapPak(&pak);
     free(xcd.modulePath);
 }
 
@@ -1166,6 +1169,14 @@ const char* Config::modulePath() const {
     return CB->modulePath;
 }
 
+/*
+ * Return a pointer to the data of a module entry.  The memory remains valid
+ * for the lifetime of the Config.
+ */
+const uint8_t* Config::moduleData( const CDIEntry* ent ) const {
+    return cdi_mappedChunk(&CX->pak, ent);
+}
+
 static int lastChar(const char* str) {
     while (*str)
         ++str;
@@ -1336,6 +1347,7 @@ const UltimaSaveIds* Config::usaveIds() const {
 }
 
 extern bool loadMap(Map *map, FILE* sav);
+extern void mapPrefetch(Map *map);
 
 Map* Config::map(uint32_t id) {
     if (id >= CB->mapList.size())
@@ -1351,6 +1363,14 @@ Map* Config::map(uint32_t id) {
     return rmap;
 }
 
+/*
+ * Begin reading a map in the background if it is not yet loaded.
+ */
+void Config::prefetchMap(uint32_t id) {
+    if (id < CB->mapList.size())
+        mapPrefetch(CB->mapList[id]);
+}
+
 // Load map from saved game.
 Map* Config::restoreMap(uint32_t id) {
     if (id >= CB->mapList.size())
@@ -1326,6 +1326,7 @@ const UltimaSaveIds* Config::usaveIds() const {
 }
 
 extern bool loadMap(Map *map, FILE* sav);
+extern void mapPrefetch(Map *map);
 
 Map* Config::map(uint32_t id) {
     if (id >= CB->mapList.size())
@@ -1341,6 +1342,14 @@ Map* Config::map(uint32_t id) {
     return rmap;
 }
 
+/*
+ * Begin reading a map in the background if it is not yet loaded.
+ */
+void Config::prefetchMap(uint32_t id) {
+    if (id < CB->mapList.size())
+        mapPrefetch(CB->mapList[id]);
+}
+
 // Load map from saved game.
 Map* Config::restoreMap(uint32_t id) {
     if (id >= CB->mapList.size())
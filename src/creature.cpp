@@ -534,43 +534,72 @@ bool Creature::hideOrShow(Map* map) {
     return visible;
 }
 
-Creature *Creature::nearestOpponent(Map* map, int *dist, bool ranged) const {
-    Creature *opponent = NULL;
-    int d, leastDist = 0xFFFF;
-    ObjectDeque::iterator i;
-    bool jinx = (c->aura.getType() == Aura::JINX);
-
-    for (i = map->objects.begin(); i < map->objects.end(); i++) {
-        if (!isCreature(*i))
-            continue;
-
-        bool amPlayer = isPartyMember(this);
-        bool fightingPlayer = isPartyMember(*i);
-
-        /* if a party member, find a creature. If a creature, find a party member */
-        /* if jinxed is false, find anything that isn't self */
-        if ((amPlayer != fightingPlayer) ||
-            (jinx && !amPlayer && *i != this)) {
-            Coords objCoords = (*i)->coords;
-
-            /* if ranged, get the distance using diagonals, otherwise get movement distance */
-            if (ranged)
-                d = map_distance(objCoords, coords);
-            else
-                d = map_movementDistance(objCoords, coords);
-
-            /* skip target 50% of time if same distance */
-            if (d < leastDist || (d == leastDist && xu4_random(2) == 0)) {
-                opponent = dynamic_cast<Creature*>(*i);
-                leastDist = d;
-            }
+struct OpponentQuery {
+    const Creature* self;
+    Creature* opponent;
+    int leastDist;
+    bool amPlayer;
+    bool jinx;
+    bool ranged;
+};
+
+static int considerOpponent(Object* obj, void* user) {
+    OpponentQuery* oq = (OpponentQuery*) user;
+    int d;
+
+    if (!isCreature(obj))
+        return Map::QueryContinue;
+
+    bool fightingPlayer = isPartyMember(obj);
+
+    /* if a party member, find a creature. If a creature, find a party member */
+    /* if jinxed is false, find anything that isn't self */
+    if ((oq->amPlayer != fightingPlayer) ||
+        (oq->jinx && !oq->amPlayer && obj != oq->self)) {
+        /* if ranged, get the distance using diagonals, otherwise get movement distance */
+        if (oq->ranged)
+            d = map_distance(obj->coords, oq->self->coords);
+        else
+            d = map_movementDistance(obj->coords, oq->self->coords);
+
+        /* skip target 50% of time if same distance */
+        if (d < oq->leastDist || (d == oq->leastDist && xu4_random(2) == 0)) {
+            oq->opponent = dynamic_cast<Creature*>(obj);
+            oq->leastDist = d;
         }
     }
+    return Map::QueryContinue;
+}
+
+/*
+ * Find the closest opponent by searching squares of increasing size
+ * around the creature.  Both distance measures are never less than the
+ * square radius, so the search can stop as soon as an opponent is found
+ * within the current square.
+ */
+Creature *Creature::nearestOpponent(Map* map, int *dist, bool ranged) const {
+    OpponentQuery oq;
+    int maxRadius = (map->width > map->height) ? map->width : map->height;
+    int radius = 2;
+
+    oq.self = this;
+    oq.amPlayer = isPartyMember(this);
+    oq.jinx = (c->aura.getType() == Aura::JINX);
+    oq.ranged = ranged;
+
+    for (;;) {
+        oq.opponent = NULL;
+        oq.leastDist = 0xFFFF;
+        map->queryObjects(coords, radius, considerOpponent, &oq);
+        if ((oq.opponent && oq.leastDist <= radius) || radius >= maxRadius)
+            break;
+        radius *= 2;
+    }
 
-    if (opponent)
-        *dist = leastDist;
+    if (oq.opponent)
+        *dist = oq.leastDist;
 
-    return opponent;
+    return oq.opponent;
 }
 
 void Creature::putToSleep() {
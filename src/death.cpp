@@ -19,6 +19,7 @@
 
 int timerCount;
 unsigned int timerMsg;
+static TimerId timerId;
 int deathSequenceRunning = 0;
 
 void deathTimer(void *data);
@@ -60,7 +61,7 @@ void deathStart(int delaySeconds) {
     screenDisableCursor();
 
     xu4.eventHandler->pushKeyHandler(&KeyHandler::ignoreKeys);
-    xu4.eventHandler->getTimer()->add(&deathTimer, xu4.settings->gameCyclesPerSecond);
+    timerId = xu4.eventHandler->getTimer()->add(&deathTimer, xu4.settings->gameCyclesPerSecond);
 }
 
 void deathTimer(void *data) {
@@ -75,7 +76,7 @@ void deathTimer(void *data) {
         timerMsg++;
 
         if (timerMsg >= N_MSGS) {
-            xu4.eventHandler->getTimer()->remove(&deathTimer);
+            xu4.eventHandler->getTimer()->remove(timerId);
             deathRevive();
         }
     }
@@ -28,11 +28,13 @@ Dialogue* U4TlkDialogueLoader::load(void *source) {
     };
 
     /* there's no dialogues left in the file */
-    char tlk_buffer[288];
-    if (u4fread(tlk_buffer, 1, sizeof(tlk_buffer), file) != sizeof(tlk_buffer))
+    char tlk_copy[288];
+    const char *tlk_buffer = (const char*) u4fspan(file, sizeof(tlk_copy),
+                                                   tlk_copy);
+    if (! tlk_buffer)
         return NULL;
 
-    char *ptr = &tlk_buffer[3];
+    const char *ptr = &tlk_buffer[3];
     vector<string> strings;
     for (int i = 0; i < 12; i++) {
         strings.push_back(ptr);
@@ -31,13 +31,15 @@ DungeonView::DungeonView(int x, int y, int columns, int rows) : TileView(x, y, r
     down_ladder   = tileset->getByName(SYM_DOWN_LADDER)->getId();
     updown_ladder = tileset->getByName(SYM_UP_DOWN_LADDER)->getId();
 
+    for (int i = 0; i < 84; ++i)
+        graphic[i].info = NULL;
     cacheGraphicData();
 }
 
 /*
  * Sets coords relative to party and fills tiles from that location.
  */
-static void dungeonGetTiles(Coords& coords, std::vector<MapTile>& tiles,
+static void dungeonGetTiles(Coords& coords, TileStack& tiles,
                             int fwd, int side) {
     coords = c->location->coords;
 
@@ -80,7 +82,7 @@ void DungeonView::display(Context * c, TileView *view)
 {
     static const int8_t wallSides[3] = { -1, 1, 0 };
     Dungeon* dungeon = dynamic_cast<Dungeon *>(c->location->map);
-    vector<MapTile> tiles;
+    TileStack tiles;
     Coords drawLoc;
     int x, y;
 
@@ -91,7 +93,7 @@ void DungeonView::display(Context * c, TileView *view)
 
         screenEraseMapArea();
         if (c->party->getTorchDuration() > 0) {
-            vector<MapTile> distant_tiles;
+            TileStack distant_tiles;
 
             for (y = 3; y >= 0; y--) {
                 DungeonGraphicType type;
@@ -285,7 +287,7 @@ int DungeonView::graphicIndex(const Coords& loc, int xoffset, int distance,
 }
 
 DungeonGraphicType DungeonView::tilesToGraphic(const Dungeon* dungeon,
-                                        const std::vector<MapTile> &tiles) {
+                                        const TileStack &tiles) {
     MapTile tile = tiles.front();
 
     /*
@@ -444,12 +446,30 @@ const struct {
  * loading during drawWall().
  */
 void DungeonView::cacheGraphicData() {
+    ImageInfo* info;
     Symbol name;
     int i;
 
+    releaseGraphicData();
     for (i = 0; i < GRAPHIC_COUNT; ++i) {
         name = xu4.config->intern(dngGraphicInfo[i].imageName);
-        graphic[i].info = xu4.imageMgr->imageInfo(name, &graphic[i].sub);
+        info = xu4.imageMgr->imageInfo(name, &graphic[i].sub);
+        if (info)
+            xu4.imageMgr->pin(info);
+        graphic[i].info = info;
+    }
+}
+
+/*
+ * Unpin the graphics held by cacheGraphicData().  This must be called
+ * before the ImageMgr is deleted.
+ */
+void DungeonView::releaseGraphicData() {
+    for (int i = 0; i < GRAPHIC_COUNT; ++i) {
+        if (graphic[i].info) {
+            xu4.imageMgr->unpin(graphic[i].info);
+            graphic[i].info = NULL;
+        }
     }
 }
 
@@ -29,6 +29,7 @@ public:
     DungeonView(int x, int y, int columns, int rows);
 
     void cacheGraphicData();
+    void releaseGraphicData();
     void display(Context * c, TileView *view);
     void detectTraps();
 
@@ -42,11 +43,11 @@ private:
     int graphicIndex(const Coords& loc, int xoffset, int distance,
                      Direction orientation, DungeonGraphicType type);
     DungeonGraphicType tilesToGraphic(const Dungeon*,
-                                      const std::vector<MapTile> &tiles);
+                                      const TileStack &tiles);
     void drawWall(int graphic);
 
     struct GraphicData {
-        const ImageInfo* info;
+        ImageInfo* info;
         const SubImage* sub;
     };
 
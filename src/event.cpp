@@ -8,10 +8,13 @@
 
 #include "event.h"
 
+#include "assetloader.h"
 #include "config.h"
 #include "context.h"
 #include "debug.h"
+#include "imagemgr.h"
 #include "location.h"
+#include "profile.h"
 #include "savegame.h"
 #include "screen.h"
 #include "textview.h"
@@ -20,11 +23,8 @@
 static void frameSleepInit(FrameSleep* fs, int frameDuration) {
     fs->frameInterval = frameDuration;
     fs->realTime = 0;
-    for (int i = 0; i < 8; ++i)
-        fs->ftime[i] = frameDuration;
-    fs->ftimeSum = frameDuration * 8;
-    fs->ftimeIndex = 0;
-    fs->fsleep = frameDuration - 6;
+    fs->accum = frameDuration;
+    fs->frameSeconds = float(frameDuration) * 0.001f;
 }
 
 /**
@@ -94,8 +94,8 @@ TimedEventMgr* EventHandler::getTimer() { return &timedEvents; }
 Controller *EventHandler::pushController(Controller *c) {
     controllers.push_back(c);
     int interval = c->getTimerInterval();
-    if (interval)
-        timedEvents.add(&Controller::timerCallback, interval, c);
+    controllerTimers.push_back(interval ?
+            timedEvents.add(&Controller::timerCallback, interval, c) : 0);
     return c;
 }
 
@@ -104,10 +104,11 @@ Controller *EventHandler::popController() {
         return NULL;
 
     Controller* con = controllers.back();
-    if (con->getTimerInterval())
-        timedEvents.remove(&Controller::timerCallback, con);
+    if (controllerTimers.back())
+        timedEvents.remove(controllerTimers.back());
 
     controllers.pop_back();
+    controllerTimers.pop_back();
     if (con->deleteOnPop())
         delete con;
 
@@ -169,61 +170,72 @@ void EventHandler::setScreenUpdate(void (*updateFunc)(void)) {
 #include "support/getTicks.c"
 
 /*
- * Return non-zero if waitTime has been reached or passed.
+ * Add the real time elapsed since the previous frame to the simulation
+ * accumulator.  Time lost to a long stall is dropped rather than simulated
+ * in a burst.
  */
-static int frameSleep(FrameSleep* fs, uint32_t waitTime) {
-    uint32_t now;
-    int32_t elapsed, elapsedLimit, frameAdjust;
-    int i;
+static void frameElapsed(FrameSleep* fs) {
+    uint32_t now = getTicks();
+    uint32_t elapsed = now - fs->realTime;
+    uint32_t limit = fs->frameInterval * FS_MAX_STEPS;
 
-    now = getTicks();
-    elapsed = now - fs->realTime;
     fs->realTime = now;
+    if (elapsed > limit)
+        elapsed = limit;
+    fs->frameSeconds = float(elapsed) * 0.001f;
 
-    elapsedLimit = fs->frameInterval * 8;
-    if (elapsed > elapsedLimit)
-        elapsed = elapsedLimit;
-
-    i = fs->ftimeIndex;
-    fs->ftimeSum += elapsed - fs->ftime[i];
-    fs->ftime[i] = elapsed;
-    fs->ftimeIndex = i ? i - 1 : FS_SAMPLES - 1;
-
-    frameAdjust = int(fs->frameInterval) - fs->ftimeSum / FS_SAMPLES;
-#if 0
-    // Adjust by 1 msec.
-    if (frameAdjust > 0) {
-        if (fs->fsleep < fs->frameInterval - 1)
-            ++fs->fsleep;
-    } else if (frameAdjust < 0) {
-        if (fs->fsleep)
-            --fs->fsleep;
-    }
+    fs->accum += elapsed;
+    if (fs->accum > limit)
+        fs->accum = limit;
+}
+
+/*
+ * Wait until the next frame should be presented.
+ */
+static void framePace(FrameSleep* fs) {
+#ifdef HEADLESS
+    // Nothing is presented, so just advance the simulated clock by a whole
+    // step and continue immediately.
+    msecSleep(fs->frameInterval);
 #else
-    // Adjust by 2 msec.
-    if (frameAdjust > 0) {
-        if (frameAdjust > 2)
-            frameAdjust = 2;
-        int sa = int(fs->fsleep) + frameAdjust;
-        int limit = fs->frameInterval - 1;
-        fs->fsleep = (sa > limit) ? limit : sa;
-    } else if (frameAdjust < 0) {
-        if (frameAdjust < -2)
-            frameAdjust = -2;
-        int sa = int(fs->fsleep) + frameAdjust;
-        fs->fsleep = (sa < 0) ? 0 : sa;
-    }
+    const ScreenState* ss = screenState();
+    uint32_t busy;
+
+    if (ss->uncapped)
+        return;
+
+    // The buffer swap has already waited for the display refresh.  Frames
+    // faster than any display mean the driver has ignored the vsync request.
+    if (ss->vsync && fs->frameSeconds >= 0.002f)
+        return;
+
+    // Sleep until the next simulation step is due.
+    busy = fs->accum + (getTicks() - fs->realTime);
+    if (busy < fs->frameInterval)
+        msecSleep(fs->frameInterval - busy);
 #endif
+}
 
-    if (waitTime && now >= waitTime)
-        return 1;
-#if 0
-    printf("KR fsleep %d ela:%d avg:%d adj:%d\n",
-           fs->fsleep, elapsed, fs->ftimeSum / FS_SAMPLES, frameAdjust);
+/*
+ * Run one fixed step of the simulation.  Recorded keys are passed to
+ * waitCon if it is set, otherwise to the current controller.
+ */
+void EventHandler::runStep(Controller* waitCon) {
+#ifdef DEBUG
+    int key;
+    while ((key = recordedKey())) {
+        if (waitCon)
+            waitCon->notifyKeyPressed(key);
+        else if (getController()->notifyKeyPressed(key) && updateScreen)
+            (*updateScreen)();
+    }
+    recordTick();
 #endif
-    if (fs->fsleep)
-        msecSleep(fs->fsleep);
-    return 0;
+    if (runTime >= timerInterval) {
+        runTime -= timerInterval;
+        timedEvents.tick();
+    }
+    runTime += fs.frameInterval;
 }
 
 /**
@@ -232,32 +244,46 @@ static int frameSleep(FrameSleep* fs, uint32_t waitTime) {
  * while some important event happens (e.g., getting hit by a cannon ball or
  * a spell effect).
  *
- * This method is not expected to handle msec values of less than the display
- * refresh interval.
+ * The delay is rounded up to whole simulation steps so that it is the same
+ * for any display rate.
  *
  * \return true if game should exit.
  */
 bool EventHandler::wait_msecs(unsigned int msec) {
     Controller waitCon;     // Base controller consumes key events.
     EventHandler* eh = xu4.eventHandler;
-    uint32_t waitTime = getTicks() + msec;
+    FrameSleep* fs = &eh->fs;
+    uint32_t steps = (msec + fs->frameInterval - 1) / fs->frameInterval;
+
+    if (! steps)
+        steps = 1;
+
+    // Time which passed before the wait (e.g. steps still owed by the caller
+    // or a long load) must not be spent on the wait's steps, otherwise they
+    // would all be run before any frame is presented.
+    fs->realTime = getTicks();
+    fs->accum %= fs->frameInterval;
 
     while (! eh->ended) {
+        PROFILE_FRAME_BEGIN()
+        {
+        PROFILE_ZONE("handleInputEvents")
         eh->handleInputEvents(&waitCon, NULL);
-#ifdef DEBUG
-        int key;
-        while ((key = eh->recordedKey()))
-            waitCon.notifyKeyPressed(key);
-        eh->recordTick();
-#endif
-        if (eh->runTime >= eh->timerInterval) {
-            eh->runTime -= eh->timerInterval;
-            eh->timedEvents.tick();
         }
-        eh->runTime += eh->fs.frameInterval;
+        frameElapsed(fs);
+        while (steps && fs->accum >= fs->frameInterval) {
+            fs->accum -= fs->frameInterval;
+            eh->runStep(&waitCon);
+            --steps;
+            if (eh->ended)
+                break;
+        }
 
+        xu4.assets->dispatch();
         screenSwapBuffers();
-        if (frameSleep(&eh->fs, waitTime))
+        PROFILE_FRAME_END()
+        framePace(fs);
+        if (! steps)
             break;
     }
 
@@ -266,7 +292,8 @@ bool EventHandler::wait_msecs(unsigned int msec) {
 
 /*
  * Execute the game with a deterministic loop until the current controller
- * is done or the game exits.
+ * is done or the game exits.  The simulation runs in fixed steps and is
+ * separate from the rate at which frames are presented.
  *
  * \return true if game should exit.
  */
@@ -277,27 +304,33 @@ bool EventHandler::run() {
     if (! runRecursion) {
         runTime = 0;
         fs.realTime = getTicks();
+        fs.accum = fs.frameInterval;
     }
     ++runRecursion;
 
     while (! ended && ! controllerDone) {
+        PROFILE_FRAME_BEGIN()
+        {
+        PROFILE_ZONE("handleInputEvents")
         handleInputEvents(NULL, updateScreen);
-#ifdef DEBUG
-        int key;
-        while ((key = recordedKey())) {
-            if (getController()->notifyKeyPressed(key) && updateScreen)
-                (*updateScreen)();
         }
-        recordTick();
-#endif
-        if (runTime >= timerInterval) {
-            runTime -= timerInterval;
-            timedEvents.tick();
+        frameElapsed(&fs);
+        while (fs.accum >= fs.frameInterval) {
+            fs.accum -= fs.frameInterval;
+            runStep(NULL);
+            // Leave any remaining steps to the loop which continues after
+            // this controller.
+            if (ended || controllerDone)
+                break;
         }
-        runTime += fs.frameInterval;
 
+        xu4.assets->dispatch();
         screenSwapBuffers();
-        frameSleep(&fs, 0);
+        // Nested loops may be called while images are being used.
+        if (runRecursion == 1)
+            xu4.imageMgr->trim();
+        PROFILE_FRAME_END()
+        framePace(&fs);
     }
 
     --runRecursion;
@@ -458,104 +491,232 @@ uint32_t EventHandler::replay(const char* file) {
     recordMode = MODE_REPLAY;
     return head[1];
 }
+
+/**
+ * Return true if recorded input is still being played back.
+ */
+bool EventHandler::isReplaying() const {
+    return recordMode == MODE_REPLAY;
+}
 #endif
 
 
 //----------------------------------------------------------------------------
 
 
-/* TimedEvent functions */
-TimedEvent::TimedEvent(TimedEvent::Callback cb, int i, void *d) :
-    callback(cb),
-    data(d),
-    interval(i),
-    current(0)
-{}
+/* TimedEventMgr functions */
 
-TimedEvent::Callback TimedEvent::getCallback() const    { return callback; }
-void *TimedEvent::getData()                             { return data; }
+#define NIL_EVENT   0xffff
+#define WHEEL_MASK  (TIMER_WHEEL_SIZE - 1)
+#define FIRE_LIST   (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE)
 
-/**
- * Advances the timed event forward a tick.
- * When (current >= interval), then it executes its callback function.
- */
-void TimedEvent::tick() {
-    if (++current >= interval) {
-        (*callback)(data);
-        current = 0;
-    }
+TimedEventMgr::TimedEventMgr() : now(0), freeList(NIL_EVENT) {
+    for (int i = 0; i <= FIRE_LIST; ++i)
+        wheel[i] = wheelTail[i] = NIL_EVENT;
 }
 
 /**
- * Destructs a timed event manager object.
+ * Adds a repeating timer which runs the callback every interval ticks.
+ * Returns a handle for remove().
  */
-TimedEventMgr::~TimedEventMgr() {
-    while(! events.empty()) {
-        delete events.front(), events.pop_front();
-    }
-    while(! deferredRemovals.empty()) {
-        delete deferredRemovals.front(), deferredRemovals.pop_front();
-    }
+TimerId TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
+    if (interval < 1)
+        interval = 1;
+    return schedule(callback, data, interval << TIMER_FRAC_BITS,
+                    TimedEvent::REPEAT);
 }
 
 /**
- * Adds a timed event to the event queue.
+ * Adds a timer with an interval in 1/TIMER_FRAC ticks.  The callback is
+ * run on the first tick at or after the scheduled time, and any fraction
+ * is carried over so a repeating timer keeps its average rate.
+ *
+ * \param flags     TimedEvent::REPEAT or TimedEvent::ONCE.
+ * \return Timer handle, or zero if the pool is full.
  */
-void TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
-    events.push_back(new TimedEvent(callback, interval, data));
+TimerId TimedEventMgr::schedule(TimedEvent::Callback callback, void *data,
+                                uint32_t interval, int flags) {
+    TimedEvent* ev;
+    uint16_t n;
+
+    if (freeList != NIL_EVENT) {
+        n = freeList;
+        ev = &events[n];
+        freeList = ev->next;
+    } else {
+        if (events.size() >= NIL_EVENT)
+            return 0;
+        n = events.size();
+        events.resize(n + 1);
+        ev = &events[n];
+        ev->serial = 0;
+    }
+    if (++ev->serial == 0)
+        ev->serial = 1;
+
+    // Run at most once per tick.
+    if (interval < TIMER_FRAC)
+        interval = TIMER_FRAC;
+
+    ev->callback = callback;
+    ev->data     = data;
+    ev->interval = interval;
+    ev->flags    = flags;
+    ev->due      = now - 1 + (interval >> TIMER_FRAC_BITS);
+    ev->frac     = interval & (TIMER_FRAC - 1);
+    link(n);
+
+    return uint32_t(ev->serial) << 16 | n;
 }
 
 /**
- * Removes a timed event from the event queue.
+ * Removes a timer by handle.  Returns false if the handle is no longer
+ * valid (a one-shot timer which has run, or a timer already removed).
  */
-TimedEventMgr::List::iterator TimedEventMgr::remove(List::iterator i) {
-    if (isLocked()) {
-        deferredRemovals.push_back(*i);
-        return i;
-    }
-    else {
-        delete *i;
-        return events.erase(i);
-    }
-}
-
-void TimedEventMgr::remove(TimedEvent* event) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i) == event) {
-            remove(i);
-            break;
+bool TimedEventMgr::remove(TimerId id) {
+    uint16_t n = id & 0xffff;
+    if (n < events.size()) {
+        const TimedEvent& ev = events[n];
+        if (ev.callback && ev.serial == (id >> 16)) {
+            unlink(n);
+            release(n);
+            return true;
         }
     }
+    return false;
 }
 
+/**
+ * Removes the first timer with the given callback & data.  This searches
+ * all timers; prefer removing by handle.
+ */
 void TimedEventMgr::remove(TimedEvent::Callback callback, void *data) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i)->getCallback() == callback && (*i)->getData() == data) {
-            remove(i);
+    size_t i;
+    for (i = 0; i < events.size(); ++i) {
+        const TimedEvent& ev = events[i];
+        if (ev.callback == callback && ev.data == data) {
+            unlink(i);
+            release(i);
             break;
         }
     }
 }
 
-/**
- * Runs each of the callback functions of the TimedEvents associated with this manager.
+/*
+ * Insert a timer into the wheel list for its due tick.  Timers due within
+ * TIMER_WHEEL_SIZE ticks go into the first level, others into a coarser
+ * level from which they are cascaded down as the time approaches.
  */
-void TimedEventMgr::tick() {
-    List::iterator i;
+void TimedEventMgr::link(uint16_t n) {
+    TimedEvent* ev = &events[n];
+    uint32_t due = ev->due;
+    int32_t delta = int32_t(due - now);
+    int slot;
+
+    if (delta < 0)
+        slot = now & WHEEL_MASK;        // Overdue; run on the next tick.
+    else if (delta < (1 << TIMER_WHEEL_BITS))
+        slot = due & WHEEL_MASK;
+    else if (delta < (1 << 2*TIMER_WHEEL_BITS))
+        slot = TIMER_WHEEL_SIZE + ((due >> TIMER_WHEEL_BITS) & WHEEL_MASK);
+    else if (delta < (1 << 3*TIMER_WHEEL_BITS))
+        slot = 2*TIMER_WHEEL_SIZE + ((due >> 2*TIMER_WHEEL_BITS) & WHEEL_MASK);
+    else
+        slot = 3*TIMER_WHEEL_SIZE + ((due >> 3*TIMER_WHEEL_BITS) & WHEEL_MASK);
+
+    // Append so that timers due on the same tick run in the order they
+    // were added.
+    ev->slot = slot;
+    ev->prev = wheelTail[slot];
+    ev->next = NIL_EVENT;
+    if (ev->prev == NIL_EVENT)
+        wheel[slot] = n;
+    else
+        events[ev->prev].next = n;
+    wheelTail[slot] = n;
+}
 
-    // Lock the event list so it cannot be modified during iteration.
-    locked = true;
+void TimedEventMgr::unlink(uint16_t n) {
+    TimedEvent* ev = &events[n];
+    if (ev->prev == NIL_EVENT)
+        wheel[ev->slot] = ev->next;
+    else
+        events[ev->prev].next = ev->next;
+    if (ev->next == NIL_EVENT)
+        wheelTail[ev->slot] = ev->prev;
+    else
+        events[ev->next].prev = ev->prev;
+}
 
-    for (i = events.begin(); i != events.end(); i++)
-        (*i)->tick();
+void TimedEventMgr::release(uint16_t n) {
+    TimedEvent* ev = &events[n];
+    ev->callback = NULL;
+    ev->next = freeList;
+    freeList = n;
+}
+
+/*
+ * Re-insert the timers of one coarse wheel slot so they move to a finer
+ * level.  Returns the slot index.
+ */
+int TimedEventMgr::cascade(int level, int index) {
+    int slot = level * TIMER_WHEEL_SIZE + index;
+    uint16_t n = wheel[slot];
+    uint16_t next;
+
+    wheel[slot] = wheelTail[slot] = NIL_EVENT;
+    while (n != NIL_EVENT) {
+        next = events[n].next;
+        link(n);
+        n = next;
+    }
+    return index;
+}
 
-    locked = false;
+/**
+ * Runs the callbacks of the timers which are due on this tick.
+ */
+void TimedEventMgr::tick() {
+    PROFILE_ZONE("TimedEventMgr::tick")
+    TimedEvent* ev;
+    TimedEvent::Callback callback;
+    void* data;
+    uint16_t n;
+    int index = now & WHEEL_MASK;
+
+    if (! index &&
+        ! cascade(1, (now >> TIMER_WHEEL_BITS) & WHEEL_MASK) &&
+        ! cascade(2, (now >> 2*TIMER_WHEEL_BITS) & WHEEL_MASK))
+        cascade(3, (now >> 3*TIMER_WHEEL_BITS) & WHEEL_MASK);
+
+    // Move the due timers to a separate list so that callbacks can add &
+    // remove timers while it is being run.
+    n = wheel[FIRE_LIST] = wheel[index];
+    wheelTail[FIRE_LIST] = wheelTail[index];
+    wheel[index] = wheelTail[index] = NIL_EVENT;
+    for (; n != NIL_EVENT; n = events[n].next)
+        events[n].slot = FIRE_LIST;
+    ++now;
+
+    while ((n = wheel[FIRE_LIST]) != NIL_EVENT) {
+        unlink(n);
+        ev = &events[n];
+        callback = ev->callback;
+        data = ev->data;
+
+        if (ev->flags & TimedEvent::ONCE) {
+            release(n);
+        } else {
+            uint32_t frac = ev->frac + (ev->interval & (TIMER_FRAC - 1));
+            ev->due += (ev->interval >> TIMER_FRAC_BITS) +
+                       (frac >> TIMER_FRAC_BITS);
+            ev->frac = frac & (TIMER_FRAC - 1);
+            link(n);
+        }
 
-    // Remove events that have been deferred for removal
-    for (i = deferredRemovals.begin(); i != deferredRemovals.end(); i++)
-        events.remove(*i);
+        // The events vector may be resized by the callback.
+        (*callback)(data);
+    }
 }
 
 void EventHandler::pushMouseAreaSet(MouseArea *mouseAreas) {
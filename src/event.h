@@ -121,27 +121,37 @@ public:
 };
 
 /**
- * A class for handling timed events.
+ * Handle of a timer added to a TimedEventMgr.  Zero is never a valid handle.
  */
-class TimedEvent {
-public:
-    /* Typedefs */
-    typedef void (*Callback)(void *);
+typedef uint32_t TimerId;
 
-    /* Constructors */
-    TimedEvent(Callback callback, int interval, void *data = NULL);
+#define TIMER_FRAC_BITS     8
+#define TIMER_FRAC          (1 << TIMER_FRAC_BITS)  // Interval units per tick.
 
-    /* Member functions */
-    Callback getCallback() const;
-    void *getData();
-    void tick();
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SIZE    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS  4
 
-    /* Properties */
-protected:
-    Callback callback;
+/**
+ * A timer held in the storage pool of a TimedEventMgr.
+ */
+struct TimedEvent {
+    typedef void (*Callback)(void *);
+
+    enum Flags {
+        REPEAT = 0,
+        ONCE   = 1      // Removed after the callback is run.
+    };
+
+    Callback callback;  // NULL when the storage is free.
     void *data;
-    int interval;
-    int current;
+    uint32_t due;       // Tick on which the callback is next run.
+    uint32_t interval;  // Ticks in TIMER_FRAC fixed point.
+    uint16_t frac;      // Sub-tick part of due.
+    uint16_t flags;
+    uint16_t serial;    // Changed each time the storage is reused.
+    uint16_t slot;      // Wheel list holding the timer.
+    uint16_t prev, next;
 };
 
 #if defined(IOS)
@@ -157,39 +167,46 @@ typedef void *UIEvent;
 
 /**
  * A class for managing timed events
+ *
+ * Timers are kept in a hierarchical timing wheel so the cost of adding,
+ * removing, and running them does not depend on how many are pending.
+ * Callbacks may add or remove any timer, including their own.
  */
 class TimedEventMgr {
 public:
-    typedef std::list<TimedEvent*> List;
-
-    TimedEventMgr() : locked(false) {}
-    ~TimedEventMgr();
+    TimedEventMgr();
 
-    /** Returns true if the event list is locked (in use) */
-    bool isLocked() const { return locked; }
-
-    void add(TimedEvent::Callback callback, int interval, void *data = NULL);
-    List::iterator remove(List::iterator i);
-    void remove(TimedEvent* event);
+    TimerId add(TimedEvent::Callback callback, int interval, void *data = NULL);
+    TimerId schedule(TimedEvent::Callback callback, void *data,
+                     uint32_t interval, int flags);
+    bool remove(TimerId id);
     void remove(TimedEvent::Callback callback, void *data = NULL);
     void tick();
 
 private:
-    /* Properties */
-    bool locked;
-    List events;
-    List deferredRemovals;
+    void link(uint16_t n);
+    void unlink(uint16_t n);
+    void release(uint16_t n);
+    int cascade(int level, int index);
+
+    uint32_t now;       // Tick to be run next.
+    uint16_t freeList;
+    std::vector<TimedEvent> events;
+    uint16_t wheel[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE + 1];
+    uint16_t wheelTail[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SIZE + 1];
 };
 
-#define FS_SAMPLES  8
+#define FS_MAX_STEPS    8   // Simulation steps allowed to catch up a stall.
 
+/*
+ * The game is simulated in fixed steps of frameInterval milliseconds while
+ * frames are presented as often as the screen pacing allows.
+ */
 struct FrameSleep {
-    uint32_t frameInterval;     // Milliseconds between display updates.
+    uint32_t frameInterval;     // Milliseconds per simulation step.
     uint32_t realTime;
-    int ftime[FS_SAMPLES];      // Msec elapsed for past frames.
-    int ftimeSum;
-    uint16_t ftimeIndex;
-    uint16_t fsleep;            // Msec to sleep - adjusted slowly.
+    uint32_t accum;             // Real msec elapsed but not yet simulated.
+    float frameSeconds;         // Real time between the last two frames.
 };
 
 typedef void(*updateScreenCallback)(void);
@@ -252,8 +269,11 @@ public:
     int  recordedKey();
     void recordTick() { ++recordClock; }
     uint32_t replay(const char* file);
+    bool isReplaying() const;
 #endif
 
+    float frameSeconds() const { return fs.frameSeconds; }
+
     void advanceFlourishAnim() {
         anim_advance(&flourishAnim, float(timerInterval) * 0.001f);
     }
@@ -263,6 +283,7 @@ public:
 
 protected:
     void handleInputEvents(Controller*, updateScreenCallback);
+    void runStep(Controller*);
 
     FrameSleep fs;
     uint32_t timerInterval;     // Milliseconds between timedEvents ticks.
@@ -279,6 +300,7 @@ protected:
     bool ended;
     TimedEventMgr timedEvents;
     std::vector<Controller *> controllers;
+    std::vector<TimerId> controllerTimers;
     MouseAreaList mouseAreaSets;
     updateScreenCallback updateScreen;
 };
@@ -0,0 +1,28 @@
+/*
+ * event_headless.cpp
+ *
+ * There is no input device in a headless build; all key presses come from
+ * a recording passed with --replay.  The game exits once the recording is
+ * exhausted.
+ */
+
+#include "event.h"
+#include "xu4.h"
+
+/*
+ * \param waitCon  Unused; there are no input events to dispatch.
+ */
+void EventHandler::handleInputEvents(Controller* waitCon,
+                                     updateScreenCallback update) {
+#ifdef DEBUG
+    if (! isReplaying())
+#endif
+        quitGame();
+}
+
+/**
+ * Sets the key-repeat characteristics of the keyboard.
+ */
+int EventHandler::setKeyRepeat(int delay, int interval) {
+    return 0;
+}
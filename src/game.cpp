@@ -66,6 +66,9 @@ void gameDestroyAllCreatures(void);
 void gameFixupObjects(Map *map, const SaveGameMonsterRecord* table);
 void gameCreatureAttack(Creature *obj);
 
+/* map functions */
+void gamePrefetchMaps(const Location* loc);
+
 /* Functions END */
 /*---------------*/
 
@@ -141,7 +144,9 @@ int AlphaActionController::get(char lastValidLetter, const string &prompt, Event
 }
 
 GameController::GameController() : TurnController(1),
-    mapArea(BORDER_WIDTH, BORDER_HEIGHT, VIEWPORT_W, VIEWPORT_H),
+    mapArea(BORDER_WIDTH, BORDER_HEIGHT,
+            screenState()->viewW, screenState()->viewH,
+            VIEWPORT_W * TILE_WIDTH, VIEWPORT_H * TILE_HEIGHT),
     cutScene(false)
 {
     gs_listen(1<<SENDER_LOCATION | 1<<SENDER_PARTY, gameNotice, this);
@@ -154,6 +159,7 @@ GameController::~GameController() {
 
 bool GameController::present() {
     xu4.screenImage->fill(Image::black);
+    screenInvalidateMapArea();
 
     if (c == NULL || (xu4.intro && xu4.intro->hasInitiatedNewGame()))
         return initContext();   // Loads current savegame
@@ -498,6 +504,7 @@ void GameController::setMap(Map *map, bool saveLocation, const Portal *portal, T
     }
     c->location = new Location(coords, map, viewMode, context, turnCompleter, c->location);
     c->party->setActivePlayer(activePlayer);
+    gamePrefetchMaps(c->location);
 #ifdef IOS
     U4IOS::updateGameControllerContext(c->location->context);
 #endif
@@ -2266,6 +2273,8 @@ horse_moved:
         if (checkMoongates())
             event.result = (MoveResult)(MOVE_MAP_CHANGE | MOVE_END_TURN);
     }
+
+    gamePrefetchMaps(c->location);
 }
 
 /**
@@ -3168,6 +3177,62 @@ void gameFixupObjects(Map *map, const SaveGameMonsterRecord* table) {
     }
 }
 
+#define PREFETCH_PORTAL_RANGE   3
+#define PREFETCH_HOSTILE_RANGE  4
+
+struct PrefetchQuery {
+    const Location* loc;
+    const Tile* ground;
+};
+
+static int prefetchHostileArena(Object* obj, void* user) {
+    PrefetchQuery* pq = (PrefetchQuery*) user;
+    const Location* loc = pq->loc;
+
+    if (obj->objType == Object::UNKNOWN ||
+        obj->coords.z != loc->coords.z ||
+        map_movementDistance(obj->coords, loc->coords, loc->map) >
+            PREFETCH_HOSTILE_RANGE)
+        return Map::QueryContinue;
+
+    const Creature* m = dynamic_cast<Creature*>(obj);
+    if (obj->objType == Object::PERSON ?
+            (obj->movement != MOVEMENT_ATTACK_AVATAR) : ! m->willAttack())
+        return Map::QueryContinue;
+
+    if (! pq->ground)
+        pq->ground = battleGround(loc->map, loc->coords);
+    xu4.config->prefetchMap(CombatMap::mapForTile(pq->ground,
+                            c->party->getTransport().getTileType(), obj));
+    return Map::QueryContinue;
+}
+
+/**
+ * Start reading the maps which the party is likely to enter next; those
+ * of nearby portals and the combat arena of any approaching hostiles.
+ */
+void gamePrefetchMaps(const Location* loc) {
+    Map* map = loc->map;
+
+    PortalList::const_iterator it;
+    foreach (it, map->portals) {
+        const Portal* portal = *it;
+        if (portal->coords.z == loc->coords.z &&
+            map_movementDistance(portal->coords, loc->coords, map) <=
+                PREFETCH_PORTAL_RANGE)
+            xu4.config->prefetchMap(portal->destid);
+    }
+
+    if (loc->context & (CTX_COMBAT | CTX_DUNGEON))
+        return;
+
+    PrefetchQuery pq;
+    pq.loc = loc;
+    pq.ground = NULL;
+    map->queryObjects(loc->coords, PREFETCH_HOSTILE_RANGE,
+                      prefetchHostileArena, &pq);
+}
+
 /**
  * Handles what happens when a creature attacks you
  */
@@ -21,9 +21,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "assetloader.h"
+#include "profile.h"
+#include "screen.h"
+#include "settings.h"
 #include "tileanim.h"
 #include "tileset.h"
 #include "tileview.h"
+#include "u4.h"
+#include "xu4.h"
 
 //#include "gpu_opengl.h"
 
@@ -36,6 +42,7 @@ extern uint32_t getTicks();
 
 #define LOC_POS     0
 #define LOC_UV      1
+#define LOC_SPRITE  2
 
 const char* solid_vertShader =
     "#version 330\n"
@@ -101,6 +108,12 @@ static const uint8_t whitePixels[] = {
 };
 
 #define SHADOW_DIM      512
+#define SHAPE_ROWS      ((VIEWPORT_MAX_W * VIEWPORT_MAX_H + 63) / 64)
+
+// Sprite instance attributes: X, Y, UV index, flags.
+#define SPRITE_ATTR_COUNT   4
+#define SPRITE_STRIDE       (sizeof(float) * SPRITE_ATTR_COUNT)
+#define SPRITE_UV_COLUMNS   64      // Must match world.glsl uvTable.
 
 
 #ifdef _WIN32
@@ -216,20 +229,16 @@ static char* readShader(const char* filename)
     if (! ent)
         return NULL;
 
+    const uint8_t* data = xu4.config->moduleData(ent);
+    if (! data)
+        return NULL;
+
+    // Copy to add the nul terminator.
     char* buf = (char*) malloc(ent->bytes + 1);
     if (buf) {
-        FILE* fp = fopen(xu4.config->modulePath(), "rb");
-        if (fp) {
-            fseek(fp, ent->offset, SEEK_SET);
-
-            size_t len = fread(buf, 1, ent->bytes, fp);
-            fclose(fp);
-            if (len == ent->bytes) {
-                buf[len] = '\0';
-                return buf;
-            }
-        }
-        free(buf);
+        memcpy(buf, data, ent->bytes);
+        buf[ent->bytes] = '\0';
+        return buf;
     }
 #else
     char fnBuf[40];
@@ -256,10 +265,13 @@ static char* readShader(const char* filename)
 
 /*
  * Returns zero on success or 1-4 to indicate compile/link/read error.
+ *
+ * \param defines  Extra preprocessor lines for the vertex shader or NULL.
  */
-static int compileSLFile(GLuint program, const char* filename, int scale)
+static int compileSLFile(GLuint program, const char* filename, int scale,
+                         const char* defines)
 {
-    const char* src[4];
+    const char* src[5];
     int res = 4;
     char* buf = readShader(filename);
 
@@ -270,12 +282,15 @@ static int compileSLFile(GLuint program, const char* filename, int scale)
                 spos[6] = '0' + scale;
         }
 
+        int vcount = 2;
         src[0] = "#version 330\n#define VERTEX\n";
-        src[1] = buf;
-        src[2] = "#version 330\n#define FRAGMENT\n";
-        src[3] = buf;
+        if (defines)
+            src[vcount++] = defines;
+        src[vcount]   = buf;
+        src[vcount+1] = "#version 330\n#define FRAGMENT\n";
+        src[vcount+2] = buf;
 
-        res = compileShaderParts(program, src, 2, 2);
+        res = compileShaderParts(program, src, vcount + 1, 2);
         free(buf);
     }
     return res;
@@ -292,6 +307,24 @@ static void _defineAttributeLayout(GLuint vao, GLuint vbo)
                           (const GLvoid*) 12);
 }
 
+#ifdef GPU_RENDER
+/*
+ * Define a layout which draws the quad once for each sprite in vbo.
+ */
+static void _defineSpriteLayout(GLuint vao, GLuint quad, GLuint vbo)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, quad);
+    glEnableVertexAttribArray(LOC_POS);
+    glVertexAttribPointer(LOC_POS, 3, GL_FLOAT, GL_FALSE, ATTR_STRIDE, 0);
+    glDisableVertexAttribArray(LOC_UV);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(LOC_SPRITE);
+    glVertexAttribPointer(LOC_SPRITE, 4, GL_FLOAT, GL_FALSE, SPRITE_STRIDE, 0);
+    glVertexAttribDivisor(LOC_SPRITE, 1);
+}
+#endif
+
 #ifdef GPU_RENDER
 static GLuint _makeFramebuffer(GLuint texId)
 {
@@ -338,10 +371,10 @@ static GLuint loadTexture(const char* file, GLuint useTex)
 {
     GLuint texId = 0;
     const CDIEntry* ent = xu4.config->fileEntry(file);
-    if (ent) {
-        U4FILE* uf = u4fopen_stdio(xu4.config->modulePath());
+    const uint8_t* data = ent ? xu4.config->moduleData(ent) : NULL;
+    if (data) {
+        U4FILE* uf = u4fopen_mem(data, ent->bytes);
         if (uf) {
-            u4fseek(uf, ent->offset, SEEK_SET);
             Image* img = loadImage_png(uf);
             u4fclose(uf);
             if (img) {
@@ -401,10 +434,10 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     gr->tilesTex = 0;
     */
 #ifdef GPU_RENDER
-    gr->dl[0].buf = GLOB_DRAW_LIST0;
-    gr->dl[0].byteSize = ATTR_STRIDE * 6 * 400;
-    gr->dl[1].buf = GLOB_FX_LIST0;
-    gr->dl[1].byteSize = ATTR_STRIDE * 6 * 20;
+    gr->dl[0].buf = GLOB_SPRITE_LIST0;
+    gr->dl[0].byteSize = SPRITE_STRIDE * 2048;
+    gr->dl[1].buf = GLOB_SPRITEFX_LIST0;
+    gr->dl[1].byteSize = SPRITE_STRIDE * 256;
     gr->dl[2].buf = GLOB_MAPFX_LIST0;
     gr->dl[2].byteSize = ATTR_STRIDE * 6 * 8;
 #endif
@@ -428,6 +461,14 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     if (! gr->shadowFbo)
         return "shadow FBO";
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    // Shape table for the largest view; 64 shapes per row.
+    glGenTextures(1, &gr->shapeTex);
+    glBindTexture(GL_TEXTURE_2D, gr->shapeTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, 64, SHAPE_ROWS, 0,
+                 GL_RGB, GL_FLOAT, NULL);
 #endif
 
 
@@ -449,7 +490,7 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
             return "hq2x.png";
 
         gr->scaler = sh = glCreateProgram();
-        if (compileSLFile(sh, "hq2x.glsl", scale))
+        if (compileSLFile(sh, "hq2x.glsl", scale, NULL))
             return "hq2x.glsl";
 
         gr->slocScMat = glGetUniformLocation(sh, "MVPMatrix");
@@ -465,7 +506,7 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     }
     else if (filter == 2 && scale > 1) {
         gr->scaler = sh = glCreateProgram();
-        if (compileSLFile(sh, "xbr-lv2.glsl", scale))
+        if (compileSLFile(sh, "xbr-lv2.glsl", scale, NULL))
             return "xbr-lv2.glsl";
 
         gr->slocScMat = 0;
@@ -510,7 +551,7 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
 
     // Create shadowcast shader.
     gr->shadow = sh = glCreateProgram();
-    if (compileSLFile(sh, "shadowcast.glsl", 0))
+    if (compileSLFile(sh, "shadowcast.glsl", 0, NULL))
         return "shadowcast.glsl";
 
     gr->shadowTrans  = glGetUniformLocation(sh, "transform");
@@ -518,11 +559,13 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     gr->shadowViewer = glGetUniformLocation(sh, "viewer");
     gr->shadowCounts = glGetUniformLocation(sh, "shape_count");
     gr->shadowShapes = glGetUniformLocation(sh, "shapes");
+    glUseProgram(sh);
+    glUniform1i(gr->shadowShapes, GTU_SHAPES);
 
 
     // Create world shader.
     gr->shadeWorld = sh = glCreateProgram();
-    if (compileSLFile(sh, "world.glsl", 0))
+    if (compileSLFile(sh, "world.glsl", 0, NULL))
         return "world.glsl";
 
     gr->worldTrans     = glGetUniformLocation(sh, "transform");
@@ -538,6 +581,24 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     glUniform1i(mmap, GTU_MATERIAL);
     glUniform1i(noise, GTU_NOISE);
     glUniform1i(gr->worldShadowMap, GTU_SHADOW);
+
+
+    // Create sprite shader.
+    gr->shadeSprite = sh = glCreateProgram();
+    if (compileSLFile(sh, "world.glsl", 0, "#define INSTANCED\n"))
+        return "world.glsl (instanced)";
+
+    gr->spriteTrans    = glGetUniformLocation(sh, "transform");
+    gr->spriteScroll   = glGetUniformLocation(sh, "scroll");
+    gr->spriteSize     = glGetUniformLocation(sh, "spriteSize");
+
+    glUseProgram(sh);
+    glUniformMatrix4fv(gr->spriteTrans, 1, GL_FALSE, unitMatrix);
+    glUniform1i(glGetUniformLocation(sh, "cmap"), GTU_CMAP);
+    glUniform1i(glGetUniformLocation(sh, "mmap"), GTU_MATERIAL);
+    glUniform1i(glGetUniformLocation(sh, "noise2D"), GTU_NOISE);
+    glUniform1i(glGetUniformLocation(sh, "shadowMap"), GTU_SHADOW);
+    glUniform1i(glGetUniformLocation(sh, "uvTable"), GTU_UV_TABLE);
 #endif
 
 
@@ -546,8 +607,8 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
 
 #ifdef GPU_RENDER
     // Reserve space in the double-buffered draw lists.
-    reserveDrawList(gr->vbo + GLOB_DRAW_LIST0, gr->dl[0].byteSize);
-    reserveDrawList(gr->vbo + GLOB_FX_LIST0,   gr->dl[1].byteSize);
+    reserveDrawList(gr->vbo + GLOB_SPRITE_LIST0,   gr->dl[0].byteSize);
+    reserveDrawList(gr->vbo + GLOB_SPRITEFX_LIST0, gr->dl[1].byteSize);
     reserveDrawList(gr->vbo + GLOB_MAPFX_LIST0,gr->dl[2].byteSize);
 #endif
 
@@ -559,6 +620,10 @@ const char* gpu_init(void* res, int w, int h, int scale, int filter)
     glGenVertexArrays(GLOB_COUNT, gr->vao);
     for(int i = 0; i < GLOB_COUNT; ++i)
         _defineAttributeLayout(gr->vao[i], gr->vbo[i]);
+#ifdef GPU_RENDER
+    for(int i = GLOB_SPRITE_LIST0; i <= GLOB_SPRITEFX_LIST1; ++i)
+        _defineSpriteLayout(gr->vao[i], gr->vbo[GLOB_QUAD], gr->vbo[i]);
+#endif
     glBindVertexArray(0);
 
     return NULL;
@@ -573,14 +638,25 @@ void gpu_free(void* res)
         glDeleteTextures(1, &gr->scalerLut);
     }
 
+#ifdef GPU_RENDER
+    if (gr->mapBuild) {
+        xu4.assets->cancel(ASSET_CHUNK);
+        free(gr->mapBuild);
+    }
+#endif
+
     glDeleteVertexArrays(GLOB_COUNT, gr->vao);
     glDeleteBuffers(GLOB_COUNT, gr->vbo);
     glDeleteProgram(gr->shadeColor);
 #ifdef GPU_RENDER
     glDeleteProgram(gr->shadeSolid);
     glDeleteProgram(gr->shadeWorld);
+    glDeleteProgram(gr->shadeSprite);
+    if (gr->tilesUVTex)
+        glDeleteTextures(1, &gr->tilesUVTex);
     glDeleteProgram(gr->shadow);
     glDeleteFramebuffers(1, &gr->shadowFbo);
+    glDeleteTextures(1, &gr->shapeTex);
 #endif
     glDeleteTextures(4, &gr->screenTex);
 }
@@ -605,6 +681,21 @@ void gpu_blitTexture(uint32_t tex, int x, int y, const Image32* img)
                     GL_RGBA, GL_UNSIGNED_BYTE, img->pixels);
 }
 
+/*
+ * Copy an area of an image to the same position in a texture of equal size.
+ *
+ * \param rect  Area x, y, width & height.
+ */
+void gpu_blitTextureRect(uint32_t tex, const Image32* img, const int* rect)
+{
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, img->w);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, rect[0], rect[1], rect[2], rect[3],
+                    GL_RGBA, GL_UNSIGNED_BYTE,
+                    img->pixels + rect[1] * img->w + rect[0]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 void gpu_freeTexture(uint32_t tex)
 {
     glDeleteTextures(1, &tex);
@@ -620,12 +711,35 @@ uint32_t gpu_screenTexture(void* res)
 }
 
 #ifdef GPU_RENDER
-void gpu_setTilesTexture(void* res, uint32_t tex, uint32_t mat, float vDim)
+/*
+ * \param uvs      Table of four floats (minU,minV,maxU,maxV) per tile.
+ * \param uvCount  Number of tiles in the uvs table.
+ */
+void gpu_setTilesTexture(void* res, uint32_t tex, uint32_t mat, float vDim,
+                         const float* uvs, int uvCount)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
     gr->tilesTex = tex;
     gr->tilesMat = mat;
     gr->tilesVDim = vDim;
+
+    // Store the UV table in a texture so that sprites can be drawn using
+    // only their tile index.
+    int rows = (uvCount + SPRITE_UV_COLUMNS - 1) / SPRITE_UV_COLUMNS;
+    size_t rowSize = SPRITE_UV_COLUMNS * 4 * sizeof(float);
+    float* table = (float*) calloc(rows, rowSize);
+    if (table) {
+        memcpy(table, uvs, uvCount * 4 * sizeof(float));
+
+        if (! gr->tilesUVTex)
+            glGenTextures(1, &gr->tilesUVTex);
+        glBindTexture(GL_TEXTURE_2D, gr->tilesUVTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SPRITE_UV_COLUMNS, rows,
+                     0, GL_RGBA, GL_FLOAT, table);
+        free(table);
+    }
 }
 #endif
 
@@ -755,6 +869,75 @@ void gpu_drawTris(void* res, int list)
     glDrawArrays(GL_TRIANGLES, 0, dl->count / ATTR_COUNT);
 }
 
+/*
+ * Begin adding sprites to a double-buffered draw list.  Sprites are drawn
+ * with instancing so only their position & tile are stored.
+ *
+ * Returns a pointer to the start of the instance buffer.  This should be
+ * advanced by gpu_emitSprite() and passed to gpu_endTris() when all
+ * sprites have been added.
+ *
+ * \param list  The list identifier in the range 0-1.
+ * \param w     Width of every sprite in the list.
+ * \param h     Height of every sprite in the list.
+ */
+float* gpu_beginSprites(void* res, int list, float w, float h)
+{
+    OpenGLResources* gr = (OpenGLResources*) res;
+    DrawList* dl = gr->dl + list;
+
+    dl->size[0] = w;
+    dl->size[1] = h;
+    dl->buf ^= 1;
+    glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[ dl->buf ]);
+    gr->dptr = (GLfloat*) glMapBufferRange(GL_ARRAY_BUFFER, 0, dl->byteSize,
+                                           GL_MAP_WRITE_BIT |
+                                           GL_MAP_INVALIDATE_BUFFER_BIT);
+    return gr->dptr;
+}
+
+/*
+ * Draw the sprites created between the last gpu_beginSprites/endTris calls
+ * with a single instanced draw call.
+ */
+void gpu_drawSprites(void* res, int list)
+{
+    OpenGLResources* gr = (OpenGLResources*) res;
+    DrawList* dl = gr->dl + list;
+
+    if (! dl->count)
+        return;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBlendEquation(GL_FUNC_ADD);
+
+    glUseProgram(gr->shadeSprite);
+    glUniform2f(gr->spriteScroll, gr->tilesVDim, gr->time);
+    glUniform2f(gr->spriteSize, dl->size[0], dl->size[1]);
+    glActiveTexture(GL_TEXTURE0 + GTU_UV_TABLE);
+    glBindTexture(GL_TEXTURE_2D, gr->tilesUVTex);
+
+    glBindVertexArray(gr->vao[ dl->buf ]);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, dl->count / SPRITE_ATTR_COUNT);
+}
+
+/*
+ * Add a sprite with its lower-left corner at x,y to a list begun with
+ * gpu_beginSprites().
+ *
+ * \param uvIndex  Index of the tile in the gpu_setTilesTexture() UV table.
+ * \param flags    Passed to the shader as texCoord.p.
+ */
+float* gpu_emitSprite(float* attr, float x, float y, int uvIndex, float flags)
+{
+    *attr++ = x;
+    *attr++ = y;
+    *attr++ = (float) uvIndex;
+    *attr++ = flags;
+    return attr;
+}
+
 float* gpu_emitQuad(float* attr, const float* drawRect, const float* uvRect)
 {
     float w = drawRect[2];
@@ -930,7 +1113,23 @@ float* gpu_emitQuadFlag(float* attr, const float* drawRect)
 //--------------------------------------
 // Map Rendering
 
-#define CHUNK_CACHE_SIZE    4
+/*
+ * Map geometry is kept in a ring of mapChunkCount vertex buffers which each
+ * hold one chunk.  The least recently drawn chunk is replaced when another
+ * is needed.  The chunks ahead of the view in the direction of travel are
+ * built on the AssetLoader thread so that only the upload is done here when
+ * they come into view.
+ */
+
+struct ChunkBuild {
+    OpenGLResources* gr;
+    const TileId* src;          // Map data aligned at top-left of chunk.
+    float* attr;                // Vertices (mapChunkVertCount).
+    MapFx fx[CHUNK_FX_LIMIT];
+    TileId fxTile[CHUNK_FX_LIMIT];
+    int fxUsed;
+    uint16_t chunkId;           // 0xffff when the build is unused.
+};
 
 #ifdef MAP_ANIMATOR
 static void stopChunkAnimations(Animator* animator, MapFx* it, int count)
@@ -948,6 +1147,10 @@ static void stopChunkAnimations(Animator* animator, MapFx* it, int count)
 void gpu_resetMap(void* res, const Map* map)
 {
     OpenGLResources* gr = (OpenGLResources*) res;
+    int i;
+
+    // Builds read the map data so they must be stopped first.
+    xu4.assets->cancel(ASSET_CHUNK);
 
     gr->blockCount = 0;
     gr->mapData    = map->data;
@@ -960,10 +1163,42 @@ void gpu_resetMap(void* res, const Map* map)
     gr->mapChunkDim = map->chunk_width;
     gr->mapChunkVertCount = gr->mapChunkDim * gr->mapChunkDim * 6;
 
-    for (int i = 0; i < CHUNK_CACHE_SIZE; ++i) {
-        glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[ GLOB_MAP_CHUNK0+i ]);
-        glBufferData(GL_ARRAY_BUFFER, gr->mapChunkVertCount * ATTR_STRIDE,
-                     NULL, GL_DYNAMIC_DRAW);
+    // A view can span more than two chunks in each direction, and there is
+    // no point in drawing more than one copy of the map.
+    {
+    const ScreenState* ss = screenState();
+    int cdim = gr->mapChunkDim;
+    int spanW = (ss->viewW < map->width)  ? ss->viewW : map->width;
+    int spanH = (ss->viewH < map->height) ? ss->viewH : map->height;
+    int need;
+    for (;;) {
+        need = ((spanW & ~1) / cdim + 2) * ((spanH & ~1) / cdim + 2);
+        if (need <= CHUNK_CACHE_MAX)
+            break;
+        if (spanW > spanH)
+            spanW -= 2;
+        else
+            spanH -= 2;
+    }
+    gr->mapSpanW = spanW;
+    gr->mapSpanH = spanH;
+
+    i = xu4.settings->mapChunkCache;
+    if (i < need)
+        i = need;
+    if (i < 4)
+        i = 4;
+    else if (i > CHUNK_CACHE_MAX)
+        i = CHUNK_CACHE_MAX;
+    gr->mapChunkCount = i;
+    }
+
+    for (i = 0; i < CHUNK_CACHE_MAX; ++i) {
+        if (i < gr->mapChunkCount) {
+            glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[ GLOB_MAP_CHUNK0+i ]);
+            glBufferData(GL_ARRAY_BUFFER, gr->mapChunkVertCount * ATTR_STRIDE,
+                         NULL, GL_DYNAMIC_DRAW);
+        }
 
 #ifdef MAP_ANIMATOR
         int fxUsed = gr->mapChunkFxUsed[i];
@@ -974,8 +1209,24 @@ void gpu_resetMap(void* res, const Map* map)
     }
 
     // Clear chunk cache.
-    memset(gr->mapChunkId, 0xff, CHUNK_CACHE_SIZE*sizeof(uint16_t));
-    memset(gr->mapChunkFxUsed, 0, CHUNK_CACHE_SIZE*sizeof(uint16_t));
+    memset(gr->mapChunkId, 0xff, CHUNK_CACHE_MAX*sizeof(uint16_t));
+    memset(gr->mapChunkFxUsed, 0, CHUNK_CACHE_MAX*sizeof(uint16_t));
+    memset(gr->mapChunkUse, 0, CHUNK_CACHE_MAX*sizeof(uint32_t));
+    gr->mapFrame = 1;
+
+    // Allocate the background build buffers.
+    free(gr->mapBuild);
+    gr->mapBuild = (ChunkBuild*) malloc(CHUNK_BUILD_MAX *
+                        (sizeof(ChunkBuild) + gr->mapChunkVertCount * ATTR_STRIDE));
+    if (gr->mapBuild) {
+        float* attr = (float*) (gr->mapBuild + CHUNK_BUILD_MAX);
+        for (i = 0; i < CHUNK_BUILD_MAX; ++i) {
+            gr->mapBuild[i].gr = gr;
+            gr->mapBuild[i].attr = attr;
+            gr->mapBuild[i].chunkId = 0xffff;
+            attr += gr->mapChunkVertCount * ATTR_STRIDE / sizeof(float);
+        }
+    }
 }
 
 struct ChunkLoc {
@@ -984,8 +1235,6 @@ struct ChunkLoc {
 
 struct ChunkInfo {
     OpenGLResources* gr;
-    const float* uvs;
-    uint16_t* mapChunkId;
     ChunkLoc* chunkLoc;
     int geoUsedMask;
 };
@@ -1026,54 +1275,30 @@ static void _initFxInvert(MapFx* fx, TileId tid, float* drawRect,
     fx->v2 = uvCur[1] + tileTexCoordH * py;
     fx->v  =   fx->v2 + tileTexCoordH * ph;
 #endif
-
-#ifdef EMULATE_U4
-    fx->anim = anim_startCycleRandomI(MAP_ANIMATOR,
-                                      0.25, ANIM_FOREVER, 0,
-                                      0, 2, tile->anim->random);
-#endif
+    fx->anim = ANIM_UNUSED;
 }
 
 /*
- * \param chunk    Map data aligned at top-left of chunk.
+ * Generate the vertices & effects of a chunk.  This only reads the map and
+ * does not call OpenGL so it is safe to run on the loader thread.
+ *
+ * \param attr  Vertex attributes for mapChunkVertCount vertices.
  */
-static void _buildChunkGeo(ChunkInfo* ci, int i, const TileId* chunk)
+static void _buildChunkGeo(ChunkBuild* cb, float* attr)
 {
     float drawRect[4];  // x, y, width, height
     const float* uvCur;
     const float* uvScroll;
-    float* attr;
     const TileId* ip;
     const TileRenderData* tr;
-    const float* uvTable = ci->uvs;
-    OpenGLResources* gr = ci->gr;
+    const OpenGLResources* gr = cb->gr;
+    const float* uvTable = gr->mapUVs;
+    const TileId* chunk = cb->src;
     float startX;
     int x, y;
     int stride = gr->mapW;          // Map tile width
     int cdim   = gr->mapChunkDim;   // Chunk tile dimensions
-    int fxUsed;
-
-
-#ifdef MAP_ANIMATOR
-    // Stop any running animations.
-    fxUsed = gr->mapChunkFxUsed[i];
-    if (fxUsed) {
-        stopChunkAnimations(MAP_ANIMATOR,
-                            gr->mapChunkFx + i*CHUNK_FX_LIMIT, fxUsed);
-        fxUsed = 0;
-    }
-#else
-    fxUsed = 0;
-#endif
-
-    glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[GLOB_MAP_CHUNK0 + i]);
-    attr = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0,
-                                     gr->mapChunkVertCount * ATTR_STRIDE,
-                                     GL_MAP_WRITE_BIT);
-    if (! attr) {
-        fprintf(stderr, "buildChunkGeo: glMapBufferRange failed\n");
-        return;
-    }
+    int fxUsed = 0;
 
     // Placing center of the top left tile at the origin.
     startX = -0.5f * VIEW_TILE_SIZE;
@@ -1097,8 +1322,8 @@ static void _buildChunkGeo(ChunkInfo* ci, int i, const TileId* chunk)
                 attr = gpu_emitQuadFire(attr, drawRect, uvCur, uOff);
             } else {
                 if (tr->animType == ATYPE_INVERT && fxUsed < CHUNK_FX_LIMIT) {
-                    _initFxInvert(gr->mapChunkFx + i*CHUNK_FX_LIMIT + fxUsed,
-                                  ip[-1], drawRect, uvCur);
+                    _initFxInvert(cb->fx + fxUsed, ip[-1], drawRect, uvCur);
+                    cb->fxTile[fxUsed] = ip[-1];
                     ++fxUsed;
                 }
                 attr = gpu_emitQuad(attr, drawRect, uvCur);
@@ -1109,8 +1334,112 @@ static void _buildChunkGeo(ChunkInfo* ci, int i, const TileId* chunk)
         chunk += stride;
     }
 
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    gr->mapChunkFxUsed[i] = fxUsed;
+    cb->fxUsed = fxUsed;
+}
+
+/*
+ * Assign the effects of a built chunk to a chunk buffer & start their
+ * animations.
+ */
+static void _assignChunk(OpenGLResources* gr, int i, const ChunkBuild* cb)
+{
+    MapFx* fx = gr->mapChunkFx + i*CHUNK_FX_LIMIT;
+
+#ifdef MAP_ANIMATOR
+    // Stop any running animations.
+    if (gr->mapChunkFxUsed[i])
+        stopChunkAnimations(MAP_ANIMATOR, fx, gr->mapChunkFxUsed[i]);
+#endif
+
+    gr->mapChunkId[i] = cb->chunkId;
+    gr->mapChunkFxUsed[i] = cb->fxUsed;
+    memcpy(fx, cb->fx, cb->fxUsed * sizeof(MapFx));
+
+#ifdef EMULATE_U4
+    for (int n = 0; n < cb->fxUsed; ++n) {
+        const Tile* tile = Tileset::findTileById(cb->fxTile[n]);
+        fx[n].anim = anim_startCycleRandomI(MAP_ANIMATOR,
+                                            0.25, ANIM_FOREVER, 0,
+                                            0, 2, tile->anim->random);
+    }
+#endif
+}
+
+/*
+ * Return the chunk buffer holding chunkId or -1 if it is not cached.
+ */
+static int _findChunk(const OpenGLResources* gr, uint16_t chunkId)
+{
+    for (int i = 0; i < gr->mapChunkCount; ++i) {
+        if (gr->mapChunkId[i] == chunkId)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Return the least recently drawn chunk buffer.  Buffers drawn in the
+ * current frame are never chosen.
+ */
+static int _replaceableChunk(const OpenGLResources* gr)
+{
+    int i, lru = -1;
+    for (i = 0; i < gr->mapChunkCount; ++i) {
+        if (gr->mapChunkId[i] == 0xffff)
+            return i;
+        if (gr->mapChunkUse[i] != gr->mapFrame &&
+            (lru < 0 || gr->mapChunkUse[i] < gr->mapChunkUse[lru]))
+            lru = i;
+    }
+    return lru;
+}
+
+static void chunkJobWork(AssetJob* job)
+{
+    ChunkBuild* cb = (ChunkBuild*) job->result;
+    _buildChunkGeo(cb, cb->attr);
+    job->ok = true;
+}
+
+static void chunkJobFinish(AssetJob* job)
+{
+    ChunkBuild* cb = (ChunkBuild*) job->result;
+    OpenGLResources* gr = cb->gr;
+
+    if (_findChunk(gr, cb->chunkId) < 0) {
+        int i = _replaceableChunk(gr);
+        if (i >= 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[GLOB_MAP_CHUNK0 + i]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0,
+                            gr->mapChunkVertCount * ATTR_STRIDE, cb->attr);
+            _assignChunk(gr, i, cb);
+        }
+    }
+    cb->chunkId = 0xffff;
+}
+
+static void chunkJobDiscard(AssetJob* job)
+{
+    ((ChunkBuild*) job->result)->chunkId = 0xffff;
+}
+
+/*
+ * Finish any background build of chunkId.
+ * Return the chunk buffer used or -1 if there was no build.
+ */
+static int _waitChunkBuild(OpenGLResources* gr, uint16_t chunkId)
+{
+    if (gr->mapBuild) {
+        for (int n = 0; n < CHUNK_BUILD_MAX; ++n) {
+            if (gr->mapBuild[n].chunkId == chunkId) {
+                AssetJob* job = xu4.assets->find(ASSET_CHUNK, gr->mapBuild + n);
+                if (job)
+                    xu4.assets->wait(job);
+                return _findChunk(gr, chunkId);
+            }
+        }
+    }
+    return -1;
 }
 
 #define WRAP(x,loc,limit) \
@@ -1127,17 +1456,18 @@ static void _buildChunkGeo(ChunkInfo* ci, int i, const TileId* chunk)
 #define CHUNK_ID(c,r)       (c<<8 | r)
 
 /*
- * Find (or create) chunk geometry in the four reserved VBO slots.
- * Return the chunk vertex buffer used (0-3), or -1 if no slot is available.
+ * Find (or create) chunk geometry in the chunk buffer ring.
+ * Return the chunk vertex buffer used, or -1 if no buffer is available.
  *
  * \param x         Map tile column.
  * \param y         Map tile row.
- * \param bumpPass  Replace a cached chunk.
+ * \param bumpPass  Replace the least recently drawn chunk if not cached.
  */
 static int _obtainChunkGeo(ChunkInfo* ci, int x, int y, int bumpPass)
 {
     OpenGLResources* gr = ci->gr;
     ChunkLoc* loc;
+    float* attr;
     int i;
     int ccol, crow;
     int cdim = gr->mapChunkDim;
@@ -1150,40 +1480,46 @@ static int _obtainChunkGeo(ChunkInfo* ci, int x, int y, int bumpPass)
     crow = y / cdim;
     chunkId = CHUNK_ID(ccol, crow);
 
-    if (bumpPass)
-    {
-        // Find unassigned chunk to replace.
-        for (i = 0; i < CHUNK_CACHE_SIZE; ++i) {
-            if ((ci->geoUsedMask & (1 << i)) == 0)
-                goto build;
-        }
+    // Check if already made.
+    i = _findChunk(gr, chunkId);
+    if (i >= 0)
+        goto used;
+    if (! bumpPass)
+        return -1;
+
+    i = _waitChunkBuild(gr, chunkId);
+    if (i >= 0)
+        goto used;
+
+    i = _replaceableChunk(gr);
+    if (i < 0) {
         // This should never be reached unless the function is called more
-        // than CHUNK_CACHE_SIZE times.
+        // than mapChunkCount times.
         assert(0 && "bumpPass failed");
         return -1;
     }
-    else
-    {
-        // Check if already made.
-        for (i = 0; i < CHUNK_CACHE_SIZE; ++i) {
-            if (ci->mapChunkId[i] == chunkId)
-                goto used;
-        }
 
-        // Find unused VBO.
-        for (i = 0; i < CHUNK_CACHE_SIZE; ++i) {
-            if (ci->mapChunkId[i] == 0xffff)
-                goto build;
-        }
+    {
+    ChunkBuild cb;
+    cb.gr  = gr;
+    cb.src = gr->mapData + (crow * gr->mapW + ccol) * cdim;
+    cb.chunkId = chunkId;
 
-        // No unused VBO, fail.
+    glBindBuffer(GL_ARRAY_BUFFER, gr->vbo[GLOB_MAP_CHUNK0 + i]);
+    attr = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                     gr->mapChunkVertCount * ATTR_STRIDE,
+                                     GL_MAP_WRITE_BIT);
+    if (! attr) {
+        fprintf(stderr, "buildChunkGeo: glMapBufferRange failed\n");
         return -1;
     }
+    _buildChunkGeo(&cb, attr);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    _assignChunk(gr, i, &cb);
+    }
 
-build:
-    ci->mapChunkId[i] = chunkId;
-    _buildChunkGeo(ci, i, gr->mapData + (crow * gr->mapW + ccol) * cdim);
 used:
+    gr->mapChunkUse[i] = gr->mapFrame;
     loc = ci->chunkLoc + i;
     loc->x = wx + (ccol * cdim);
     loc->y = wy + (crow * cdim);
@@ -1191,6 +1527,80 @@ used:
     return i;
 }
 
+/*
+ * Queue a background build of the chunk at map tile x, y (which may be
+ * outside the map).
+ */
+static void _prefetchChunk(OpenGLResources* gr, int x, int y)
+{
+    ChunkBuild* cb;
+    ChunkBuild* avail = NULL;
+    int cdim = gr->mapChunkDim;
+    int n;
+    uint16_t chunkId;
+
+    x %= gr->mapW;
+    if (x < 0)
+        x += gr->mapW;
+    y %= gr->mapH;
+    if (y < 0)
+        y += gr->mapH;
+    chunkId = CHUNK_ID(x / cdim, y / cdim);
+
+    if (_findChunk(gr, chunkId) >= 0)
+        return;
+    for (n = 0; n < CHUNK_BUILD_MAX; ++n) {
+        cb = gr->mapBuild + n;
+        if (cb->chunkId == chunkId)
+            return;
+        if (cb->chunkId == 0xffff)
+            avail = cb;
+    }
+    if (! avail)
+        return;
+
+    AssetJob job;
+    job.work    = chunkJobWork;
+    job.finish  = chunkJobFinish;
+    job.discard = chunkJobDiscard;
+    job.key     = avail;
+    job.file    = NULL;
+    job.result  = avail;
+    job.size    = 0;
+    job.id      = chunkId;
+    job.group   = 0;
+    job.kind    = ASSET_CHUNK;
+    job.flag    = false;
+
+    avail->src = gr->mapData + ((y / cdim) * gr->mapW + (x / cdim)) * cdim;
+    avail->chunkId = chunkId;
+    if (! xu4.assets->request(job))
+        avail->chunkId = 0xffff;
+}
+
+/*
+ * Start building the chunks that the view will enter next if it keeps
+ * moving in the same direction.
+ */
+static void _prefetchAhead(OpenGLResources* gr, int dx, int dy,
+                           int left, int top, int right, int bot)
+{
+    int cdim = gr->mapChunkDim;
+    int ex = (dx > 0) ? right + cdim : left - cdim;
+    int ey = (dy > 0) ? bot + cdim : top - cdim;
+
+    if (dx) {
+        _prefetchChunk(gr, ex, top);
+        _prefetchChunk(gr, ex, bot);
+    }
+    if (dy) {
+        _prefetchChunk(gr, left,  ey);
+        _prefetchChunk(gr, right, ey);
+    }
+    if (dx && dy)
+        _prefetchChunk(gr, ex, ey);
+}
+
 /*
  * \param view          Pointer to TileView with a valid map.
  * \param tileUVs       Table of four floats (minU,minV,maxU,maxV) per tile.
@@ -1204,8 +1614,9 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
                  const BlockingGroups* blocks,
                  int cx, int cy, float scale)
 {
+    PROFILE_ZONE("gpu_drawMap")
     OpenGLResources* gr = (OpenGLResources*) res;
-    ChunkLoc cloc[4];   // Tile location of chunks on the map.
+    ChunkLoc cloc[CHUNK_CACHE_MAX];     // Tile location of chunks on the map.
     int i, usedMask;
 
     // Render shadows.
@@ -1215,10 +1626,18 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
             glUseProgram(gr->shadow);
             glUniformMatrix4fv(gr->shadowTrans, 1, GL_FALSE, unitMatrix);
             glUniform4f(gr->shadowVport, 0.0f, 0.0f, SHADOW_DIM, SHADOW_DIM);
-            glUniform3f(gr->shadowViewer, 0.0f, 0.0f, 11.0f);
+            glUniform4f(gr->shadowViewer, 0.0f, 0.0f,
+                        (float) view->columns, (float) view->rows);
             glUniform3i(gr->shadowCounts, blocks->left, blocks->center,
                                           blocks->right);
-            glUniform3fv(gr->shadowShapes, gr->blockCount, blocks->tilePos);
+
+            i = (gr->blockCount + 63) / 64;
+            if (i > SHAPE_ROWS)
+                i = SHAPE_ROWS;
+            glActiveTexture(GL_TEXTURE0 + GTU_SHAPES);
+            glBindTexture(GL_TEXTURE_2D, gr->shapeTex);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 64, i, GL_RGB, GL_FLOAT,
+                            &blocks->tilePos[0]);
 
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gr->shadowFbo);
             glViewport(0, 0, SHADOW_DIM, SHADOW_DIM);
@@ -1233,40 +1652,64 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
 
     {
     ChunkInfo ci;
-    int bindex[4];  // Chunk vertex buffer index (0-3) at view corner.
+    int bindex[CHUNK_CACHE_MAX];  // Chunk vertex buffer index of sample.
+    int sampleX[CHUNK_CACHE_MAX];
+    int sampleY[CHUNK_CACHE_MAX];
     int left, top, right, bot;
     int halfW, halfH;
+    int x, y, n;
 
     ci.gr = gr;
-    ci.uvs = tileUVs;
-    ci.mapChunkId = gr->mapChunkId;
     ci.chunkLoc = cloc;
     ci.geoUsedMask = 0;
+    gr->mapUVs = tileUVs;
+    ++gr->mapFrame;
 
     // FIXME: Apply scale.
-    halfW = view->columns / 2;
-    halfH = view->rows / 2;
+    halfW = ((view->columns < gr->mapSpanW) ? view->columns : gr->mapSpanW) / 2;
+    halfH = ((view->rows < gr->mapSpanH) ? view->rows : gr->mapSpanH) / 2;
 
     left  = cx - halfW;
     right = cx + halfW;
     top   = cy - halfH;
     bot   = cy + halfH;
 
+    // Sample the view every chunk dimension (and at the far edges) so that
+    // every chunk it overlaps is visited.
+    n = 0;
+    for (y = top; ; y += gr->mapChunkDim) {
+        if (y > bot)
+            y = bot;
+        for (x = left; ; x += gr->mapChunkDim) {
+            if (x > right)
+                x = right;
+            sampleX[n] = x;
+            sampleY[n] = y;
+            ++n;
+            if (x == right)
+                break;
+        }
+        if (y == bot)
+            break;
+    }
+
     // First pass to see what chunks are cached.
-    bindex[0] = _obtainChunkGeo(&ci, left,  top, 0);
-    bindex[1] = _obtainChunkGeo(&ci, right, top, 0);
-    bindex[2] = _obtainChunkGeo(&ci, left,  bot, 0);
-    bindex[3] = _obtainChunkGeo(&ci, right, bot, 0);
-
-    // Second pass to bump any cached chunks (if needed).
-    if (bindex[0] < 0)
-        _obtainChunkGeo(&ci, left,  top, 1);
-    if (bindex[1] < 0)
-        _obtainChunkGeo(&ci, right, top, 1);
-    if (bindex[2] < 0)
-        _obtainChunkGeo(&ci, left,  bot, 1);
-    if (bindex[3] < 0)
-        _obtainChunkGeo(&ci, right, bot, 1);
+    for (i = 0; i < n; ++i)
+        bindex[i] = _obtainChunkGeo(&ci, sampleX[i], sampleY[i], 0);
+
+    // Second pass to bump the least recently used chunks (if needed).
+    for (i = 0; i < n; ++i) {
+        if (bindex[i] < 0)
+            _obtainChunkGeo(&ci, sampleX[i], sampleY[i], 1);
+    }
+
+    // Only speculate when there are buffers to spare beyond those in view.
+    if (gr->mapChunkCount > n && gr->mapBuild &&
+        (cx != gr->mapViewX || cy != gr->mapViewY))
+        _prefetchAhead(gr, cx - gr->mapViewX, cy - gr->mapViewY,
+                       left, top, right, bot);
+    gr->mapViewX = cx;
+    gr->mapViewY = cy;
 
     usedMask = ci.geoUsedMask;
     }
@@ -1303,7 +1746,7 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
 
     glDisable(GL_BLEND);
 
-    for (i = 0; i < 4; ++i) {
+    for (i = 0; i < gr->mapChunkCount; ++i) {
         if (usedMask & (1 << i)) {
             // Position chunk in viewport.
             matrix[ MAT_X ] = (float) (cloc[i].x - cx) * scale;
@@ -1323,7 +1766,7 @@ void gpu_drawMap(void* res, const TileView* view, const float* tileUVs,
         float rect[4];
         float xoff, yoff;
         float* fxAttr = gpu_beginTris(gr, MAPFX_LIST);
-        for (i = 0; i < 4; ++i) {
+        for (i = 0; i < gr->mapChunkCount; ++i) {
             if (usedMask & (1 << i) && gr->mapChunkFxUsed[i]) {
                 xoff = (float) (cloc[i].x - cx);
                 yoff = (float) (cy - cloc[i].y);
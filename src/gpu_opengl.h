@@ -12,19 +12,20 @@
 #include "anim.h"
 #include "tile.h"
 
+#define CHUNK_CACHE_MAX 16
+#define CHUNK_BUILD_MAX 4
+
 enum GLObject {
     GLOB_QUAD,
 #ifdef GPU_RENDER
-    GLOB_DRAW_LIST0,
-    GLOB_DRAW_LIST1,
-    GLOB_FX_LIST0,
-    GLOB_FX_LIST1,
+    GLOB_SPRITE_LIST0,
+    GLOB_SPRITE_LIST1,
+    GLOB_SPRITEFX_LIST0,
+    GLOB_SPRITEFX_LIST1,
     GLOB_MAPFX_LIST0,
     GLOB_MAPFX_LIST1,
     GLOB_MAP_CHUNK0,
-    GLOB_MAP_CHUNK1,
-    GLOB_MAP_CHUNK2,
-    GLOB_MAP_CHUNK3,
+    GLOB_MAP_CHUNK_LAST = GLOB_MAP_CHUNK0 + CHUNK_CACHE_MAX - 1,
 #endif
     GLOB_COUNT
 };
@@ -34,13 +35,16 @@ enum GLTextureUnit {
     GTU_MATERIAL,
     GTU_NOISE,
     GTU_SHADOW,
-    GTU_SCALER_LUT
+    GTU_SCALER_LUT,
+    GTU_UV_TABLE,
+    GTU_SHAPES
 };
 
 struct DrawList {
     int     buf;        // GLObject vbo index toggle.
     int     byteSize;
     GLsizei count;      // Number of floats.
+    float   size[2];    // Sprite width & height (see gpu_beginSprites).
 };
 
 #define CHUNK_FX_LIMIT  8
@@ -51,12 +55,15 @@ struct MapFx {
     AnimId anim;
 };
 
+struct ChunkBuild;
+
 struct OpenGLResources {
     GLuint screenTex;
     GLuint whiteTex;
     GLuint noiseTex;
     GLuint shadowTex;
     GLuint shadowFbo;
+    GLuint shapeTex;            // BlockingGroups tilePos for shadowcast.
     GLuint vbo[ GLOB_COUNT ];
     GLuint vao[ GLOB_COUNT ];
 
@@ -88,8 +95,14 @@ struct OpenGLResources {
     GLint  worldShadowMap;
     GLint  worldScroll;
 
+    GLuint shadeSprite;
+    GLint  spriteTrans;
+    GLint  spriteScroll;
+    GLint  spriteSize;
+
     GLuint tilesTex;            // Managed by user.
     GLuint tilesMat;            // Managed by user.
+    GLuint tilesUVTex;          // UV table of tilesTex for shadeSprite.
     float  tilesVDim;
     float  time;
     DrawList dl[3];
@@ -101,8 +114,17 @@ struct OpenGLResources {
     uint16_t mapW;
     uint16_t mapH;
     uint16_t mapChunkDim;       // Size in tiles (width & height are the same).
-    uint16_t mapChunkId[4];     // Chunk X,Y of associated GLOB_MAP_CHUNK.
-    uint16_t mapChunkFxUsed[4];
-    MapFx mapChunkFx[4*CHUNK_FX_LIMIT];
+    uint16_t mapChunkCount;     // Number of GLOB_MAP_CHUNK buffers used.
+    uint16_t mapSpanW;          // Maximum view width & height drawn.
+    uint16_t mapSpanH;
+    uint16_t mapChunkId[CHUNK_CACHE_MAX];   // Chunk X,Y of GLOB_MAP_CHUNK.
+    uint16_t mapChunkFxUsed[CHUNK_CACHE_MAX];
+    uint32_t mapChunkUse[CHUNK_CACHE_MAX];  // mapFrame when last drawn.
+    uint32_t mapFrame;
+    int      mapViewX;          // Center of previous gpu_drawMap().
+    int      mapViewY;
+    const float* mapUVs;
+    ChunkBuild* mapBuild;       // CHUNK_BUILD_MAX background builds.
+    MapFx mapChunkFx[CHUNK_CACHE_MAX*CHUNK_FX_LIMIT];
 #endif
 };
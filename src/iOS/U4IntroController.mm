@@ -86,7 +86,7 @@
     if (finishFirstTimeLoad)
         return;
     finishFirstTimeLoad = YES;
-    screenInit();
+    screenInit(false);
     ProgressBar pb((320/2) - (200/2), (200/2), 200, 10, 0, 7);
     pb.setBorderColor(240, 240, 240);
     pb.setColor(0, 0, 128);
@@ -59,9 +59,103 @@ Image *Image::duplicate(const Image *image) {
  * Frees the image.
  */
 Image::~Image() {
+    delete dirty;
     image32_freePixels(this);
 }
 
+/**
+ * Enable or disable recording of the areas changed by the drawing methods.
+ * When enabled the whole image is initially marked as dirty.
+ */
+void Image::trackChanges(bool on) {
+    if (on) {
+        if (! dirty)
+            dirty = new ImageDirty;
+        dirty->count = 0;
+        markDirty(0, 0, w, h);
+    } else {
+        delete dirty;
+        dirty = NULL;
+    }
+}
+
+/**
+ * Add a rectangle to the dirty areas if change tracking is enabled.
+ * The rectangle is clipped to the image and merged with any dirty area it
+ * overlaps or touches.  If the list is full then it is merged with the
+ * area that grows the least.
+ */
+void Image::markDirty(int x, int y, int rw, int rh) {
+    ImageDirty* dr = dirty;
+    int* r;
+    int x2, y2, i, area, growth, best, bestGrowth;
+
+    if (! dr)
+        return;
+
+    x2 = x + rw;
+    y2 = y + rh;
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x2 > int(w))
+        x2 = w;
+    if (y2 > int(h))
+        y2 = h;
+    if (x >= x2 || y >= y2)
+        return;
+
+merge:
+    for (i = 0; i < dr->count; ++i) {
+        r = dr->rect[i];
+        if (x <= r[0] + r[2] && r[0] <= x2 &&
+            y <= r[1] + r[3] && r[1] <= y2)
+            goto absorb;
+    }
+
+    if (dr->count < DIRTY_RECT_MAX) {
+        r = dr->rect[dr->count++];
+        r[0] = x;
+        r[1] = y;
+        r[2] = x2 - x;
+        r[3] = y2 - y;
+        return;
+    }
+
+    best = 0;
+    bestGrowth = 0;
+    for (i = 0; i < DIRTY_RECT_MAX; ++i) {
+        r = dr->rect[i];
+        area = (std::max(x2, r[0] + r[2]) - std::min(x, r[0])) *
+               (std::max(y2, r[1] + r[3]) - std::min(y, r[1]));
+        growth = area - r[2] * r[3];
+        if (i == 0 || growth < bestGrowth) {
+            best = i;
+            bestGrowth = growth;
+        }
+    }
+    i = best;
+    r = dr->rect[i];
+
+absorb:
+    // Remove rectangle i and retry with the union as it may now touch
+    // other areas.
+    x  = std::min(x, r[0]);
+    y  = std::min(y, r[1]);
+    x2 = std::max(x2, r[0] + r[2]);
+    y2 = std::max(y2, r[1] + r[3]);
+    --dr->count;
+    if (i != dr->count) {
+        const int* last = dr->rect[dr->count];
+        r[0] = last[0];
+        r[1] = last[1];
+        r[2] = last[2];
+        r[3] = last[3];
+    }
+    goto merge;
+}
+
 RGBA Image::setColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
     RGBA color;
     rgba_set(color, r, g, b, a);
@@ -72,6 +166,8 @@ void Image::putPixel(int x, int y, int r, int g, int b, int a) {
     RGBA col;
     rgba_set(col, r, g, b, a);
     pixels[ y*w + x ] = *((uint32_t*) &col);
+    if (dirty)
+        markDirty(x, y, 1, 1);
 }
 
 void Image::makeColorTransparent(const RGBA& bgColor, int haloSize, int shadowOpacity)
@@ -94,6 +190,8 @@ void Image::performTransparencyHack(const RGBA& transColor,
 
     if (bottom > h)
         bottom = h;     // Keep bottom <= height.
+    if (dirty)
+        markDirty(0, top, w, bottom - top);
 
     for (y = top; y < bottom; y++) {
         cp = (RGBA*) (pixels + y*w);
@@ -139,6 +237,8 @@ void Image::performTransparencyHack(const RGBA& transColor,
  */
 void Image::putPixelIndex(int x, int y, uint32_t index) {
     pixels[ y*w + x ] = index;
+    if (dirty)
+        markDirty(x, y, 1, 1);
 }
 
 /**
@@ -152,6 +252,8 @@ void Image::fill(const RGBA& col) {
 #else
     image32_fill(this, &col);
 #endif
+    if (dirty)
+        markDirty(0, 0, w, h);
 }
 
 /**
@@ -187,6 +289,9 @@ void Image::fillRect(int x, int y, int rw, int rh, int r, int g, int b, int a) {
     if (blitH < 1)
         return;
 
+    if (dirty)
+        markDirty(x, y, blitW, blitH);
+
     while (blitH--) {
         dp = drow;
         dend = dp + blitW;
@@ -224,7 +329,10 @@ void Image::getPixelIndex(int x, int y, unsigned int &index) const {
  * Draws the entire image onto the screen at the given offset.
  */
 void Image::draw(int x, int y) const {
-    image32_blit(xu4.screenImage, x, y, this, blending);
+    Image* dest = xu4.screenImage;
+    image32_blit(dest, x, y, this, blending);
+    if (dest->dirty)
+        dest->markDirty(x, y, w, h);
 }
 
 /**
@@ -232,7 +340,10 @@ void Image::draw(int x, int y) const {
  * The area of the image to draw is defined by the rectangle rx, ry, rw, rh.
  */
 void Image::drawSubRect(int x, int y, int rx, int ry, int rw, int rh) const {
-    image32_blitRect(xu4.screenImage, x, y, this, rx, ry, rw, rh, blending);
+    Image* dest = xu4.screenImage;
+    image32_blitRect(dest, x, y, this, rx, ry, rw, rh, blending);
+    if (dest->dirty)
+        dest->markDirty(x, y, rw, rh);
 }
 
 /**
@@ -252,7 +363,7 @@ void Image::drawSubRect(int x, int y, int rx, int ry, int rw, int rh) const {
 void Image::drawLetter(int dx, int dy, int sx, int sy, int sw, int sh,
                        const RGBA* palette, const RGBA* bg) const
 {
-    Image32* dest = xu4.screenImage;
+    Image* dest = xu4.screenImage;
     uint32_t background = *((uint32_t*) &black);
     uint32_t* drow;
     const uint32_t* srow;
@@ -261,6 +372,9 @@ void Image::drawLetter(int dx, int dy, int sx, int sy, int sw, int sh,
     CLIP_SUB(dx, sx, sw, w, dest->w)
     CLIP_SUB(dy, sy, sh, h, dest->h)
 
+    if (dest->dirty)
+        dest->markDirty(dx, dy, sw, sh);
+
     srow = pixels + w * sy + sx;
     drow = dest->pixels + dest->w * dy + dx;
 
@@ -314,44 +428,18 @@ void Image::drawLetter(int dx, int dy, int sx, int sy, int sw, int sh,
  * Draws a piece of the image flipped vertically onto another image.
  */
 void Image::drawSubRectInvertedOn(Image *dest, int x, int y, int rx, int ry, int rw, int rh) const {
-    uint32_t* dp;
-    uint32_t* drow;
-    const uint32_t* sp;
-    const uint32_t* send;
-    const uint32_t* srow;
-
     if (dest == NULL)
         dest = xu4.screenImage;
-
-    // Clip position and source rect to positive values.
-    CLIP_SUB(x, rx, rw, w, dest->w)
-    CLIP_SUB(y, ry, rh, h, dest->h)
-
-    srow = pixels + w * ry + rx;
-    drow = dest->pixels + dest->w * y + x;
-
-    srow += w * (rh - 1);
-    while (rh--) {
-        dp = drow;
-        sp = srow;
-        send = sp + rw;
-        while( sp != send )
-            *dp++ = *sp++;
-        drow += dest->w;
-        srow -= w;
-    }
+    image32_blitRectFlipV(dest, x, y, this, rx, ry, rw, rh);
+    if (dest->dirty)
+        dest->markDirty(x, y, rw, rh);
 }
 
 /**
  * Invert the RGB values of image.
  */
 void Image::drawHighlighted() {
-    RGBA* col = (RGBA*) pixels;
-    RGBA* end = col + w*h;
-    while (col != end) {
-        col->r = 0xff - col->r;
-        col->g = 0xff - col->g;
-        col->b = 0xff - col->b;
-        ++col;
-    }
+    image32_invertRGB(this);
+    if (dirty)
+        markDirty(0, 0, w, h);
 }
@@ -16,6 +16,18 @@ typedef struct CGLayer *CGLayerRef;
 #define IM_OPAQUE       255
 #define IM_TRANSPARENT  0
 
+#define DIRTY_RECT_MAX  8
+
+/*
+ * The areas of an image which have been written since the last
+ * Image::clearDirty().  Overlapping or adjacent rectangles are merged so
+ * there are never more than DIRTY_RECT_MAX.
+ */
+struct ImageDirty {
+    int count;
+    int rect[DIRTY_RECT_MAX][4];    // x, y, w, h
+};
+
 /**
  * A simple image object that can be drawn and read/written to at the
  * pixel level.
@@ -69,12 +81,16 @@ public:
     /** Draws the image onto another image. */
     void drawOn(Image *d, int x, int y) const {
         image32_blit(d, x, y, this, blending);
+        if (d->dirty)
+            d->markDirty(x, y, w, h);
     }
 
     /** Draws a piece of the image onto another image. */
     void drawSubRectOn(Image *d, int x, int y,
                        int rx, int ry, int rw, int rh) const {
         image32_blitRect(d, x, y, this, rx, ry, rw, rh, blending);
+        if (d->dirty)
+            d->markDirty(x, y, rw, rh);
     }
 
     void drawSubRectInvertedOn(Image *d, int x, int y, int rx, int ry, int rw, int rh) const;
@@ -88,6 +104,12 @@ public:
     }
     void drawHighlighted();
 
+    /* change tracking */
+    void trackChanges(bool on);
+    void markDirty(int x, int y, int rw, int rh);
+    const ImageDirty* dirtyRects() const { return dirty; }
+    void clearDirty() { if (dirty) dirty->count = 0; }
+
 #ifdef IOS
     CGLayerRef getSurface() { return surface; }
     void initWithImage(CGImageRef image);
@@ -104,7 +126,9 @@ private:
 private:
     static int blending;
 
-    Image() {}      /* use create method to construct images */
+    ImageDirty* dirty;      // NULL unless trackChanges() is on.
+
+    Image() : dirty(NULL) {}    /* use create method to construct images */
 
     // disallow assignments, copy contruction
     Image(const Image&);
@@ -3,7 +3,7 @@
  */
 
 #include "rle.h"
-#include "lzw/u4decode.h"
+#include "lzw/lzw.h"
 #include "lzw/u6decode.h"
 
 /**
@@ -54,10 +54,14 @@ Image *loadImage_u4(U4FILE *file, int ftype, int width, int height, int bpp) {
         compressed = (unsigned char *) malloc(compLen);
         file->read(compressed, 1, compLen);
 
-        if (ftype == FTYPE_U4RLE)
+        if (ftype == FTYPE_U4RLE) {
             rawLen = rleDecompressMemory(compressed, compLen, (void**) &raw);
-        else
-            rawLen = decompress_u4_memory(compressed, compLen, (void**) &raw);
+        } else {
+            // The size is known so decode directly into the final buffer.
+            raw = (unsigned char *) malloc(width * height * bpp / 8);
+            rawLen = lzwDecompress(compressed, compLen,
+                                   raw, width * height * bpp / 8);
+        }
         free(compressed);
 
         if (rawLen != (width * height * bpp / 8))
@@ -75,7 +79,11 @@ Image *loadImage_u4(U4FILE *file, int ftype, int width, int height, int bpp) {
         rawLen = compressed[0] + (compressed[1]<<8) +
                  (compressed[2]<<16) + (compressed[3]<<24);
         raw = (unsigned char *) malloc(rawLen);
-        U6Decode::lzw_decompress(compressed+4, compLen-4, raw, rawLen);
+        if (U6Decode::lzw_decompress(compressed+4, compLen-4, raw, rawLen)
+                != EXIT_SUCCESS) {
+            free(compressed);
+            goto cleanup_raw;
+        }
         free(compressed);
         break;
     }
@@ -4,6 +4,7 @@
 
 #include <string.h>
 
+#include "assetloader.h"
 #include "config.h"
 #include "debug.h"
 #include "error.h"
@@ -24,7 +25,7 @@ Image *screenScale(Image *src, int scale, int n, int filter);
 
 ImageSymbols ImageMgr::sym;
 
-ImageMgr::ImageMgr() : vgaColors(NULL), resGroup(0) {
+ImageMgr::ImageMgr() : vgaColors(NULL), useClock(0), resGroup(0) {
 #ifdef TRACE_ON
     logger = new Debug("debug/imagemgr.txt", "ImageMgr");
     TRACE(*logger, "creating ImageMgr");
@@ -65,6 +66,7 @@ ImageMgr::ImageMgr() : vgaColors(NULL), resGroup(0) {
 
 ImageMgr::~ImageMgr() {
     gs_unplug(listenerId);
+    xu4.assets->cancel(ASSET_IMAGE);
 
     std::map<Symbol, ImageSet *>::iterator it;
     foreach (it, imageSets)
@@ -401,8 +403,8 @@ U4FILE * ImageMgr::getImageFile(ImageInfo *info)
     } else if (fn[0] == 'I' && fn[2] < 0x20) {
         const CDIEntry* ent = xu4.config->imageFile(fn);
         if (ent) {
-            file = u4fopen_stdio(xu4.config->modulePath());
-            u4fseek(file, ent->offset, SEEK_SET);
+            const uint8_t* data = xu4.config->moduleData(ent);
+            file = data ? u4fopen_mem(data, ent->bytes) : NULL;
         } else
             file = NULL;
     } else
@@ -426,6 +428,7 @@ ImageInfo* ImageMgr::imageInfo(Symbol name, const SubImage** subPtr) {
     if (! info) {
         subImg = getSubImage(name, &info);
         if (subImg) {
+            info->lastUse = useClock;
             if (! info->image)
                 info = load(info, false);
         }
@@ -441,6 +444,7 @@ ImageInfo *ImageMgr::get(Symbol name, bool returnUnscaled) {
     ImageInfo *info = getInfoFromSet(name, baseSet);
     if (! info)
         return NULL;
+    info->lastUse = useClock;
 
     /* return if already loaded */
     if (info->image != NULL)
@@ -574,11 +578,90 @@ static Image* buildAtlas(ImageMgr* mgr, ImageInfo* atlas) {
 }
 #endif
 
+static void imageJobWork(AssetJob* job) {
+    const ImageInfo* info = (const ImageInfo*) job->key;
+    U4FILE* file = (U4FILE*) job->file;
+
+    job->result = loadImage(file, info->filetype, info->width, info->height,
+                            info->depth);
+    u4fclose(file);
+    job->file = NULL;
+}
+
+static void imageJobDiscard(AssetJob* job) {
+    if (job->file)
+        u4fclose((U4FILE*) job->file);
+    delete (Image*) job->result;
+}
+
+void ImageMgr::finishJob(AssetJob* job) {
+    ImageInfo* info = (ImageInfo*) job->key;
+    Image* unscaled = (Image*) job->result;
+
+    if (unscaled) {
+        xu4.imageMgr->finishLoad(info, unscaled, job->group, job->flag);
+        job->ok = true;
+    } else {
+        errorWarning("Can't load image \"%s\" with type %d",
+                     xu4.config->confString(info->filename), info->filetype);
+    }
+}
+
+/**
+ * Queue an image to be read & decoded by the background loader.
+ * Nothing is done if the image is already loaded or requested.
+ */
+void ImageMgr::prefetch(Symbol name) {
+    ImageInfo* info = getInfoFromSet(name, baseSet);
+    if (! info && ! getSubImage(name, &info))
+        return;
+    if (info->image || xu4.assets->find(ASSET_IMAGE, info))
+        return;
+#ifdef CONF_MODULE
+    if (info->filetype == FTYPE_ATLAS)
+        return;
+#endif
+
+    // The palettes are loaded on demand, which must not happen on the
+    // loader thread.
+    if (info->depth == 8) {
+        if (! vgaPalette())
+            return;
+    } else if (info->depth == 4)
+        xu4.config->egaPalette();
+
+    U4FILE* file = getImageFile(info);
+    if (! file)
+        return;
+
+    AssetJob job;
+    job.work    = imageJobWork;
+    job.finish  = finishJob;
+    job.discard = imageJobDiscard;
+    job.key     = info;
+    job.file    = file;
+    job.result  = NULL;
+    job.id      = name;
+    job.group   = resGroup;
+    job.kind    = ASSET_IMAGE;
+    job.flag    = false;
+    if (! xu4.assets->request(job))
+        u4fclose(file);
+}
+
 ImageInfo* ImageMgr::load(ImageInfo* info, bool returnUnscaled) {
+    AssetJob* job = xu4.assets->find(ASSET_IMAGE, info);
+    if (job) {
+        job->flag = returnUnscaled;
+        xu4.assets->wait(job);
+        return info;
+    }
+
 #ifdef CONF_MODULE
     if (info->filetype == FTYPE_ATLAS) {
         info->image = buildAtlas(this, info);
         info->resGroup = resGroup;
+        makeResident(info);
         return info;
     }
 #endif
@@ -598,51 +681,6 @@ ImageInfo* ImageMgr::load(ImageInfo* info, bool returnUnscaled) {
                          xu4.config->confString(info->filename), info->filetype);
             return info;
         }
-
-        info->resGroup = resGroup;
-        if (info->width == -1) {
-            // Write in the values for later use.
-            info->width  = unscaled->width();
-            info->height = unscaled->height();
-        }
-
-#ifdef USE_GL
-        // Pre-compute tile UVs.
-        if (info->tiles > 1 && info->tileTexCoord == NULL ) {
-            // Assuming image is one tile wide.
-            float iwf = (float) unscaled->width();
-            float ihf = (float) unscaled->height();
-            float tileH = iwf;
-            float tileY = 0.0f;
-            float *uv;
-            int tileCount = info->tiles;
-
-            info->tileTexCoord = uv = new float[tileCount * 4];
-            for (int i = 0; i < tileCount; ++i) {
-                *uv++ = 0.0f;
-                *uv++ = tileY / ihf;
-                *uv++ = 1.0f;
-                *uv++ = (tileY + tileH) / ihf;
-                tileY += tileH;
-            }
-        }
-        /*
-        SubImage* simg = (SubImage*) info->subImages;
-        SubImage* end = simg + info->subImageCount;
-        while (simg != end) {
-            simg->u0 = simg->x / iwf;
-            simg->v0 = simg->y / ihf;
-            simg->u1 = (simg->x + simg->width) / iwf;
-            simg->v1 = (simg->y + simg->height) / ihf;
-            ++simg;
-        }
-        */
-#endif
-
-#if 0
-        string out("/tmp/xu4/");
-        unscaled->save(out.append(name).append(".ppm").c_str());
-#endif
     }
     else
     {
@@ -651,8 +689,55 @@ ImageInfo* ImageMgr::load(ImageInfo* info, bool returnUnscaled) {
         return NULL;
     }
 
-    if (unscaled == NULL)
-        return NULL;
+    finishLoad(info, unscaled, resGroup, returnUnscaled);
+    return info;
+}
+
+/*
+ * Fixup & scale a decoded image and assign it to info.
+ */
+void ImageMgr::finishLoad(ImageInfo* info, Image* unscaled, uint16_t group,
+                          bool returnUnscaled) {
+    info->resGroup = group;
+    makeResident(info);
+    if (info->width == -1) {
+        // Write in the values for later use.
+        info->width  = unscaled->width();
+        info->height = unscaled->height();
+    }
+
+#ifdef USE_GL
+    // Pre-compute tile UVs.
+    if (info->tiles > 1 && info->tileTexCoord == NULL ) {
+        // Assuming image is one tile wide.
+        float iwf = (float) unscaled->width();
+        float ihf = (float) unscaled->height();
+        float tileH = iwf;
+        float tileY = 0.0f;
+        float *uv;
+        int tileCount = info->tiles;
+
+        info->tileTexCoord = uv = new float[tileCount * 4];
+        for (int i = 0; i < tileCount; ++i) {
+            *uv++ = 0.0f;
+            *uv++ = tileY / ihf;
+            *uv++ = 1.0f;
+            *uv++ = (tileY + tileH) / ihf;
+            tileY += tileH;
+        }
+    }
+    /*
+    SubImage* simg = (SubImage*) info->subImages;
+    SubImage* end = simg + info->subImageCount;
+    while (simg != end) {
+        simg->u0 = simg->x / iwf;
+        simg->v0 = simg->y / ihf;
+        simg->u1 = (simg->x + simg->width) / iwf;
+        simg->v1 = (simg->y + simg->height) / ihf;
+        ++simg;
+    }
+    */
+#endif
 
 #ifdef USE_GL
     info->prescale = 1;
@@ -717,7 +802,7 @@ ImageInfo* ImageMgr::load(ImageInfo* info, bool returnUnscaled) {
     if (returnUnscaled)
     {
         info->image = unscaled;
-        return info;
+        return;
     }
 
     int imageScale = xu4.settings->scale;
@@ -740,8 +825,6 @@ ImageInfo* ImageMgr::load(ImageInfo* info, bool returnUnscaled) {
     info->image->save(out3.append(name).append("-scale.ppm").c_str());
 #endif
 #endif
-
-    return info;
 }
 
 /**
@@ -777,7 +860,8 @@ uint16_t ImageMgr::setResourceGroup(uint16_t group) {
 }
 
 /**
- * Free all images that are part of the specified group.
+ * Free all images that are part of the specified group.  Pinned images are
+ * kept until they are unpinned.
  */
 void ImageMgr::freeResourceGroup(uint16_t group) {
     std::map<Symbol, ImageSet *>::iterator si;
@@ -786,19 +870,121 @@ void ImageMgr::freeResourceGroup(uint16_t group) {
     foreach (si, imageSets) {
         foreach (j, si->second->info) {
             ImageInfo *info = j->second;
-            if (info->image && (info->resGroup == group)) {
+            if (info->image && (info->resGroup == group) &&
+                ! info->pinCount) {
                 //printf("ImageMgr::freeRes %s\n", info->filename.c_str());
+                freeImage(info);
+            }
+        }
+    }
+}
+
+void ImageMgr::freeImage(ImageInfo* info) {
 #ifdef USE_GL
-                if (info->tex) {
-                    gpu_freeTexture(info->tex);
-                    info->tex = 0;
-                }
+    if (info->tex) {
+        gpu_freeTexture(info->tex);
+        info->tex = 0;
+    }
 #endif
-                delete info->image;
-                info->image = NULL;
+    delete info->image;
+    info->image = NULL;
+}
+
+void ImageMgr::makeResident(ImageInfo* info) {
+    std::vector<ImageInfo*>::iterator it;
+
+    // Prefetched images have not been used yet; count them as new so that
+    // trim() does not free them before they are drawn.
+    info->lastUse = useClock;
+
+    foreach (it, resident) {
+        if (*it == info)
+            return;
+    }
+    resident.push_back(info);
+}
+
+static inline uint32_t imageBytes(const ImageInfo* info) {
+    return info->image->width() * info->image->height() * sizeof(uint32_t);
+}
+
+/**
+ * Free the least recently used images until the memory used is within
+ * Settings::imageBudget.  Pinned images are never freed, and any other
+ * image will be loaded again the next time it is requested.
+ *
+ * This must only be called between frames when no ImageInfo pointers are
+ * held other than those which are pinned.
+ */
+void ImageMgr::trim() {
+    uint32_t budget = xu4.settings->imageBudget * 1024;
+    uint32_t total = 0;
+    size_t i, n;
+
+    ++useClock;
+
+    // Drop any images freed by freeResourceGroup() & sum the rest.
+    for (i = n = 0; i < resident.size(); ++i) {
+        ImageInfo* info = resident[i];
+        if (info->image) {
+            total += imageBytes(info);
+            resident[n++] = info;
+        }
+    }
+    resident.resize(n);
+
+    if (! budget)
+        return;
+
+    while (total > budget) {
+        ImageInfo* oldest = NULL;
+        size_t oi = 0;
+        for (i = 0; i < resident.size(); ++i) {
+            ImageInfo* info = resident[i];
+            if (! info->pinCount &&
+                (! oldest || info->lastUse < oldest->lastUse)) {
+                oldest = info;
+                oi = i;
             }
         }
+        if (! oldest)
+            break;
+
+        total -= imageBytes(oldest);
+        freeImage(oldest);
+        resident.erase(resident.begin() + oi);
+    }
+}
+
+/**
+ * Report the memory used by resident images for each resource group.
+ *
+ * \return Number of ImageGroupStats written to stats.
+ */
+int ImageMgr::groupStats(ImageGroupStats* stats, int max) const {
+    std::vector<ImageInfo*>::const_iterator it;
+    int i, count = 0;
+
+    foreach (it, resident) {
+        const ImageInfo* info = *it;
+        if (! info->image)
+            continue;
+        for (i = 0; i < count; ++i) {
+            if (stats[i].group == info->resGroup)
+                break;
+        }
+        if (i == count) {
+            if (count == max)
+                continue;
+            ++count;
+            stats[i].group  = info->resGroup;
+            stats[i].images = 0;
+            stats[i].bytes  = 0;
+        }
+        ++stats[i].images;
+        stats[i].bytes += imageBytes(info);
     }
+    return count;
 }
 
 /**
@@ -842,6 +1028,8 @@ ImageSet::~ImageSet() {
 }
 
 ImageInfo::ImageInfo() {
+    pinCount = 0;
+    lastUse = 0;
 #ifdef USE_GL
     tex = 0;
     tileTexCoord = NULL;
@@ -7,6 +7,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "config.h"
 #include "image.h"
@@ -166,6 +167,8 @@ public:
     StringId filename;
     Symbol name;
     uint16_t resGroup;          /**< resource group */
+    uint16_t pinCount;          /**< image is not evicted while non-zero */
+    uint32_t lastUse;           /**< ImageMgr use clock of last get() */
     uint16_t tiles;             /**< used to scale the without bleeding colors between adjacent tiles */
     int16_t width, height;
     int16_t subImageCount;
@@ -184,6 +187,7 @@ public:
 
 class Debug;
 class Settings;
+struct AssetJob;
 
 class ImageSet {
 public:
@@ -194,6 +198,15 @@ public:
     std::map<Symbol, ImageInfo *> info;
 };
 
+/**
+ * Resident image memory of one resource group.
+ */
+struct ImageGroupStats {
+    uint16_t group;
+    uint16_t images;
+    uint32_t bytes;
+};
+
 /**
  * The image manager singleton that keeps track of all the images.
  */
@@ -206,17 +219,27 @@ public:
 
     ImageInfo* imageInfo(Symbol name, const SubImage** subPtr);
     ImageInfo* get(Symbol name, bool returnUnscaled=false);
+    void prefetch(Symbol name);
 
     uint16_t setResourceGroup(uint16_t group);
     void freeResourceGroup(uint16_t group);
+    void pin(ImageInfo* info) { ++info->pinCount; }
+    void unpin(ImageInfo* info) { if (info->pinCount) --info->pinCount; }
+    void trim();
+    int groupStats(ImageGroupStats* stats, int max) const;
 
     const RGBA* vgaPalette();
 
 private:
     static void notice(int, void*, void*);
+    static void finishJob(AssetJob*);
     const SubImage* getSubImage(Symbol name, ImageInfo** infoPtr);
     ImageInfo* load(ImageInfo* info, bool returnUnscaled);
+    void finishLoad(ImageInfo* info, Image* unscaled, uint16_t group,
+                    bool returnUnscaled);
     U4FILE * getImageFile(ImageInfo *info);
+    void makeResident(ImageInfo* info);
+    void freeImage(ImageInfo* info);
     ImageSet* scheme(Symbol setname);
     ImageInfo* getInfoFromSet(Symbol name, ImageSet *set);
 
@@ -228,10 +251,12 @@ private:
     void fixupFMTowns(Image *im);
 
     std::map<Symbol, ImageSet *> imageSets;
+    std::vector<ImageInfo*> resident;
     ImageSet *baseSet;
     RGBA* vgaColors;
     Debug *logger;
     int listenerId;
+    uint32_t useClock;
     uint16_t resGroup;
 };
 
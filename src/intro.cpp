@@ -12,6 +12,7 @@
 #include "debug.h"
 #include "error.h"
 #include "imagemgr.h"
+#include "mapmgr.h"
 #include "sound.h"
 #include "party.h"
 #include "screen.h"
@@ -99,6 +100,8 @@ bool IntroBinData::load() {
     int i;
     const UltimaSaveIds* usaveIds = xu4.config->usaveIds();
     const Tileset* tileset = xu4.config->tileset();
+    uint8_t copy[INTRO_MAP_WIDTH * INTRO_MAP_HEIGHT];  // Largest u4fspan.
+    const uint8_t* bytes;
 
     U4FILE *title = u4fopen("title.exe");
     if (!title)
@@ -129,8 +132,11 @@ bool IntroBinData::load() {
     loadMapData(&introMap, title, 0);
 #else
     introMap.resize(INTRO_MAP_WIDTH * INTRO_MAP_HEIGHT, MapTile(0));
+    bytes = u4fspan(title, INTRO_MAP_WIDTH * INTRO_MAP_HEIGHT, copy);
+    if (! bytes)
+        goto fail;
     for (i = 0; i < INTRO_MAP_HEIGHT * INTRO_MAP_WIDTH; i++)
-        introMap[i] = usaveIds->moduleId(u4fgetc(title));
+        introMap[i] = usaveIds->moduleId(bytes[i]);
 #endif
 
     u4fseek(title, INTRO_SCRIPT_TABLE_OFFSET, SEEK_SET);
@@ -139,8 +145,11 @@ bool IntroBinData::load() {
 
     u4fseek(title, INTRO_BASETILE_TABLE_OFFSET, SEEK_SET);
     baseTileTable = new const Tile*[INTRO_BASETILE_TABLE_SIZE];
+    bytes = u4fspan(title, INTRO_BASETILE_TABLE_SIZE, copy);
+    if (! bytes)
+        goto fail;
     for (i = 0; i < INTRO_BASETILE_TABLE_SIZE; i++) {
-        MapTile tile = usaveIds->moduleId(u4fgetc(title));
+        MapTile tile = usaveIds->moduleId(bytes[i]);
         baseTileTable[i] = tileset->get(tile.id);
     }
 
@@ -149,22 +158,21 @@ bool IntroBinData::load() {
        -------------------------- */
     beastie1FrameTable = new unsigned char[BEASTIE1_FRAMES];
     u4fseek(title, BEASTIE_FRAME_TABLE_OFFSET + BEASTIE1_FRAMES_OFFSET, SEEK_SET);
-    for (i = 0; i < BEASTIE1_FRAMES; i++) {
-        beastie1FrameTable[i] = u4fgetc(title);
-    }
+    u4fread(beastie1FrameTable, 1, BEASTIE1_FRAMES, title);
 
     /* --------------------------
        load beastie frame table 2
        -------------------------- */
     beastie2FrameTable = new unsigned char[BEASTIE2_FRAMES];
     u4fseek(title, BEASTIE_FRAME_TABLE_OFFSET + BEASTIE2_FRAMES_OFFSET, SEEK_SET);
-    for (i = 0; i < BEASTIE2_FRAMES; i++) {
-        beastie2FrameTable[i] = u4fgetc(title);
-    }
+    u4fread(beastie2FrameTable, 1, BEASTIE2_FRAMES, title);
 
     u4fclose(title);
-
     return true;
+
+fail:
+    u4fclose(title);
+    return false;
 }
 
 IntroController::IntroController() :
@@ -334,6 +342,7 @@ bool IntroController::init() {
     Symbol sym[2];
     xu4.config->internSymbols(sym, 2, "beast0frame00 beast1frame00");
     beastiesImg = xu4.imageMgr->get(BKGD_ANIMATE);  // Assign resource group.
+    xu4.imageMgr->pin(beastiesImg);
     beastieSub[0] = beastiesImg->subImageIndex[sym[0]];
     beastieSub[1] = beastiesImg->subImageIndex[sym[1]];
 
@@ -409,8 +418,11 @@ void IntroController::deleteIntro() {
     objectStateTable = NULL;
 #endif
 
+    if (beastiesImg) {
+        xu4.imageMgr->unpin(beastiesImg);
+        beastiesImg = NULL;
+    }
     xu4.imageMgr->freeResourceGroup(StageIntro);
-    beastiesImg = NULL;
 }
 
 unsigned char *IntroController::getSigData() {
@@ -1636,7 +1648,8 @@ void IntroController::initPlayers(SaveGame *saveGame) {
 
 
 /**
- * Preload map tiles
+ * Preload map tiles, and have the background loader read the images used by
+ * the menus & new game story, and the world map, while the titles play.
  */
 void IntroController::preloadMap()
 {
@@ -1654,6 +1667,16 @@ void IntroController::preloadMap()
             mapArea.loadTile(objectStateTable[i].tile);
     }
 #endif
+
+    uint16_t saveGroup = xu4.imageMgr->setResourceGroup(StageIntro);
+    for (const Symbol* it = &BKGD_OPTIONS_TOP; it <= &BKGD_ABACUS; ++it)
+        xu4.imageMgr->prefetch(*it);
+    xu4.imageMgr->prefetch(IMG_MOONGATE);
+    xu4.imageMgr->prefetch(IMG_ITEMS);
+    xu4.imageMgr->setResourceGroup(saveGroup);
+
+    xu4.imageMgr->prefetch(BKGD_BORDERS);
+    xu4.config->prefetchMap(MAP_WORLD);
 }
 
 
@@ -2,10 +2,6 @@
  * $Id$
  */
 
-#include <list>
-#include <map>
-#include <set>
-
 #include "location.h"
 
 #include "context.h"
@@ -43,10 +39,13 @@ void locationFree(Location **stack) {
     delete loc;
 }
 
+#define ANNOT_AT_MAX    TILE_STACK_MAX
+
 /**
- * Append the entire stack of objects at the given location to a vector.
+ * Append the entire stack of objects at the given location to a TileStack.
+ * No memory is allocated.
  */
-void Location::getTilesAt(std::vector<MapTile>& tiles,
+void Location::getTilesAt(TileStack& tiles,
                           const Coords& coords, bool& focus) {
     const Object *obj = map->objectAt(coords);
     const Creature *m = dynamic_cast<const Creature *>(obj);
@@ -69,9 +68,11 @@ void Location::getTilesAt(std::vector<MapTile>& tiles,
         tiles.push_back(c->party->getTransport());
 
     /* Add visual-only annotations to the list */
-    std::list<Annotation *> annot = map->annotations.ptrsToAllAt(coords);
-    std::list<Annotation *>::const_iterator i;
-    for (i = annot.begin(); i != annot.end(); i++) {
+    const Annotation* annot[ANNOT_AT_MAX];
+    const Annotation* const* annotEnd = annot +
+        map->annotations.ptrsToAllAt(coords, annot, ANNOT_AT_MAX);
+    const Annotation* const* i;
+    for (i = annot; i != annotEnd; i++) {
         if ((*i)->visualOnly)
         {
             tiles.push_back((*i)->tile);
@@ -114,7 +115,7 @@ void Location::getTilesAt(std::vector<MapTile>& tiles,
         tiles.push_back(c->party->getTransport());
 
     /* then permanent annotations */
-    for (i = annot.begin(); i != annot.end(); i++) {
+    for (i = annot; i != annotEnd; i++) {
         if (!(*i)->visualOnly) {
             tiles.push_back((*i)->tile);
 
@@ -148,25 +149,33 @@ void Location::getTilesAt(std::vector<MapTile>& tiles,
  * cannot be found, it returns a "best guess" tile.
  */
 TileId Location::getReplacementTile(const Coords& atCoords, const Tile * forTile) {
-    std::map<TileId, int> validMapTileCount;
+    // The search ends once the queue holds 64 or more entries or after
+    // 128 steps, so it can never grow past this many entries.
+#define REPLACE_QUEUE_MAX   (1 + 128 * 4)
+
+    struct TileCount {
+        TileId id;
+        int count;
+    };
 
     const static int dirs[][2] = {{-1,0},{1,0},{0,-1},{0,1}};
     const static int dirs_per_step = sizeof(dirs) / sizeof(*dirs);
     int loop_count = 0;
 
-    std::set<Coords> searched;
-    std::list<Coords> searchQueue;
+    TileCount validMapTileCount[dirs_per_step];
+    int validCount;
+    Coords searchQueue[REPLACE_QUEUE_MAX];
+    int head = 0;
+    int tail = 0;
 
     //Pathfinding to closest traversable tile with appropriate replacement properties.
     //For tiles marked water-replaceable, pathfinding includes swimmables.
-    searchQueue.push_back(atCoords);
+    searchQueue[tail++] = atCoords;
     do
     {
-        Coords currentStep = searchQueue.front();
-        searchQueue.pop_front();
-
-        searched.insert(currentStep);
+        Coords currentStep = searchQueue[head++];
 
+        validCount = 0;
         for (int i = 0; i < dirs_per_step; i++)
         {
             Coords newStep(currentStep);
@@ -174,47 +183,48 @@ TileId Location::getReplacementTile(const Coords& atCoords, const Tile * forTile
 
             Tile const * tileType = map->tileTypeAt(newStep,WITHOUT_OBJECTS);
 
-            if (!tileType->isOpaque()) {
-                //if (searched.find(newStep) == searched.end()) -- the find mechanism doesn't work.
-                searchQueue.push_back(newStep);
-            }
+            if (!tileType->isOpaque())
+                searchQueue[tail++] = newStep;
 
             if ((tileType->isReplacement() && (forTile->isLandForeground() || forTile->isLivingObject())) ||
                 (tileType->isWaterReplacement() && forTile->isWaterForeground()))
             {
-                std::map<TileId, int>::iterator validCount = validMapTileCount.find(tileType->getId());
-
-                if (validCount == validMapTileCount.end())
-                {
-                    validMapTileCount[tileType->getId()] = 1;
+                TileId id = tileType->getId();
+                int n;
+                for (n = 0; n < validCount; n++) {
+                    if (validMapTileCount[n].id == id)
+                        break;
                 }
-                else
-                {
-                    validMapTileCount[tileType->getId()]++;
+                if (n == validCount) {
+                    validMapTileCount[n].id = id;
+                    validMapTileCount[n].count = 0;
+                    validCount++;
                 }
+                validMapTileCount[n].count++;
             }
         }
 
-        if (validMapTileCount.size() > 0)
+        if (validCount > 0)
         {
-            std::map<TileId, int>::iterator itr = validMapTileCount.begin();
-
-            TileId winner = itr->first;
-            int score = itr->second;
+            // Pick the most common tile; ties go to the lowest id.
+            TileId winner = validMapTileCount[0].id;
+            int score = validMapTileCount[0].count;
 
-            while (++itr != validMapTileCount.end())
+            for (int n = 1; n < validCount; n++)
             {
-                if (score < itr->second)
+                const TileCount& tc = validMapTileCount[n];
+                if (score < tc.count ||
+                    (score == tc.count && tc.id < winner))
                 {
-                    score = itr->second;
-                    winner = itr->first;
+                    score = tc.count;
+                    winner = tc.id;
                 }
             }
 
             return winner;
         }
         /* loop_count is an ugly hack to temporarily fix infinite loop */
-    } while (++loop_count < 128 && searchQueue.size() > 0 && searchQueue.size() < 64);
+    } while (++loop_count < 128 && head < tail && (tail - head) < 64);
 
     /* couldn't find a tile, give it the classic default */
     return map->tileset->getByName(Tile::sym.brickFloor)->getId();
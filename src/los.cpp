@@ -0,0 +1,563 @@
+/*
+ * los.cpp
+ */
+
+#include <string.h>
+#include "los.h"
+#include "profile.h"
+
+#define BLOCKING(x,y)   blocking[(y) * w + (x)]
+#define LOS(x,y)        lineOfSight[(y) * w + (x)]
+
+/**
+ * Finds which tiles in the viewport are visible from the avatars
+ * location in the middle. (original DOS algorithm)
+ */
+void los_dos(const uint8_t* blocking, uint8_t* lineOfSight, int w, int h) {
+    int x, y;
+    const int halfW = w / 2;
+    const int halfH = h / 2;
+
+    memset(lineOfSight, 0, w * h);
+    LOS(halfW, halfH) = 1;
+
+    for (x = halfW - 1; x >= 0; x--)
+        if (LOS(x + 1, halfH) && ! BLOCKING(x + 1, halfH))
+            LOS(x, halfH) = 1;
+
+    for (x = halfW + 1; x < w; x++)
+        if (LOS(x - 1, halfH) && ! BLOCKING(x - 1, halfH))
+            LOS(x, halfH) = 1;
+
+    for (y = halfH - 1; y >= 0; y--)
+        if (LOS(halfW, y + 1) && ! BLOCKING(halfW, y + 1))
+            LOS(halfW, y) = 1;
+
+    for (y = halfH + 1; y < h; y++)
+        if (LOS(halfW, y - 1) && ! BLOCKING(halfW, y - 1))
+            LOS(halfW, y) = 1;
+
+    for (y = halfH - 1; y >= 0; y--) {
+
+        for (x = halfW - 1; x >= 0; x--) {
+            if (LOS(x, y + 1) && ! BLOCKING(x, y + 1))
+                LOS(x, y) = 1;
+            else if (LOS(x + 1, y) && ! BLOCKING(x + 1, y))
+                LOS(x, y) = 1;
+            else if (LOS(x + 1, y + 1) && ! BLOCKING(x + 1, y + 1))
+                LOS(x, y) = 1;
+        }
+
+        for (x = halfW + 1; x < w; x++) {
+            if (LOS(x, y + 1) && ! BLOCKING(x, y + 1))
+                LOS(x, y) = 1;
+            else if (LOS(x - 1, y) && ! BLOCKING(x - 1, y))
+                LOS(x, y) = 1;
+            else if (LOS(x - 1, y + 1) && ! BLOCKING(x - 1, y + 1))
+                LOS(x, y) = 1;
+        }
+    }
+
+    for (y = halfH + 1; y < h; y++) {
+
+        for (x = halfW - 1; x >= 0; x--) {
+            if (LOS(x, y - 1) && ! BLOCKING(x, y - 1))
+                LOS(x, y) = 1;
+            else if (LOS(x + 1, y) && ! BLOCKING(x + 1, y))
+                LOS(x, y) = 1;
+            else if (LOS(x + 1, y - 1) && ! BLOCKING(x + 1, y - 1))
+                LOS(x, y) = 1;
+        }
+
+        for (x = halfW + 1; x < w; x++) {
+            if (LOS(x, y - 1) && ! BLOCKING(x, y - 1))
+                LOS(x, y) = 1;
+            else if (LOS(x - 1, y) && ! BLOCKING(x - 1, y))
+                LOS(x, y) = 1;
+            else if (LOS(x - 1, y - 1) && ! BLOCKING(x - 1, y - 1))
+                LOS(x, y) = 1;
+        }
+    }
+}
+
+/*
+ * bitmasks for LOS shadows
+ */
+#define ____H 0x01    // obscured along the horizontal face
+#define ___C_ 0x02    // obscured at the center
+#define __V__ 0x04    // obscured along the vertical face
+#define _N___ 0x80    // start of new raster
+
+#define ___CH 0x03
+#define __VCH 0x07
+#define __VC_ 0x06
+
+#define _N__H 0x81
+#define _N_CH 0x83
+#define _NVCH 0x87
+#define _NVC_ 0x86
+#define _NV__ 0x84
+
+/*
+ * Mark the shadows cast by each blocking cell in the flags grid (which
+ * must be cleared first).  A cell is hidden if it has all three __VCH
+ * flags set.  As each wall is handled independently, the flags of any
+ * grid are the union of those cast by its walls alone.
+ *
+ * A new, more accurate LOS function
+ *
+ * Based somewhat off Andy McFadden's 1994 article,
+ *   "Improvements to a Fast Algorithm for Calculating Shading
+ *   and Visibility in a Two-Dimensional Field"
+ *   -----
+ *   http://www.fadden.com/techmisc/fast-los.html
+ *
+ * This function uses a lookup table to get the correct shadowmap,
+ * which only covers walls up to four tiles from the center, so it is
+ * only used for the standard 11x11 viewport.  The function assumes that
+ * the viewport width and height are odd values and that the player
+ * is always at the center of the screen.
+ */
+static void rasterShadows(const uint8_t* blocking, uint8_t* lineOfSight,
+                          int w, int h) {
+    /*
+     * the shadow rasters for each viewport octant
+     *
+     * shadowRaster[0][0]    // number of raster segments in this shadow
+     * shadowRaster[0][1]    // #1 shadow bitmask value (low three bits) + "newline" flag (high bit)
+     * shadowRaster[0][2]    // #1 length
+     * shadowRaster[0][3]    // #2 shadow bitmask value
+     * shadowRaster[0][4]    // #2 length
+     * shadowRaster[0][5]    // #3 shadow bitmask value
+     * shadowRaster[0][6]    // #3 length
+     * ...etc...
+     */
+    static const uint8_t colRasterIndex[5] = { 0, 0, 2, 5, 9 };
+    static const uint8_t shadowRaster[14][13] = {
+        { 6, __VCH, 4, _N_CH, 1, __VCH, 3, _N___, 1, ___CH, 1, __VCH, 1 },    // raster_1_0
+        { 6, __VC_, 1, _NVCH, 2, __VC_, 1, _NVCH, 3, _NVCH, 2, _NVCH, 1 },    // raster_1_1
+        //
+        { 4, __VCH, 3, _N__H, 1, ___CH, 1, __VCH, 1,     0, 0,     0, 0 },    // raster_2_0
+        { 6, __VC_, 2, _N_CH, 1, __VCH, 2, _N_CH, 1, __VCH, 1, _N__H, 1 },    // raster_2_1
+        { 6, __V__, 1, _NVCH, 1, __VC_, 1, _NVCH, 1, __VC_, 1, _NVCH, 1 },    // raster_2_2
+        //
+        { 2, __VCH, 2, _N__H, 2,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_3_0
+        { 3, __VC_, 2, _N_CH, 1, __VCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_1
+        { 3, __VC_, 1, _NVCH, 2, _N_CH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_2
+        { 3, _NVCH, 1, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_3
+        //
+        { 2, __VCH, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_0
+        { 2, __VC_, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_1
+        { 2, __VC_, 1, _N_CH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_2
+        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_3
+        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 }     // raster_4_4
+    };
+    static const char octantSign[8 * 3] = {
+    // xSign, ySign, reflect
+         1,  1,  0,     // lower-right
+         1,  1,  1,
+         1, -1,  1,     // lower-left
+        -1,  1,  0,
+        -1, -1,  0,     // upper-left
+        -1, -1,  1,
+        -1,  1,  1,     // upper-right
+         1, -1,  0,
+    };
+
+    /*
+     * As each viewport tile is processed, it will store the bitmask for the shadow it casts.
+     * Later, after processing all octants, the entire viewport will be marked visible except
+     * for those tiles that have the __VCH bitmask.
+     */
+    const int _OCTANTS = 8;
+    const int _NUM_RASTERS_COLS = 4;
+
+    int octant;
+    int xOrigin, yOrigin, xSign, ySign, reflect;
+    int xTile, yTile, xTileOffset, yTileOffset;
+    int currentRaster;
+    int maxWidth, maxHeight;
+    const char* osign = octantSign;
+
+    // determine the origin point
+    xOrigin = w / 2;
+    yOrigin = h / 2;
+
+    for (octant = 0; octant < _OCTANTS; octant++) {
+        xSign   = *osign++;
+        ySign   = *osign++;
+        reflect = *osign++;
+
+        // make sure the segment doesn't reach out of bounds
+        if (reflect) {
+            // swap height and width
+            maxWidth  = yOrigin;
+            maxHeight = xOrigin;
+        } else {
+            maxWidth  = xOrigin;
+            maxHeight = yOrigin;
+        }
+
+        // check the visibility of each tile
+        for (int currentCol = 1; currentCol <= _NUM_RASTERS_COLS; currentCol++) {
+            for (int currentRow = 0; currentRow <= currentCol; currentRow++) {
+                // swap X and Y to reflect the octant rasters
+                if (reflect) {
+                    xTile = xOrigin+(currentRow*ySign);
+                    yTile = yOrigin+(currentCol*xSign);
+                }
+                else {
+                    xTile = xOrigin+(currentCol*xSign);
+                    yTile = yOrigin+(currentRow*ySign);
+                }
+
+                if (BLOCKING(xTile, yTile)) {
+                    // a wall was detected, so go through the raster for this
+                    // wall segment and mark everything behind it with the
+                    // appropriate shadow bitmask.
+
+                    // first, get the correct raster (0-13)
+                    currentRaster = currentRow + colRasterIndex[currentCol];
+
+                    xTileOffset = 0;
+                    yTileOffset = 0;
+
+                    //========================================
+                    for (int currentSegment = 0; currentSegment < shadowRaster[currentRaster][0]; currentSegment++) {
+                        // each shadow segment is 2 bytes
+                        int shadowType   = shadowRaster[currentRaster][currentSegment*2+1];
+                        int shadowLength = shadowRaster[currentRaster][currentSegment*2+2];
+
+                        // update the raster length to make sure it fits in the viewport
+                        shadowLength = (shadowLength+1+yTileOffset > maxWidth ? maxWidth : shadowLength);
+
+                        // check to see if we should move up a row
+                        if (shadowType & 0x80) {
+                            // remove the flag from the shadowType
+                            shadowType ^= _N___;
+                            if (currentRow + yTileOffset > maxHeight)
+                                break;
+
+                            xTileOffset = yTileOffset;
+                            yTileOffset++;
+                        }
+
+                        /* it is seemingly unnecessary to swap the edges for
+                         * shadow tiles, because we only care about shadow
+                         * tiles that have all three parts (V, C, and H)
+                         * flagged.  if a tile has fewer than three, it is
+                         * ignored during the draw phase, so vertical and
+                         * horizontal shadow edge accuracy isn't important
+                         */
+                        // if reflecting the octant, swap the edges
+                        /*
+                        if (reflect) {
+                            int shadowTemp = 0;
+                            // swap the vertical and horizontal shadow edges
+                            if (shadowType & __V__) { shadowTemp |= ____H; }
+                            if (shadowType & ___C_) { shadowTemp |= ___C_; }
+                            if (shadowType & ____H) { shadowTemp |= __V__; }
+                            shadowType = shadowTemp;
+                        }
+                        */
+
+                        for (int currentShadow = 1; currentShadow <= shadowLength; currentShadow++) {
+                            // apply the shadow to the shadowMap
+                            if (reflect) {
+                                LOS(xTile + ((yTileOffset) * ySign), yTile + ((currentShadow+xTileOffset) * xSign)) |= shadowType;
+                            }
+                            else {
+                                LOS(xTile + ((currentShadow+xTileOffset) * xSign), yTile + ((yTileOffset) * ySign)) |= shadowType;
+                            }
+                        }
+                        xTileOffset += shadowLength;
+                    }  // currentSegment
+                    //========================================
+
+                }  // BLOCKING
+            }  // currentRow
+        }  // currentCol
+    }  // octant
+}
+
+/**
+ * Finds which tiles in the viewport are visible from the avatars
+ * location in the middle using the shadow rasters.
+ */
+void los_enhanced(const uint8_t* blocking, uint8_t* lineOfSight, int w, int h) {
+    memset(lineOfSight, 0, w * h);
+    rasterShadows(blocking, lineOfSight, w, h);
+
+    // go through all tiles on the viewable area and set the appropriate visibility
+    uint8_t* end = lineOfSight + w * h;
+    while (lineOfSight != end) {
+        // if the shadow flags equal __VCH, hide it, otherwise it's fully visible
+        if ((*lineOfSight & __VCH) == __VCH)
+            *lineOfSight = 0;
+        else
+            *lineOfSight = 1;
+        ++lineOfSight;
+    }
+}
+
+//--------------------------------------
+// Bitboards
+
+/*
+ * The DOS and Enhanced algorithms are reproduced exactly with whole rows
+ * handled at once.  Each row is a uint64_t with bit x for column x.
+ */
+
+#define ROW_MASK(w)     ((uint64_t(1) << (w)) - 1)
+
+/*
+ * Pack a byte grid into bitboard rows.
+ */
+void los_pack(const uint8_t* cells, uint64_t* rows, int w, int h) {
+    uint64_t row;
+    int x, y;
+    for (y = 0; y < h; ++y) {
+        row = 0;
+        for (x = 0; x < w; ++x) {
+            if (*cells++)
+                row |= uint64_t(1) << x;
+        }
+        rows[y] = row;
+    }
+}
+
+/*
+ * Unpack bitboard rows into a byte grid of ones & zeros.
+ */
+void los_unpack(const uint64_t* rows, uint8_t* cells, int w, int h) {
+    uint64_t row;
+    int x, y;
+    for (y = 0; y < h; ++y) {
+        row = rows[y];
+        for (x = 0; x < w; ++x)
+            *cells++ = (row >> x) & 1;
+    }
+}
+
+/*
+ * Return the cells reached by spreading seed through open cells toward
+ * bit zero.  A cell is reached if it is seeded or its upper neighbor is
+ * both reached and open.  This is a Kogge-Stone occluded fill.
+ */
+static inline uint64_t spreadDown(uint64_t seed, uint64_t open) {
+    uint64_t g = seed & open;   // Reached & open cells pass it on.
+    uint64_t p = open;
+    g |= p & (g >> 1);  p &= p >> 1;
+    g |= p & (g >> 2);  p &= p >> 2;
+    g |= p & (g >> 4);  p &= p >> 4;
+    g |= p & (g >> 8);  p &= p >> 8;
+    g |= p & (g >> 16); p &= p >> 16;
+    g |= p & (g >> 32);
+    return seed | (g >> 1);
+}
+
+static inline uint64_t spreadUp(uint64_t seed, uint64_t open) {
+    uint64_t g = seed & open;
+    uint64_t p = open;
+    g |= p & (g << 1);  p &= p << 1;
+    g |= p & (g << 2);  p &= p << 2;
+    g |= p & (g << 4);  p &= p << 4;
+    g |= p & (g << 8);  p &= p << 8;
+    g |= p & (g << 16); p &= p << 16;
+    g |= p & (g << 32);
+    return seed | (g << 1);
+}
+
+/*
+ * Compute visible row y of los_dos() from the row nearer the center.
+ *
+ * \param pass  Cells of the previous row which are visible & open.
+ * \param open  Open cells of this row.
+ */
+static inline uint64_t dosRow(uint64_t pass, uint64_t open, uint64_t cbit,
+                              uint64_t leftMask, uint64_t rightMask) {
+    uint64_t c = pass & cbit;
+    uint64_t seedL = ((pass | (pass >> 1)) & leftMask) | c;
+    uint64_t seedR = ((pass | (pass << 1)) & rightMask) | c;
+    return (spreadDown(seedL, open) & (leftMask | cbit)) |
+           (spreadUp(seedR, open) & (rightMask | cbit));
+}
+
+/*
+ * Bitboard version of los_dos() which produces identical results.
+ */
+void los_bitsDOS(const uint64_t* blocking, uint64_t* visible, int w, int h) {
+    PROFILE_ZONE("los_bitsDOS")
+    const int halfW = w / 2;
+    const int halfH = h / 2;
+    const uint64_t full = ROW_MASK(w);
+    const uint64_t cbit = uint64_t(1) << halfW;
+    const uint64_t leftMask  = cbit - 1;
+    const uint64_t rightMask = full & ~(leftMask | cbit);
+    uint64_t open;
+    int y;
+
+    // The center row spreads out from the viewer only.
+    open = ~blocking[halfH] & full;
+    visible[halfH] = (spreadDown(cbit, open) & (leftMask | cbit)) |
+                     (spreadUp(cbit, open) & rightMask);
+
+    for (y = halfH - 1; y >= 0; --y) {
+        visible[y] = dosRow(visible[y + 1] & ~blocking[y + 1],
+                            ~blocking[y] & full, cbit, leftMask, rightMask);
+    }
+    for (y = halfH + 1; y < h; ++y) {
+        visible[y] = dosRow(visible[y - 1] & ~blocking[y - 1],
+                            ~blocking[y] & full, cbit, leftMask, rightMask);
+    }
+}
+
+/*
+ * The vertical, center & horizontal shadow rows cast by a single wall.
+ */
+struct ShadowCaster {
+    int x, y;
+    uint64_t* vch;      // 3 * h rows.
+};
+
+static struct {
+    int w, h;
+    int count;
+    ShadowCaster caster[9 * 9];
+    uint64_t* rows;
+} shadowTable = { 0, 0, 0, {}, NULL };
+
+/*
+ * Build the shadows of every cell that can cast one by running
+ * rasterShadows() on a grid with only that cell blocked.
+ */
+static void buildShadowTable(int w, int h) {
+    uint8_t blocking[LOS_MAX_W * LOS_MAX_H];
+    uint8_t flags[LOS_MAX_W * LOS_MAX_H];
+    const int halfW = w / 2;
+    const int halfH = h / 2;
+    ShadowCaster* sc;
+    uint64_t* rows;
+    const uint8_t* fp;
+    int x, y, i, j, dx, dy, cell;
+    bool cast;
+
+    delete[] shadowTable.rows;
+    shadowTable.w = w;
+    shadowTable.h = h;
+    shadowTable.count = 0;
+    shadowTable.rows = rows = new uint64_t[9 * 9 * 3 * h];
+
+    memset(blocking, 0, w * h);
+    for (dy = -4; dy <= 4; ++dy) {
+        y = halfH + dy;
+        if (y < 0 || y >= h)
+            continue;
+        for (dx = -4; dx <= 4; ++dx) {
+            x = halfW + dx;
+            if (x < 0 || x >= w || (dx == 0 && dy == 0))
+                continue;
+
+            cell = y * w + x;
+            blocking[cell] = 1;
+            memset(flags, 0, w * h);
+            rasterShadows(blocking, flags, w, h);
+            blocking[cell] = 0;
+
+            memset(rows, 0, 3 * h * sizeof(uint64_t));
+            cast = false;
+            fp = flags;
+            for (j = 0; j < h; ++j) {
+                for (i = 0; i < w; ++i, ++fp) {
+                    if (*fp & __V__)
+                        rows[j] |= uint64_t(1) << i;
+                    if (*fp & ___C_)
+                        rows[h + j] |= uint64_t(1) << i;
+                    if (*fp & ____H)
+                        rows[2*h + j] |= uint64_t(1) << i;
+                    if (*fp)
+                        cast = true;
+                }
+            }
+
+            if (cast) {
+                sc = shadowTable.caster + shadowTable.count++;
+                sc->x = x;
+                sc->y = y;
+                sc->vch = rows;
+                rows += 3 * h;
+            }
+        }
+    }
+}
+
+/*
+ * Bitboard version of los_enhanced() which produces identical results.
+ * The shadows of each wall are built once for the viewport size and then
+ * combined a row at a time.
+ */
+void los_bitsEnhanced(const uint64_t* blocking, uint64_t* visible,
+                      int w, int h) {
+    PROFILE_ZONE("los_bitsEnhanced")
+    const uint64_t full = ROW_MASK(w);
+    const ShadowCaster* it;
+    const ShadowCaster* end;
+    const uint64_t* vch;
+    uint64_t shadowV[LOS_MAX_H];
+    uint64_t shadowC[LOS_MAX_H];
+    uint64_t shadowH[LOS_MAX_H];
+    int y;
+
+    if (shadowTable.w != w || shadowTable.h != h)
+        buildShadowTable(w, h);
+
+    memset(shadowV, 0, h * sizeof(uint64_t));
+    memset(shadowC, 0, h * sizeof(uint64_t));
+    memset(shadowH, 0, h * sizeof(uint64_t));
+
+    it  = shadowTable.caster;
+    end = it + shadowTable.count;
+    for (; it != end; ++it) {
+        if ((blocking[it->y] >> it->x) & 1) {
+            vch = it->vch;
+            for (y = 0; y < h; ++y) {
+                shadowV[y] |= vch[y];
+                shadowC[y] |= vch[h + y];
+                shadowH[y] |= vch[2*h + y];
+            }
+        }
+    }
+
+    for (y = 0; y < h; ++y)
+        visible[y] = ~(shadowV[y] & shadowC[y] & shadowH[y]) & full;
+}
+
+void los_cacheInit(LosCache* cache) {
+    memset(cache, 0, sizeof(LosCache));
+    cache->mode = -1;
+}
+
+/*
+ * Return the visible rows for a blocking grid.  As the viewer is always at
+ * the center, the result only depends upon the grid and it is reused
+ * while the grid is unchanged (e.g. while the avatar stands still).
+ *
+ * The returned pointer is valid until the next call.
+ */
+const uint64_t* los_compute(LosCache* cache, int mode,
+                            const uint64_t* blocking, int w, int h) {
+    if (cache->mode == mode && cache->w == w && cache->h == h &&
+        memcmp(cache->blocking, blocking, h * sizeof(uint64_t)) == 0)
+        return cache->visible;
+
+    cache->mode = mode;
+    cache->w = w;
+    cache->h = h;
+    memcpy(cache->blocking, blocking, h * sizeof(uint64_t));
+
+    if (mode == LOS_DOS)
+        los_bitsDOS(blocking, cache->visible, w, h);
+    else
+        los_bitsEnhanced(blocking, cache->visible, w, h);
+    return cache->visible;
+}
@@ -0,0 +1,49 @@
+/*
+ * los.h
+ */
+
+#ifndef LOS_H
+#define LOS_H
+
+#include <stdint.h>
+
+/*
+ * Line of sight for a viewport with the viewer at the center.
+ *
+ * The byte grid functions hold one cell per byte (w * h).  The bitboard
+ * functions hold one row per uint64_t with bit x set for column x, so the
+ * width is limited to LOS_MAX_W.  The Enhanced rasters only reach four
+ * cells from the center, so those functions are for views up to 11x11.
+ */
+
+#define LOS_MAX_W   63
+#define LOS_MAX_H   63
+
+enum LosMode {
+    LOS_DOS,            // Matches settings lineOfSight values.
+    LOS_ENHANCED
+};
+
+void los_dos(const uint8_t* blocking, uint8_t* visible, int w, int h);
+void los_enhanced(const uint8_t* blocking, uint8_t* visible, int w, int h);
+
+void los_pack(const uint8_t* cells, uint64_t* rows, int w, int h);
+void los_unpack(const uint64_t* rows, uint8_t* cells, int w, int h);
+void los_bitsDOS(const uint64_t* blocking, uint64_t* visible, int w, int h);
+void los_bitsEnhanced(const uint64_t* blocking, uint64_t* visible,
+                      int w, int h);
+
+/*
+ * The last blocking grid & its result.
+ */
+struct LosCache {
+    int mode, w, h;     // Mode is -1 when empty.
+    uint64_t blocking[LOS_MAX_H];
+    uint64_t visible[LOS_MAX_H];
+};
+
+void los_cacheInit(LosCache* cache);
+const uint64_t* los_compute(LosCache* cache, int mode,
+                            const uint64_t* blocking, int w, int h);
+
+#endif /* LOS_H */
@@ -26,8 +26,13 @@
  * 2) The dictionary is implemented as a hash table.
  * While the dictionary is supposed to implemented as a hash table in the LZW *en*coder (to speed up
  * string searches), there is no reason not to implement it as a simple array in the decoder.
- * But since U4 uses a hash table in the decoder, this C version must do the same (or it won't be
- * able to decode the U4 files).
+ * But since U4 uses a hash table in the decoder, the codewords are hash table positions and this
+ * C version must find new positions the same way (or it won't be able to decode the U4 files).
+ * Lookups of existing codewords are direct table accesses.
+ *
+ * Every dictionary string has already been output once, so the decoder only records where in the
+ * output each string starts and its length.  Strings are then copied from the earlier output with
+ * memcpy rather than being rebuilt one character at a time.
  * An article on LZW data (de)compression can be found here:
  * http://dogma.net/markn/articles/lzw/lzw.htm
  */
@@ -37,300 +42,275 @@
 #include <stdlib.h>
 #include <string.h>
 
-typedef void (*WRITE_DECOMP)(unsigned char root, unsigned char *destination, long* position);
+/* re-initialize the dictionary when there are more than 0xccc entries */
+#define MAX_DICT_ENTRIES    0xccc
+#define DICT_SIZE           0x1000
 
-typedef struct _lzwDictionaryEntry
+typedef struct
 {
-    unsigned char root;
-    int codeword;
-    unsigned char occupied;
-} lzwDictionaryEntry;
+    unsigned short codeword[DICT_SIZE];     /* prefix codeword */
+    unsigned short length[DICT_SIZE];       /* string length; 0 if free */
+    unsigned char root[DICT_SIZE];          /* last character */
+    long start[DICT_SIZE];                  /* output position of string */
+} LzwDictionary;
 
-long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize);
-int getNextCodeword(long* bitsRead, unsigned char *compressedMem);
-void discardRoot(unsigned char root, unsigned char *destination, long* position);
-void outputRoot(unsigned char root, unsigned char *destination, long* position);
+typedef struct
+{
+    unsigned char* mem;
+    long size;
+    int growable;
+} LzwOutput;
 
-void getString(int codeword, lzwDictionaryEntry *lzwDictionary, unsigned char* stack, int *elementsInStack);
-int getNewHashCode(unsigned char root, int codeword, lzwDictionaryEntry* dictionary);
-unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDictionaryEntry* dictionary);
+static long lzwDecode(const unsigned char* compressedMem, long compressedSize, LzwOutput* out);
 
 /*
  * This function returns the decompressed size of a block of compressed data.
- * It doesn't decompress the data.
- * Use this function if you want to decompress a block of data, but don't know the decompressed size
- * in advance.
+ * It decompresses into a temporary buffer, so use lzwDecompressAlloc()
+ * instead if the data is wanted.
  *
- * There is some error checking to detect if the compressed data is corrupt, but it's only rudimentary.
  * Returns:
  * No errors: (long) decompressed size
  * Error: (long) -1
  */
-long lzwGetDecompressedSize(unsigned char* compressedMem, long compressedSize)
+long lzwGetDecompressedSize(const unsigned char* compressedMem, long compressedSize)
 {
-    return(generalizedDecompress(&discardRoot, compressedMem, NULL, compressedSize));
+    unsigned char* mem;
+    long size = lzwDecompressAlloc(compressedMem, compressedSize, &mem);
+    if (size >= 0)
+        free(mem);
+    return size;
 }
 
 /*
  * Decompresses a block of compressed data from memory to memory.
  * Use this function if you already know the decompressed size.
  *
- * This function assumes that *decompressed_mem is already allocated, and that the decompressed data
- * will fit into *decompressed_mem.
  * There is some error checking to detect if the compressed data is corrupt, but it's only rudimentary.
  * Returns:
  * No errors: (long) decompressed size
- * Error: (long) -1
+ * Error: (long) -1, which includes the data not fitting into decompressedSize bytes.
  */
-long lzwDecompress(unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
+long lzwDecompress(const unsigned char* compressedMem, long compressedSize,
+                   unsigned char* decompressedMem, long decompressedSize)
 {
-    return(generalizedDecompress(&outputRoot, compressedMem, decompressedMem, compressedSize));
+    LzwOutput out;
+    out.mem = decompressedMem;
+    out.size = decompressedSize;
+    out.growable = 0;
+    return lzwDecode(compressedMem, compressedSize, &out);
 }
 
-/* --------------------------------------------------------------------------------------
-   Functions used only inside lzw.c
-   -------------------------------------------------------------------------------------- */
-
 /*
- * This function does the actual decompression work.
- * Parameters:
- * perform_decompression: FALSE ==> return decompressed size, but discard decompressed data
- * compressed_mem: compressed data
- * decompressed_mem: this is where the compressed data will be decompressed to
- * compressed_size: size of the compressed data (in bytes)
+ * Decompresses a block of compressed data into a buffer allocated with
+ * malloc().  Use this function if you don't know the decompressed size in
+ * advance.
+ *
+ * Returns:
+ * No errors: (long) decompressed size.  The caller must free() *decompressedMem.
+ * Error: (long) -1 and *decompressedMem is unchanged.
  */
-long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
+long lzwDecompressAlloc(const unsigned char* compressedMem, long compressedSize,
+                        unsigned char** decompressedMem)
 {
-    int i;
-
-    /* re-initialize the dictionary when there are more than 0xccc entries */
-    const int maxDictEntries = 0xccc;
-
-    const int lzwStackSize = 0x8000;
-    const int lzwDictionarySize = 0x1000;
-
-    int old_code;
-    int new_code;
-    unsigned char character;
-
-    long bitsRead = 0;
-    long bytesWritten = 0;
-
-    /* newpos: position in the dictionary where new codeword was added                      */
-    /* must be equal to current codeword (if it isn't, the compressed data must be corrupt) */
-    /* unknownCodeword: is the current codeword in the dictionary?                          */
-    int newpos;
-    unsigned char unknownCodeword;
-
-    /* initialize the dictionary and the stack */
-    lzwDictionaryEntry *lzwDictionary = (lzwDictionaryEntry *) malloc(sizeof(lzwDictionaryEntry) * lzwDictionarySize);
-    int codewordsInDictionary = 0;
-    unsigned char *lzwStack = (unsigned char *) malloc(sizeof(unsigned char) * lzwStackSize);
-    int elementsInStack = 0;
-
-    /* clear the dictionary */
-    memset(lzwDictionary, 0, sizeof(lzwDictionaryEntry) * lzwDictionarySize);
-    for (i = 0; i < 0x100; i++)
-    {
-        lzwDictionary[i].occupied = 1;
+    LzwOutput out;
+    long size;
+
+    /* LZW seldom does better than 4:1 on the U4 images. */
+    out.size = compressedSize * 4;
+    if (out.size < 0x1000)
+        out.size = 0x1000;
+    out.mem = (unsigned char*) malloc(out.size);
+    out.growable = 1;
+    if (! out.mem)
+        return -1;
+
+    size = lzwDecode(compressedMem, compressedSize, &out);
+    if (size < 0) {
+        free(out.mem);
+        return -1;
     }
-
-    if (bitsRead + 12 <= compressedSize * 8)
-    {
-        /* read OLD_CODE */
-        old_code = getNextCodeword(&bitsRead, compressedMem);
-        /* CHARACTER = OLD_CODE */
-        character = (unsigned char)old_code;
-        /* output OLD_CODE */
-        outFunc(character, decompressedMem, &bytesWritten);
-
-        while (bitsRead + 12 <= compressedSize * 8) /* WHILE there are still input characters DO */
-        {
-            /* read NEW_CODE */
-            new_code = getNextCodeword(&bitsRead, compressedMem);
-
-            if (lzwDictionary[new_code].occupied)   /* is the codeword in the dictionary? */
-            {
-                /* codeword is present in the dictionary                                               */
-                /* it must either be a root or a non-root that has already been added to the dicionary */
-                unknownCodeword = 0;
-
-                /* STRING = get translation of NEW_CODE */
-                getString(new_code,lzwDictionary,lzwStack,&elementsInStack);
-            }
-            else
-            {
-                /* codeword is yet to be defined */
-                unknownCodeword = 1;
-
-                /* STRING = get translation of OLD_CODE */
-                /* STRING = STRING+CHARACTER            */
-                lzwStack[elementsInStack] = character;   /* push character on the stack */
-                elementsInStack++;
-
-                getString(old_code,lzwDictionary,lzwStack,&elementsInStack);
-            }
-
-            /* CHARACTER = first character in STRING */
-            character = lzwStack[elementsInStack-1];   /* element at top of stack */
-
-            /* output STRING */
-            while (elementsInStack > 0)
-            {
-                outFunc(lzwStack[elementsInStack-1], decompressedMem, &bytesWritten);
-                elementsInStack--;
-            }
-
-            /* add OLD_CODE + CHARACTER to the translation table */
-            newpos = getNewHashCode(character,old_code,lzwDictionary);
-
-            lzwDictionary[newpos].root = character;
-            lzwDictionary[newpos].codeword = old_code;
-            lzwDictionary[newpos].occupied = 1;
-            codewordsInDictionary++;
-
-            /* check for errors */
-            if (unknownCodeword && (newpos != new_code))
-            {
-                /* clean up */
-                free(lzwStack);
-                free(lzwDictionary);
-
-                return(-1);
-            }
-
-            if (codewordsInDictionary > maxDictEntries)
-            {
-                /* wipe dictionary */
-                codewordsInDictionary = 0;
-                memset(lzwDictionary, 0, sizeof(lzwDictionaryEntry) * lzwDictionarySize);
-                for (i = 0; i < 0x100; i++)
-                {
-                    lzwDictionary[i].occupied = 1;
-                }
-
-                if (bitsRead + 12 <= compressedSize * 8)
-                {
-                    new_code = getNextCodeword(&bitsRead, compressedMem);
-                    character = (unsigned char)new_code;
-
-                    outFunc(character, decompressedMem, &bytesWritten);
-                }
-                else
-                {
-                    /* clean up */
-                    free(lzwStack);
-                    free(lzwDictionary);
-
-                    return(bytesWritten);
-                }
-            }
-
-            /* OLD_CODE = NEW_CODE */
-            old_code = new_code;
-        }
-    }    
-    /* clean up */
-    free(lzwStack);
-    free(lzwDictionary);
-
-    return(bytesWritten);
-}
-
-/* read the next 12-bit codeword from the compressed data */
-int getNextCodeword(long* bitsRead, unsigned char *compressedMem)
-{
-    int codeword = (compressedMem[(*bitsRead)/8] << 8) + compressedMem[(*bitsRead)/8+1];
-    codeword = codeword >> (4-((*bitsRead)%8));
-    codeword = codeword & 0xfff;
-    (*bitsRead) += 12;
-
-    return(codeword);
-}
-
-/* increment position pointer, but do not write root to memory */
-void discardRoot(unsigned char root, unsigned char *destination, long* position)
-{
-    (*position)++;
-}
-
-/* output a root to memory */
-void outputRoot(unsigned char root, unsigned char *destination, long* position)
-{
-    destination[*position] = root;
-    (*position)++;
+    *decompressedMem = out.mem;
+    return size;
 }
 
 /* --------------------------------------------------------------------------------------
-   Dictionary-related functions
+   Functions used only inside lzw.c
    -------------------------------------------------------------------------------------- */
 
-/* pushes the string associated with codeword onto the stack */
-void getString(int codeword, lzwDictionaryEntry *dictionary, unsigned char *stack, int *elementsInStack)
-{
-    unsigned char root;
-    int currentCodeword = codeword;
+/* read the next 12-bit codeword from the compressed data */
+#define NEXT_CODEWORD(cw) \
+    cw = (compressedMem[bitsRead >> 3] << 8) | compressedMem[(bitsRead >> 3) + 1]; \
+    cw = (cw >> (4 - (bitsRead & 7))) & 0xfff; \
+    bitsRead += 12
 
-    while (currentCodeword > 0xff)
-    {
-        root = dictionary[currentCodeword].root;
-        currentCodeword = dictionary[currentCodeword].codeword;
-        stack[*elementsInStack] = root;
-        (*elementsInStack)++;
+/*
+ * Make sure there is room in the output for n more characters.
+ * Returns 0 if the output is full.
+ */
+static int reserveOutput(LzwOutput* out, long used, long n)
+{
+    if (used + n > out->size) {
+        long size;
+        unsigned char* mem;
+
+        if (! out->growable)
+            return 0;
+        size = out->size * 2;
+        if (size < used + n)
+            size = used + n;
+        mem = (unsigned char*) realloc(out->mem, size);
+        if (! mem)
+            return 0;
+        out->mem = mem;
+        out->size = size;
     }
-
-    /* push the root at the leaf */
-    stack[*elementsInStack] = (unsigned char)currentCodeword;
-    (*elementsInStack)++;
+    return 1;
 }
 
-int getNewHashCode (unsigned char root, int codeword, lzwDictionaryEntry *dictionary)
+/* the hash table position is free or already holds the (root,codeword) pair */
+#define HASH_POS_FOUND(hc) \
+    (hc > 0xff && (! dict->length[hc] || \
+        (dict->root[hc] == root && dict->codeword[hc] == codeword)))
+
+static int getNewHashCode(const LzwDictionary* dict, unsigned char root, int codeword)
 {
     int hashCode;
 
     /* probe 1 */
     hashCode = probe1(root, codeword);
-    if (hashPosFound(hashCode, root, codeword, dictionary)) {
-        return(hashCode);
-    }
+    if (HASH_POS_FOUND(hashCode))
+        return hashCode;
     /* probe 2 */
     hashCode = probe2(root, codeword);
-    if (hashPosFound(hashCode, root, codeword, dictionary)) {
-        return(hashCode);
-    }
+    if (HASH_POS_FOUND(hashCode))
+        return hashCode;
     /* probe 3 */
     do {
         hashCode = probe3(hashCode);
-    }
-    while (! hashPosFound(hashCode, root, codeword, dictionary));
+    } while (! HASH_POS_FOUND(hashCode));
 
-    return(hashCode);
+    return hashCode;
 }
 
-unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDictionaryEntry* dictionary)
+static void clearDictionary(LzwDictionary* dict)
 {
-    if (hashCode > 0xff)   /* hash codes must not be roots */
+    int i;
+    memset(dict->length + 0x100, 0, sizeof(unsigned short) * (DICT_SIZE - 0x100));
+    for (i = 0; i < 0x100; i++)
+        dict->length[i] = 1;
+}
+
+/*
+ * This function does the actual decompression work.
+ * Parameters:
+ * compressedMem: compressed data
+ * compressedSize: size of the compressed data (in bytes)
+ * out: this is where the compressed data will be decompressed to
+ *
+ * Returns the decompressed size or -1 if the data is corrupt or does not fit.
+ */
+static long lzwDecode(const unsigned char* compressedMem, long compressedSize, LzwOutput* out)
+{
+    LzwDictionary* dict;
+    unsigned char* dst;
+    const long bitsTotal = compressedSize * 8;
+    long bitsRead = 0;
+    long bytesWritten = 0;
+    long oldPos, len;
+    int old_code, new_code, newpos, codewordsInDictionary;
+
+    if (bitsTotal < 12)
+        return 0;
+
+    dict = (LzwDictionary*) malloc(sizeof(LzwDictionary));
+    if (! dict)
+        return -1;
+    clearDictionary(dict);
+    codewordsInDictionary = 0;
+
+    /* read OLD_CODE, which must be a root, and output it */
+    NEXT_CODEWORD(old_code);
+    if (old_code > 0xff || ! reserveOutput(out, 0, 1))
+        goto fail;
+    out->mem[0] = (unsigned char) old_code;
+    oldPos = 0;
+    bytesWritten = 1;
+
+    while (bitsRead + 12 <= bitsTotal) /* WHILE there are still input characters DO */
     {
-        unsigned char c1, c2, c3;
+        unsigned char root;
+        int codeword;
+
+        NEXT_CODEWORD(new_code);
 
-        if (dictionary[hashCode].occupied)
+        if (dict->length[new_code])   /* is the codeword in the dictionary? */
         {
-            /* hash table position is occupied */
-            c1 = 1;
-            /* is our (root,codeword) pair already in the hash table? */
-            c2 = dictionary[hashCode].root == root;
-            c3 = dictionary[hashCode].codeword == codeword;
+            /* output STRING = translation of NEW_CODE */
+            len = dict->length[new_code];
+            if (! reserveOutput(out, bytesWritten, len))
+                goto fail;
+            dst = out->mem + bytesWritten;
+            if (new_code > 0xff)
+                memcpy(dst, out->mem + dict->start[new_code], len);
+            else
+                *dst = (unsigned char) new_code;
         }
         else
         {
-            /* hash table position is free */
-            c1 = 0;
+            /* codeword is yet to be defined */
+            /* output STRING = translation of OLD_CODE + CHARACTER */
+            len = dict->length[old_code] + 1;
+            if (! reserveOutput(out, bytesWritten, len))
+                goto fail;
+            dst = out->mem + bytesWritten;
+            memcpy(dst, out->mem + oldPos, len - 1);
+            dst[len - 1] = *dst;
         }
 
-        return((!c1) || (c1 && c2 && c3));
-    }
-    else
-    {
-        return(0);
+        /* add OLD_CODE + CHARACTER to the translation table */
+        /* CHARACTER = first character in STRING */
+        root = *dst;
+        codeword = old_code;
+        newpos = getNewHashCode(dict, root, codeword);
+
+        /* check for errors                                                     */
+        /* newpos must be equal to an undefined codeword or the data is corrupt */
+        if (! dict->length[new_code] && newpos != new_code)
+            goto fail;
+
+        dict->root[newpos] = root;
+        dict->codeword[newpos] = codeword;
+        dict->length[newpos] = dict->length[old_code] + 1;
+        dict->start[newpos] = oldPos;
+        codewordsInDictionary++;
+
+        oldPos = bytesWritten;
+        bytesWritten += len;
+
+        if (codewordsInDictionary > MAX_DICT_ENTRIES)
+        {
+            /* wipe dictionary */
+            codewordsInDictionary = 0;
+            clearDictionary(dict);
+
+            if (bitsRead + 12 > bitsTotal)
+                break;
+
+            NEXT_CODEWORD(new_code);
+            if (new_code > 0xff || ! reserveOutput(out, bytesWritten, 1))
+                goto fail;
+            out->mem[bytesWritten] = (unsigned char) new_code;
+            oldPos = bytesWritten++;
+        }
+
+        /* OLD_CODE = NEW_CODE */
+        old_code = new_code;
     }
+
+    free(dict);
+    return bytesWritten;
+
+fail:
+    free(dict);
+    return -1;
 }
@@ -25,8 +25,11 @@
 extern "C" {
 #endif
 
-long lzwGetDecompressedSize(unsigned char* compressedMem, long compressedSize);
-long lzwDecompress(unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize);
+long lzwGetDecompressedSize(const unsigned char* compressedMem, long compressedSize);
+long lzwDecompress(const unsigned char* compressedMem, long compressedSize,
+                   unsigned char* decompressedMem, long decompressedSize);
+long lzwDecompressAlloc(const unsigned char* compressedMem, long compressedSize,
+                        unsigned char** decompressedMem);
 
 #ifdef __cplusplus
 }
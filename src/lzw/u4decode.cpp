@@ -35,7 +35,6 @@ long decompress_u4_file(FILE *in, long filesize, void **out)
 {
     unsigned char *compressed_mem, *decompressed_mem;
     long compressed_filesize, decompressed_filesize;
-    long errorCode;
 
     /* size of the compressed input file */
     compressed_filesize = filesize;
@@ -53,67 +52,47 @@ long decompress_u4_file(FILE *in, long filesize, void **out)
     fread(compressed_mem, 1, compressed_filesize, in);
 
     /*
-     * determine decompressed file size
-     * if lzw_get_decompressed_size() can't determine the decompressed size (i.e. the compressed
-     * data is corrupt), it returns -1
+     * decompress file from compressed_mem[] into decompressed_mem[]
+     * if the compressed data is corrupt, -1 is returned
      */
-    decompressed_filesize = lzwGetDecompressedSize(compressed_mem,compressed_filesize);
+    decompressed_filesize = lzwDecompressAlloc(compressed_mem, compressed_filesize, &decompressed_mem);
+
+    free(compressed_mem);
 
     if (decompressed_filesize <= 0) {
+        if (decompressed_filesize == 0)
+            free(decompressed_mem);
         return(-1);
     }
 
-    /* decompress file from compressed_mem[] into decompressed_mem[] */
-    decompressed_mem = (unsigned char *) malloc(decompressed_filesize);
-
-    /* testing: clear destination mem */
-    memset(decompressed_mem, 0, decompressed_filesize);
-
-    errorCode = lzwDecompress(compressed_mem, decompressed_mem, compressed_filesize);
-
-    free(compressed_mem);
-
     *out = decompressed_mem;
 
-    return(errorCode);
+    return(decompressed_filesize);
 }
 
 long decompress_u4_memory(void *in, long inlen, void **out) {
-    unsigned char *compressed_mem, *decompressed_mem;
-    long compressed_filesize, decompressed_filesize;
-    long errorCode;
+    unsigned char *decompressed_mem;
+    long decompressed_size;
 
-    /* size of the compressed input */
-    compressed_filesize = inlen;
-
-    /* input file should be longer than 0 bytes */
-    if (compressed_filesize == 0)
+    /* input should be longer than 0 bytes */
+    if (inlen == 0)
         return(-1);
 
-    compressed_mem = (unsigned char *) in;
-
     /*
-     * determine decompressed data size
-     * if lzw_get_decompressed_size() can't determine the decompressed size (i.e. the compressed
-     * data is corrupt), it returns -1
+     * decompress in[] into decompressed_mem[] in a single pass
+     * if the compressed data is corrupt, -1 is returned
      */
-    decompressed_filesize = lzwGetDecompressedSize(compressed_mem,compressed_filesize);
+    decompressed_size = lzwDecompressAlloc((unsigned char *) in, inlen, &decompressed_mem);
 
-    if (decompressed_filesize <= 0) {
+    if (decompressed_size <= 0) {
+        if (decompressed_size == 0)
+            free(decompressed_mem);
         return(-1);
     }
 
-    /* decompress file from compressed_mem[] into decompressed_mem[] */
-    decompressed_mem = (unsigned char *) malloc(decompressed_filesize);
-
-    /* testing: clear destination mem */
-    memset(decompressed_mem, 0, decompressed_filesize);
-
-    errorCode = lzwDecompress(compressed_mem, decompressed_mem, compressed_filesize);
-
     *out = decompressed_mem;
 
-    return(errorCode);
+    return(decompressed_size);
 }
 
 /*
@@ -29,15 +29,12 @@
 
 #include <stdio.h>
 #include <cstdlib>
+#include <cstring>
 
 #include "u6decode.h"
-#include "u6stack.h"
-#include "u6dict.h"
 
 using namespace U6Decode;
 
-Dict dict;
-
 unsigned char U6Decode::read1(FILE *f) {
     return(fgetc(f));
 }
@@ -132,119 +129,128 @@ int U6Decode::get_next_codeword (long& bits_read, unsigned char *source, int cod
     return (codeword);
 }
 
-void U6Decode::output_root(unsigned char root, unsigned char *destination, long& position) {
-    destination[position] = root;
-    position++;   
-}
-
-void U6Decode::get_string(Stack &stack, int codeword) {
-    unsigned char root;
-    int current_codeword;
-   
-    current_codeword = codeword;
-    while (current_codeword > 0xff)
-        {
-            root = dict.get_root(current_codeword);
-            current_codeword = dict.get_codeword(current_codeword);
-            stack.push(root);
-        }
+// ----------------------------------------------------------------
+// Read the next code word, treating bytes past the end of the source
+// buffer as zero.
+// ----------------------------------------------------------------
+static inline int read_codeword(const unsigned char *source, long source_length,
+                                long bits_read, int codeword_size) {
+    long i = bits_read / 8;
+    int codeword;
 
-    // push the root at the leaf
-    stack.push((unsigned char)current_codeword);
+    if (i + 2 < source_length) {
+        codeword = (source[i+2] << 16) | (source[i+1] << 8) | source[i];
+    } else {
+        codeword = 0;
+        if (i + 1 < source_length)
+            codeword = source[i+1] << 8;
+        if (i < source_length)
+            codeword |= source[i];
+    }
+    return (codeword >> (bits_read % 8)) & ((1 << codeword_size) - 1);
 }
 
 // -----------------------------------------------------------------------------
 // LZW-decompress from buffer to buffer.
-// The parameters "source_length" and "destination_length" are currently unused.
-// They might be used to prevent reading/writing outside the buffers.
+//
+// Every string in the dictionary has already been output once, so the
+// dictionary only holds the position & length of each string in the
+// destination and strings are copied from there with memcpy.
+//
+// Returns EXIT_FAILURE if the data is corrupt or the decompressed data does
+// not fit into destination_length bytes.
 // -----------------------------------------------------------------------------
 int U6Decode::lzw_decompress(unsigned char *source, long source_length, unsigned char *destination, long destination_length) {
     const int max_codeword_length = 12;
+    const long bits_total = source_length * 8;
+
+    long start[0x1000];
+    unsigned short length[0x1000];
 
-    bool end_marker_reached = false;
     int codeword_size = 9;
-    long bits_read = 0; 
+    long bits_read = 0;
     int next_free_codeword = 0x102;
     int dictionary_size = 0x200;
 
     long bytes_written = 0;
+    long len;
 
     int cW;
     int pW = 0;
-    unsigned char C;
+    long pW_pos = 0;            // Position of the string for pW.
+    unsigned char* dst;
+
+    for (int i = 0; i < 0x100; ++i)
+        length[i] = 1;
+
+    for (;;) {
+        if (bits_read + codeword_size > bits_total)
+            return(EXIT_FAILURE);   // End marker is missing.
+        cW = read_codeword(source, source_length, bits_read, codeword_size);
+        bits_read += codeword_size;
 
-    while (! end_marker_reached) {
-        cW = get_next_codeword(bits_read, source, codeword_size);
-        switch (cW) {
+        if (cW == 0x100) {
             // re-init the dictionary
-        case 0x100:
             codeword_size = 9;
             next_free_codeword = 0x102;
             dictionary_size = 0x200;
-            dict.init();
-            cW = get_next_codeword(bits_read, source, codeword_size);
-            output_root((unsigned char)cW, destination, bytes_written);
-            break;
-            // end of compressed file has been reached
-        case 0x101:
-            end_marker_reached = true;
-            break;
-            // (cW <> 0x100) && (cW <> 0x101)
-        default:
-            if (cW < next_free_codeword) { // codeword is already in the dictionary
-                Stack stack;
-
-                // create the string associated with cW (on the stack)
-                get_string(stack, cW);
-                C = stack.gettop();
-                // output the string represented by cW
-                while (!stack.is_empty()) {
-                    output_root(stack.pop(), destination, bytes_written);
-                }
-                // add pW+C to the dictionary
-                dict.add(C,pW);
-
-                next_free_codeword++;
-                if (next_free_codeword >= dictionary_size) {
-                    if (codeword_size < max_codeword_length) {
-                        codeword_size += 1;
-                        dictionary_size *= 2;
-                    }
-                }
-            }
-            else {  // codeword is not yet defined
-                Stack stack;
-
-                // create the string associated with pW (on the stack)
-                get_string(stack, pW);
-                C = stack.gettop();
-                // output the string represented by pW
-                while (!stack.is_empty()) {
-                    output_root(stack.pop(), destination, bytes_written);
-                }
-                // output the char C
-                output_root(C, destination, bytes_written);
-                // the new dictionary entry must correspond to cW
-                // if it doesn't, something is wrong with the lzw-compressed data.
-                if (cW != next_free_codeword) {
-                    printf("cW != next_free_codeword!\n");
-                    return(EXIT_FAILURE);
-                }
-                // add pW+C to the dictionary
-                dict.add(C,pW);
-             
-                next_free_codeword++;
-                if (next_free_codeword >= dictionary_size) {
-                    if (codeword_size < max_codeword_length) {
-                        codeword_size += 1;
-                        dictionary_size *= 2;
-                    } 
-                }
+
+            cW = read_codeword(source, source_length, bits_read, codeword_size);
+            bits_read += codeword_size;
+            if (cW > 0xff || bytes_written >= destination_length)
+                return(EXIT_FAILURE);
+            pW = cW;
+            pW_pos = bytes_written;
+            destination[bytes_written++] = (unsigned char) cW;
+            continue;
+        }
+        if (cW == 0x101)
+            break;      // end of compressed file has been reached
+
+        if (cW < next_free_codeword) {
+            // codeword is already in the dictionary
+            // output the string represented by cW
+            len = length[cW];
+            if (bytes_written + len > destination_length)
+                return(EXIT_FAILURE);
+            dst = destination + bytes_written;
+            if (cW > 0xff)
+                memcpy(dst, destination + start[cW], len);
+            else
+                *dst = (unsigned char) cW;
+        } else {
+            // codeword is not yet defined
+            // the new dictionary entry must correspond to cW
+            // if it doesn't, something is wrong with the lzw-compressed data.
+            if (cW != next_free_codeword || bytes_written == 0)
+                return(EXIT_FAILURE);
+
+            // output the string represented by pW followed by its first char
+            len = length[pW] + 1;
+            if (bytes_written + len > destination_length)
+                return(EXIT_FAILURE);
+            dst = destination + bytes_written;
+            memcpy(dst, destination + pW_pos, len - 1);
+            dst[len - 1] = *dst;
+        }
+
+        // add pW+C to the dictionary, where C is the first char of the string
+        if (next_free_codeword < 0x1000) {
+            start[next_free_codeword] = pW_pos;
+            length[next_free_codeword] = length[pW] + 1;
+        }
+        next_free_codeword++;
+        if (next_free_codeword >= dictionary_size) {
+            if (codeword_size < max_codeword_length) {
+                codeword_size += 1;
+                dictionary_size *= 2;
             }
-            break;
         }
+
         // shift roles - the current cW becomes the new pW
         pW = cW;
+        pW_pos = bytes_written;
+        bytes_written += len;
     }
 
     return(EXIT_SUCCESS);
@@ -10,6 +10,7 @@
 #include "event.h"
 #include "party.h"
 #include "portal.h"
+#include "profile.h"
 #include "tileset.h"
 #include "xu4.h"
 
@@ -108,6 +109,9 @@ int map_getRelativeDirection(const Coords& a, const Coords& b, const Map *map) {
  * obstacles, but still fails with anything mildly complicated.
  * This function also takes into account map boundaries and adjusts
  * itself accordingly, provided the 'map' parameter is passed
+ *
+ * See path_stepToward() for a search that can find its way around
+ * obstacles.
  */
 Direction map_pathTo(const Coords& a, const Coords &b, int valid_directions, bool towards, const Map *map) {
     int directionsToObject;
@@ -199,6 +203,11 @@ bool map_outOfBounds(const Map* map, const Coords& c) {
  * Map Class Implementation
  */
 
+#define OBJ_BUCKET(bx,by) \
+    ((((by) & (OBJ_INDEX_DIM-1)) * OBJ_INDEX_DIM) + ((bx) & (OBJ_INDEX_DIM-1)))
+#define OBJ_BUCKET_AT(C) \
+    OBJ_BUCKET((C).x >> OBJ_CELL_SHIFT, (C).y >> OBJ_CELL_SHIFT)
+
 Map::Map() {
     _pad = 0;
     width = 0;
@@ -212,6 +221,12 @@ Map::Map() {
     id = 0;
     data = NULL;
     tileset = NULL;
+    objSeq = 0;
+    movePlanes = NULL;
+    movePlanesData = NULL;
+    moveRev = 0;
+    moveRowWords = 0;
+    annotations.setChangeHook(annotationChanged, this);
 }
 
 Map::~Map() {
@@ -221,28 +236,46 @@ Map::~Map() {
     }
     clearObjects();
     delete[] data;
+    delete[] movePlanes;
 }
 
 const char* Map::getName() const {
     return xu4.config->confString(fname);
 }
 
+/*
+ * Return true if the box tile at data[di] is surrounded by other boxes.
+ * These can never be the nearest surface to an open cell so the shader
+ * does not need them.
+ */
+static bool enclosedBox(const Map* map, int x, int y, int di) {
+    const Tileset* ts = map->tileset;
+    const TileId* data = map->data;
+    if (x == 0 || y == 0 || x == map->width - 1 || y == map->height - 1)
+        return false;
+    return ts->get(data[di - 1])->opaque == 1 &&
+           ts->get(data[di + 1])->opaque == 1 &&
+           ts->get(data[di - map->width])->opaque == 1 &&
+           ts->get(data[di + map->width])->opaque == 1;
+}
+
 /*
  * Build BlockingGroups for use by the shadow casting shader.
+ * The tilePos buffer is sized for the view area and rounded up to whole
+ * rows of 64 shapes.
  */
 void Map::queryBlocking(BlockingGroups* bg, int sx, int sy, int vw, int vh) const {
+    PROFILE_ZONE("Map::queryBlocking")
     const Tile* tile;
     int centerX, leftEndX, maxX;
     int centerY, maxY;
     int x, y, di;
     int count;
-    float* pos = bg->tilePos;
-    float* posEnd = pos + BLOCKING_POS_SIZE;
+    float* pos;
 
     centerX = sx + vw / 2;
-    centerY = sy + vw / 2;
+    centerY = sy + vh / 2;
 
-    // Initialize counts in case the function aborts (buffer_full).
     bg->left = bg->center = bg->right = 0;
 
     // Handle negative start positions.
@@ -262,12 +295,17 @@ void Map::queryBlocking(BlockingGroups* bg, int sx, int sy, int vw, int vh) cons
     if (maxY > height)
         maxY = height;
 
+    if (maxX <= sx || maxY <= sy)
+        return;
+    bg->tilePos.resize((((maxX - sx) * (maxY - sy) + 63) & ~63) * 3);
+    pos = &bg->tilePos[0];
+
 #define BLOCKING_COLUMN \
     for (di = sy * width + x, y = sy; y < maxY; di += width, ++y) { \
         tile = tileset->get(data[di]); \
         if (tile->opaque) { \
-            if (pos == posEnd) \
-                goto buffer_full; \
+            if (tile->opaque == 1 && enclosedBox(this, x, y, di)) \
+                continue; \
             *pos++ = (float) (x - centerX); \
             *pos++ = (float) (y - centerY); \
             *pos++ = (float) tile->opaque; \
@@ -295,10 +333,28 @@ void Map::queryBlocking(BlockingGroups* bg, int sx, int sy, int vw, int vh) cons
         BLOCKING_COLUMN
     }
     bg->right = count;
-    return;
+}
 
-buffer_full:
-    fprintf(stderr, "Map::queryBlocking pos buffer full!\n" );
+struct VisibleQuery {
+    void (*func)(const Coords*, VisualId, void*);
+    void* user;
+    const Object** focusPtr;
+    const TileRenderData* rd;
+    const Animator* animator;
+};
+
+static int queryVisibleObject(Object* obj, void* user) {
+    const VisibleQuery* vq = (const VisibleQuery*) user;
+    if (obj->focused)
+        *vq->focusPtr = obj;
+    //printf("KR obj %d %d %d,%d\n",
+    //        obj->tile.id, obj->tile.frame, obj->coords.x, obj->coords.y);
+    if (obj->animId != ANIM_UNUSED) {
+        obj->tile.frame = anim_valueI(vq->animator, obj->animId);
+    }
+    vq->func(&obj->coords, vq->rd[obj->tile.id].vid + obj->tile.frame,
+             vq->user);
+    return Map::QueryContinue;
 }
 
 /*
@@ -338,23 +394,13 @@ void Map::queryVisible(const Coords& center, int radius,
         func(cp, vid, user);
     }
 
-    const Animator* animator = &xu4.eventHandler->flourishAnim;
-    ObjectDeque::const_iterator it;
-    for(it = objects.begin(); it != objects.end(); it++) {
-        Object* obj = *it;
-        cp = &obj->coords;
-        if (OUTSIDE(cp))
-            continue;
-        if (obj->focused)
-            *focusPtr = obj;
-        //printf("KR obj %d %d %d,%d\n",
-        //        obj->tile.id, obj->tile.frame, cp->x, cp->y);
-        if (obj->animId != ANIM_UNUSED) {
-            obj->tile.frame = anim_valueI(animator, obj->animId);
-        }
-        vid = rd[obj->tile.id].vid + obj->tile.frame;
-        func(cp, vid, user);
-    }
+    VisibleQuery vq;
+    vq.func = func;
+    vq.user = user;
+    vq.focusPtr = focusPtr;
+    vq.rd = rd;
+    vq.animator = &xu4.eventHandler->flourishAnim;
+    queryObjects(center, radius, queryVisibleObject, &vq);
 
     if (flags & SHOW_AVATAR) {
         cp = &c->location->coords;
@@ -366,6 +412,53 @@ void Map::queryVisible(const Coords& center, int radius,
     }
 }
 
+/*
+ * Call a function for each Object within a square area (all levels).
+ * The callback must return Map::QueryDone or Map::QueryContinue.
+ *
+ * Only the index buckets overlapping the area are visited.  Objects
+ * on the same tile are passed to the callback in the order they were added
+ * to the map.
+ *
+ * \param center    Center of area to process.
+ * \param radius    Number of tiles away from center.
+ */
+void Map::queryObjects(const Coords& center, int radius,
+                       int (*func)(Object*, void*), void* user) const {
+    int minX, minY, maxX, maxY;
+    int bx0, by0, bx1, by1, bx, by;
+    const Coords* cp;
+
+    minX = center.x - radius;
+    minY = center.y - radius;
+    maxX = center.x + radius;
+    maxY = center.y + radius;
+
+    // Limit the block range so that no bucket is visited twice.
+    bx0 = minX >> OBJ_CELL_SHIFT;
+    by0 = minY >> OBJ_CELL_SHIFT;
+    bx1 = maxX >> OBJ_CELL_SHIFT;
+    by1 = maxY >> OBJ_CELL_SHIFT;
+    if (bx1 - bx0 >= OBJ_INDEX_DIM)
+        bx1 = bx0 + OBJ_INDEX_DIM - 1;
+    if (by1 - by0 >= OBJ_INDEX_DIM)
+        by1 = by0 + OBJ_INDEX_DIM - 1;
+
+    for (by = by0; by <= by1; ++by) {
+        for (bx = bx0; bx <= bx1; ++bx) {
+            const ObjectBucket& bucket = objIndex[ OBJ_BUCKET(bx, by) ];
+            ObjectBucket::const_iterator it;
+            for (it = bucket.begin(); it != bucket.end(); ++it) {
+                cp = &it->obj->coords;
+                if (OUTSIDE(cp))
+                    continue;
+                if (func(it->obj, user) == Map::QueryDone)
+                    return;
+            }
+        }
+    }
+}
+
 /*
  * Call a function for each Annotation at a given coordinate.
  * The callback must return Map::QueryDone or Map::QueryContinue.
@@ -389,11 +482,12 @@ void Map::queryAnnotations(const Coords& pos,
  */
 const Object *Map::objectAt(const Coords &coords) const {
     /* FIXME: return a list instead of one object */
-    ObjectDeque::const_iterator i;
+    const ObjectBucket& bucket = objIndex[ OBJ_BUCKET_AT(coords) ];
+    ObjectBucket::const_iterator i;
     const Object *objAt = NULL;
 
-    for(i = objects.begin(); i != objects.end(); i++) {
-        const Object *obj = *i;
+    for(i = bucket.begin(); i != bucket.end(); i++) {
+        const Object *obj = i->obj;
 
         if (coords == obj->coords) {
             /* get the most visible object */
@@ -472,6 +566,139 @@ const Tile* Map::tileTypeAt(const Coords &coords, int withObjects) const {
 void Map::setTileAt(const Coords& coords, TileId tid) {
     int i = (coords.z * width * height) + (coords.y * width) + coords.x;
     data[i] = tid;
+    if (movePlanes)
+        updateMovePlanes(coords);
+}
+
+/*
+ * Return the MovePlane bits for a tile.
+ */
+static uint16_t tileMoveFlags(const Tile* tile) {
+    uint16_t mf = 0;
+    int d;
+    for (d = DIR_WEST; d <= DIR_SOUTH; ++d) {
+        if (tile->canWalkOn(Direction(d)))
+            mf |= MP_WALKON(d);
+        if (tile->canWalkOff(Direction(d)))
+            mf |= MP_WALKOFF(d);
+    }
+    if (tile->isWalkable())
+        mf |= MP_BIT(MP_WALKABLE);
+    if (tile->isSwimable())
+        mf |= MP_BIT(MP_SWIMABLE);
+    if (tile->isSailable())
+        mf |= MP_BIT(MP_SAILABLE);
+    if (tile->isFlyable())
+        mf |= MP_BIT(MP_FLYABLE);
+    if (tile->isCreatureWalkable())
+        mf |= MP_BIT(MP_CREATURE_WALKABLE);
+    if (tile->isShip())
+        mf |= MP_BIT(MP_SHIP);
+    return mf;
+}
+
+static uint32_t moveRevCounter = 0;
+
+#define PLANE_WORD(plane,z,y,x) \
+    movePlanes[(((plane) * levels + (z)) * height + (y)) * moveRowWords + \
+               ((x) >> 5)]
+
+/*
+ * Fill movePlanes from the map data & any terrain annotations.
+ */
+void Map::buildMovePlanes() {
+    std::vector<uint16_t> tileFlags;
+    const TileId* tp = data;
+    uint32_t* plane;
+    size_t planeWords;
+    uint32_t bit;
+    uint16_t mf;
+    int p, x, y, z;
+
+    delete[] movePlanes;
+    moveRowWords = (width + 31) / 32;
+    planeWords = size_t(moveRowWords) * height * levels;
+    movePlanes = new uint32_t[planeWords * MP_COUNT];
+    memset(movePlanes, 0, planeWords * MP_COUNT * sizeof(uint32_t));
+    movePlanesData = data;
+    moveRev = ++moveRevCounter;
+
+    for (z = 0; z < levels; ++z) {
+        for (y = 0; y < height; ++y) {
+            for (x = 0; x < width; ++x, ++tp) {
+                if (*tp >= tileFlags.size())
+                    tileFlags.resize(*tp + 1, 0xffff);
+                mf = tileFlags[*tp];
+                if (mf == 0xffff)
+                    mf = tileFlags[*tp] = tileMoveFlags(tileset->get(*tp));
+
+                plane = &PLANE_WORD(0, z, y, x);
+                bit = 1 << (x & 31);
+                for (p = 0; p < MP_COUNT; ++p, plane += planeWords) {
+                    if (mf & (1 << p))
+                        *plane |= bit;
+                }
+            }
+        }
+    }
+
+    AnnotationList::const_iterator ait;
+    for (ait = annotations.begin(); ait != annotations.end(); ++ait) {
+        if (! ait->visualOnly)
+            updateMovePlanes(ait->coords);
+    }
+}
+
+/*
+ * Set the movePlanes bits at a single position to match tileTypeAt().
+ */
+void Map::updateMovePlanes(const Coords& pos) {
+    if (MAP_IS_OOB(this, pos))
+        return;
+
+    uint16_t mf = tileMoveFlags(tileTypeAt(pos, WITHOUT_OBJECTS));
+    uint32_t bit = 1 << (pos.x & 31);
+    moveRev = ++moveRevCounter;
+    for (int p = 0; p < MP_COUNT; ++p) {
+        uint32_t& word = PLANE_WORD(p, pos.z, pos.y, pos.x);
+        if (mf & (1 << p))
+            word |= bit;
+        else
+            word &= ~bit;
+    }
+}
+
+/*
+ * Return the terrain MovePlane bits at a position.  This is equivalent to
+ * tileMoveFlags(tileTypeAt(pos, WITHOUT_OBJECTS)).
+ */
+uint16_t Map::moveFlagsAt(const Coords& pos) const {
+    if (! movePlanes || MAP_IS_OOB(this, pos))
+        return tileMoveFlags(tileTypeAt(pos, WITHOUT_OBJECTS));
+
+    const uint32_t* plane = &PLANE_WORD(0, pos.z, pos.y, pos.x);
+    size_t planeWords = size_t(moveRowWords) * height * levels;
+    int shift = pos.x & 31;
+    uint16_t mf = 0;
+    for (int p = 0; p < MP_COUNT; ++p, plane += planeWords)
+        mf |= ((*plane >> shift) & 1) << p;
+    return mf;
+}
+
+/*
+ * Return a value which changes whenever the terrain movement rules of the
+ * map change.  The values are unique across all maps.
+ */
+uint32_t Map::moveRevision() {
+    if (movePlanesData != data)
+        buildMovePlanes();
+    return moveRev;
+}
+
+void Map::annotationChanged(void* user, const Coords& pos) {
+    Map* map = (Map*) user;
+    if (map->movePlanes)
+        map->updateMovePlanes(pos);
 }
 
 /**
@@ -557,14 +784,17 @@ Creature *Map::addCreature(const Creature *creature, const Coords& coords) {
 
     /* place the creature on the map */
     objects.push_back(m);
+    indexObject(m);
     return m;
 }
 
 /**
- * Adds an object to the given map
+ * Adds an existing object to the given map at the specified position.
  */
 Object *Map::addObject(Object *obj, Coords coords) {
+    obj->placeOnMap(this, coords);
     objects.push_back(obj);
+    indexObject(obj);
     return obj;
 }
 
@@ -576,6 +806,7 @@ Object *Map::addObject(MapTile tile, MapTile prevtile, const Coords& coords) {
     obj->placeOnMap(this, coords);
 
     objects.push_back(obj);
+    indexObject(obj);
 
     return obj;
 }
@@ -594,6 +825,7 @@ bool Map::removeObject(const Object *rem, bool deleteObject) {
     ObjectDeque::iterator i;
     for (i = objects.begin(); i != objects.end(); i++) {
         if (*i == rem) {
+            unindexObject(*i);
             /* Party members persist through different maps, so don't delete them! */
             if (deleteObject && ! isPartyMember(*i))
                 delete (*i);
@@ -605,6 +837,7 @@ bool Map::removeObject(const Object *rem, bool deleteObject) {
 }
 
 ObjectDeque::iterator Map::removeObject(ObjectDeque::iterator rem, bool deleteObject) {
+    unindexObject(*rem);
     /* Party members persist through different maps, so don't delete them! */
     if (!isPartyMember(*rem) && deleteObject)
         delete (*rem);
@@ -618,12 +851,81 @@ bool Map::objectPresent(const Object* obj) const {
     return find(objects.begin(), objects.end(), obj) != objects.end();
 }
 
+/*
+ * Add object to the spatial index bucket for its current coords.
+ */
+void Map::indexObject(Object* obj) {
+    ObjectIndexEntry ent;
+    ent.obj = obj;
+    ent.seq = objSeq++;
+    objIndex[ OBJ_BUCKET_AT(obj->coords) ].push_back(ent);
+}
+
+/*
+ * Remove object from the spatial index.
+ */
+void Map::unindexObject(const Object* obj) {
+    ObjectBucket* bucket = objIndex + OBJ_BUCKET_AT(obj->coords);
+    ObjectBucket* end = objIndex + OBJ_INDEX_DIM * OBJ_INDEX_DIM;
+    ObjectBucket::iterator it;
+
+    for (it = bucket->begin(); it != bucket->end(); ++it) {
+        if (it->obj == obj) {
+            bucket->erase(it);
+            return;
+        }
+    }
+
+    // Coords were changed without calling objectMoved(); search everywhere.
+    for (bucket = objIndex; bucket != end; ++bucket) {
+        for (it = bucket->begin(); it != bucket->end(); ++it) {
+            if (it->obj == obj) {
+                bucket->erase(it);
+                return;
+            }
+        }
+    }
+}
+
+/*
+ * Update the spatial index after the coords of an object have changed.
+ * This is called by Object::updateCoords() & Object::placeOnMap().
+ *
+ * \param from  The previous coords of the object.
+ *
+ * Return false if the object is not indexed on this map.
+ */
+bool Map::objectMoved(const Object* obj, const Coords& from) {
+    ObjectBucket& src = objIndex[ OBJ_BUCKET_AT(from) ];
+    ObjectBucket& dst = objIndex[ OBJ_BUCKET_AT(obj->coords) ];
+    ObjectBucket::iterator it;
+
+    for (it = src.begin(); it != src.end(); ++it) {
+        if (it->obj == obj) {
+            if (&src != &dst) {
+                // Keep the destination ordered by seq so that objectAt()
+                // resolves overlapping objects as Map::objects would.
+                ObjectIndexEntry ent = *it;
+                src.erase(it);
+                for (it = dst.end(); it != dst.begin(); --it) {
+                    if ((it - 1)->seq < ent.seq)
+                        break;
+                }
+                dst.insert(it, ent);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * Moves all of the objects on the given map.
  * Returns an attacking object if there is a creature attacking.
  * Also performs special creature actions and creature effects.
  */
 Creature *Map::moveObjects(const Coords& avatar) {
+    PROFILE_ZONE("Map::moveObjects")
     Creature *attacker = NULL;
 
     for (unsigned int i = 0; i < objects.size(); i++) {
@@ -676,6 +978,10 @@ void Map::clearObjects() {
             delete *o;
     }
     objects.clear();
+
+    for (int i = 0; i < OBJ_INDEX_DIM * OBJ_INDEX_DIM; ++i)
+        objIndex[i].clear();
+    objSeq = 0;
 }
 
 /**
@@ -703,11 +1009,12 @@ int Map::getValidMoves(const Coords& from, MapTile transport) {
     Direction d;
     Object *obj;
     const Creature *m, *to_m;
-    const Tile* prev_tile;
-    const Tile* tile;
+    uint16_t prevMove, move;
     int ontoAvatar, ontoCreature;
     Coords testCoord;
 
+    moveRevision();
+
     // get the creature object, if it exists (the one that's moving)
     m = Creature::getByTile(transport);
 
@@ -715,7 +1022,7 @@ int Map::getValidMoves(const Coords& from, MapTile transport) {
     if (m && m->canMoveOntoPlayer())
         isAvatar = false;
 
-    prev_tile = tileTypeAt(from, WITHOUT_OBJECTS);
+    prevMove = moveFlagsAt(from);
 
     retval = 0;
     for (d = DIR_WEST; d <= DIR_SOUTH; d = (Direction)(d+1)) {
@@ -742,13 +1049,15 @@ int Map::getValidMoves(const Coords& from, MapTile transport) {
         else if (obj && (obj->objType != Object::UNKNOWN))
             ontoCreature = 1;
 
-        // get the destination tile
+        // get the destination tile movement flags
         if (ontoAvatar)
-            tile = c->party->getTransport().getTileType();
+            move = tileMoveFlags(c->party->getTransport().getTileType());
         else if (ontoCreature)
-            tile = obj->tile.getTileType();
+            move = tileMoveFlags(obj->tile.getTileType());
+        else if (obj)
+            move = tileMoveFlags(tileTypeAt(testCoord, WITH_OBJECTS));
         else
-            tile = tileTypeAt(testCoord, WITH_OBJECTS);
+            move = moveFlagsAt(testCoord);
 
         // get the other creature object, if it exists (the one that's being moved onto)
         to_m = dynamic_cast<Creature*>(obj);
@@ -761,7 +1070,7 @@ int Map::getValidMoves(const Coords& from, MapTile transport) {
             // these conditions are not met, the creature cannot move onto another.
 
             if ((ontoAvatar && m->canMoveOntoPlayer()) || (ontoCreature && m->canMoveOntoCreatures()))
-                tile = tileTypeAt(testCoord, WITHOUT_OBJECTS); //Ignore all objects, and just consider terrain
+                move = moveFlagsAt(testCoord); //Ignore all objects, and just consider terrain
               if ((ontoAvatar && !m->canMoveOntoPlayer())
                 ||  (
                         ontoCreature &&
@@ -781,14 +1090,14 @@ int Map::getValidMoves(const Coords& from, MapTile transport) {
             // avatar or horseback: check walkable
 
             const Tile* transTile = transport.getTileType();
-            if (transTile->isShip() && tile->isSailable())
+            if (transTile->isShip() && (move & MP_BIT(MP_SAILABLE)))
                 retval = DIR_ADD_TO_MASK(d, retval);
-            else if (transTile->isBalloon() && tile->isFlyable())
+            else if (transTile->isBalloon() && (move & MP_BIT(MP_FLYABLE)))
                 retval = DIR_ADD_TO_MASK(d, retval);
             else if (transTile->name == Tile::sym.avatar || transTile->isHorse()) {
-                if (tile->canWalkOn(d) &&
-                    (!transTile->isHorse() || tile->isCreatureWalkable()) &&
-                    prev_tile->canWalkOff(d))
+                if ((move & MP_WALKON(d)) &&
+                    (!transTile->isHorse() || (move & MP_BIT(MP_CREATURE_WALKABLE))) &&
+                    (prevMove & MP_WALKOFF(d)))
                     retval = DIR_ADD_TO_MASK(d, retval);
             }
 //            else if (ontoCreature && to_m->canMoveOntoPlayer()) {
@@ -798,54 +1107,55 @@ int Map::getValidMoves(const Coords& from, MapTile transport) {
 
         // creature movement
         else if (m) {
-            // flying creatures
-            if (tile->isFlyable() && m->flies()) {
-                // FIXME: flying creatures behave differently on the world map?
-                if (isWorldMap())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-                else if (tile->isWalkable() ||
-                         tile->isSwimable() ||
-                         tile->isSailable())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-            }
-            // swimming creatures and sailing creatures
-            else if (tile->isSwimable() ||
-                     tile->isSailable() ||
-                     tile->isShip()) {
-                if (m->swims() && tile->isSwimable())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-                if (m->sails() && tile->isSailable())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-                if (m->canMoveOntoPlayer() && tile->isShip())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-            }
-            // ghosts and other incorporeal creatures
-            else if (m->isIncorporeal()) {
-                // can move anywhere but onto water, unless of course the creature can swim
-                if (!(tile->isSwimable() ||
-                      tile->isSailable()))
-                    retval = DIR_ADD_TO_MASK(d, retval);
-            }
-            // walking creatures
-            else if (m->walks()) {
-                if (tile->canWalkOn(d) &&
-                    prev_tile->canWalkOff(d) &&
-                    tile->isCreatureWalkable())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-            }
-            // Creatures that can move onto player
-            else if (ontoAvatar && m->canMoveOntoPlayer())
-            {
-                //tile should be transport
-                if (tile->isShip() && m->swims())
-                    retval = DIR_ADD_TO_MASK(d, retval);
-            }
+            if (map_creatureCanMove(m, prevMove, move, d, isWorldMap()))
+                retval = DIR_ADD_TO_MASK(d, retval);
         }
     }
 
     return retval;
 }
 
+/**
+ * Returns true if the creature can move in direction d from a tile with the
+ * MovePlane bits fromMove to one with toMove.
+ */
+bool map_creatureCanMove(const Creature* m, uint16_t fromMove, uint16_t toMove,
+                         Direction d, bool worldMap) {
+    // flying creatures
+    if ((toMove & MP_BIT(MP_FLYABLE)) && m->flies()) {
+        // FIXME: flying creatures behave differently on the world map?
+        if (worldMap)
+            return true;
+        return (toMove & (MP_BIT(MP_WALKABLE) |
+                          MP_BIT(MP_SWIMABLE) |
+                          MP_BIT(MP_SAILABLE))) != 0;
+    }
+    // swimming creatures and sailing creatures
+    if (toMove & (MP_BIT(MP_SWIMABLE) |
+                  MP_BIT(MP_SAILABLE) |
+                  MP_BIT(MP_SHIP))) {
+        if (m->swims() && (toMove & MP_BIT(MP_SWIMABLE)))
+            return true;
+        if (m->sails() && (toMove & MP_BIT(MP_SAILABLE)))
+            return true;
+        return m->canMoveOntoPlayer() && (toMove & MP_BIT(MP_SHIP));
+    }
+    // ghosts and other incorporeal creatures
+    if (m->isIncorporeal()) {
+        // can move anywhere but onto water, unless of course the creature can swim
+        return true;
+    }
+    // walking creatures
+    if (m->walks()) {
+        return (toMove & MP_WALKON(d)) &&
+               (fromMove & MP_WALKOFF(d)) &&
+               (toMove & MP_BIT(MP_CREATURE_WALKABLE));
+    }
+    // A creature that can move onto the player would only be allowed onto
+    // a ship, which is handled above.
+    return false;
+}
+
 bool Map::move(Object *obj, Direction d) {
     Coords new_coords = obj->coords;
     map_move(new_coords, d);
@@ -34,10 +34,57 @@ typedef std::deque<const Object *> CObjectDeque;
 #define WITH_GROUND_OBJECTS 1
 #define WITH_OBJECTS        2
 
-#define BLOCKING_POS_SIZE   128*3
+/*
+ * Objects are bucketed by blocks of OBJ_CELL_DIM x OBJ_CELL_DIM tiles.  The
+ * bucket table covers OBJ_INDEX_DIM x OBJ_INDEX_DIM blocks and repeats
+ * (wraps) over larger maps.
+ */
+#define OBJ_CELL_SHIFT  2
+#define OBJ_CELL_DIM    (1 << OBJ_CELL_SHIFT)
+#define OBJ_INDEX_DIM   16
+
+struct ObjectIndexEntry {
+    Object* obj;
+    uint32_t seq;       // Order of insertion into Map::objects.
+};
+
+typedef std::vector<ObjectIndexEntry> ObjectBucket;
+
+/*
+ * Terrain movement rules are kept in bitplanes (one bit per map cell) so
+ * that getValidMoves() doesn't need to search the annotations for each
+ * test.  A MovePlane value is the plane index and also the bit number of
+ * the flags returned by moveFlagsAt().
+ */
+enum MovePlane {
+    MP_WALKON_W,        // Walk on from DIR_WEST ... DIR_SOUTH.
+    MP_WALKON_N,
+    MP_WALKON_E,
+    MP_WALKON_S,
+    MP_WALKOFF_W,       // Walk off to DIR_WEST ... DIR_SOUTH.
+    MP_WALKOFF_N,
+    MP_WALKOFF_E,
+    MP_WALKOFF_S,
+    MP_WALKABLE,
+    MP_SWIMABLE,
+    MP_SAILABLE,
+    MP_FLYABLE,
+    MP_CREATURE_WALKABLE,
+    MP_SHIP,
+    MP_COUNT
+};
+
+#define MP_BIT(plane)       (1 << (plane))
+#define MP_WALKON(dir)      (1 << (MP_WALKON_W + (dir) - DIR_WEST))
+#define MP_WALKOFF(dir)     (1 << (MP_WALKOFF_W + (dir) - DIR_WEST))
+
+/*
+ * Opaque tiles of a view for the shadow casting shader, grouped by the
+ * columns left of, at, and right of the center.
+ */
 struct BlockingGroups {
     int left, center, right;
-    float tilePos[BLOCKING_POS_SIZE];
+    std::vector<float> tilePos;     // (x, y, opaque type) for each tile.
 };
 
 /**
@@ -77,6 +124,8 @@ public:
     void queryAnnotations(const Coords& pos,
                           int (*func)(const Annotation*, void*),
                           void* user) const;
+    void queryObjects(const Coords& center, int radius,
+                      int (*func)(Object*, void*), void* user) const;
     const Object* objectAt(const Coords &coords) const;
     Object* objectAt(const Coords &coords) {
         return (Object*) static_cast<const Map*>(this)->objectAt(coords);
@@ -94,9 +143,12 @@ public:
     ObjectDeque::iterator removeObject(ObjectDeque::iterator rem, bool deleteObject = true);
     void clearObjects();
     bool objectPresent(const Object* obj) const;
+    bool objectMoved(const Object* obj, const Coords& from);
     class Creature *moveObjects(const Coords& avatar);
     int getNumberOfCreatures();
     int getValidMoves(const Coords& from, MapTile transport);
+    uint16_t moveFlagsAt(const Coords&) const;
+    uint32_t moveRevision();
     bool move(Object *obj, Direction d);
     void alertGuards();
     const Coords* getLabel(Symbol name) const;
@@ -128,7 +180,7 @@ public:
     PortalList      portals;
     AnnotationList  annotations;
     TileId*         data;
-    ObjectDeque     objects;
+    ObjectDeque     objects;    // Only modify with add/removeObject.
     std::map<Symbol, Coords> labels;
     const Tileset*  tileset;
 
@@ -139,6 +191,18 @@ private:
     Map &operator=(const Map &map);
 
     void findWalkability(Coords coords, int *path_data);
+    void indexObject(Object*);
+    void unindexObject(const Object*);
+    void buildMovePlanes();
+    void updateMovePlanes(const Coords&);
+    static void annotationChanged(void* user, const Coords&);
+
+    ObjectBucket    objIndex[OBJ_INDEX_DIM * OBJ_INDEX_DIM];
+    uint32_t        objSeq;
+    uint32_t*       movePlanes;     // MP_COUNT planes of levels * height rows.
+    const TileId*   movePlanesData; // The data which movePlanes was built from.
+    uint32_t        moveRev;        // Changed whenever movePlanes changes.
+    uint16_t        moveRowWords;
 };
 
 inline bool isCity(const Map* map)      { return map->type == Map::CITY; }
@@ -148,6 +212,8 @@ inline bool isDungeon(const Map* map)   { return map->type == Map::DUNGEON; }
 Direction map_pathTo(const Coords &a, const Coords &b,
                      int valid_dirs = MASK_DIR_ALL, bool towards = true,
                      const Map *map = NULL);
+bool map_creatureCanMove(const Creature* m, uint16_t fromMove, uint16_t toMove,
+                         Direction d, bool worldMap);
 Direction map_pathAway(const Coords &a, const Coords &b,
                        int valid_dirs = MASK_DIR_ALL);
 void map_wrap(Coords&, const Map *map);
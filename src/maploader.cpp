@@ -2,9 +2,11 @@
  * maploader.cpp
  */
 
+#include <cstdlib>
 #include <cstring>
 #include "u4.h"
 
+#include "assetloader.h"
 #include "city.h"
 #include "config.h"
 #include "dialogueloader.h"
@@ -13,6 +15,7 @@
 #include "error.h"
 #include "mapmgr.h"
 #include "person.h"
+#include "settings.h"
 #include "u4file.h"
 #include "xu4.h"
 
@@ -27,6 +30,96 @@ static bool isChunkCompressed(Map *map, int chunk) {
 }
 #endif
 
+/*
+ * Map & dialogue files which have been read by the background loader but
+ * not yet parsed are held here until loadMap() needs them.  The total size
+ * is limited by Settings::prefetchBudget and the least recently requested
+ * files are dropped first.
+ */
+#define PREFETCH_SLOTS  24
+
+struct PrefetchedFile {
+    const void* key;        // Map* or City::tlk_fname.
+    uint8_t* buf;
+    long size;
+    uint32_t lastUse;
+};
+
+static PrefetchedFile prefetched[PREFETCH_SLOTS];
+static long prefetchedBytes = 0;
+static uint32_t prefetchClock = 0;
+
+static void dropPrefetched(PrefetchedFile* pf) {
+    free(pf->buf);
+    prefetchedBytes -= pf->size;
+    pf->key = NULL;
+    pf->buf = NULL;
+    pf->size = 0;
+}
+
+static PrefetchedFile* findPrefetched(const void* key) {
+    PrefetchedFile* pf  = prefetched;
+    PrefetchedFile* end = pf + PREFETCH_SLOTS;
+    for (; pf != end; ++pf) {
+        if (pf->key == key)
+            return pf;
+    }
+    return NULL;
+}
+
+static void cachePrefetched(const void* key, uint8_t* buf, long size) {
+    long budget = long(xu4.settings->prefetchBudget) * 1024;
+    PrefetchedFile* pf;
+    PrefetchedFile* oldest;
+    int i;
+
+    if (size > budget) {
+        free(buf);
+        return;
+    }
+
+    for (;;) {
+        oldest = NULL;
+        pf = NULL;
+        for (i = 0; i < PREFETCH_SLOTS; ++i) {
+            if (! prefetched[i].key)
+                pf = prefetched + i;
+            else if (! oldest || prefetched[i].lastUse < oldest->lastUse)
+                oldest = prefetched + i;
+        }
+        if (pf && prefetchedBytes + size <= budget)
+            break;
+        dropPrefetched(oldest);
+    }
+
+    pf->key  = key;
+    pf->buf  = buf;
+    pf->size = size;
+    pf->lastUse = ++prefetchClock;
+    prefetchedBytes += size;
+}
+
+/*
+ * Return the prefetched contents of a file and remove it from the cache,
+ * or NULL if it has not been read.  If the loader is still reading it then
+ * wait for it to finish.  The caller must free() the returned buffer.
+ */
+static uint8_t* takePrefetched(const void* key, long* size) {
+    AssetJob* job = xu4.assets->find(ASSET_MAP, key);
+    if (job)
+        xu4.assets->wait(job);
+
+    PrefetchedFile* pf = findPrefetched(key);
+    if (! pf)
+        return NULL;
+
+    uint8_t* buf = pf->buf;
+    *size = pf->size;
+    pf->buf = NULL;
+    dropPrefetched(pf);
+    return buf;
+}
+
 /**
  * Loads raw data from the given file.
  */
@@ -35,7 +128,7 @@ bool loadMapData(Map *map, U4FILE *uf, Symbol borderTile) {
     unsigned int chunkCols, chunkRows;
     size_t chunkLen;
     uint8_t* chunk;
-    uint8_t* cp;
+    const uint8_t* cp;
     const UltimaSaveIds* usaveIds = xu4.config->usaveIds();
     bool ok = false;
 #ifdef U5_DAT
@@ -112,11 +205,11 @@ bool loadMapData(Map *map, U4FILE *uf, Symbol borderTile) {
             else
 #endif
             {
-                size_t n = u4fread(chunk, 1, chunkLen, uf);
-                if (n != chunkLen)
+                // Use the file bytes in place if possible.
+                cp = u4fspan(uf, chunkLen, chunk);
+                if (! cp)
                     goto cleanup;
 
-                cp = chunk;
                 for(y = 0; y < map->chunk_height; ++y) {
                     for(x = 0; x < map->chunk_width; ++x) {
                         int c = *cp++;
@@ -217,7 +310,10 @@ static bool loadCityMap(Map *map, U4FILE *ult) {
 
     {
     const uint8_t* conv_idx = data + PD_CONV;
-    U4FILE *tlk = u4fopen(xu4.config->confString(city->tlk_fname));
+    long tlkSize;
+    uint8_t* tlkData = takePrefetched(&city->tlk_fname, &tlkSize);
+    U4FILE *tlk = tlkData ? u4fopen_mem(tlkData, tlkSize)
+                          : u4fopen(xu4.config->confString(city->tlk_fname));
     if (! tlk)
         errorFatal("Unable to open .TLK file");
 
@@ -252,6 +348,7 @@ static bool loadCityMap(Map *map, U4FILE *ult) {
     }
 
     u4fclose(tlk);
+    free(tlkData);
     }
 
     /*
@@ -501,10 +598,8 @@ static bool loadDungeonMap(Map *map, U4FILE *uf, FILE *sav) {
     return true;
 }
 
-bool loadMap(Map *map, FILE* sav) {
+static U4FILE* openMapFile(const Map* map) {
     U4FILE* uf;
-    bool ok = false;
-
 #ifdef CONF_MODULE
     if (map->fname) {
         string fname( xu4.config->confString(map->fname) );
@@ -512,8 +607,8 @@ bool loadMap(Map *map, FILE* sav) {
     } else {
         const CDIEntry* ent = xu4.config->mapFile(map->id);
         if (ent) {
-            uf = u4fopen_stdio(xu4.config->modulePath());
-            u4fseek(uf, ent->offset, SEEK_SET);
+            const uint8_t* data = xu4.config->moduleData(ent);
+            uf = data ? u4fopen_mem(data, ent->bytes) : NULL;
         } else
             uf = NULL;
     }
@@ -521,26 +616,153 @@ bool loadMap(Map *map, FILE* sav) {
     string fname( xu4.config->confString(map->fname) );
     uf = u4fopen(fname);
 #endif
+    return uf;
+}
+
+static bool parseMap(Map *map, U4FILE* uf, FILE* sav) {
+    bool ok = false;
+    switch (map->type) {
+        case Map::CITY:
+            ok = loadCityMap(map, uf);
+            break;
+
+        case Map::COMBAT:
+        case Map::SHRINE:
+            ok = loadCombatMap(map, uf);
+            break;
+
+        case Map::DUNGEON:
+            ok = loadDungeonMap(map, uf, sav);
+            break;
+
+        case Map::WORLD:
+            ok = loadMapData(map, uf, SYM_UNSET);
+            break;
+    }
+    return ok;
+}
+
+/*
+ * If job->flag is set then job->file is a malloc'd file name which is opened
+ * here so that the main thread does not wait on the path search.
+ */
+static void mapJobWork(AssetJob* job) {
+    U4FILE* uf;
+    long len;
+    uint8_t* buf;
+
+    if (job->flag) {
+        char* fname = (char*) job->file;
+        uf = u4fopen(fname);
+        free(fname);
+        job->file = NULL;
+        job->flag = false;
+        if (! uf)
+            return;
+    } else
+        uf = (U4FILE*) job->file;
+
+    len = u4flength(uf);
+    buf = (uint8_t*) malloc(len);
+
+    if (buf && u4fread(buf, 1, len, uf) == (size_t) len) {
+        job->result = buf;
+        job->size = len;
+    } else
+        free(buf);
+
+    u4fclose(uf);
+    job->file = NULL;
+}
+
+static void mapJobDiscard(AssetJob* job) {
+    if (job->flag)
+        free(job->file);
+    else if (job->file)
+        u4fclose((U4FILE*) job->file);
+    free(job->result);
+}
+
+static void mapJobFinish(AssetJob* job) {
+    if (job->result) {
+        cachePrefetched(job->key, (uint8_t*) job->result, job->size);
+        job->ok = true;
+    }
+}
+
+/*
+ * Return true if the file for key is neither cached nor being read.
+ * A cached file is marked as recently used.
+ */
+static bool prefetchNeeded(const void* key) {
+    PrefetchedFile* pf = findPrefetched(key);
+    if (pf) {
+        pf->lastUse = ++prefetchClock;
+        return false;
+    }
+    return xu4.assets->find(ASSET_MAP, key) == NULL;
+}
+
+static void requestRead(const void* key, uint32_t id, U4FILE* uf,
+                        const char* fname = NULL) {
+    AssetJob job;
+    job.work    = mapJobWork;
+    job.finish  = mapJobFinish;
+    job.discard = mapJobDiscard;
+    job.key     = key;
+    job.file    = fname ? (void*) strdup(fname) : (void*) uf;
+    job.result  = NULL;
+    job.size    = 0;
+    job.id      = id;
+    job.group   = 0;
+    job.kind    = ASSET_MAP;
+    job.flag    = (fname != NULL);
+    if (! xu4.assets->request(job)) {
+        if (fname)
+            free(job.file);
+        else
+            u4fclose(uf);
+    }
+}
+
+/**
+ * Have the background loader read the files for a map (and its dialogue
+ * if it is a city) so that a later loadMap() does not wait on storage.
+ */
+void mapPrefetch(Map *map) {
+    U4FILE* uf;
+
+    if (map->data || xu4.settings->prefetchBudget <= 0)
+        return;
+
+#ifdef CONF_MODULE
+    // Maps without a file name are already in the mapped module package.
+    if (map->fname && prefetchNeeded(map)) {
+#else
+    if (prefetchNeeded(map)) {
+#endif
+        uf = openMapFile(map);
+        if (uf)
+            requestRead(map, map->id, uf);
+    }
+
+    if (map->type == Map::CITY) {
+        City* city = dynamic_cast<City*>(map);
+        if (prefetchNeeded(&city->tlk_fname))
+            requestRead(&city->tlk_fname, map->id, NULL,
+                        xu4.config->confString(city->tlk_fname));
+    }
+}
+
+bool loadMap(Map *map, FILE* sav) {
+    long size;
+    uint8_t* data = takePrefetched(map, &size);
+    U4FILE* uf = data ? u4fopen_mem(data, size) : openMapFile(map);
+    bool ok = false;
     if (uf) {
-        switch (map->type) {
-            case Map::CITY:
-                ok = loadCityMap(map, uf);
-                break;
-
-            case Map::COMBAT:
-            case Map::SHRINE:
-                ok = loadCombatMap(map, uf);
-                break;
-
-            case Map::DUNGEON:
-                ok = loadDungeonMap(map, uf, sav);
-                break;
-
-            case Map::WORLD:
-                ok = loadMapData(map, uf, SYM_UNSET);
-                break;
-        }
+        ok = parseMap(map, uf, sav);
         u4fclose(uf);
     }
+    free(data);
     return ok;
 }
@@ -7,6 +7,7 @@
 #include "context.h"
 #include "debug.h"
 #include "dungeon.h"
+#include "pathfind.h"
 #include "utils.h"
 #include "xu4.h"
 
@@ -197,7 +198,7 @@ int moveObject(Map *map, Creature *obj, const Coords& avatar) {
             break;
         }
 
-        dir = map_pathTo(new_coords, avatar, dirmask, true, c->location->map);
+        dir = path_stepToward(map, obj, new_coords, avatar, dirmask);
         break;
     }
 
@@ -241,7 +242,7 @@ int moveObject(Map *map, Creature *obj, const Coords& avatar) {
     if (! (new_coords == obj->coords) &&
         ! MAP_IS_OOB(map, new_coords))
     {
-        obj->coords = new_coords;
+        obj->updateCoords(new_coords);
     }
     return 1;
 }
@@ -277,7 +278,7 @@ int moveCombatObject(int act, Map *map, Creature *obj, const Coords& target) {
         else if (new_coords.y >= (signed)(map->height - 1))
             valid_dirs = DIR_REMOVE_FROM_MASK(DIR_SOUTH, valid_dirs);
 
-        dir = map_pathTo(new_coords, target, valid_dirs);
+        dir = path_stepToward(map, obj, new_coords, target, valid_dirs);
     }
 
     if (dir)
@@ -35,14 +35,34 @@ bool Object::setDirection(Direction d) {
     return tile.setDirection(d);
 }
 
+/*
+ * Move the Object to a new position and save the current one in prevCoords.
+ * The spatial index of any map the Object is on is kept in sync.
+ */
+void Object::updateCoords(const Coords& pos) {
+    prevCoords = coords;
+    coords = pos;
+
+    Location* loc = c ? c->location : NULL;
+    int maps = onMaps;
+    while (maps && loc) {
+        if (loc->map->objectMoved(this, prevCoords))
+            --maps;
+        loc = loc->prev;
+    }
+}
+
 /*
  * Sets Object coords & prevCoords to the specified position.
  */
 void Object::placeOnMap(Map* map, const Coords& pos) {
+    Coords from = coords;
+
     if (! onMaps || ! map->objectPresent(this))
         ++onMaps;
 
     coords = prevCoords = pos;
+    map->objectMoved(this, from);
 
     /* Start frame animation */
     if (animId == ANIM_UNUSED) {
@@ -0,0 +1,375 @@
+/*
+ * pathfind.cpp
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include "pathfind.h"
+
+#include "creature.h"
+#include "map.h"
+#include "profile.h"
+
+/*
+ * Creatures chasing the same target share a distance field.  This is a
+ * breadth first search outward from the target over a window of the map
+ * (the whole map if it is small enough) which holds the number of moves
+ * needed to reach the target from each cell.  Each creature then steps to
+ * the neighboring cell with the lowest distance.
+ *
+ * Only the terrain is considered, so a field remains valid until the
+ * target moves or Map::moveRevision() changes.  Creatures with the same
+ * movement attributes use the same field.
+ *
+ * Creatures outside the window fall back to an A* search.
+ */
+
+#define FIELD_DIM       64
+#define FIELD_CACHE     16
+#define UNREACHED       0xffff
+#define ASTAR_NODES     1024
+#define ASTAR_HASH      (ASTAR_NODES * 2)
+
+struct DistanceField {
+    const Map* map;
+    uint32_t revision;
+    uint32_t lastUse;
+    Coords target;
+    uint16_t moverKey;
+    uint16_t w, h;
+    int x0, y0;             // Map position of the window origin.
+    uint16_t dist[FIELD_DIM * FIELD_DIM];
+};
+
+static DistanceField fieldCache[FIELD_CACHE];
+static uint32_t fieldClock = 0;
+
+static const int stepX[5] = { 0, -1, 0, 1, 0 };     // Indexed by Direction.
+static const int stepY[5] = { 0, 0, -1, 0, 1 };
+
+static uint16_t moverKey(const Creature* m) {
+    return (m->flies()     ? 0x01 : 0) |
+           (m->swims()     ? 0x02 : 0) |
+           (m->sails()     ? 0x04 : 0) |
+           (m->canMoveOntoPlayer() ? 0x08 : 0) |
+           (m->isIncorporeal()     ? 0x10 : 0);
+}
+
+/*
+ * Move x,y one step in direction d.
+ * Return false if the step leaves a map which does not wrap.
+ */
+static bool stepPos(const Map* map, int& x, int& y, int d) {
+    x += stepX[d];
+    y += stepY[d];
+    if (map->border_behavior == Map::BORDER_WRAP) {
+        if (x < 0)
+            x += map->width;
+        else if (x >= map->width)
+            x -= map->width;
+        if (y < 0)
+            y += map->height;
+        else if (y >= map->height)
+            y -= map->height;
+        return true;
+    }
+    return x >= 0 && x < map->width && y >= 0 && y < map->height;
+}
+
+/*
+ * Return the window index of a map position or -1 if it is outside.
+ */
+static int fieldIndex(const DistanceField* df, const Map* map, int x, int y) {
+    x -= df->x0;
+    y -= df->y0;
+    if (map->border_behavior == Map::BORDER_WRAP) {
+        x %= map->width;
+        if (x < 0)
+            x += map->width;
+        y %= map->height;
+        if (y < 0)
+            y += map->height;
+    }
+    if (x < 0 || x >= df->w || y < 0 || y >= df->h)
+        return -1;
+    return y * df->w + x;
+}
+
+static int windowOrigin(int target, int dim, int mapDim, bool wrap) {
+    if (dim == mapDim)
+        return 0;
+    int org = target - dim / 2;
+    if (! wrap) {
+        if (org < 0)
+            org = 0;
+        else if (org > mapDim - dim)
+            org = mapDim - dim;
+    }
+    return org;
+}
+
+static void buildField(DistanceField* df, Map* map, const Creature* m) {
+    static uint16_t moves[FIELD_DIM * FIELD_DIM];
+    static uint16_t queue[FIELD_DIM * FIELD_DIM];
+    const bool wrap = (map->border_behavior == Map::BORDER_WRAP);
+    const bool world = map->isWorldMap();
+    Coords pos(0, 0, df->target.z);
+    int i, d, head, tail, bi, ai, bx, by, ax, ay;
+
+    PROFILE_ZONE("buildField")
+
+    df->w = std::min(int(map->width),  FIELD_DIM);
+    df->h = std::min(int(map->height), FIELD_DIM);
+    df->x0 = windowOrigin(df->target.x, df->w, map->width, wrap);
+    df->y0 = windowOrigin(df->target.y, df->h, map->height, wrap);
+
+    for (i = 0; i < df->w * df->h; ++i) {
+        pos.x = df->x0 + i % df->w;
+        pos.y = df->y0 + i / df->w;
+        map_wrap(pos, map);
+        moves[i] = map->moveFlagsAt(pos);
+        df->dist[i] = UNREACHED;
+    }
+
+    bi = fieldIndex(df, map, df->target.x, df->target.y);
+    if (bi < 0)
+        return;
+    df->dist[bi] = 0;
+    queue[0] = bi;
+    head = 0;
+    tail = 1;
+
+    // Search backwards, finding the cells A from which a creature can
+    // step onto cell B.  The target cell itself is always enterable.
+    while (head < tail) {
+        bi = queue[head++];
+        bx = df->x0 + bi % df->w;
+        by = df->y0 + bi / df->w;
+
+        for (d = DIR_WEST; d <= DIR_SOUTH; ++d) {
+            ax = bx;
+            ay = by;
+            if (! stepPos(map, ax, ay, dirReverse(Direction(d))))
+                continue;
+            ai = fieldIndex(df, map, ax, ay);
+            if (ai < 0 || df->dist[ai] != UNREACHED)
+                continue;
+            if (df->dist[bi] != 0 &&
+                ! map_creatureCanMove(m, moves[ai], moves[bi], Direction(d),
+                                      world))
+                continue;
+            df->dist[ai] = df->dist[bi] + 1;
+            queue[tail++] = ai;
+        }
+    }
+}
+
+/*
+ * Return the distance field for creatures like m heading to the target.
+ */
+static const DistanceField* distanceField(Map* map, const Creature* m,
+                                          const Coords& target) {
+    uint32_t rev = map->moveRevision();
+    uint16_t key = moverKey(m);
+    DistanceField* df;
+    DistanceField* oldest = fieldCache;
+    int i;
+
+    ++fieldClock;
+    for (i = 0; i < FIELD_CACHE; ++i) {
+        df = fieldCache + i;
+        if (df->map == map && df->revision == rev &&
+            df->moverKey == key && df->target == target) {
+            df->lastUse = fieldClock;
+            return df;
+        }
+        if (df->lastUse < oldest->lastUse)
+            oldest = df;
+    }
+
+    df = oldest;
+    df->map      = map;
+    df->revision = rev;
+    df->lastUse  = fieldClock;
+    df->target   = target;
+    df->moverKey = key;
+    buildField(df, map, m);
+    return df;
+}
+
+/**
+ * Finds the direction to travel to get from one point to another.
+ * Only directions in the valid_dirs mask are considered.  If there is no
+ * way to get closer to the target, then map_pathTo() is used.
+ */
+Direction path_stepToward(Map* map, const Creature* m, const Coords& from,
+                          const Coords& to, int valid_dirs) {
+    const DistanceField* df;
+    int fi, ni, d, nx, ny;
+    int best, bestDirs;
+
+    if (from.z != to.z || ! (valid_dirs & (MASK_DIR_WEST | MASK_DIR_NORTH |
+                                          MASK_DIR_EAST | MASK_DIR_SOUTH)))
+        return map_pathTo(from, to, valid_dirs, true, map);
+
+    df = distanceField(map, m, to);
+    fi = fieldIndex(df, map, from.x, from.y);
+    if (fi < 0) {
+        d = path_aStar(map, m, from, to, ASTAR_NODES);
+        if (d != DIR_NONE && DIR_IN_MASK(d, valid_dirs))
+            return Direction(d);
+        return map_pathTo(from, to, valid_dirs, true, map);
+    }
+
+    best = df->dist[fi];
+    bestDirs = 0;
+    for (d = DIR_WEST; d <= DIR_SOUTH; ++d) {
+        if (! DIR_IN_MASK(d, valid_dirs))
+            continue;
+        nx = from.x;
+        ny = from.y;
+        if (! stepPos(map, nx, ny, d))
+            continue;
+        ni = fieldIndex(df, map, nx, ny);
+        if (ni < 0)
+            continue;
+        if (df->dist[ni] < best) {
+            best = df->dist[ni];
+            bestDirs = MASK_DIR(d);
+        } else if (bestDirs && df->dist[ni] == best) {
+            bestDirs |= MASK_DIR(d);
+        }
+    }
+
+    if (bestDirs)
+        return dirRandomDir(bestDirs);
+    return map_pathTo(from, to, valid_dirs, true, map);
+}
+
+struct AStarNode {
+    uint32_t cell;
+    int16_t x, y;
+    uint16_t g;
+    uint8_t firstDir;
+    uint8_t closed;
+};
+
+// The open set is a heap of (f << 16 | node index).
+#define HEAP_PUSH(f,i) \
+    heap[heapLen++] = (uint32_t(f) << 16) | (i); \
+    std::push_heap(heap, heap + heapLen, minHeap)
+
+#define HASH_SLOT(c)    ((c) * 2654435761u >> 21 & (ASTAR_HASH - 1))
+
+static int wrapDelta(int a, int b, int dim, bool wrap) {
+    int d = abs(a - b);
+    if (wrap && d > dim / 2)
+        d = dim - d;
+    return d;
+}
+
+/**
+ * Searches for the shortest path for a creature between two points using
+ * the A* algorithm.  The search gives up after visiting maxNodes cells
+ * (capped at 1024).  Objects on the map are ignored.
+ *
+ * Returns the first direction of the path or DIR_NONE if no path was found.
+ */
+Direction path_aStar(Map* map, const Creature* m, const Coords& from,
+                     const Coords& to, int maxNodes) {
+    static AStarNode node[ASTAR_NODES];
+    static int16_t hashTable[ASTAR_HASH];
+    static uint32_t heap[ASTAR_NODES * 4];
+    const bool wrap = (map->border_behavior == Map::BORDER_WRAP);
+    const bool world = map->isWorldMap();
+    std::greater<uint32_t> minHeap;
+    Coords pos(from);
+    AStarNode* cur;
+    AStarNode* nn;
+    uint16_t curMove;
+    uint32_t cell;
+    int heapLen, nodeCount, n, d, h, slot, x, y;
+
+    if (from.z != to.z || from == to)
+        return DIR_NONE;
+    if (maxNodes > ASTAR_NODES)
+        maxNodes = ASTAR_NODES;
+
+    PROFILE_ZONE("path_aStar")
+    map->moveRevision();
+
+    for (n = 0; n < ASTAR_HASH; ++n)
+        hashTable[n] = -1;
+
+    cur = node;
+    cur->cell = from.y * map->width + from.x;
+    cur->x = from.x;
+    cur->y = from.y;
+    cur->g = 0;
+    cur->firstDir = DIR_NONE;
+    cur->closed = 0;
+    hashTable[HASH_SLOT(cur->cell)] = 0;
+    nodeCount = 1;
+    heapLen = 0;
+    HEAP_PUSH(0, 0);
+
+    while (heapLen) {
+        std::pop_heap(heap, heap + heapLen, minHeap);
+        cur = node + (heap[--heapLen] & 0xffff);
+        if (cur->closed)
+            continue;
+        cur->closed = 1;
+
+        pos.x = cur->x;
+        pos.y = cur->y;
+        curMove = map->moveFlagsAt(pos);
+
+        for (d = DIR_WEST; d <= DIR_SOUTH; ++d) {
+            x = cur->x;
+            y = cur->y;
+            if (! stepPos(map, x, y, d))
+                continue;
+
+            // The target is always enterable.
+            if (x == to.x && y == to.y)
+                return Direction(cur->firstDir ? cur->firstDir : d);
+
+            pos.x = x;
+            pos.y = y;
+            if (! map_creatureCanMove(m, curMove, map->moveFlagsAt(pos),
+                                      Direction(d), world))
+                continue;
+
+            // Find or add the node.
+            cell = y * map->width + x;
+            slot = HASH_SLOT(cell);
+            while (hashTable[slot] >= 0 && node[hashTable[slot]].cell != cell)
+                slot = (slot + 1) & (ASTAR_HASH - 1);
+
+            if (hashTable[slot] >= 0) {
+                nn = node + hashTable[slot];
+                if (nn->closed || nn->g <= cur->g + 1)
+                    continue;
+            } else {
+                if (nodeCount == maxNodes)
+                    return DIR_NONE;
+                hashTable[slot] = nodeCount;
+                nn = node + nodeCount++;
+                nn->cell = cell;
+                nn->x = x;
+                nn->y = y;
+                nn->closed = 0;
+            }
+            nn->g = cur->g + 1;
+            nn->firstDir = cur->firstDir ? cur->firstDir : d;
+
+            if (heapLen == ASTAR_NODES * 4)
+                return DIR_NONE;
+            h = wrapDelta(x, to.x, map->width, wrap) +
+                wrapDelta(y, to.y, map->height, wrap);
+            HEAP_PUSH(nn->g + h, nn - node);
+        }
+    }
+    return DIR_NONE;
+}
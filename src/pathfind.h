@@ -0,0 +1,19 @@
+/*
+ * pathfind.h
+ */
+
+#ifndef PATHFIND_H
+#define PATHFIND_H
+
+#include "coords.h"
+#include "direction.h"
+
+class Creature;
+class Map;
+
+Direction path_stepToward(Map* map, const Creature* m, const Coords& from,
+                          const Coords& to, int valid_dirs);
+Direction path_aStar(Map* map, const Creature* m, const Coords& from,
+                     const Coords& to, int maxNodes);
+
+#endif /* PATHFIND_H */
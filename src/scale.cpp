@@ -2,304 +2,460 @@
  * $Id$
  */
 
+#include <cstring>
 #include "debug.h"
 #include "image.h"
 #include "screen.h"
 #include "scale.h"
+#include "threadPool.h"
+#include "xu4.h"
 
-/**
- * A simple row and column duplicating scaler.
+/*
+ * The scalers split the source image rows into jobs which are run on the
+ * xu4.threadPool workers.  Each destination row is written by exactly one
+ * job, so no locking is required.
+ *
+ * The n argument divides the source image into n horizontal bands (the
+ * frames of a tileset or animation) which are filtered separately so that
+ * pixels do not bleed from one band into the next.  As before, any rows
+ * below the last whole band are left blank by the filtering scalers.
  */
-Image *scalePoint(Image *src, int scale, int n) {
-    int x, y, i, j;
-    Image *dest;
 
-    dest = Image::create(src->width() * scale, src->height() * scale);
-    if (!dest)
-        return NULL;
+#define SCALE_JOB_PIXELS    8192
 
-    for (y = 0; y < src->height(); y++) {
-        for (x = 0; x < src->width(); x++) {
-            for (i = 0; i < scale; i++) {
-                for (j = 0; j < scale; j++) {
-                    unsigned int index;
-                    src->getPixelIndex(x, y, index);
-                    dest->putPixelIndex(x * scale + j, y * scale + i, index);
-                }
-            }
-        }
-    }
+struct ScaleJob;
+typedef void (*ScaleRowFunc)(const ScaleJob*, int y);
 
-    return dest;
+struct ScaleJob {
+    const uint32_t* src;
+    uint32_t* dest;
+    int sw;             // Source width.
+    int dw;             // Destination width.
+    int scale;
+    int bandH;          // Source rows per band.
+    int rows;           // Source rows to process.
+    int rowsPerJob;
+    ScaleRowFunc scaleRow;
+};
+
+/*
+ * Return the source row one past the end of the band which holds row y.
+ */
+#define BAND_END(job,y)     (((y) / (job)->bandH + 1) * (job)->bandH)
+
+/*
+ * Per-channel averages of packed RGBA pixels.  These handle all four
+ * channels in one 32-bit operation and give the same result as
+ * (a.r + b.r) >> 1, etc.
+ */
+static inline uint32_t avg2(uint32_t a, uint32_t b) {
+    return (a & b) + (((a ^ b) & 0xfefefefe) >> 1);
 }
 
-/**
- * A scaler that interpolates each intervening pixel from it's two
- * neighbors.
+static inline uint32_t avg4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t hi = ((a >> 2) & 0x3f3f3f3f) + ((b >> 2) & 0x3f3f3f3f) +
+                  ((c >> 2) & 0x3f3f3f3f) + ((d >> 2) & 0x3f3f3f3f);
+    uint32_t lo = (a & 0x03030303) + (b & 0x03030303) +
+                  (c & 0x03030303) + (d & 0x03030303);
+    return hi + ((lo >> 2) & 0x03030303);
+}
+
+static inline uint32_t setOpaque(uint32_t pixel) {
+    union {
+        uint32_t u;
+        RGBA c;
+    } p;
+    p.u = pixel;
+    p.c.a = 255;
+    return p.u;
+}
+
+static void scaleJobRun(void* user, int job) {
+    const ScaleJob* sj = (const ScaleJob*) user;
+    int y = job * sj->rowsPerJob;
+    int yend = y + sj->rowsPerJob;
+    if (yend > sj->rows)
+        yend = sj->rows;
+    for (; y < yend; ++y)
+        sj->scaleRow(sj, y);
+}
+
+/*
+ * Create the destination image and run scaleRow on each source row.
  */
-Image *scale2xBilinear(Image *src, int scale, int n) {
-    int i, x, y, xoff, yoff;
-    RGBA a, b, c, d;
+static Image *scaleRun(Image *src, int scale, int n, bool banded,
+                       ScaleRowFunc scaleRow) {
+    ScaleJob sj;
     Image *dest;
-
-    /* this scaler works only with images scaled by 2x */
-    ASSERT(scale == 2, "invalid scale: %d", scale);
+    int jobs;
 
     dest = Image::create(src->width() * scale, src->height() * scale);
     if (!dest)
         return NULL;
 
-    /*
-     * Each pixel in the source image is translated into four in the
-     * destination.  The destination pixels are dependant on the pixel
-     * itself, and the three surrounding pixels (A is the original
-     * pixel):
-     * A B
-     * C D
-     * The four destination pixels mapping to A are calculated as
-     * follows:
-     * [   A   ] [  (A+B)/2  ]
-     * [(A+C)/2] [(A+B+C+D)/4]
-     */
-
-    for (i = 0; i < n; i++) {
-        for (y = (src->height() / n) * i; y < (src->height() / n) * (i + 1); y++) {
-            if (y == (src->height() / n) * (i + 1) - 1)
-                yoff = 0;
-            else
-                yoff = 1;
-
-            for (x = 0; x < src->width(); x++) {
-                if (x == src->width() - 1)
-                    xoff = 0;
-                else
-                    xoff = 1;
+    sj.src   = src->pixelData();
+    sj.dest  = dest->pixels;
+    sj.sw    = src->width();
+    sj.dw    = dest->width();
+    sj.scale = scale;
+    if (banded) {
+        sj.bandH = src->height() / n;
+        sj.rows  = sj.bandH * n;
+    } else {
+        sj.bandH = sj.rows = src->height();
+    }
+    sj.rowsPerJob = SCALE_JOB_PIXELS / sj.sw;
+    if (sj.rowsPerJob < 1)
+        sj.rowsPerJob = 1;
+    sj.scaleRow = scaleRow;
 
-                src->getPixel(x, y, a);
-                src->getPixel(x + xoff, y, b);
-                src->getPixel(x, y + yoff, c);
-                src->getPixel(x + xoff, y + yoff, d);
+    jobs = (sj.rows + sj.rowsPerJob - 1) / sj.rowsPerJob;
+    threadPool_run(xu4.threadPool, scaleJobRun, &sj, jobs);
+    return dest;
+}
 
-                dest->putPixel(x * 2, y * 2, a.r, a.g, a.b, a.a);
-                dest->putPixel(x * 2 + 1, y * 2, (a.r + b.r) >> 1, (a.g + b.g) >> 1, (a.b + b.b) >> 1, (a.a + b.a) >> 1);
-                dest->putPixel(x * 2, y * 2 + 1, (a.r + c.r) >> 1, (a.g + c.g) >> 1, (a.b + c.b) >> 1, (a.a + c.a) >> 1);
-                dest->putPixel(x * 2 + 1, y * 2 + 1, (a.r + b.r + c.r + d.r) >> 2, (a.g + b.g + c.g + d.g) >> 2, (a.b + b.b + c.b + d.b) >> 2, (a.a + b.a + c.a + d.a) >> 2);
-            }
+static void scalePointRow(const ScaleJob* sj, int y) {
+    const uint32_t* sp   = sj->src + y * sj->sw;
+    const uint32_t* send = sp + sj->sw;
+    uint32_t* row = sj->dest + y * sj->scale * sj->dw;
+    uint32_t* dp = row;
+    uint32_t pixel;
+    int i;
+
+    if (sj->scale == 2) {
+        for (; sp != send; dp += 2) {
+            pixel = *sp++;
+            dp[0] = dp[1] = pixel;
+        }
+    } else {
+        while (sp != send) {
+            pixel = *sp++;
+            for (i = 0; i < sj->scale; ++i)
+                *dp++ = pixel;
         }
     }
 
-    return dest;
+    for (i = 1; i < sj->scale; ++i)
+        memcpy(row + i * sj->dw, row, sj->dw * sizeof(uint32_t));
+}
+
+/**
+ * A simple row and column duplicating scaler.
+ */
+Image *scalePoint(Image *src, int scale, int n) {
+    return scaleRun(src, scale, n, false, scalePointRow);
 }
 
-int colorEqual(RGBA a, RGBA b) {
-    return
-        a.r == b.r &&
-        a.g == b.g &&
-        a.b == b.b &&
-        a.a == b.a;
+/*
+ * Each pixel in the source image is translated into four in the
+ * destination.  The destination pixels are dependant on the pixel
+ * itself, and the three surrounding pixels (A is the original
+ * pixel):
+ * A B
+ * C D
+ * The four destination pixels mapping to A are calculated as
+ * follows:
+ * [   A   ] [  (A+B)/2  ]
+ * [(A+C)/2] [(A+B+C+D)/4]
+ */
+static void scale2xBilinearRow(const ScaleJob* sj, int y) {
+    const uint32_t* ra = sj->src + y * sj->sw;
+    const uint32_t* rc = ra;
+    uint32_t* d0 = sj->dest + y * 2 * sj->dw;
+    uint32_t* d1 = d0 + sj->dw;
+    uint32_t a, b, c, d;
+    int x;
+    int last = sj->sw - 1;
+
+    if (y != BAND_END(sj, y) - 1)
+        rc += sj->sw;
+
+    for (x = 0; x < last; ++x) {
+        a = ra[x];
+        b = ra[x + 1];
+        c = rc[x];
+        d = rc[x + 1];
+        d0[x * 2]     = a;
+        d0[x * 2 + 1] = avg2(a, b);
+        d1[x * 2]     = avg2(a, c);
+        d1[x * 2 + 1] = avg4(a, b, c, d);
+    }
+
+    // The right edge pixel has no neighbor so B = A & D = C.
+    a = ra[last];
+    c = rc[last];
+    d0[last * 2]     = a;
+    d0[last * 2 + 1] = a;
+    d1[last * 2]     = avg2(a, c);
+    d1[last * 2 + 1] = avg4(a, a, c, c);
 }
 
-RGBA colorAverage(RGBA a, RGBA b) {
-    RGBA result;
-    result.r = (a.r + b.r) >> 1;
-    result.g = (a.g + b.g) >> 1;
-    result.b = (a.b + b.b) >> 1;
-    result.a = (a.a + b.a) >> 1;
-    return result;
+/**
+ * A scaler that interpolates each intervening pixel from it's two
+ * neighbors.
+ */
+Image *scale2xBilinear(Image *src, int scale, int n) {
+    /* this scaler works only with images scaled by 2x */
+    ASSERT(scale == 2, "invalid scale: %d", scale);
+
+    return scaleRun(src, scale, n, true, scale2xBilinearRow);
 }
 
-int _2xSaI_GetResult1(RGBA a, RGBA b, RGBA c, RGBA d) {
+static int _2xSaI_GetResult1(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
     int x = 0;
     int y = 0;
     int r = 0;
-    if (colorEqual(a, c)) x++; else if (colorEqual(b, c)) y++;
-    if (colorEqual(a, d)) x++; else if (colorEqual(b, d)) y++;
+    if (a == c) x++; else if (b == c) y++;
+    if (a == d) x++; else if (b == d) y++;
     if (x <= 1) r++;
     if (y <= 1) r--;
     return r;
 }
 
-int _2xSaI_GetResult2(RGBA a, RGBA b, RGBA c, RGBA d) {
+static int _2xSaI_GetResult2(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
     int x = 0;
     int y = 0;
     int r = 0;
-    if (colorEqual(a, c)) x++; else if (colorEqual(b, c)) y++;
-    if (colorEqual(a, d)) x++; else if (colorEqual(b, d)) y++;
+    if (a == c) x++; else if (b == c) y++;
+    if (a == d) x++; else if (b == d) y++;
     if (x <= 1) r--;
     if (y <= 1) r++;
     return r;
 }
 
-/**
- * A more sophisticated scaler that interpolates each new pixel the
- * surrounding pixels.
+/*
+ * Each pixel in the source image is translated into four in the
+ * destination.  The destination pixels are dependant on the pixel
+ * itself, and the surrounding pixels as shown below (A is the
+ * original pixel):
+ * I E F J
+ * G A B K
+ * H C D L
+ * M N O P
+ *
+ * NOTE: K & L have always been sampled from the left column (the same as
+ * G & H) and P is unused.  This is kept to preserve the original output.
  */
-Image *scale2xSaI(Image *src, int scale, int N) {
-    int ii, x, y, xoff0, xoff1, xoff2, yoff0, yoff1, yoff2;
-    RGBA a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p;
-    RGBA prod0, prod1, prod2;
-    Image *dest;
+static void scale2xSaIRow(const ScaleJob* sj, int y) {
+    const int sw = sj->sw;
+    const uint32_t* rowA = sj->src + y * sw;
+    const uint32_t* rowE;
+    const uint32_t* rowC;
+    const uint32_t* rowN;
+    uint32_t* d0 = sj->dest + y * 2 * sj->dw;
+    uint32_t* d1 = d0 + sj->dw;
+    uint32_t a, b, c, d, e, f, g, h, i, j, k, l, m, n, o;
+    uint32_t prod0, prod1, prod2;
+    int x, xoff0, xoff1, xoff2;
+    int bandLast = BAND_END(sj, y) - 1;
+
+    rowE = (y == 0) ? rowA : rowA - sw;
+    if (y == bandLast) {
+        rowC = rowN = rowA;
+    } else if (y == bandLast - 1) {
+        rowC = rowN = rowA + sw;
+    } else {
+        rowC = rowA + sw;
+        rowN = rowC + sw;
+    }
 
-    /* this scaler works only with images scaled by 2x */
-    ASSERT(scale == 2, "invalid scale: %d", scale);
+    for (x = 0; x < sw; x++) {
+        xoff0 = (x == 0) ? 0 : -1;
+        if (x == sw - 1) {
+            xoff1 = 0;
+            xoff2 = 0;
+        }
+        else if (x == sw - 2) {
+            xoff1 = 1;
+            xoff2 = 1;
+        }
+        else {
+            xoff1 = 1;
+            xoff2 = 2;
+        }
 
-    dest = Image::create(src->width() * scale, src->height() * scale);
-    if (!dest)
-        return NULL;
+        a = rowA[x];
+        b = rowA[x + xoff1];
+        c = rowC[x];
+        d = rowC[x + xoff1];
+
+        e = rowE[x];
+        f = rowE[x + xoff1];
+        g = rowA[x + xoff0];
+        h = rowC[x + xoff0];
+
+        i = rowE[x + xoff0];
+        j = rowE[x + xoff2];
+        k = g;
+        l = h;
+
+        m = rowN[x + xoff0];
+        n = rowN[x];
+        o = rowN[x + xoff1];
+
+        if (a == d && b != c) {
+            if ((a == e && b == l) ||
+                (a == c && a == f && b != e && b == j))
+                prod0 = a;
+            else
+                prod0 = avg2(a, b);
 
-    /*
-     * Each pixel in the source image is translated into four in the
-     * destination.  The destination pixels are dependant on the pixel
-     * itself, and the surrounding pixels as shown below (A is the
-     * original pixel):
-     * I E F J
-     * G A B K
-     * H C D L
-     * M N O P
-     */
-
-    for (ii = 0; ii < N; ii++) {
-        for (y = (src->height() / N) * ii; y < (src->height() / N) * (ii + 1); y++) {
-            if (y == 0)
-                yoff0 = 0;
+            if ((a == g && c == o) ||
+                (a == b && a == h && g != c && c == m))
+                prod1 = a;
             else
-                yoff0 = -1;
-            if (y == (src->height() / N) * (ii + 1) - 1) {
-                yoff1 = 0;
-                yoff2 = 0;
-            }
-            else if (y == (src->height() / N) * (ii + 1) - 2) {
-                yoff1 = 1;
-                yoff2 = 1;
-            }
-            else {
-                yoff1 = 1;
-                yoff2 = 2;
-            }
+                prod1 = avg2(a, c);
+
+            prod2 = a;
+        }
+        else if (b == c && a != d) {
+            if ((b == f && a == h) ||
+                (b == e && b == d && a != f && a == i))
+                prod0 = b;
+            else
+                prod0 = avg2(a, b);
 
+            if ((c == h && a == f) ||
+                (c == g && c == d && a != h && a == i))
+                prod1 = c;
+            else
+                prod1 = avg2(a, c);
 
-            for (x = 0; x < src->width(); x++) {
-                if (x == 0)
-                    xoff0 = 0;
-                else
-                    xoff0 = -1;
-                if (x == src->width() - 1) {
-                    xoff1 = 0;
-                    xoff2 = 0;
-                }
-                else if (x == src->width() - 2) {
-                    xoff1 = 1;
-                    xoff2 = 1;
-                }
-                else {
-                    xoff1 = 1;
-                    xoff2 = 2;
-                }
-
-                src->getPixel(x, y, a);
-                src->getPixel(x + xoff1, y, b);
-                src->getPixel(x, y + yoff1, c);
-                src->getPixel(x + xoff1, y + yoff1, d);
-
-                src->getPixel(x, y + yoff0, e);
-                src->getPixel(x + xoff1, y + yoff0, f);
-                src->getPixel(x + xoff0, y, g);
-                src->getPixel(x + xoff0, y + yoff1, h);
-
-                src->getPixel(x + xoff0, y + yoff0, i);
-                src->getPixel(x + xoff2, y + yoff0, j);
-                src->getPixel(x + xoff0, y, k);
-                src->getPixel(x + xoff0, y + yoff1, l);
-
-                src->getPixel(x + xoff0, y + yoff2, m);
-                src->getPixel(x, y + yoff2, n);
-                src->getPixel(x + xoff1, y + yoff2, o);
-                src->getPixel(x + xoff2, y + yoff2, p);
-
-                if (colorEqual(a, d) && !colorEqual(b, c)) {
-                    if ((colorEqual(a, e) && colorEqual(b, l)) ||
-                        (colorEqual(a, c) && colorEqual(a, f) && !colorEqual(b, e) && colorEqual(b, j)))
-                        prod0 = a;
-                    else
-                        prod0 = colorAverage(a, b);
-
-                    if ((colorEqual(a, g) && colorEqual(c, o)) ||
-                        (colorEqual(a, b) && colorEqual(a, h) && !colorEqual(g, c) && colorEqual(c, m)))
-                        prod1 = a;
-                    else
-                        prod1 = colorAverage(a, c);
+            prod2 = b;
+        }
+        else if (a == d && b == c) {
+            if (a == b)
+                prod0 = prod1 = prod2 = a;
+            else {
+                int r = 0;
+                prod0 = avg2(a, b);
+                prod1 = avg2(a, c);
 
-                    prod2 = a;
-                }
-                else if (colorEqual(b, c) && !colorEqual(a, d)) {
-                    if ((colorEqual(b, f) && colorEqual(a, h)) ||
-                        (colorEqual(b, e) && colorEqual(b, d) && !colorEqual(a, f) && colorEqual(a, i)))
-                        prod0 = b;
-                    else
-                        prod0 = colorAverage(a, b);
-
-                    if ((colorEqual(c, h) && colorEqual(a, f)) ||
-                        (colorEqual(c, g) && colorEqual(c, d) && !colorEqual(a, h) && colorEqual(a, i)))
-                        prod1 = c;
-                    else
-                        prod1 = colorAverage(a, c);
+                r += _2xSaI_GetResult1(a, b, g, e);
+                r += _2xSaI_GetResult2(b, a, k, f);
+                r += _2xSaI_GetResult2(b, a, h, n);
+                r += _2xSaI_GetResult1(a, b, l, o);
 
+                if (r > 0)
+                    prod2 = a;
+                else if (r < 0)
                     prod2 = b;
-                }
-                else if (colorEqual(a, d) && colorEqual(b, c)) {
-                    if (colorEqual(a, b))
-                        prod0 = prod1 = prod2 = a;
-                    else {
-                        int r = 0;
-                        prod0 = colorAverage(a, b);
-                        prod1 = colorAverage(a, c);
-
-                        r += _2xSaI_GetResult1(a, b, g, e);
-                        r += _2xSaI_GetResult2(b, a, k, f);
-                        r += _2xSaI_GetResult2(b, a, h, n);
-                        r += _2xSaI_GetResult1(a, b, l, o);
-
-                        if (r > 0)
-                            prod2 = a;
-                        else if (r < 0)
-                            prod2 = b;
-                        else {
-                            prod2.r = (a.r + b.r + c.r + d.r) >> 2;
-                            prod2.g = (a.g + b.g + c.g + d.g) >> 2;
-                            prod2.b = (a.b + b.b + c.b + d.b) >> 2;
-                        }
-                    }
-                }
-                else {
-                    if (colorEqual(a, c) && colorEqual(a, f) && !colorEqual(b, e) && colorEqual(b, j))
-                        prod0 = a;
-                    else if (colorEqual(b, e) && colorEqual(b, d) && !colorEqual(a, f) && colorEqual(a, i))
-                        prod0 = b;
-                    else
-                        prod0 = colorAverage(a, b);
-
-                    if (colorEqual(a, b) && colorEqual(a, h) && !colorEqual(g, c) && colorEqual(c, m))
-                        prod1 = a;
-                    else if (colorEqual(c, g) && colorEqual(c, d) && !colorEqual(a, h) && colorEqual(a, i))
-                        prod1 = c;
-                    else
-                        prod1 = colorAverage(a, c);
-
-                    prod2.r = (a.r + b.r + c.r + d.r) >> 2;
-                    prod2.g = (a.g + b.g + c.g + d.g) >> 2;
-                    prod2.b = (a.b + b.b + c.b + d.b) >> 2;
-                    prod2.a = 255;
-                }
-
-                dest->putPixel((x << 1), (y << 1), a.r, a.g, a.b, a.a);
-                dest->putPixel((x << 1) + 1, (y << 1), prod0.r, prod0.g, prod0.b, prod0.a);
-                dest->putPixel((x << 1), (y << 1) + 1, prod1.r, prod1.g, prod1.b, prod1.a);
-                dest->putPixel((x << 1) + 1, (y << 1) + 1, prod2.r, prod2.g, prod2.b, prod2.a);
+                else
+                    prod2 = setOpaque(avg4(a, b, c, d));
             }
         }
+        else {
+            if (a == c && a == f && b != e && b == j)
+                prod0 = a;
+            else if (b == e && b == d && a != f && a == i)
+                prod0 = b;
+            else
+                prod0 = avg2(a, b);
+
+            if (a == b && a == h && g != c && c == m)
+                prod1 = a;
+            else if (c == g && c == d && a != h && a == i)
+                prod1 = c;
+            else
+                prod1 = avg2(a, c);
+
+            prod2 = setOpaque(avg4(a, b, c, d));
+        }
+
+        d0[x << 1]       = a;
+        d0[(x << 1) + 1] = prod0;
+        d1[x << 1]       = prod1;
+        d1[(x << 1) + 1] = prod2;
     }
+}
 
-    return dest;
+/**
+ * A more sophisticated scaler that interpolates each new pixel the
+ * surrounding pixels.
+ */
+Image *scale2xSaI(Image *src, int scale, int N) {
+    /* this scaler works only with images scaled by 2x */
+    ASSERT(scale == 2, "invalid scale: %d", scale);
+
+    return scaleRun(src, scale, N, true, scale2xSaIRow);
+}
+
+/*
+ * Each pixel in the source image is translated into four (or
+ * nine) in the destination.  The destination pixels are dependant
+ * on the pixel itself, and the eight surrounding pixels (E is the
+ * original pixel):
+ *
+ * A B C
+ * D E F
+ * G H I
+ */
+static void scaleScale2xRow(const ScaleJob* sj, int y) {
+    const int sw = sj->sw;
+    const int dw = sj->dw;
+    const uint32_t* rowE = sj->src + y * sw;
+    const uint32_t* rowB = (y == 0) ? rowE : rowE - sw;
+    const uint32_t* rowH = (y == BAND_END(sj, y) - 1) ? rowE : rowE + sw;
+    uint32_t* dp = sj->dest + y * sj->scale * dw;
+    uint32_t a, b, c, d, e, f, g, h, i;
+    uint32_t e0, e1, e2, e3;
+    uint32_t e4, e5, e6, e7;
+    int x, xoff0, xoff1;
+
+    for (x = 0; x < sw; x++) {
+        xoff0 = (x == 0) ? 0 : -1;
+        xoff1 = (x == sw - 1) ? 0 : 1;
+
+        a = rowB[x + xoff0];
+        b = rowB[x];
+        c = rowB[x + xoff1];
+
+        d = rowE[x + xoff0];
+        e = rowE[x];
+        f = rowE[x + xoff1];
+
+        g = rowH[x + xoff0];
+        h = rowH[x];
+        i = rowH[x + xoff1];
+
+        // lissen diagonals (45,135,225,315)
+        // corner : if there is gradient towards a diagonal direction,
+        // take the color of surrounding points in this direction
+        e0 = (d == b && b != f && d != h) ? d : e;
+        e1 = (b == f && b != d && f != h) ? f : e;
+        e2 = (d == h && d != b && h != f) ? d : e;
+        e3 = (h == f && d != h && b != f) ? f : e;
+
+        if (sj->scale == 2) {
+            dp[x * 2]          = e0;
+            dp[x * 2 + 1]      = e1;
+            dp[dw + x * 2]     = e2;
+            dp[dw + x * 2 + 1] = e3;
+        } else {
+            // lissen eight more directions (22 or 67, 112 or 157...)
+            // middle of side : if there is a gradient towards one of these
+            // directions (middle of side direction and of direction of
+            // either diagonal around this side), take the color of
+            // surrounding points in this direction
+            e4 = (e0 == c) ? e0 : (e1 == a) ? e1 : e;
+            e5 = (e2 == a) ? e2 : (e0 == g) ? e0 : e;
+            e6 = (e1 == i) ? e1 : (e3 == c) ? e3 : e;
+            e7 = (e3 == g) ? e3 : (e2 == i) ? e2 : e;
+
+            uint32_t* p = dp + x * 3;
+            p[0] = e0;
+            p[1] = e4;
+            p[2] = e1;
+            p += dw;
+            p[0] = e5;
+            p[1] = e;
+            p[2] = e6;
+            p += dw;
+            p[0] = e2;
+            p[1] = e7;
+            p[2] = e3;
+        }
+    }
 }
 
 /**
@@ -307,101 +463,10 @@ Image *scale2xSaI(Image *src, int scale, int N) {
  * the stair step effect by detecting angles.
  */
 Image *scaleScale2x(Image *src, int scale, int n) {
-    int ii, x, y, xoff0, xoff1, yoff0, yoff1;
-    RGBA a, b, c, d, e, f, g, h, i;
-    RGBA e0, e1, e2, e3;
-    RGBA e4, e5, e6, e7;
-    Image *dest;
-
     /* this scaler works only with images scaled by 2x or 3x */
     ASSERT(scale == 2 || scale == 3, "invalid scale: %d", scale);
 
-    dest = Image::create(src->width() * scale, src->height() * scale);
-    if (!dest)
-        return NULL;
-
-    /*
-     * Each pixel in the source image is translated into four (or
-     * nine) in the destination.  The destination pixels are dependant
-     * on the pixel itself, and the eight surrounding pixels (E is the
-     * original pixel):
-     *
-     * A B C
-     * D E F
-     * G H I
-     */
-
-    for (ii = 0; ii < n; ii++) {
-        for (y = (src->height() / n) * ii; y < (src->height() / n) * (ii + 1); y++) {
-            if (y == 0)
-                yoff0 = 0;
-            else
-                yoff0 = -1;
-            if (y == (src->height() / n) * (ii + 1) - 1)
-                yoff1 = 0;
-            else
-                yoff1 = 1;
-
-            for (x = 0; x < src->width(); x++) {
-                if (x == 0)
-                    xoff0 = 0;
-                else
-                    xoff0 = -1;
-                if (x == src->width() - 1)
-                    xoff1 = 0;
-                else
-                    xoff1 = 1;
-
-                src->getPixel(x + xoff0, y + yoff0, a);
-                src->getPixel(x, y + yoff0, b);
-                src->getPixel(x + xoff1, y + yoff0, c);
-
-                src->getPixel(x + xoff0, y, d);
-                src->getPixel(x, y, e);
-                src->getPixel(x + xoff1, y, f);
-
-                src->getPixel(x + xoff0, y + yoff1, g);
-                src->getPixel(x, y + yoff1, h);
-                src->getPixel(x + xoff1, y + yoff1, i);
-
-                // lissen diagonals (45,135,225,315)
-                // corner : if there is gradient towards a diagonal direction,
-                // take the color of surrounding points in this direction
-                e0 = colorEqual(d, b) && (!colorEqual(b, f)) && (!colorEqual(d, h)) ? d : e;
-                e1 = colorEqual(b, f) && (!colorEqual(b, d)) && (!colorEqual(f, h)) ? f : e;
-                e2 = colorEqual(d, h) && (!colorEqual(d, b)) && (!colorEqual(h, f)) ? d : e;
-                e3 = colorEqual(h, f) && (!colorEqual(d, h)) && (!colorEqual(b, f)) ? f : e;
-
-                // lissen eight more directions (22 or 67, 112 or 157...)
-                // middle of side : if there is a gradient towards one of these directions (middle of side direction and of direction of either diagonal around this side),
-                // take the color of surrounding points in this direction
-                e4 = colorEqual(e0, c) ? e0 : colorEqual(e1, a) ? e1 : e;
-                e5 = colorEqual(e2, a) ? e2 : colorEqual(e0, g) ? e0 : e;
-                e6 = colorEqual(e1, i) ? e1 : colorEqual(e3, c) ? e3 : e;
-                e7 = colorEqual(e3, g) ? e3 : colorEqual(e2, i) ? e2 : e;
-
-                if (scale == 2) {
-                    dest->putPixel(x * 2, y * 2, e0.r, e0.g, e0.b, e0.a);
-                    dest->putPixel(x * 2 + 1, y * 2, e1.r, e1.g, e1.b, e1.a);
-                    dest->putPixel(x * 2, y * 2 + 1, e2.r, e2.g, e2.b, e2.a);
-                    dest->putPixel(x * 2 + 1, y * 2 + 1, e3.r, e3.g, e3.b, e3.a);
-                } else if (scale == 3) {
-                    dest->putPixel(x * 3, y * 3, e0.r, e0.g, e0.b, e0.a);
-                    dest->putPixel(x * 3 + 1, y * 3, e4.r, e4.g, e4.b, e4.a);
-                    dest->putPixel(x * 3 + 2, y * 3, e1.r, e1.g, e1.b, e1.a);
-                    dest->putPixel(x * 3, y * 3 + 1, e5.r, e5.g, e5.b, e5.a);
-                    dest->putPixel(x * 3 + 1, y * 3 + 1, e.r, e.g, e.b, e.a);
-                    dest->putPixel(x * 3 + 2, y * 3 + 1, e6.r, e6.g, e6.b, e6.a);
-                    dest->putPixel(x * 3, y * 3 + 2, e2.r, e2.g, e2.b, e2.a);
-                    dest->putPixel(x * 3 + 1, y * 3 + 2, e7.r, e7.g, e7.b, e7.a);
-                    dest->putPixel(x * 3 + 2, y * 3 + 2, e3.r, e3.g, e3.b, e3.a);
-
-                }
-            }
-        }
-    }
-
-    return dest;
+    return scaleRun(src, scale, n, true, scaleScale2xRow);
 }
 
 Scaler scalerGet(int filter) {
@@ -18,6 +18,8 @@
 #include "event.h"
 #include "game.h"
 #include "imagemgr.h"
+#include "los.h"
+#include "profile.h"
 #include "scale.h"
 #include "settings.h"
 #include "textview.h"
@@ -60,6 +62,7 @@ struct Screen {
     short colorFG;
 #ifdef GPU_RENDER
     ImageInfo* textureInfo;
+    ImageInfo* materialInfo;
     TileView* renderMapView;
     VisualId focusReticle;
     int mapId;          // Tracks map changes.
@@ -68,8 +71,10 @@ struct Screen {
     BlockingGroups* blockingUpdate;
     BlockingGroups blockingGroups;
 #else
-    uint8_t blockingGrid[VIEWPORT_W * VIEWPORT_H];
-    uint8_t screenLos[VIEWPORT_W * VIEWPORT_H];
+    uint64_t blockingRows[VIEWPORT_H];  // Bit x set if cell blocks.
+    const uint64_t* losRows;    // Bit x set if cell is visible.
+    LosCache losCache;
+    TileStack viewTiles[VIEWPORT_W * VIEWPORT_H];   // Reused each frame.
 #endif
 
     Screen() {
@@ -82,7 +87,11 @@ struct Screen {
         state.tileanims = NULL;
         state.currentCycle = 0;
         state.vertOffset = 0;
+        state.viewW = VIEWPORT_W;
+        state.viewH = VIEWPORT_H;
         state.formatIsABGR = true;
+        state.vsync = false;
+        state.uncapped = false;
         dispWidth = dispHeight = 0;
         aspectW = aspectH = 0;
         cursorX = cursorY = 0;
@@ -92,7 +101,11 @@ struct Screen {
         colorFG = FONT_COLOR_INDEX(FG_WHITE);
 #ifdef GPU_RENDER
         textureInfo = NULL;
+        materialInfo = NULL;
         renderMapView = NULL;
+#else
+        los_cacheInit(&losCache);
+        losRows = losCache.visible;
 #endif
     }
 
@@ -149,6 +162,12 @@ static void screenInit_data(Screen* scr, Settings& settings) {
     if (! scr->filterScaler)
         errorFatal("Invalid filter %d", settings.filter);
 
+    {
+    int simd = image32_selectSimd(IMAGE32_SIMD_AUTO);
+    if (verbose)
+        printf("using %s image kernels\n", image32_simdName(simd));
+    }
+
     /* If we can't use VGA graphics then reset to EGA. */
     if (! u4isUpgradeAvailable() && settings.videoType == "VGA")
         settings.videoType = "EGA";
@@ -161,12 +180,14 @@ static void screenInit_data(Screen* scr, Settings& settings) {
         (320 * settings.scale, 200 * settings.scale);
 #endif
     xu4.screenImage->fill(Image::black);
+    xu4.screenImage->trackChanges(true);
 
     xu4.imageMgr = new ImageMgr;
 
     scr->charsetInfo = xu4.imageMgr->get(BKGD_CHARSET);
     if (! scr->charsetInfo)
         errorLoadImage(BKGD_CHARSET);
+    xu4.imageMgr->pin(scr->charsetInfo);
 
 #ifdef GPU_RENDER
     {
@@ -178,14 +199,18 @@ static void screenInit_data(Screen* scr, Settings& settings) {
     xu4.config->internSymbols(symbol, 3, "texture material reticle");
     scr->textureInfo = tinfo = xu4.imageMgr->get(symbol[0]);
     if (tinfo) {
-        minfo = xu4.imageMgr->get(symbol[1]);
+        xu4.imageMgr->pin(tinfo);
+        scr->materialInfo = minfo = xu4.imageMgr->get(symbol[1]);
         if (minfo) {
+            xu4.imageMgr->pin(minfo);
             if (! minfo->tex)
                 minfo->tex = gpu_makeTexture(minfo->image);
             matId = minfo->tex;
         }
 
-        gpu_setTilesTexture(xu4.gpu, tinfo->tex, matId, tinfo->tileTexCoord[3]);
+        gpu_setTilesTexture(xu4.gpu, tinfo->tex, matId, tinfo->tileTexCoord[3],
+                            tinfo->tileTexCoord, tinfo->subImageCount ?
+                                tinfo->subImageCount : tinfo->tiles);
         scr->focusReticle = tinfo->subImageIndex.find(symbol[2])->second;
     }
     }
@@ -212,8 +237,31 @@ static void screenInit_data(Screen* scr, Settings& settings) {
 }
 
 static void screenDelete_data(Screen* scr) {
+    ImageMgr* mgr = xu4.imageMgr;
+
     Tileset::unloadImages();
 
+    if (scr->dungeonView)
+        scr->dungeonView->releaseGraphicData();
+    if (scr->gemTilesInfo) {
+        mgr->unpin(scr->gemTilesInfo);
+        scr->gemTilesInfo = NULL;
+    }
+#ifdef GPU_RENDER
+    if (scr->materialInfo) {
+        mgr->unpin(scr->materialInfo);
+        scr->materialInfo = NULL;
+    }
+    if (scr->textureInfo) {
+        mgr->unpin(scr->textureInfo);
+        scr->textureInfo = NULL;
+    }
+#endif
+    if (scr->charsetInfo) {
+        mgr->unpin(scr->charsetInfo);
+        scr->charsetInfo = NULL;
+    }
+
     delete scr->state.tileanims;
     scr->state.tileanims = NULL;
 
@@ -230,11 +278,41 @@ enum ScreenSystemStage {
     SYS_RESET = 1   // Reconfigure screen settings.
 };
 
+/*
+ * Set the map viewport size from the settings.  This is done only once as
+ * the game map view is created with it.
+ *
+ * The software renderer draws tiles at a fixed size into the map area of
+ * the screen image so it always uses VIEWPORT_W x VIEWPORT_H.  The GPU
+ * renderer scales the tiles to fit.
+ */
+static void screenInitViewport(Screen* scr, const SettingsData& settings) {
+#ifdef GPU_RENDER
+    ScreenState* state = &scr->state;
+
+    // The avatar is at the center so the dimensions must be odd.
+    state->viewW = (settings.viewportW - 1) | 1;
+    state->viewH = (settings.viewportH - 1) | 1;
+    if (state->viewW < VIEWPORT_W)
+        state->viewW = VIEWPORT_W;
+    else if (state->viewW > VIEWPORT_MAX_W)
+        state->viewW = VIEWPORT_MAX_W;
+    if (state->viewH < VIEWPORT_H)
+        state->viewH = VIEWPORT_H;
+    else if (state->viewH > VIEWPORT_MAX_H)
+        state->viewH = VIEWPORT_MAX_H;
+#endif
+}
+
 /*
  * Sets xu4.screen, xu4.screenSys, xu4.screenImage & xu4.gpu pointers.
+ * If uncapped is true then frames will not be limited to the display
+ * refresh rate (for benchmarking).
  */
-void screenInit() {
+void screenInit(bool uncapped) {
     xu4.screen = new Screen;
+    xu4.screen->state.uncapped = uncapped;
+    screenInitViewport(xu4.screen, *xu4.settings);
     screenInit_sys(xu4.settings, &xu4.screen->dispWidth, SYS_CLEAN);
     screenInit_data(xu4.screen, *xu4.settings);
 }
@@ -471,7 +549,11 @@ static void screenLoadLayoutsFromConf(Screen* scr) {
         errorFatal("no dungeon gem layout found!\n");
 }
 
-vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus) {
+/*
+ * Fill tiles with the stack of tiles to show at viewport position x,y.
+ */
+void screenViewportTile(TileStack& tiles, unsigned int width,
+                        unsigned int height, int x, int y, bool &focus) {
     Map* map = c->location->map;
     Coords center = c->location->coords;
     static MapTile grass = map->tileset->getByName(Tile::sym.grass)->getId();
@@ -490,17 +572,16 @@ vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int
     /* Wrap the location if we can */
     map_wrap(tc, map);
 
+    tiles.clear();
+
     /* off the edge of the map: pad with grass tiles */
     if (MAP_IS_OOB(map, tc)) {
         focus = false;
-        vector<MapTile> result;
-        result.push_back(grass);
-        return result;
+        tiles.push_back(grass);
+        return;
     }
 
-    vector<MapTile> tiles;
     c->location->getTilesAt(tiles, tc, focus);
-    return tiles;
 }
 
 /*
@@ -513,34 +594,37 @@ bool screenTileUpdate(TileView *view, const Coords &coords)
         return false;
 
     // Get the screen coordinates
+    const int viewW = xu4.screen->state.viewW;
+    const int viewH = xu4.screen->state.viewH;
     int x = coords.x;
     int y = coords.y;
 
-    if (loc->map->width > VIEWPORT_W || loc->map->height > VIEWPORT_H)
+    if (loc->map->width > viewW || loc->map->height > viewH)
     {
         //Center the coordinates to the viewport if you're on centered-view map.
-        x = x - loc->coords.x + VIEWPORT_W / 2;
-        y = y - loc->coords.y + VIEWPORT_H / 2;
+        x = x - loc->coords.x + viewW / 2;
+        y = y - loc->coords.y + viewH / 2;
     }
 
 #ifdef GPU_RENDER
-    if (x >= 0 && y >= 0 && x < VIEWPORT_W && y < VIEWPORT_H)
+    if (x >= 0 && y >= 0 && x < viewW && y < viewH)
         return true;
 #else
     // Draw if it is on screen
-    if (x >= 0 && y >= 0 && x < VIEWPORT_W && y < VIEWPORT_H &&
-        xu4.screen->screenLos[y*VIEWPORT_W + x])
+    if (x >= 0 && y >= 0 && x < viewW && y < viewH &&
+        ((xu4.screen->losRows[y] >> x) & 1))
     {
         // Get the tiles
         bool focus;
         Coords mc(coords);
         map_wrap(mc, loc->map);
-        vector<MapTile> tiles;
+        TileStack tiles;
         loc->getTilesAt(tiles, mc, focus);
 
         view->drawTile(tiles, x, y);
         if (focus)
             view->drawFocus(x, y);
+        view->invalidateCell(x, y);
         return true;
     }
 #endif
@@ -550,8 +634,7 @@ bool screenTileUpdate(TileView *view, const Coords &coords)
 #ifdef GPU_RENDER
 struct SpriteRenderData {
     float* attr;
-    const float* uvTable;
-    float rect[4];
+    float tileW, tileH;     // Tile size in normalized device coordinates.
     int cx, cy;
 };
 
@@ -560,17 +643,13 @@ enum TriangleList {
     TRIS_MAP_FX
 };
 
-#define VIEW_TILE_SIZE  (2.0f / VIEWPORT_W)     //1.0f
-
 static void emitSprite(const Coords* loc, VisualId vid, void* user) {
     SpriteRenderData* rd = (SpriteRenderData*) user;
-    float* rect = rd->rect;
-    const float halfTile = VIEW_TILE_SIZE * -0.5f;
-    int uvIndex = VID_INDEX(vid);
 
-    rect[0] = halfTile + (float) (loc->x - rd->cx) * VIEW_TILE_SIZE;
-    rect[1] = halfTile + (float) (rd->cy - loc->y) * VIEW_TILE_SIZE;
-    rd->attr = gpu_emitQuad(rd->attr, rect, rd->uvTable + uvIndex*4);
+    rd->attr = gpu_emitSprite(rd->attr,
+                    ((float) (loc->x - rd->cx) - 0.5f) * rd->tileW,
+                    ((float) (rd->cy - loc->y) - 0.5f) * rd->tileH,
+                    VID_INDEX(vid), 0.0f);
 #if 0
     printf("KR emitSprite %d,%d vid:%d:%d\n",
             loc->x, loc->y, VID_BANK(vid), VID_INDEX(vid));
@@ -618,13 +697,14 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
     SpriteRenderData rd;
     const Object* focusObj;
 
-    rd.uvTable = sp->textureInfo->tileTexCoord;
-    rd.rect[2] = rd.rect[3] = VIEW_TILE_SIZE;
+    rd.tileW = view->scale;
+    rd.tileH = view->scale * view->aspect;
     rd.cx = center.x;
     rd.cy = center.y;
-    rd.attr = gpu_beginTris(xu4.gpu, TRIS_MAP_OBJ);
+    rd.attr = gpu_beginSprites(xu4.gpu, TRIS_MAP_OBJ, rd.tileW, rd.tileH);
 
-    map->queryVisible(center, view->columns / 2, emitSprite, &rd, &focusObj);
+    int radius = (view->columns > view->rows) ? view->columns : view->rows;
+    map->queryVisible(center, radius / 2, emitSprite, &rd, &focusObj);
 
     if (focusObj) {
         if ((screenState()->currentCycle * 4 / SCR_CYCLE_PER_SECOND) % 2) {
@@ -644,6 +724,7 @@ void screenUpdateMap(TileView* view, const Map* map, const Coords& center) {
  * neither is set, the map area is left untouched.
  */
 void screenUpdate(TileView *view, bool showmap, bool blackout) {
+    PROFILE_ZONE("screenUpdate")
     ASSERT(c != NULL, "context has not yet been initialized");
 
     if (blackout)
@@ -658,6 +739,8 @@ void screenUpdate(TileView *view, bool showmap, bool blackout) {
         screenRedrawMapArea();
 #ifdef GPU_RENDER
         xu4.screen->renderMapView = NULL;
+#else
+        view->invalidate();
 #endif
     }
     else if (showmap) {
@@ -665,38 +748,54 @@ void screenUpdate(TileView *view, bool showmap, bool blackout) {
         screenUpdateMap(view, c->location->map, c->location->coords);
 #else
         MapTile black = c->location->map->tileset->getByName(Tile::sym.black)->getId();
-        vector<MapTile> viewTiles[VIEWPORT_W][VIEWPORT_H];
-        uint8_t* blocked = xu4.screen->blockingGrid;
+        TileStack* viewTiles = xu4.screen->viewTiles;
+        TileStack* stack;
+        uint64_t* blocked = xu4.screen->blockingRows;
+        uint64_t row;
         bool focus;
         int focusX, focusY;
         int x, y;
 
         focusX = -1;
+        {
+        PROFILE_ZONE("screenCompose")
+        stack = viewTiles;
         for (y = 0; y < VIEWPORT_H; y++) {
-            for (x = 0; x < VIEWPORT_W; x++) {
-                viewTiles[x][y] = screenViewportTile(VIEWPORT_W, VIEWPORT_H,
-                                                     x, y, focus);
-                *blocked++ = viewTiles[x][y].front().getTileType()->isOpaque();
+            row = 0;
+            for (x = 0; x < VIEWPORT_W; x++, stack++) {
+                screenViewportTile(*stack, VIEWPORT_W, VIEWPORT_H, x, y, focus);
+                if (stack->front().getTileType()->isOpaque())
+                    row |= uint64_t(1) << x;
                 if (focus) {
                     focusX = x;
                     focusY = y;
                 }
             }
+            *blocked++ = row;
+        }
         }
 
         screenFindLineOfSight();
 
-        const uint8_t* lineOfSight = xu4.screen->screenLos;
+        // Only redraw the cells which differ from the last update.
+        const uint64_t* lineOfSight = xu4.screen->losRows;
+        bool focusOn = (xu4.screen->state.currentCycle * 4 /
+                        SCR_CYCLE_PER_SECOND) % 2;
+        stack = viewTiles;
         for (y = 0; y < VIEWPORT_H; y++) {
-            for (x = 0; x < VIEWPORT_W; x++) {
-                if (*lineOfSight++)
-                    view->drawTile(viewTiles[x][y], x, y);
-                else
+            row = *lineOfSight++;
+            for (x = 0; x < VIEWPORT_W; x++, stack++, row >>= 1) {
+                focus = focusOn && x == focusX && y == focusY;
+                if (row & 1) {
+                    if (view->cellChanged(x, y, stack, focus)) {
+                        view->drawTile(*stack, x, y);
+                        if (focus)
+                            view->drawFocus(x, y);
+                    }
+                } else if (view->cellChanged(x, y, NULL, false))
                     view->drawTile(black, x, y);
             }
         }
-        if (focusX >= 0)
-            view->drawFocus(focusX, focusY);
         screenRedrawMapArea();
 #endif
     }
@@ -709,11 +808,17 @@ void screenUpdate(TileView *view, bool showmap, bool blackout) {
 
 #ifdef USE_GL
 /**
- * Transfer the contents of the screenImage to the GPU.
+ * Transfer the areas of the screenImage changed since the last call to
+ * the GPU.
  * This function will be removed after GPU rendering is fully implemented.
  */
 void screenUploadToGPU() {
-    gpu_blitTexture(gpu_screenTexture(xu4.gpu), 0, 0, xu4.screenImage);
+    Image* screen = xu4.screenImage;
+    const ImageDirty* dirty = screen->dirtyRects();
+    uint32_t tex = gpu_screenTexture(xu4.gpu);
+    for (int i = 0; i < dirty->count; ++i)
+        gpu_blitTextureRect(tex, screen, dirty->rect[i]);
+    screen->clearDirty();
 }
 
 void screenRender() {
@@ -740,13 +845,12 @@ void screenRender() {
                     sp->blockingUpdate, sp->blockX, sp->blockY, view->scale);
         sp->blockingUpdate = NULL;
 
-        gpu_drawTris(gpu, TRIS_MAP_OBJ);
+        gpu_drawSprites(gpu, TRIS_MAP_OBJ);
 
-        anim_advance(&xu4.eventHandler->fxAnim, 1.0f / 24.0f);
-        view->updateEffects((float) sp->blockX,
-                            (float) sp->blockY,
-                            sp->textureInfo->tileTexCoord);
-        gpu_drawTris(gpu, TRIS_MAP_FX);
+        anim_advance(&xu4.eventHandler->fxAnim,
+                     xu4.eventHandler->frameSeconds());
+        view->updateEffects((float) sp->blockX, (float) sp->blockY);
+        gpu_drawSprites(gpu, TRIS_MAP_FX);
 
         if (view->highlightActive())
             gpu_invertColors(gpu);
@@ -770,6 +874,7 @@ void screenDrawImageInMapArea(Symbol name) {
                              SCALED(BORDER_WIDTH), SCALED(BORDER_HEIGHT),
                              VIEWPORT_W * SCALED(TILE_WIDTH),
                              VIEWPORT_H * SCALED(TILE_HEIGHT));
+    screenInvalidateMapArea();
 }
 
 /**
@@ -942,352 +1047,32 @@ void screenDetectDungeonTraps() {
 }
 
 #ifndef GPU_RENDER
-#define BLOCKING(x,y)   blocking[(y) * VIEWPORT_W + (x)]
-#define LOS(x,y)        lineOfSight[(y) * VIEWPORT_W + (x)]
-
-/**
- * Finds which tiles in the viewport are visible from the avatars
- * location in the middle. (original DOS algorithm)
- */
-static void screenFindLineOfSightDOS(const uint8_t* blocking, uint8_t* lineOfSight) {
-    int x, y;
-    const int halfW = VIEWPORT_W / 2;
-    const int halfH = VIEWPORT_H / 2;
-
-    LOS(halfW, halfH) = 1;
-
-    for (x = halfW - 1; x >= 0; x--)
-        if (LOS(x + 1, halfH) && ! BLOCKING(x + 1, halfH))
-            LOS(x, halfH) = 1;
-
-    for (x = halfW + 1; x < VIEWPORT_W; x++)
-        if (LOS(x - 1, halfH) && ! BLOCKING(x - 1, halfH))
-            LOS(x, halfH) = 1;
-
-    for (y = halfH - 1; y >= 0; y--)
-        if (LOS(halfW, y + 1) && ! BLOCKING(halfW, y + 1))
-            LOS(halfW, y) = 1;
-
-    for (y = halfH + 1; y < VIEWPORT_H; y++)
-        if (LOS(halfW, y - 1) && ! BLOCKING(halfW, y - 1))
-            LOS(halfW, y) = 1;
-
-    for (y = halfH - 1; y >= 0; y--) {
-
-        for (x = halfW - 1; x >= 0; x--) {
-            if (LOS(x, y + 1) && ! BLOCKING(x, y + 1))
-                LOS(x, y) = 1;
-            else if (LOS(x + 1, y) && ! BLOCKING(x + 1, y))
-                LOS(x, y) = 1;
-            else if (LOS(x + 1, y + 1) && ! BLOCKING(x + 1, y + 1))
-                LOS(x, y) = 1;
-        }
-
-        for (x = halfW + 1; x < VIEWPORT_W; x++) {
-            if (LOS(x, y + 1) && ! BLOCKING(x, y + 1))
-                LOS(x, y) = 1;
-            else if (LOS(x - 1, y) && ! BLOCKING(x - 1, y))
-                LOS(x, y) = 1;
-            else if (LOS(x - 1, y + 1) && ! BLOCKING(x - 1, y + 1))
-                LOS(x, y) = 1;
-        }
-    }
-
-    for (y = halfH + 1; y < VIEWPORT_H; y++) {
-
-        for (x = halfW - 1; x >= 0; x--) {
-            if (LOS(x, y - 1) && ! BLOCKING(x, y - 1))
-                LOS(x, y) = 1;
-            else if (LOS(x + 1, y) && ! BLOCKING(x + 1, y))
-                LOS(x, y) = 1;
-            else if (LOS(x + 1, y - 1) && ! BLOCKING(x + 1, y - 1))
-                LOS(x, y) = 1;
-        }
-
-        for (x = halfW + 1; x < VIEWPORT_W; x++) {
-            if (LOS(x, y - 1) && ! BLOCKING(x, y - 1))
-                LOS(x, y) = 1;
-            else if (LOS(x - 1, y) && ! BLOCKING(x - 1, y))
-                LOS(x, y) = 1;
-            else if (LOS(x - 1, y - 1) && ! BLOCKING(x - 1, y - 1))
-                LOS(x, y) = 1;
-        }
-    }
-}
-
-#if 1
-/*
- * bitmasks for LOS shadows
- */
-#define ____H 0x01    // obscured along the horizontal face
-#define ___C_ 0x02    // obscured at the center
-#define __V__ 0x04    // obscured along the vertical face
-#define _N___ 0x80    // start of new raster
-
-#define ___CH 0x03
-#define __VCH 0x07
-#define __VC_ 0x06
-
-#define _N__H 0x81
-#define _N_CH 0x83
-#define _NVCH 0x87
-#define _NVC_ 0x86
-#define _NV__ 0x84
-
-/**
- * Finds which tiles in the viewport are visible from the avatars
- * location in the middle.
- *
- * A new, more accurate LOS function
- *
- * Based somewhat off Andy McFadden's 1994 article,
- *   "Improvements to a Fast Algorithm for Calculating Shading
- *   and Visibility in a Two-Dimensional Field"
- *   -----
- *   http://www.fadden.com/techmisc/fast-los.html
- *
- * This function uses a lookup table to get the correct shadowmap,
- * therefore, the table will need to be updated if the viewport
- * dimensions increase. Also, the function assumes that the
- * viewport width and height are odd values and that the player
- * is always at the center of the screen.
- */
-static void screenFindLineOfSightEnhanced(const uint8_t* blocking, uint8_t* lineOfSight) {
-    /*
-     * the shadow rasters for each viewport octant
-     *
-     * shadowRaster[0][0]    // number of raster segments in this shadow
-     * shadowRaster[0][1]    // #1 shadow bitmask value (low three bits) + "newline" flag (high bit)
-     * shadowRaster[0][2]    // #1 length
-     * shadowRaster[0][3]    // #2 shadow bitmask value
-     * shadowRaster[0][4]    // #2 length
-     * shadowRaster[0][5]    // #3 shadow bitmask value
-     * shadowRaster[0][6]    // #3 length
-     * ...etc...
-     */
-    static const uint8_t colRasterIndex[5] = { 0, 0, 2, 5, 9 };
-    static const uint8_t shadowRaster[14][13] = {
-        { 6, __VCH, 4, _N_CH, 1, __VCH, 3, _N___, 1, ___CH, 1, __VCH, 1 },    // raster_1_0
-        { 6, __VC_, 1, _NVCH, 2, __VC_, 1, _NVCH, 3, _NVCH, 2, _NVCH, 1 },    // raster_1_1
-        //
-        { 4, __VCH, 3, _N__H, 1, ___CH, 1, __VCH, 1,     0, 0,     0, 0 },    // raster_2_0
-        { 6, __VC_, 2, _N_CH, 1, __VCH, 2, _N_CH, 1, __VCH, 1, _N__H, 1 },    // raster_2_1
-        { 6, __V__, 1, _NVCH, 1, __VC_, 1, _NVCH, 1, __VC_, 1, _NVCH, 1 },    // raster_2_2
-        //
-        { 2, __VCH, 2, _N__H, 2,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_3_0
-        { 3, __VC_, 2, _N_CH, 1, __VCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_1
-        { 3, __VC_, 1, _NVCH, 2, _N_CH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_2
-        { 3, _NVCH, 1, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_3
-        //
-        { 2, __VCH, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_0
-        { 2, __VC_, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_1
-        { 2, __VC_, 1, _N_CH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_2
-        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_3
-        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 }     // raster_4_4
-    };
-    static const char octantSign[8 * 3] = {
-    // xSign, ySign, reflect
-         1,  1,  0,     // lower-right
-         1,  1,  1,
-         1, -1,  1,     // lower-left
-        -1,  1,  0,
-        -1, -1,  0,     // upper-left
-        -1, -1,  1,
-        -1,  1,  1,     // upper-right
-         1, -1,  0,
-    };
-
-    /*
-     * As each viewport tile is processed, it will store the bitmask for the shadow it casts.
-     * Later, after processing all octants, the entire viewport will be marked visible except
-     * for those tiles that have the __VCH bitmask.
-     */
-    const int _OCTANTS = 8;
-    const int _NUM_RASTERS_COLS = 4;
-
-    int octant;
-    int xOrigin, yOrigin, xSign, ySign, reflect;
-    int xTile, yTile, xTileOffset, yTileOffset;
-    int currentRaster;
-    int maxWidth, maxHeight;
-    const char* osign = octantSign;
-
-    // determine the origin point
-    xOrigin = VIEWPORT_W / 2;
-    yOrigin = VIEWPORT_H / 2;
-
-    for (octant = 0; octant < _OCTANTS; octant++) {
-        xSign   = *osign++;
-        ySign   = *osign++;
-        reflect = *osign++;
-
-        // make sure the segment doesn't reach out of bounds
-        if (reflect) {
-            // swap height and width
-            maxWidth  = yOrigin;
-            maxHeight = xOrigin;
-        } else {
-            maxWidth  = xOrigin;
-            maxHeight = yOrigin;
-        }
-
-        // check the visibility of each tile
-        for (int currentCol = 1; currentCol <= _NUM_RASTERS_COLS; currentCol++) {
-            for (int currentRow = 0; currentRow <= currentCol; currentRow++) {
-                // swap X and Y to reflect the octant rasters
-                if (reflect) {
-                    xTile = xOrigin+(currentRow*ySign);
-                    yTile = yOrigin+(currentCol*xSign);
-                }
-                else {
-                    xTile = xOrigin+(currentCol*xSign);
-                    yTile = yOrigin+(currentRow*ySign);
-                }
-
-                if (BLOCKING(xTile, yTile)) {
-                    // a wall was detected, so go through the raster for this
-                    // wall segment and mark everything behind it with the
-                    // appropriate shadow bitmask.
-
-                    // first, get the correct raster (0-13)
-                    currentRaster = currentRow + colRasterIndex[currentCol];
-
-                    xTileOffset = 0;
-                    yTileOffset = 0;
-
-                    //========================================
-                    for (int currentSegment = 0; currentSegment < shadowRaster[currentRaster][0]; currentSegment++) {
-                        // each shadow segment is 2 bytes
-                        int shadowType   = shadowRaster[currentRaster][currentSegment*2+1];
-                        int shadowLength = shadowRaster[currentRaster][currentSegment*2+2];
-
-                        // update the raster length to make sure it fits in the viewport
-                        shadowLength = (shadowLength+1+yTileOffset > maxWidth ? maxWidth : shadowLength);
-
-                        // check to see if we should move up a row
-                        if (shadowType & 0x80) {
-                            // remove the flag from the shadowType
-                            shadowType ^= _N___;
-                            if (currentRow + yTileOffset > maxHeight)
-                                break;
-
-                            xTileOffset = yTileOffset;
-                            yTileOffset++;
-                        }
-
-                        /* it is seemingly unnecessary to swap the edges for
-                         * shadow tiles, because we only care about shadow
-                         * tiles that have all three parts (V, C, and H)
-                         * flagged.  if a tile has fewer than three, it is
-                         * ignored during the draw phase, so vertical and
-                         * horizontal shadow edge accuracy isn't important
-                         */
-                        // if reflecting the octant, swap the edges
-                        /*
-                        if (reflect) {
-                            int shadowTemp = 0;
-                            // swap the vertical and horizontal shadow edges
-                            if (shadowType & __V__) { shadowTemp |= ____H; }
-                            if (shadowType & ___C_) { shadowTemp |= ___C_; }
-                            if (shadowType & ____H) { shadowTemp |= __V__; }
-                            shadowType = shadowTemp;
-                        }
-                        */
-
-                        for (int currentShadow = 1; currentShadow <= shadowLength; currentShadow++) {
-                            // apply the shadow to the shadowMap
-                            if (reflect) {
-                                LOS(xTile + ((yTileOffset) * ySign), yTile + ((currentShadow+xTileOffset) * xSign)) |= shadowType;
-                            }
-                            else {
-                                LOS(xTile + ((currentShadow+xTileOffset) * xSign), yTile + ((yTileOffset) * ySign)) |= shadowType;
-                            }
-                        }
-                        xTileOffset += shadowLength;
-                    }  // currentSegment
-                    //========================================
-
-                }  // BLOCKING
-            }  // currentRow
-        }  // currentCol
-    }  // octant
-
-    // go through all tiles on the viewable area and set the appropriate visibility
-    uint8_t* end = lineOfSight + VIEWPORT_W * VIEWPORT_H;
-    while (lineOfSight != end) {
-        // if the shadow flags equal __VCH, hide it, otherwise it's fully visible
-        if ((*lineOfSight & __VCH) == __VCH)
-            *lineOfSight = 0;
-        else
-            *lineOfSight = 1;
-        ++lineOfSight;
-    }
-}
-#else
-
-typedef struct {
-    const uint8_t* blocking;
-    uint8_t* visible;
-    //float visible[VIEWPORT_W * VIEWPORT_H];
-} GridSC;
-
-#define GSC_TYPE                GridSC
-#define GSC_XDIM(g)             VIEWPORT_W
-#define GSC_YDIM(g)             VIEWPORT_H
-#define GSC_IS_WALL(g,x,y)      g->blocking[VIEWPORT_W * y + x]
-#define GSC_SET_LIGHT(g,x,y,ds) g->visible[VIEWPORT_W * y + x] = 1
-#include "support/gridShadowCast.c"
-
-static void screenFindLineOfSightEnhanced(const uint8_t* blocking, uint8_t* lineOfSight) {
-    GridSC grid;
-    int viewPos[2];
-
-    grid.blocking = blocking;
-    grid.visible  = lineOfSight;
-    viewPos[0] = VIEWPORT_W/2;
-    viewPos[1] = VIEWPORT_H/2;
-
-#if 0
-    // Mark cells as not visible.
-    for (int i = 0; i < VIEWPORT_W*VIEWPORT_H; ++i)
-        grid.visible[i] = -1.0f;
-#endif
-
-    gsc_computeVisibility(&grid, viewPos, 8.0f);
-
-#if 0
-    for (int i = 0; i < VIEWPORT_W*VIEWPORT_H; ++i) {
-        lineOfSight[i] = (grid.visible[i] >= 0.0) ? 1 : 0;
-        //printf( "KR los %d %f\n", i, grid.visible[i]);
-    }
-#endif
-}
-#endif
-
 //#define CPU_TEST
 #include "support/cpuCounter.h"
 
 /**
  * Finds which tiles in the viewport are visible from the avatars
  * location in the middle.
- * Uses Screen blockingGrid to build screenLos.
+ * Uses Screen blockingRows to set losRows.
  */
 static void screenFindLineOfSight() {
+    Screen* scr = xu4.screen;
+    const int w = VIEWPORT_W;
+    const int h = VIEWPORT_H;
+
     if (c->location->map->flags & NO_LINE_OF_SIGHT) {
         // The map has the no line of sight flag, all is visible
-        memset(xu4.screen->screenLos, 1, VIEWPORT_W * VIEWPORT_H);
+        LosCache* cache = &scr->losCache;
+        cache->mode = -1;
+        for (int y = 0; y < h; ++y)
+            cache->visible[y] = (uint64_t(1) << w) - 1;
+        scr->losRows = cache->visible;
     } else {
         // otherwise calculate it from the map data
-        memset(xu4.screen->screenLos, 0, VIEWPORT_W * VIEWPORT_H);
-
         CPU_START()
-        if (xu4.settings->lineOfSight == 0)
-            screenFindLineOfSightDOS(xu4.screen->blockingGrid,
-                                     xu4.screen->screenLos);
-        else
-            screenFindLineOfSightEnhanced(xu4.screen->blockingGrid,
-                                          xu4.screen->screenLos);
-        CPU_END()
+        scr->losRows = los_compute(&scr->losCache, xu4.settings->lineOfSight,
+                                   scr->blockingRows, w, h);
+        CPU_END("LOS")
     }
 }
 #endif
@@ -1399,6 +1184,18 @@ void screenEraseMapArea() {
                               VIEWPORT_W * SCALED(TILE_WIDTH),
                               VIEWPORT_H * SCALED(TILE_HEIGHT),
                               0, 0, 0);
+    screenInvalidateMapArea();
+}
+
+/*
+ * Force the next screenUpdate() to redraw every map tile.  Call this after
+ * drawing over the map area by other means.
+ */
+void screenInvalidateMapArea() {
+#ifndef GPU_RENDER
+    if (xu4.game)
+        xu4.game->mapArea.invalidate();
+#endif
 }
 
 void screenEraseTextArea(int x, int y, int width, int height) {
@@ -1458,6 +1255,7 @@ static void screenShowGemTile(const Layout *layout, const Map *map,
             scr->gemTilesInfo = xu4.imageMgr->get(BKGD_GEMTILES);
             if (! scr->gemTilesInfo)
                 errorLoadImage(BKGD_GEMTILES);
+            xu4.imageMgr->pin(scr->gemTilesInfo);
         }
 
         if (tile < 128) {
@@ -1492,6 +1290,7 @@ void screenGemUpdate() {
                               SCALED(VIEWPORT_W * TILE_WIDTH),
                               SCALED(VIEWPORT_H * TILE_HEIGHT),
                               0, 0, 0);
+    screenInvalidateMapArea();
 
     if (map->type == Map::DUNGEON) {
         //DO THE SPECIAL DUNGEON MAP TRAVERSAL
@@ -1499,7 +1298,7 @@ void screenGemUpdate() {
 
         vector<vector<int> > drawnTiles(layout->viewport.width, vector<int>(layout->viewport.height, 0));
         vector<std::pair<int,int> > coordStack;
-        vector<MapTile> tiles;
+        TileStack tiles;
         const Coords& coords = c->location->coords;
 
         //Put the avatar's position on the stack
@@ -1528,10 +1327,10 @@ void screenGemUpdate() {
             drawnTiles[x][y] = 1;
 
             // DRAW THE ACTUAL TILE
-            tiles = screenViewportTile(layout->viewport.width,
-                                       layout->viewport.height,
-                                       x - center_x + avt_x,
-                                       y - center_y + avt_y, focus);
+            screenViewportTile(tiles, layout->viewport.width,
+                               layout->viewport.height,
+                               x - center_x + avt_x,
+                               y - center_y + avt_y, focus);
             tile = tiles.front();
 
             if (! weAreDrawingTheAvatarTile) {
@@ -1575,8 +1374,10 @@ void screenGemUpdate() {
 
         for (x = 0; x < layout->viewport.width; x++) {
             for (y = 0; y < layout->viewport.height; y++) {
-                tile = screenViewportTile(layout->viewport.width,
-                                          layout->viewport.height, x, y, focus).front();
+                TileStack tiles;
+                screenViewportTile(tiles, layout->viewport.width,
+                                   layout->viewport.height, x, y, focus);
+                tile = tiles.front();
                 screenShowGemTile(layout, map, tile, focus, x, y);
             }
         }
@@ -1599,26 +1400,33 @@ void screenGemUpdate() {
  */
 Image *screenScale(Image *src, int scale, int n, int filter) {
     Image *dest = NULL;
+    Image *pass;
 
     if (n == 0)
         n = 1;
 
+    // Each pass after the first frees the intermediate image it scales.
     Scaler filterScaler = xu4.screen->filterScaler;
     if (filterScaler) {
         while (filter && (scale % 2 == 0)) {
-            dest = (*filterScaler)(src, 2, n);
-            src = dest;
+            pass = (*filterScaler)(src, 2, n);
+            delete dest;
+            src = dest = pass;
             scale /= 2;
         }
         if (scale == 3 && scaler3x(xu4.settings->filter)) {
-            dest = (*filterScaler)(src, 3, n);
-            src = dest;
+            pass = (*filterScaler)(src, 3, n);
+            delete dest;
+            src = dest = pass;
             scale /= 3;
         }
     }
 
-    if (scale != 1)
-        dest = (*scalerGet(ScreenFilter_point))(src, scale, n);
+    if (scale != 1) {
+        pass = (*scalerGet(ScreenFilter_point))(src, scale, n);
+        delete dest;
+        dest = pass;
+    }
 
     if (!dest)
         dest = Image::duplicate(src);
@@ -88,12 +88,16 @@ struct ScreenState {
     const TileAnimSet* tileanims;
     int currentCycle;
     int vertOffset;
+    int viewW;          // Map viewport size in tiles (always odd).
+    int viewH;
     bool formatIsABGR;
+    bool vsync;         // Buffer swaps wait for the display refresh.
+    bool uncapped;      // Present frames as fast as possible.
 };
 
 #define SCR_CYCLE_PER_SECOND 4
 
-void screenInit(void);
+void screenInit(bool uncapped);
 void screenRefreshTimerInit(void);
 void screenDelete(void);
 void screenReInit(void);
@@ -115,6 +119,7 @@ void screenDrawImageInMapArea(Symbol bkgd);
 
 void screenCycle(void);
 void screenEraseMapArea(void);
+void screenInvalidateMapArea(void);
 void screenEraseTextArea(int x, int y, int width, int height);
 void screenGemUpdate(void);
 
@@ -136,7 +141,8 @@ void screenUpdate(TileView *view, bool showmap, bool blackout);
 void screenUpdateCursor(void);
 void screenUpdateMoons(void);
 void screenUpdateWind(void);
-std::vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus);
+void screenViewportTile(TileStack& tiles, unsigned int width,
+                        unsigned int height, int x, int y, bool &focus);
 
 void screenShowCursor(void);
 void screenHideCursor(void);
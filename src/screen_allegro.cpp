@@ -130,6 +130,9 @@ void screenInit_sys(const Settings* settings, int* dim, int reset) {
 
 #ifdef USE_GL
         gpu_free(&sa->gpu);
+#else
+        al_destroy_bitmap(sa->frame);
+        sa->frame = NULL;
 #endif
         al_destroy_display(sa->disp);
         sa->disp = NULL;
@@ -159,6 +162,10 @@ void screenInit_sys(const Settings* settings, int* dim, int reset) {
         dflags |= ALLEGRO_FULLSCREEN_WINDOW;
     al_set_new_display_flags(dflags);
 
+    // Present at the display refresh rate unless running uncapped.
+    // An ALLEGRO_VSYNC value of 1 requests vsync on and 2 requests it off.
+    al_set_new_display_option(ALLEGRO_VSYNC,
+                              screenState()->uncapped ? 2 : 1, ALLEGRO_SUGGEST);
 #ifdef USE_GL
     //al_set_new_display_option(ALLEGRO_ALPHA_SIZE, 8, ALLEGRO_REQUIRE);
 #endif
@@ -178,6 +185,8 @@ void screenInit_sys(const Settings* settings, int* dim, int reset) {
 #endif
             goto fatal;
     }
+    screenState()->vsync =
+        (al_get_display_option(sa->disp, ALLEGRO_VSYNC) == 1);
 
 #if defined(_WIN32) && defined(USE_GL)
     {
@@ -238,6 +247,14 @@ void screenInit_sys(const Settings* settings, int* dim, int reset) {
             state->formatIsABGR = true;
             break;
     }
+
+    // The backbuffer contents are undefined after a flip, so screenImage
+    // changes are accumulated in a bitmap which is drawn every frame.
+    al_set_new_bitmap_format(format);
+    al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+    sa->frame = al_create_bitmap(dw, dh);
+    if (! sa->frame)
+        goto fatal;
     }
 #endif
 
@@ -294,6 +311,8 @@ void screenDelete_sys() {
 
 #ifdef USE_GL
     gpu_free(&sa->gpu);
+#else
+    al_destroy_bitmap(sa->frame);
 #endif
 
     for( int i = 1; i < 5; ++i )
@@ -324,17 +343,19 @@ void screenIconify() {
 #ifndef USE_GL
 /*
  * Show screenImage on the display.
- * If w is zero then the entire display is updated.
+ * Only the areas of screenImage which have changed are copied to the frame
+ * bitmap.
  */
-static void updateDisplay(int x, int y, int w, int h) {
+static void updateDisplay() {
+    ScreenAllegro* sa = SA;
+    Image* screen = xu4.screenImage;
+    const ImageDirty* dirty = screen->dirtyRects();
     const ALLEGRO_LOCKED_REGION* lr;
-    uint32_t* drow;
-    uint32_t* dp;
+    const int* rect;
+    uint8_t* drow;
     const uint32_t* srow;
-    const uint32_t* send;
-    const uint32_t* sp;
-    int dpitch, cr;
-    int screenImageW = xu4.screenImage->width();
+    int i, cr, rowBytes;
+    int screenImageW = screen->width();
     int offset = screenState()->vertOffset;
 
 #if 0
@@ -346,45 +367,32 @@ static void updateDisplay(int x, int y, int w, int h) {
 
     CPU_START()
 
-    if (w == 0) {
-        w = xu4.screenImage->width();
-        h = xu4.screenImage->height();
-    }
-
-    ALLEGRO_BITMAP* backBuf = al_get_backbuffer(SA->disp);
-
-    lr = al_lock_bitmap(backBuf, ALLEGRO_PIXEL_FORMAT_ANY,
-                        ALLEGRO_LOCK_WRITEONLY);
-    assert(lr);
+    for (i = 0; i < dirty->count; ++i) {
+        rect = dirty->rect[i];
+        lr = al_lock_bitmap_region(sa->frame, rect[0], rect[1],
+                                   rect[2], rect[3], ALLEGRO_PIXEL_FORMAT_ANY,
+                                   ALLEGRO_LOCK_WRITEONLY);
+        assert(lr);
 #if 0
-    printf("KR updateDisplay format:%d psize:%d pitch:%d\n",
-            lr->format, lr->pixel_size, lr->pitch);
+        printf("KR updateDisplay format:%d psize:%d pitch:%d\n",
+                lr->format, lr->pixel_size, lr->pitch);
 #endif
-    dpitch = lr->pitch / sizeof(uint32_t);
-    drow = ((uint32_t*) lr->data) + y*dpitch + x;
-    srow = xu4.screenImage->pixelData() + y*screenImageW + x;
-
-    if (offset > 0) {
-        h -= offset;
-        while (offset) {
-            memset(drow, 0, w * sizeof(uint32_t));
-            drow += dpitch;
-            --offset;
-        }
-    }
-
-    for (cr = 0; cr < h; ++cr) {
-        dp = drow;
-        sp = srow;
-        send = srow + w;
-        while (sp != send) {
-            *dp++ = *sp++;
+        drow = (uint8_t*) lr->data;
+        srow = screen->pixelData() + rect[1]*screenImageW + rect[0];
+        rowBytes = rect[2] * sizeof(uint32_t);
+        for (cr = 0; cr < rect[3]; ++cr) {
+            memcpy(drow, srow, rowBytes);
+            drow += lr->pitch;
+            srow += screenImageW;
         }
-        drow += dpitch;
-        srow += screenImageW;
+        al_unlock_bitmap(sa->frame);
     }
-    al_unlock_bitmap(backBuf);
+    screen->clearDirty();
 
+    al_set_target_backbuffer(sa->disp);
+    if (offset > 0)
+        al_clear_to_color(al_map_rgb(0, 0, 0));
+    al_draw_bitmap(sa->frame, 0, offset, 0);
     al_flip_display();
 
     CPU_END("ut:")
@@ -404,7 +412,7 @@ void screenSwapBuffers() {
     al_flip_display();
     CPU_END("ut:")
 #else
-    updateDisplay(0, 0, 0, 0);
+    updateDisplay();
 #endif
 }
 
@@ -12,6 +12,8 @@ struct ScreenAllegro {
     int currentCursor;
 #ifdef USE_GL
     OpenGLResources gpu;
+#else
+    ALLEGRO_BITMAP* frame;      // Copy of screenImage in display format.
 #endif
 };
 
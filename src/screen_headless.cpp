@@ -0,0 +1,68 @@
+/*
+ * screen_headless.cpp
+ *
+ * Null display backend.  All drawing still happens in xu4.screenImage but
+ * nothing is presented, so recorded sessions can be replayed on machines
+ * without a display or GPU.
+ */
+
+#include <cstring>
+
+#include "screen.h"
+#include "settings.h"
+#include "xu4.h"
+
+extern bool verbose;
+extern void msecSleep(uint32_t);
+
+struct ScreenHeadless {
+    uint32_t frameCount;
+    int frameDuration;
+};
+
+#define SH  ((ScreenHeadless*) xu4.screenSys)
+
+void screenInit_sys(const Settings* settings, int* dim, int reset) {
+    ScreenHeadless* sh;
+
+    if (reset) {
+        sh = SH;
+    } else {
+        xu4.screenSys = sh = new ScreenHeadless;
+        memset(sh, 0, sizeof(ScreenHeadless));
+    }
+
+    dim[0] = dim[2] = 320 * settings->scale;
+    dim[1] = dim[3] = 200 * settings->scale;
+
+    screenState()->formatIsABGR = false;
+    sh->frameDuration = 1000 / settings->screenAnimationFramesPerSecond;
+}
+
+void screenDelete_sys() {
+    ScreenHeadless* sh = SH;
+
+    if (verbose)
+        printf("headless: %u frames simulated\n", sh->frameCount);
+
+    delete sh;
+    xu4.screenSys = NULL;
+}
+
+void screenIconify() {
+}
+
+void screenSwapBuffers() {
+    ++SH->frameCount;
+}
+
+void screenWait(int numberOfAnimationFrames) {
+    screenSwapBuffers();
+    msecSleep(numberOfAnimationFrames * SH->frameDuration);
+}
+
+void screenSetMouseCursor(MouseCursor cursor) {
+}
+
+void screenShowMouseCursor(bool visible) {
+}
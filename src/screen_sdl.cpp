@@ -241,21 +241,38 @@ int screenLoadImageCga(Image **image, int width, int height, U4FILE *file, Compr
 }
 #endif
 
+/*
+ * Copy an area of screenImage to the surface at dx, dy.
+ */
+static void copyToSurface(SDL_Surface* ss, int dx, int dy,
+                          int x, int y, int w, int h) {
+    const uint32_t* srow;
+    uint8_t* drow;
+    int screenImageW = xu4.screenImage->width();
+
+    srow = xu4.screenImage->pixelData() + y*screenImageW + x;
+    drow = ((uint8_t*) ss->pixels) + dy*ss->pitch + dx*sizeof(uint32_t);
+    while (h--) {
+        memcpy(drow, srow, w * sizeof(uint32_t));
+        srow += screenImageW;
+        drow += ss->pitch;
+    }
+}
+
 /*
  * Show screenImage on the display.
- * If w is zero then the entire display is updated.
+ * Only the areas of screenImage which have changed are copied unless the
+ * screen is being shaken.
  */
-static void updateDisplay( int x, int y, int w, int h ) {
+static void updateDisplay() {
+    static int prevOffset = 0;
     SDL_Surface* ss = SDL_GetVideoSurface();
     if (ss) {
-        uint32_t* dp;
-        uint32_t* drow;
-        const uint32_t* sp;
-        const uint32_t* send;
-        const uint32_t* srow;
-        int dpitch = ss->pitch / sizeof(uint32_t);
-        int screenImageW = xu4.screenImage->width();
-        int cr;
+        Image* screen = xu4.screenImage;
+        const ImageDirty* dirty = screen->dirtyRects();
+        const int* rect;
+        SDL_Rect update[DIRTY_RECT_MAX];
+        int i;
         int offset = screenState()->vertOffset;
 
 #if 0
@@ -265,36 +282,28 @@ static void updateDisplay( int x, int y, int w, int h ) {
                 ss->w, ss->h, ss->pitch );
 #endif
 
-        if (w == 0) {
-            w = ss->w;
-            h = ss->h;
-        }
-
         SDL_LockSurface(ss);
-        srow = xu4.screenImage->pixelData() + y*screenImageW + x;
-        drow = ((uint32_t*) ss->pixels) + y*dpitch + x;
-
-        if (offset > 0) {
-            h -= offset;
-            while (offset) {
-                memset(drow, 0, w * sizeof(uint32_t));
-                drow += dpitch;
-                --offset;
+        if (offset > 0 || prevOffset > 0) {
+            if (offset > 0)
+                memset(ss->pixels, 0, offset * ss->pitch);
+            copyToSurface(ss, 0, offset, 0, 0, ss->w, ss->h - offset);
+            SDL_UnlockSurface(ss);
+            SDL_UpdateRect(ss, 0, 0, 0, 0);
+        } else {
+            for (i = 0; i < dirty->count; ++i) {
+                rect = dirty->rect[i];
+                copyToSurface(ss, rect[0], rect[1],
+                              rect[0], rect[1], rect[2], rect[3]);
+                update[i].x = rect[0];
+                update[i].y = rect[1];
+                update[i].w = rect[2];
+                update[i].h = rect[3];
             }
+            SDL_UnlockSurface(ss);
+            SDL_UpdateRects(ss, dirty->count, update);
         }
-
-        for (cr = 0; cr < h; ++cr) {
-            dp = drow;
-            sp = srow;
-            send = srow + screenImageW;
-            while (sp != send)
-                *dp++ = *sp++;
-            srow += screenImageW;
-            drow += dpitch;
-        }
-        SDL_UnlockSurface(ss);
-
-        SDL_UpdateRect(ss, 0, 0, 0, 0);
+        prevOffset = offset;
+        screen->clearDirty();
     }
 }
 
@@ -303,7 +312,7 @@ static void updateDisplay( int x, int y, int w, int h ) {
 
 void screenSwapBuffers() {
     CPU_START()
-    updateDisplay(0, 0, 0, 0);
+    updateDisplay();
     CPU_END("ut:")
 }
 
@@ -46,16 +46,53 @@ static void script_reportError(UThread* ut, const UCell* ex)
     ur_strFree(&str);
 }
 
-static const UCell* script_eval(UThread* ut, char* script, int len)
+/*
+  Evaluate script text, reusing the block made by any earlier call with the
+  same text so that repeated commands are not tokenized & bound again.
+*/
+static const UCell* script_evalCached(UThread* ut, vector<ScriptCall>& cache,
+                                      const char* script, int len)
 {
-    UCell* res = boron_evalUtf8(ut, script, len);
-    if (! res) {
-        const UCell* ex = ur_exception(ut);
-        if (ur_is(ex, UT_ERROR))
-            script_reportError(ut, ex);
-        boron_reset(ut);
+    vector<ScriptCall>::const_iterator it;
+    UCell blkC;
+    UCell* res;
+    UIndex blkN = 0;
+
+    foreach (it, cache) {
+        if (it->text.size() == (size_t) len &&
+            memcmp(it->text.data(), script, len) == 0) {
+            blkN = it->blkN;
+            break;
+        }
+    }
+
+    if (! blkN) {
+        blkN = ur_tokenize(ut, script, script + len, &blkC);
+        if (! blkN)
+            goto fail;
+        boron_bindDefault(ut, blkN);
+        ur_hold(blkN);      // Keep for the life of the config.
+
+        ScriptCall call;
+        call.text.assign(script, len);
+        call.blkN = blkN;
+        cache.push_back(call);
+    }
+
+    ur_setId(&blkC, UT_BLOCK);
+    ur_setSeries(&blkC, blkN, 0);
+    res = ur_stackTop(ut);
+    if (boron_doBlock(ut, &blkC, res) == UR_OK)
+        return res;
+
+fail:
+    {
+    const UCell* ex = ur_exception(ut);
+    if (ur_is(ex, UT_ERROR))
+        script_reportError(ut, ex);
+    boron_reset(ut);
     }
-    return res;
+    return NULL;
 }
 
 /*-cf-
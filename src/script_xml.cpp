@@ -42,7 +42,7 @@ static string xu4_to_string(int val) {
     return buffer;
 }
 
-static string translateContext(vector<string>& parts) {
+static string translateContext(const vector<string>& parts) {
     if (parts.size() == 1) {
         if (parts[0] == "wind")
             return getDirectionName((Direction) c->windDirection);
@@ -50,7 +50,7 @@ static string translateContext(vector<string>& parts) {
     return "";
 }
 
-static string translateMember(const PartyMember* pm, std::vector<string>& parts) {
+static string translateMember(const PartyMember* pm, const std::vector<string>& parts) {
     if (parts.size() == 1) {
         if (parts[0] == "hp")
             return xu4_to_string(pm->getHp());
@@ -106,7 +106,7 @@ static string translateMember(const PartyMember* pm, std::vector<string>& parts)
     return "";
 }
 
-static string translateParty(vector<string>& parts) {
+static string translateParty(const vector<string>& parts) {
     if (parts.size() == 1) {
         // Translate some different items for the script
         if (parts[0] == "transport") {
@@ -212,10 +212,496 @@ bool    Script::Variable::isSet() const             { return set; }
  */
 Script::ActionMap Script::action_map;
 
+//---------------------------------------------------------------------------
+
+/*
+ * Vendor scripts are compiled when loaded.  The XML document is converted
+ * into a tree of ScriptNode with the action of each element resolved, and
+ * text content & attribute values are split into literal fragments and
+ * {...} macros.  A macro without nested macros is also classified when
+ * compiled, and functions of constant arguments are evaluated then.
+ *
+ * The string based translate() is still used for values which are only
+ * known when the script runs.
+ */
+
+enum ScriptOp {
+    OP_TEXT     = -3,
+    OP_COMMENT  = -2,
+    OP_UNKNOWN  = -1
+    // Otherwise a Script::Action.
+};
+
+enum MacroKind {
+    MAC_EMPTY,              // Unknown function or provider.
+    MAC_CONST,              // Value computed when compiled.
+    MAC_VARIABLE,
+    MAC_ITERATOR,
+    MAC_SHOW_INVENTORY,
+    MAC_INVENTORY_CHOICES,
+    MAC_PARTY,
+    MAC_CONTEXT,
+    MAC_PROPERTY,
+    MAC_MATH,
+    MAC_COMPARE,
+    MAC_TOUPPER,
+    MAC_TOLOWER,
+    MAC_RANDOM,
+    MAC_ISEMPTY
+};
+
+struct ScriptMacro {
+    int kind;
+    string arg;                     // Name, script, value or function content.
+    std::vector<string> parts;      // Provider arguments.
+};
+
+struct ScriptFragment {
+    string literal;                 // Text preceding the macro.
+    ScriptText* item;               // Macro content, NULL after the last one.
+    ScriptMacro macro;              // Classified item if it has no macros.
+    string itemValue;               // Translated item if it has no macros.
+    size_t end;                     // Source offset after the closing brace.
+};
+
+struct ScriptText {
+    string source;
+    bool blank;                     // No alphanumerics; translates to "".
+    bool dynamic;                   // Has macros.  If not, the translation
+                                    // is the literal of the only fragment.
+    std::vector<ScriptFragment> frags;
+};
+
+struct ScriptAttr {
+    string name;
+    string raw;
+    ScriptText* value;
+};
+
+struct ScriptNode {
+    string name;
+    ScriptNode* parent;
+    std::vector<ScriptNode*> children;
+    std::vector<ScriptAttr> attrs;
+    ScriptText* text;               // Content of OP_TEXT nodes.
+    int index;                      // Position in parent->children.
+    int op;                         // ScriptOp or Script::Action.
+};
+
+static void freeText(ScriptText* text) {
+    if (text) {
+        for (size_t i = 0; i < text->frags.size(); ++i)
+            freeText(text->frags[i].item);
+        delete text;
+    }
+}
+
+static void freeNode(ScriptNode* node) {
+    size_t i;
+    for (i = 0; i < node->children.size(); ++i)
+        freeNode(node->children[i]);
+    for (i = 0; i < node->attrs.size(); ++i)
+        freeText(node->attrs[i].value);
+    freeText(node->text);
+    delete node;
+}
+
+static const ScriptAttr* findAttr(const ScriptNode* node, const char* name) {
+    std::vector<ScriptAttr>::const_iterator it;
+    for (it = node->attrs.begin(); it != node->attrs.end(); ++it) {
+        if (it->name == name)
+            return &(*it);
+    }
+    return NULL;
+}
+
+static bool propExists(const ScriptNode* node, const char* name) {
+    return findAttr(node, name) != NULL;
+}
+
+/*
+ * Return true if the property value is "true".
+ */
+static bool propAsBool(const ScriptNode* node, const char* name) {
+    const ScriptAttr* attr = findAttr(node, name);
+    return attr && attr->raw == "true";
+}
+
+static bool hasAlnum(const string& text) {
+    string::const_iterator it;
+    for (it = text.begin(); it != text.end(); ++it) {
+        if (isalnum(*it))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Remove all unnecessary spaces from xml.
+ * Tabs are removed, runs of spaces are reduced to their length modulo two,
+ * and a remaining space which follows a newline is removed.
+ */
+static void stripSpaces(string* text) {
+    string::iterator begin = text->begin();
+    string::iterator end = text->end();
+    string::iterator src, dst;
+    int spaces = 0;
+
+    for (src = dst = begin; src != end; ++src) {
+        if (*src == '\t')
+            continue;
+        if (*src == ' ') {
+            spaces ^= 1;
+            continue;
+        }
+        if (spaces) {
+            if (dst == begin || dst[-1] != '\n')
+                *dst++ = ' ';
+            spaces = 0;
+        }
+        *dst++ = *src;
+    }
+    if (spaces && (dst == begin || dst[-1] != '\n'))
+        *dst++ = ' ';
+    text->erase(dst, end);
+}
+
+/*
+ * Return the position of the brace which closes the one before pos.
+ */
+static size_t closingBrace(const string& text, size_t pos) {
+    int depth = 0;
+    for (; pos < text.length(); ++pos) {
+        if (text[pos] == '{')
+            ++depth;
+        else if (text[pos] == '}' && depth-- == 0)
+            return pos;
+    }
+    errorFatal("Error: no closing } found in script.");
+    return pos;
+}
+
+/**
+ * Converts an XML node (and its children if requested) into a ScriptNode.
+ */
+ScriptNode* Script::compile(xmlNodePtr xn, ScriptNode* parent, bool children) {
+    ScriptNode* node = new ScriptNode;
+    ScriptNode* child;
+    ActionMap::iterator action;
+    ScriptAttr attr;
+    xmlAttrPtr prop;
+    xmlNodePtr xc;
+    xmlChar* value;
+
+    node->name = (const char*) xn->name;
+    node->parent = parent;
+    node->text = NULL;
+    node->index = 0;
+
+    if (xmlNodeIsText(xn)) {
+        node->op = OP_TEXT;
+        node->text = new ScriptText;
+        value = xmlNodeGetContent(xn);
+        compileText(node->text, (const char*) value);
+        xmlFree(value);
+        return node;
+    }
+
+    if (xn->type == XML_COMMENT_NODE) {
+        node->op = OP_COMMENT;
+        return node;
+    }
+
+    action = action_map.find(node->name);
+    node->op = (action != action_map.end()) ? int(action->second) : OP_UNKNOWN;
+
+    if (xn->type != XML_ELEMENT_NODE)
+        return node;
+
+    for (prop = xn->properties; prop; prop = prop->next) {
+        value = xmlGetProp(xn, prop->name);
+        attr.name = (const char*) prop->name;
+        attr.raw = value ? (const char*) value : "";
+        attr.value = new ScriptText;
+        compileText(attr.value, attr.raw);
+        node->attrs.push_back(attr);
+        xmlFree(value);
+    }
+
+    if (children) {
+        for (xc = xn->children; xc; xc = xc->next) {
+            child = compile(xc, node, true);
+            child->index = node->children.size();
+            node->children.push_back(child);
+        }
+    }
+    return node;
+}
+
+/**
+ * Splits a script string into literal text and macros.  The content of
+ * each macro is compiled in turn and, if it has no macros of its own, is
+ * classified.
+ */
+void Script::compileText(ScriptText* text, const string &source) {
+    ScriptFragment frag;
+    size_t pos, open, close;
+
+    text->source = source;
+    text->blank = ! hasAlnum(source);
+    text->dynamic = false;
+    if (text->blank)
+        return;
+
+    pos = 0;
+    while ((open = source.find('{', pos)) != string::npos) {
+        close = closingBrace(source, open + 1);
+
+        frag.literal = source.substr(pos, open - pos);
+        frag.item = new ScriptText;
+        frag.end = close + 1;
+        compileText(frag.item, source.substr(open + 1, close - open - 1));
+
+        frag.itemValue.erase();
+        if (! frag.item->dynamic) {
+            if (! frag.item->blank)
+                frag.itemValue = frag.item->frags[0].literal;
+            classifyMacro(frag.itemValue, &frag.macro);
+
+            switch (frag.macro.kind) {
+            case MAC_MATH:
+            case MAC_COMPARE:
+            case MAC_TOUPPER:
+            case MAC_TOLOWER:
+            case MAC_ISEMPTY:
+                frag.macro.arg = macroValue(frag.macro, NULL);
+                frag.macro.kind = MAC_CONST;
+                break;
+            }
+        }
+
+        text->frags.push_back(frag);
+        text->dynamic = true;
+        pos = frag.end;
+    }
+
+    frag.literal = source.substr(pos);
+    frag.item = NULL;
+    frag.end = source.length();
+    if (! text->dynamic)
+        stripSpaces(&frag.literal);
+    text->frags.push_back(frag);
+}
+
+/**
+ * Determines what a macro item (the translated text inside braces) refers to.
+ */
+void Script::classifyMacro(const string &item, ScriptMacro* macro) {
+    string::size_type pos;
+
+    macro->kind = MAC_EMPTY;
+    macro->arg.erase();
+    macro->parts.clear();
+
+    // Get defined variables
+    if (item[0] == '$') {
+        macro->kind = MAC_VARIABLE;
+        macro->arg = item.substr(1);
+    }
+    // Get the current iterator for our loop
+    else if (item == "iterator")
+        macro->kind = MAC_ITERATOR;
+    else if (item.find("show_inventory:") != string::npos) {
+        macro->kind = MAC_SHOW_INVENTORY;
+        macro->arg = item.substr(item.find(':') + 1);
+    }
+    /**
+     * Make a string containing the available ids using the
+     * vendor's inventory (i.e. "bcde")
+     */
+    else if (item == "inventory_choices")
+        macro->kind = MAC_INVENTORY_CHOICES;
+    /**
+     * Ask our providers if they have a valid translation for us
+     */
+    else if ((pos = item.find_first_of(":")) != string::npos) {
+        string provider = item.substr(0, pos);
+        macro->parts = split(item.substr(pos + 1), ":");
+        // Built-in providers.
+        if (provider == "party")
+            macro->kind = MAC_PARTY;
+        else if (provider == "context")
+            macro->kind = MAC_CONTEXT;
+    }
+    /**
+     * Resolve as a property name or a function
+     */
+    else {
+        string funcName;
+
+        funcParse(item, &funcName, &macro->arg);
+
+        if (funcName.empty()) {
+            macro->kind = MAC_PROPERTY;
+            macro->arg = item;
+        }
+        else if (funcName == "math")
+            macro->kind = MAC_MATH;
+        else if (funcName == "compare")
+            macro->kind = MAC_COMPARE;
+        else if (funcName == "toupper")
+            macro->kind = MAC_TOUPPER;
+        else if (funcName == "tolower")
+            macro->kind = MAC_TOLOWER;
+        else if (funcName == "random")
+            macro->kind = MAC_RANDOM;
+        else if (funcName == "isempty")
+            macro->kind = MAC_ISEMPTY;
+    }
+}
+
+/**
+ * Returns the value of a classified macro.  Inventory macros use node
+ * as the vendor.
+ */
+string Script::macroValue(const ScriptMacro &macro, ScriptNode* node) {
+    string prop;
+
+    switch (macro.kind) {
+    case MAC_CONST:
+        prop = macro.arg;
+        break;
+
+    case MAC_VARIABLE: {
+        std::map<string, Variable*>::iterator it = variables.find(macro.arg);
+        if (it != variables.end())
+            prop = it->second->getString();
+    }
+        break;
+
+    case MAC_ITERATOR:
+        prop = xu4_to_string(this->iterator);
+        break;
+
+    case MAC_SHOW_INVENTORY: {
+        ScriptNode* itemShowScript = find(node, macro.arg);
+        ScriptNode* item;
+        size_t i;
+
+        /**
+         * Save iterator
+         */
+        int oldIterator = this->iterator;
+
+        /* start iterator at 0 */
+        this->iterator = 0;
+
+        for (i = 0; node && i < node->children.size(); ++i) {
+            item = node->children[i];
+            if (item->name == nounName && ! propAsBool(item, "hidden")) {
+                /* make sure the item's requisites are met */
+                if (!propExists(item, "req") || compare(getPropAsStr(item, "req"))) {
+                    /* put a newline after each */
+                    if (this->iterator > 0)
+                        prop += "\n";
+
+                    /* set translation context to item */
+                    translationContext.push_back(item);
+                    execute(itemShowScript, NULL, &prop);
+                    translationContext.pop_back();
+
+                    this->iterator++;
+                }
+            }
+        }
+
+        /**
+         * Restore iterator to previous value
+         */
+        this->iterator = oldIterator;
+    }
+        break;
+
+    case MAC_INVENTORY_CHOICES: {
+        ScriptNode* item;
+        size_t i;
+
+        for (i = 0; node && i < node->children.size(); ++i) {
+            item = node->children[i];
+            if (item->name == nounName) {
+                string id = getPropAsStr(item, idPropName);
+                /* make sure the item's requisites are met */
+                if (!propExists(item, "req") || compare(getPropAsStr(item, "req")))
+                    prop += id[0];
+            }
+        }
+    }
+        break;
+
+    case MAC_PARTY:
+        prop = translateParty(macro.parts);
+        break;
+
+    case MAC_CONTEXT:
+        prop = translateContext(macro.parts);
+        break;
+
+    case MAC_PROPERTY:
+        /* we have the property name, now go get the property value! */
+        prop = getPropAsStr(translationContext, macro.arg, true);
+        break;
+
+    /* perform the <math> function on the content */
+    case MAC_MATH:
+        if (macro.arg.empty())
+            errorWarning("Error: empty math() function");
+        prop = xu4_to_string(mathValue(macro.arg));
+        break;
+
+    /**
+     * Does a true/false comparison on the content.
+     * Replaced with "true" if evaluates to true, or "false" if otherwise
+     */
+    case MAC_COMPARE:
+        prop = compare(macro.arg) ? "true" : "false";
+        break;
+
+    /* make the string upper case */
+    case MAC_TOUPPER: {
+        string::iterator current;
+        prop = macro.arg;
+        for (current = prop.begin(); current != prop.end(); current++)
+            *current = toupper(*current);
+    }
+        break;
+
+    /* make the string lower case */
+    case MAC_TOLOWER: {
+        string::iterator current;
+        prop = macro.arg;
+        for (current = prop.begin(); current != prop.end(); current++)
+            *current = tolower(*current);
+    }
+        break;
+
+    /* generate a random number */
+    case MAC_RANDOM:
+        prop = xu4_to_string(xu4_random((int)strtol(macro.arg.c_str(), NULL, 10)));
+        break;
+
+    /* replaced with "true" if content is empty, or "false" if not */
+    case MAC_ISEMPTY:
+        prop = macro.arg.empty() ? "true" : "false";
+        break;
+    }
+    return prop;
+}
+
+
 /**
  * Constructs a script object
  */
-Script::Script() : vendorScriptDoc(NULL), scriptNode(NULL), debug(NULL), state(STATE_UNLOADED),
+Script::Script() : rootNode(NULL), scriptNode(NULL), debug(NULL), state(STATE_UNLOADED),
     nounName("item"), idPropName("id")
 {
     action_map["context"]           = ACTION_SET_CONTEXT;
@@ -273,15 +759,17 @@ void Script::removeCurrentVariable(const string &name) {
 /**
  * Adds an information provider for the script
  */
-void Script::addProvider(const string &name, Provider *p) {
-    providers[name] = p;
-}
 
 /**
  * Loads the vendor script
  */
 bool Script::load(const string &filename, const string &baseId, const string &subNodeName, const string &subNodeId) {
-    xmlNodePtr root, node, child;
+    xmlDocPtr doc;
+    xmlNodePtr root, node;
+    ScriptNode* base;
+    ScriptNode* child;
+    const ScriptAttr* attr;
+    size_t i;
     this->state = STATE_NORMAL;
 
     /* unload previous script */
@@ -290,8 +778,8 @@ bool Script::load(const string &filename, const string &baseId, const string &su
     /**
      * Open and parse the .xml file
      */
-    this->vendorScriptDoc = xmlParse(filename.c_str());
-    root = xmlDocGetRootElement(vendorScriptDoc);
+    doc = xmlParse(filename.c_str());
+    root = xmlDocGetRootElement(doc);
     if (xmlStrcmp(root->name, (const xmlChar *) "scripts") != 0)
         errorFatal("malformed %s", filename.c_str());
 
@@ -322,39 +810,47 @@ bool Script::load(const string &filename, const string &baseId, const string &su
     this->currentScript = NULL;
     this->currentItem = NULL;
 
+    /**
+     * Compile the scripts element and the matching script elements only
+     */
+    rootNode = compile(root, NULL, false);
+
     for (node = root->xmlChildrenNode; node; node = node->next) {
         if (xmlNodeIsText(node) || (xmlStrcmp(node->name, (const xmlChar *) "script") != 0))
             continue;
 
         if (baseId == xmlGetPropAsString(node, "id")) {
+            base = compile(node, rootNode, true);
+            base->index = rootNode->children.size();
+            rootNode->children.push_back(base);
+
             /**
              * We use the base node as our main script node
              */
             if (subNodeName.empty()) {
-                this->scriptNode = node;
-                this->translationContext.push_back(node);
+                this->scriptNode = base;
+                this->translationContext.push_back(base);
 
                 break;
             }
 
-            for (child = node->xmlChildrenNode; child; child = child->next) {
-                if (xmlNodeIsText(child) ||
-                    xmlStrcmp(child->name, (const xmlChar *) subNodeName.c_str()) != 0)
+            for (i = 0; i < base->children.size(); ++i) {
+                child = base->children[i];
+                if (child->op == OP_TEXT || child->name != subNodeName)
                     continue;
 
-                string id = xmlGetPropAsString(child, "id");
-
-                if (id == subNodeId) {
+                attr = findAttr(child, "id");
+                if (subNodeId == (attr ? attr->raw : string())) {
                     this->scriptNode = child;
                     this->translationContext.push_back(child);
 
                     /**
                      * Get a new local item name or id name
                      */
-                    if (xmlPropExists(node, "noun"))
-                        nounName = xmlGetPropAsString(node, "noun");
-                    if (xmlPropExists(node, "id_prop"))
-                        idPropName = xmlGetPropAsString(node, "id_prop");
+                    if ((attr = findAttr(base, "noun")))
+                        nounName = attr->raw;
+                    if ((attr = findAttr(base, "id_prop")))
+                        idPropName = attr->raw;
 
                     break;
                 }
@@ -365,14 +861,16 @@ bool Script::load(const string &filename, const string &baseId, const string &su
         }
     }
 
+    xmlFreeDoc(doc);
+
     if (scriptNode) {
         /**
          * Get a new local item name or id name
          */
-        if (xmlPropExists(scriptNode, "noun"))
-            nounName = xmlGetPropAsString(scriptNode, "noun");
-        if (xmlPropExists(scriptNode, "id_prop"))
-            idPropName = xmlGetPropAsString(scriptNode, "id_prop");
+        if ((attr = findAttr(scriptNode, "noun")))
+            nounName = attr->raw;
+        if ((attr = findAttr(scriptNode, "id_prop")))
+            idPropName = attr->raw;
 
         if (debug)
             fprintf(debug, "\n<Loaded subscript '%s' where id='%s' for script '%s'>\n", subNodeName.c_str(), subNodeId.c_str(), baseId.c_str());
@@ -392,10 +890,14 @@ bool Script::load(const string &filename, const string &baseId, const string &su
  * Unloads the script
  */
 void Script::unload() {
-    if (vendorScriptDoc) {
-        xmlFreeDoc(vendorScriptDoc);
-        vendorScriptDoc = NULL;
+    if (rootNode) {
+        freeNode(rootNode);
+        rootNode = NULL;
     }
+    scriptNode = NULL;
+    currentScript = NULL;
+    currentItem = NULL;
+    translationContext.clear();
 
     if (debug) {
         fclose(debug);
@@ -407,7 +909,7 @@ void Script::unload() {
  * Runs a script after it's been loaded
  */
  void Script::run(const string &script) {
-    xmlNodePtr scriptNode;
+    ScriptNode* scriptNode;
     string search_id;
 
     if (variables.find(idPropName) != variables.end()) {
@@ -427,13 +929,14 @@ void Script::unload() {
 /**
  * Executes the subscript 'script' of the main script
  */
-Script::ReturnCode Script::execute(xmlNodePtr script, xmlNodePtr currentItem, string *output) {
-    xmlNodePtr current;
+Script::ReturnCode Script::execute(ScriptNode* script, ScriptNode* currentItem, string *output) {
+    ScriptNode* current;
+    size_t i, count;
     Script::ReturnCode retval = RET_OK;
 
-    if (!script->children) {
+    if (script->children.empty()) {
         /* redirect the script to another node */
-        if (xmlPropExists(script, "redirect"))
+        if (propExists(script, "redirect"))
             retval = redirect(NULL, script);
         /* end the conversation */
         else {
@@ -446,16 +949,16 @@ Script::ReturnCode Script::execute(xmlNodePtr script, xmlNodePtr currentItem, st
 
     /* do we start where we left off, or start from the beginning? */
     if (currentItem) {
-        current = currentItem->next;
+        i = currentItem->index + 1;
         if (debug)
-            fprintf(debug, "\nReturning to execution from end of '%s' script\n", currentItem->name);
+            fprintf(debug, "\nReturning to execution from end of '%s' script\n", currentItem->name.c_str());
     }
-    else current = script->children;
+    else i = 0;
 
-    for (; current; current = current->next) {
-        string name = (char *)current->name;
+    count = script->children.size();
+    for (; i < count; ++i) {
+        current = script->children[i];
         retval = RET_OK;
-        ActionMap::iterator action;
 
         /* nothing left to do */
         if (this->state == STATE_DONE)
@@ -463,71 +966,68 @@ Script::ReturnCode Script::execute(xmlNodePtr script, xmlNodePtr currentItem, st
 
         /* begin execution of script */
 
+        switch (current->op) {
         /**
          * Handle Text
          */
-        if (xmlNodeIsText(current)) {
-            string content = getContent(current);
+        case OP_TEXT: {
+            string content;
+            translateText(*current->text, &content);
             if (output)
                 *output += content;
-            else screenMessage("%s", content.c_str());
+            else if (! content.empty())
+                screenMessage("%s", content.c_str());
 
             if (debug && content.length())
                 fprintf(debug, "\nOutput: \n====================\n%s\n====================", content.c_str());
         }
+            break;
+
         /* skip comments */
-        else if (current->type == XML_COMMENT_NODE) {}
-        else {
-            /**
-             * Search for the corresponding action and execute it!
-             */
-            action = action_map.find(name);
-            if (action != action_map.end()) {
-                /**
-                 * Found it!
-                 */
-                switch(action->second) {
-                case ACTION_SET_CONTEXT:    retval = pushContext(script, current); break;
-                case ACTION_UNSET_CONTEXT:  retval = popContext(script, current); break;
-                case ACTION_END:            retval = end(script, current); break;
-                case ACTION_REDIRECT:       retval = redirect(script, current); break;
-                case ACTION_WAIT_FOR_KEY:   retval = waitForKeypress(script, current); break;
-                case ACTION_WAIT:           retval = wait(script, current); break;
-                case ACTION_STOP:           retval = RET_STOP; break;
-                case ACTION_INCLUDE:        retval = include(script, current); break;
-                case ACTION_FOR_LOOP:       retval = forLoop(script, current); break;
-                case ACTION_RANDOM:         retval = random(script, current); break;
-                case ACTION_MOVE:           retval = move(script, current); break;
-                case ACTION_SLEEP:          retval = sleep(script, current); break;
-                case ACTION_CURSOR:         retval = cursor(script, current); break;
-                case ACTION_PAY:            retval = pay(script, current); break;
-                case ACTION_IF:             retval = _if(script, current); break;
-                case ACTION_INPUT:          retval = input(script, current); break;
-                case ACTION_ADD:            retval = add(script, current); break;
-                case ACTION_LOSE:           retval = lose(script, current); break;
-                case ACTION_HEAL:           retval = heal(script, current); break;
-                case ACTION_CAST_SPELL:     retval = castSpell(script, current); break;
-                case ACTION_DAMAGE:         retval = damage(script, current); break;
-                case ACTION_KARMA:          retval = karma(script, current); break;
-                case ACTION_MUSIC:          retval = music(script, current); break;
-                case ACTION_SET_VARIABLE:   retval = setVar(script, current); break;
-                case ACTION_ZTATS:          retval = ztats(script, current); break;
-                default:
+        case OP_COMMENT:
+            break;
 
-                    break;
-                }
-            }
-            /**
-             * Didn't find the corresponding action...
-             */
-            else if (debug)
-                 fprintf(debug, "ERROR: '%s' method not found", name.c_str());
+        /**
+         * Didn't find the corresponding action...
+         */
+        case OP_UNKNOWN:
+            if (debug)
+                 fprintf(debug, "ERROR: '%s' method not found", current->name.c_str());
+            break;
 
-            /* The script was redirected or stopped, stop now! */
-            if ((retval == RET_REDIRECTED) || (retval== RET_STOP))
-                break;
+        case ACTION_SET_CONTEXT:    retval = pushContext(script, current); break;
+        case ACTION_UNSET_CONTEXT:  retval = popContext(script, current); break;
+        case ACTION_END:            retval = end(script, current); break;
+        case ACTION_REDIRECT:       retval = redirect(script, current); break;
+        case ACTION_WAIT_FOR_KEY:   retval = waitForKeypress(script, current); break;
+        case ACTION_WAIT:           retval = wait(script, current); break;
+        case ACTION_STOP:           retval = RET_STOP; break;
+        case ACTION_INCLUDE:        retval = include(script, current); break;
+        case ACTION_FOR_LOOP:       retval = forLoop(script, current); break;
+        case ACTION_RANDOM:         retval = random(script, current); break;
+        case ACTION_MOVE:           retval = move(script, current); break;
+        case ACTION_SLEEP:          retval = sleep(script, current); break;
+        case ACTION_CURSOR:         retval = cursor(script, current); break;
+        case ACTION_PAY:            retval = pay(script, current); break;
+        case ACTION_IF:             retval = _if(script, current); break;
+        case ACTION_INPUT:          retval = input(script, current); break;
+        case ACTION_ADD:            retval = add(script, current); break;
+        case ACTION_LOSE:           retval = lose(script, current); break;
+        case ACTION_HEAL:           retval = heal(script, current); break;
+        case ACTION_CAST_SPELL:     retval = castSpell(script, current); break;
+        case ACTION_DAMAGE:         retval = damage(script, current); break;
+        case ACTION_KARMA:          retval = karma(script, current); break;
+        case ACTION_MUSIC:          retval = music(script, current); break;
+        case ACTION_SET_VARIABLE:   retval = setVar(script, current); break;
+        case ACTION_ZTATS:          retval = ztats(script, current); break;
+        default:
+            break;
         }
 
+        /* The script was redirected or stopped, stop now! */
+        if ((retval == RET_REDIRECTED) || (retval== RET_STOP))
+            break;
+
         if (debug)
             fprintf(debug, "\n");
     }
@@ -575,238 +1075,95 @@ int Script::getInputMaxLen()            { return inputMaxLen; }
  * Translates a script string with dynamic variables
  */
 void Script::translate(string *text) {
-    unsigned int pos;
-    bool nochars = true;
-    xmlNodePtr node = this->translationContext.back();
-
-    /* determine if the script is completely whitespace */
-    for (string::iterator current = text->begin(); current != text->end(); current++) {
-        if (isalnum(*current)) {
-            nochars = false;
-            break;
-        }
-    }
+    ScriptNode* node = this->translationContext.back();
 
     /* erase scripts that are composed entirely of whitespace */
-    if (nochars)
+    if (!hasAlnum(*text))
         text->erase();
 
-    while ((pos = text->find_first_of("{")) < text->length()) {
-        string pre = text->substr(0, pos);
-        string post;
-        string item = text->substr(pos+1);
+    expandMacros(text, node);
+    stripSpaces(text);
+}
 
-        /**
-         * Handle embedded items
-         */
-        int num_embedded = 0;
-        int total_pos = 0;
-        string current = item;
-        while (true) {
-            unsigned int open = current.find_first_of("{"),
-                         close = current.find_first_of("}");
-
-            if (close == current.length())
-                errorFatal("Error: no closing } found in script.");
-
-            if (open < close) {
-                num_embedded++;
-                total_pos += open + 1;
-                current = current.substr(open+1);
-            }
-            if (close < open) {
-                total_pos += close;
-                if (num_embedded == 0) {
-                    pos = total_pos;
-                    break;
-                }
-                num_embedded--;
-                total_pos += 1;
-                current = current.substr(close+1);
-            }
-        }
+/**
+ * Translates compiled script text.  The result is the same as translate()
+ * of the source string.
+ */
+void Script::translateText(const ScriptText &text, string *output) {
+    ScriptNode* node = this->translationContext.back();
+    std::vector<ScriptFragment>::const_iterator it;
+    ScriptMacro macro;
+    string item, prop;
+    const string* itemValue;
+
+    output->erase();
+    if (text.blank)
+        return;
+    if (!text.dynamic) {
+        *output = text.frags[0].literal;
+        return;
+    }
 
-        /**
-         * Separate the item itself from the pre- and post-data
-         */
-        post = item.substr(pos+1);
-        item = item.substr(0, pos);
+    for (it = text.frags.begin(); ; ++it) {
+        output->append(it->literal);
+        if (! it->item)
+            break;
 
         if (debug)
-            fprintf(debug, "\n{%s} == ", item.c_str());
-
-        /* translate any stuff contained in the item */
-        translate(&item);
-
-        string prop;
-
-        // Get defined variables
-        if (item[0] == '$') {
-            string varName = item.substr(1);
-            if (variables.find(varName) != variables.end())
-                prop = variables[varName]->getString();
+            fprintf(debug, "\n{%s} == ", it->item->source.c_str());
+
+        if (it->item->dynamic) {
+            /* translate any stuff contained in the item */
+            translateText(*it->item, &item);
+            classifyMacro(item, &macro);
+            prop = macroValue(macro, node);
+            itemValue = &item;
+        } else {
+            prop = macroValue(it->macro, node);
+            itemValue = &it->itemValue;
         }
-        // Get the current iterator for our loop
-        else if (item == "iterator")
-            prop = xu4_to_string(this->iterator);
-        else if ((pos = item.find("show_inventory:")) < item.length()) {
-            pos = item.find(":");
-            string itemScript = item.substr(pos+1);
-
-            xmlNodePtr itemShowScript = find(node, itemScript);
 
-            xmlNodePtr item;
-            prop.erase();
+        if (prop.empty() && debug)
+            fprintf(debug, "\nWarning: dynamic property '{%s}' not found in vendor script (was this intentional?)", itemValue->c_str());
 
-            /**
-             * Save iterator
-             */
-            int oldIterator = this->iterator;
-
-            /* start iterator at 0 */
-            this->iterator = 0;
-
-            for (item = node->children; item; item = item->next) {
-                if (xmlStrcmp(item->name, (const xmlChar *)nounName.c_str()) == 0) {
-                    bool hidden = (bool)xmlGetPropAsBool(item, "hidden");
-
-                    if (!hidden) {
-                        /* make sure the item's requisites are met */
-                        if (!xmlPropExists(item, "req") || compare(getPropAsStr(item, "req"))) {
-                            /* put a newline after each */
-                            if (this->iterator > 0)
-                                prop += "\n";
-
-                            /* set translation context to item */
-                            translationContext.push_back(item);
-                            execute(itemShowScript, NULL, &prop);
-                            translationContext.pop_back();
-
-                            this->iterator++;
-                        }
-                    }
-                }
-            }
+        if (debug)
+            fprintf(debug, "\"%s\"", prop.c_str());
 
-            /**
-             * Restore iterator to previous value
-             */
-            this->iterator = oldIterator;
+        if (prop.find('{') != string::npos) {
+            /* the value is translated again along with the rest */
+            prop.append(text.source, it->end, string::npos);
+            expandMacros(&prop, node);
+            output->append(prop);
+            break;
         }
+        output->append(prop);
+    }
 
-        /**
-         * Make a string containing the available ids using the
-         * vendor's inventory (i.e. "bcde")
-         */
-        else if (item == "inventory_choices") {
-            xmlNodePtr item;
-            string ids;
-
-            for (item = node->children; item; item = item->next) {
-                if (xmlStrcmp(item->name, (const xmlChar *)nounName.c_str()) == 0) {
-                    string id = getPropAsStr(item, idPropName.c_str());
-                    /* make sure the item's requisites are met */
-                    if (!xmlPropExists(item, "req") || (compare(getPropAsStr(item, "req"))))
-                        ids += id[0];
-                }
-            }
-
-            prop = ids;
-        }
+    stripSpaces(output);
+}
 
-        /**
-         * Ask our providers if they have a valid translation for us
-         */
-        else if (item.find_first_of(":") != string::npos) {
-            int pos = item.find_first_of(":");
-            string provider = item;
-            string to_find;
-
-            provider = item.substr(0, pos);
-            to_find = item.substr(pos + 1);
-            std::vector<string> parts = split(to_find, ":");
-#if 1
-            // Built-in providers.
-            if (provider == "party")
-                prop = translateParty(parts);
-            else if (provider == "context")
-                prop = translateContext(parts);
-#else
-            // External providers.
-            if (providers.find(provider) != providers.end()) {
-                Provider* p = providers[provider];
-                prop = p->translate(parts);
-            }
-#endif
-        }
+/**
+ * Replaces each {...} macro in a string with its value.
+ */
+void Script::expandMacros(string *text, ScriptNode* node) {
+    ScriptMacro macro;
+    string item, prop;
+    size_t pos, close;
 
+    while ((pos = text->find('{')) != string::npos) {
         /**
-         * Resolve as a property name or a function
+         * Separate the item itself from the pre- and post-data
          */
-        else {
-            string funcName, content;
+        close = closingBrace(*text, pos + 1);
+        item = text->substr(pos + 1, close - pos - 1);
 
-            funcParse(item, &funcName, &content);
-
-            /*
-             * Check to see if it's a property name
-             */
-            if (funcName.empty()) {
-                /* we have the property name, now go get the property value! */
-                prop = getPropAsStr(translationContext, item, true);
-            }
-
-            /**
-             * We have a function, make it work!
-             */
-            else {
-                /* perform the <math> function on the content */
-                if (funcName == "math") {
-                    if (content.empty())
-                        errorWarning("Error: empty math() function");
-
-                    prop = xu4_to_string(mathValue(content));
-                }
-
-                /**
-                 * Does a true/false comparison on the content.
-                 * Replaced with "true" if evaluates to true, or "false" if otherwise
-                 */
-                else if (funcName == "compare") {
-                    if (compare(content))
-                        prop = "true";
-                    else prop = "false";
-                }
-
-                /* make the string upper case */
-                else if (funcName == "toupper") {
-                    string::iterator current;
-                    for (current = content.begin(); current != content.end(); current++)
-                        *current = toupper(*current);
-
-                    prop = content;
-                }
-                /* make the string lower case */
-                else if (funcName == "tolower") {
-                    string::iterator current;
-                    for (current = content.begin(); current != content.end(); current++)
-                        *current = tolower(*current);
-
-                    prop = content;
-                }
-
-                /* generate a random number */
-                else if (funcName == "random")
-                    prop = xu4_to_string(xu4_random((int)strtol(content.c_str(), NULL, 10)));
+        if (debug)
+            fprintf(debug, "\n{%s} == ", item.c_str());
 
-                /* replaced with "true" if content is empty, or "false" if not */
-                else if (funcName == "isempty") {
-                    if (content.empty())
-                        prop = "true";
-                    else prop = "false";
-                }
-            }
-        }
+        /* translate any stuff contained in the item */
+        translate(&item);
+        classifyMacro(item, &macro);
+        prop = macroValue(macro, node);
 
         if (prop.empty() && debug)
             fprintf(debug, "\nWarning: dynamic property '{%s}' not found in vendor script (was this intentional?)", item.c_str());
@@ -815,37 +1172,35 @@ void Script::translate(string *text) {
             fprintf(debug, "\"%s\"", prop.c_str());
 
         /* put the script back together */
-        *text = pre + prop + post;
+        text->replace(pos, close + 1 - pos, prop);
     }
-
-    /* remove all unnecessary spaces from xml */
-    while ((pos = text->find("\t")) < text->length())
-        text->replace(pos, 1, "");
-    while ((pos = text->find("  ")) < text->length())
-        text->replace(pos, 2, "");
-    while ((pos = text->find("\n ")) < text->length())
-        text->replace(pos, 2, "\n");
 }
 
 /**
  * Finds a subscript of script 'node'
  */
- xmlNodePtr Script::find(xmlNodePtr node, const string &script_to_find, const string &id, bool _default) {
-    xmlNodePtr current;
+ScriptNode* Script::find(ScriptNode* node, const string &script_to_find, const string &id, bool _default) {
+    ScriptNode* current;
+    const ScriptAttr* attr;
+    size_t i;
+
     if (node) {
-        for (current = node->children; current; current = current->next) {
-            if (!xmlNodeIsText(current) && (script_to_find == (char *)current->name)) {
-                if (id.empty() && !xmlPropExists(current, idPropName.c_str()) && !_default)
+        for (i = 0; i < node->children.size(); ++i) {
+            current = node->children[i];
+            if (current->op != OP_TEXT && script_to_find == current->name) {
+                attr = findAttr(current, idPropName.c_str());
+                if (id.empty() && !attr && !_default)
                     return current;
-                else if (xmlPropExists(current, idPropName.c_str()) && (id == xmlGetPropAsString(current, idPropName.c_str())))
+                else if (attr && (id == attr->raw))
                     return current;
-                else if (_default && xmlPropExists(current, "default") && xmlGetPropAsBool(current, "default"))
+                else if (_default && propAsBool(current, "default"))
                     return current;
             }
         }
 
         /* only search the parent nodes if we haven't hit the base <script> node */
-        if (xmlStrcmp(node->name, (const xmlChar *)"script") != 0)
+        current = NULL;
+        if (node->name != "script")
             current = find(node->parent, script_to_find, id);
 
         /* find the default script instead */
@@ -860,68 +1215,53 @@ void Script::translate(string *text) {
  * Gets a property as string from the script, and
  * translates it using scriptTranslate.
  */
-string Script::getPropAsStr(std::list<xmlNodePtr>& nodes, const string &prop, bool recursive) {
+string Script::getPropAsStr(ScriptNode* const* nodes, size_t count, const string &prop, bool recursive) {
     string propvalue;
-    std::list<xmlNodePtr>::reverse_iterator i;
+    const ScriptAttr* attr = NULL;
+    size_t i;
 
-    for (i = nodes.rbegin(); i != nodes.rend(); i++) {
-        xmlNodePtr node = *i;
-        if (xmlPropExists(node, prop.c_str())) {
-            propvalue = xmlGetPropAsString(node, prop.c_str());
+    for (i = count; i-- > 0; ) {
+        if (nodes[i] && (attr = findAttr(nodes[i], prop.c_str())))
             break;
-        }
     }
 
-    if (propvalue.empty() && recursive) {
-        for (i = nodes.rbegin(); i != nodes.rend(); i++) {
-            xmlNodePtr node = *i;
-            if (node->parent) {
-                propvalue = getPropAsStr(node->parent, prop, recursive);
+    if (attr && !attr->raw.empty())
+        translateText(*attr->value, &propvalue);
+    else if (recursive) {
+        for (i = count; i-- > 0; ) {
+            if (nodes[i] && nodes[i]->parent) {
+                propvalue = getPropAsStr(nodes[i]->parent, prop, recursive);
+                translate(&propvalue);
                 break;
             }
         }
     }
-
-    translate(&propvalue);
     return propvalue;
 }
-string Script::getPropAsStr(xmlNodePtr node, const string &prop, bool recursive) {
-    std::list<xmlNodePtr> list;
-    list.push_back(node);
-    return getPropAsStr(list, prop, recursive);
+string Script::getPropAsStr(std::vector<ScriptNode*>& nodes, const string &prop, bool recursive) {
+    return getPropAsStr(nodes.empty() ? NULL : &nodes[0], nodes.size(), prop, recursive);
+}
+string Script::getPropAsStr(ScriptNode* node, const string &prop, bool recursive) {
+    return getPropAsStr(&node, 1, prop, recursive);
 }
 
 /**
  * Gets a property as int from the script
  */
-int Script::getPropAsInt(std::list<xmlNodePtr>& nodes, const string &prop, bool recursive) {
-    string propvalue = getPropAsStr(nodes, prop, recursive);
-    return mathValue(propvalue);
-}
-int Script::getPropAsInt(xmlNodePtr node, const string &prop, bool recursive) {
+int Script::getPropAsInt(ScriptNode* node, const string &prop, bool recursive) {
     string propvalue = getPropAsStr(node, prop, recursive);
     return mathValue(propvalue);
 }
 
-/**
- * Gets the content of a script node
- */
-string Script::getContent(xmlNodePtr node) {
-    xmlChar *nodeContent = xmlNodeGetContent(node);
-    string content = reinterpret_cast<char *>(nodeContent);
-    xmlFree(nodeContent);
-    translate(&content);
-    return content;
-}
 
 /**
  * Sets a new translation context for the script
  */
-Script::ReturnCode Script::pushContext(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::pushContext(ScriptNode* script, ScriptNode* current) {
     string nodeName = getPropAsStr(current, "name");
     string search_id;
 
-    if (xmlPropExists(current, idPropName.c_str()))
+    if (propExists(current, idPropName.c_str()))
         search_id = getPropAsStr(current, idPropName);
     else if (variables.find(idPropName) != variables.end()) {
         if (variables[idPropName]->isSet())
@@ -943,11 +1283,13 @@ Script::ReturnCode Script::pushContext(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Removes a node from the translation context
  */
-Script::ReturnCode Script::popContext(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::popContext(ScriptNode* script, ScriptNode* current) {
     if (translationContext.size() > 1) {
         translationContext.pop_back();
-        if (debug)
-            fprintf(debug, "\nReverted translation context to <%s ...>", translationContext.back()->name);
+        if (debug) {
+            ScriptNode* node = translationContext.back();
+            fprintf(debug, "\nReverted translation context to <%s ...>", node ? node->name.c_str() : "");
+        }
     }
     return RET_OK;
 }
@@ -955,11 +1297,11 @@ Script::ReturnCode Script::popContext(xmlNodePtr script, xmlNodePtr current) {
 /**
  * End script execution
  */
-Script::ReturnCode Script::end(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::end(ScriptNode* script, ScriptNode* current) {
     /**
      * See if there's a global 'end' node declared for cleanup
      */
-    xmlNodePtr endScript = find(scriptNode, "end");
+    ScriptNode* endScript = find(scriptNode, "end");
     if (endScript)
         execute(endScript);
 
@@ -974,7 +1316,7 @@ Script::ReturnCode Script::end(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Wait for keypress from the user
  */
-Script::ReturnCode Script::waitForKeypress(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::waitForKeypress(ScriptNode* script, ScriptNode* current) {
     this->currentScript = script;
     this->currentItem = current;
     this->choices = "abcdefghijklmnopqrstuvwxyz01234567890\015 \033";
@@ -991,17 +1333,17 @@ Script::ReturnCode Script::waitForKeypress(xmlNodePtr script, xmlNodePtr current
 /**
  * Redirects script execution to another script
  */
-Script::ReturnCode Script::redirect(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::redirect(ScriptNode* script, ScriptNode* current) {
     string target;
 
-    if (xmlPropExists(current, "redirect"))
+    if (propExists(current, "redirect"))
         target = getPropAsStr(current, "redirect");
     else target = getPropAsStr(current, "target");
 
     /* set a new search id */
     string search_id = getPropAsStr(current, idPropName);
 
-    xmlNodePtr newScript = find(this->scriptNode, target, search_id);
+    ScriptNode* newScript = find(this->scriptNode, target, search_id);
     if (!newScript)
         errorFatal("Error: redirect failed -- could not find target script '%s' with %s=\"%s\"", target.c_str(), idPropName.c_str(), search_id.c_str());
 
@@ -1019,11 +1361,11 @@ Script::ReturnCode Script::redirect(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Includes a script to be executed
  */
-Script::ReturnCode Script::include(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::include(ScriptNode* script, ScriptNode* current) {
     string scriptName = getPropAsStr(current, "script");
     string id = getPropAsStr(current, idPropName);
 
-    xmlNodePtr newScript = find(this->scriptNode, scriptName, id);
+    ScriptNode* newScript = find(this->scriptNode, scriptName, id);
     if (!newScript)
         errorFatal("Error: include failed -- could not find target script '%s' with %s=\"%s\"", scriptName.c_str(), idPropName.c_str(), id.c_str());
 
@@ -1041,7 +1383,7 @@ Script::ReturnCode Script::include(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Waits a given number of milliseconds before continuing execution
  */
-Script::ReturnCode Script::wait(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::wait(ScriptNode* script, ScriptNode* current) {
     int msecs = getPropAsInt(current, "msecs");
     EventHandler::wait_msecs(msecs);
     return RET_OK;
@@ -1050,7 +1392,7 @@ Script::ReturnCode Script::wait(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Executes a 'for' loop script
  */
-Script::ReturnCode Script::forLoop(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::forLoop(ScriptNode* script, ScriptNode* current) {
     Script::ReturnCode retval = RET_OK;
     int start = getPropAsInt(current, "start"),
         end = getPropAsInt(current, "end"),
@@ -1082,7 +1424,7 @@ Script::ReturnCode Script::forLoop(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Randomely executes script code
  */
-Script::ReturnCode Script::random(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::random(ScriptNode* script, ScriptNode* current) {
     int perc = getPropAsInt(current, "chance");
     int num = xu4_random(100);
     Script::ReturnCode retval = RET_OK;
@@ -1099,12 +1441,12 @@ Script::ReturnCode Script::random(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Moves the player's current position
  */
-Script::ReturnCode Script::move(xmlNodePtr script, xmlNodePtr current) {
-    if (xmlPropExists(current, "x"))
+Script::ReturnCode Script::move(ScriptNode* script, ScriptNode* current) {
+    if (propExists(current, "x"))
         c->location->coords.x = getPropAsInt(current, "x");
-    if (xmlPropExists(current, "y"))
+    if (propExists(current, "y"))
         c->location->coords.y = getPropAsInt(current, "y");
-    if (xmlPropExists(current, "z"))
+    if (propExists(current, "z"))
         c->location->coords.z = getPropAsInt(current, "z");
 
     if (debug)
@@ -1117,7 +1459,7 @@ Script::ReturnCode Script::move(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Puts the player to sleep. Useful when coding inn scripts
  */
-Script::ReturnCode Script::sleep(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::sleep(ScriptNode* script, ScriptNode* current) {
     if (debug)
         fprintf(debug, "\nSleep!\n");
 
@@ -1130,8 +1472,8 @@ Script::ReturnCode Script::sleep(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Enables/Disables the keyboard cursor
  */
-Script::ReturnCode Script::cursor(xmlNodePtr script, xmlNodePtr current) {
-    bool enable = (bool)xmlGetPropAsBool(current, "enable");
+Script::ReturnCode Script::cursor(ScriptNode* script, ScriptNode* current) {
+    bool enable = propAsBool(current, "enable");
     if (enable)
         screenEnableCursor();
     else screenDisableCursor();
@@ -1142,7 +1484,7 @@ Script::ReturnCode Script::cursor(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Pay gold to someone
  */
-Script::ReturnCode Script::pay(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::pay(ScriptNode* script, ScriptNode* current) {
     int price = getPropAsInt(current, "price");
     int quant = getPropAsInt(current, "quantity");
 
@@ -1175,7 +1517,7 @@ Script::ReturnCode Script::pay(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Perform a limited 'if' statement
  */
-Script::ReturnCode Script::_if(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::_if(ScriptNode* script, ScriptNode* current) {
     string test = getPropAsStr(current, "test");
     Script::ReturnCode retval = RET_OK;
 
@@ -1184,7 +1526,7 @@ Script::ReturnCode Script::_if(xmlNodePtr script, xmlNodePtr current) {
 
     if (compare(test)) {
         if (debug)
-            fprintf(debug, "True - Executing '%s'", current->name);
+            fprintf(debug, "True - Executing '%s'", current->name.c_str());
 
         retval = execute(current);
     }
@@ -1197,13 +1539,13 @@ Script::ReturnCode Script::_if(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Get input from the player
  */
-Script::ReturnCode Script::input(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::input(ScriptNode* script, ScriptNode* current) {
     string type = getPropAsStr(current, "type");
 
     this->currentScript = script;
     this->currentItem = current;
 
-    if (xmlPropExists(current, "target"))
+    if (propExists(current, "target"))
         this->target = getPropAsStr(current, "target");
     else this->target.erase();
 
@@ -1211,12 +1553,12 @@ Script::ReturnCode Script::input(xmlNodePtr script, xmlNodePtr current) {
     this->inputName = "input";
 
     // Does the variable have a maximum length?
-    if (xmlPropExists(current, "maxlen"))
+    if (propExists(current, "maxlen"))
         this->inputMaxLen = getPropAsInt(current, "maxlen");
     else this->inputMaxLen = Conversation::BUFFERLEN;
 
     // Should we name the variable something other than "input"
-    if (xmlPropExists(current, "name"))
+    if (propExists(current, "name"))
         this->inputName = getPropAsStr(current, "name");
     else {
         if (type == "choice")
@@ -1249,7 +1591,7 @@ Script::ReturnCode Script::input(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Add item to inventory
  */
-Script::ReturnCode Script::add(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::add(ScriptNode* script, ScriptNode* current) {
     string type = getPropAsStr(current, "type");
     string subtype = getPropAsStr(current, "subtype");
     int quant = getPropAsInt(this->translationContext.back(), "quantity");
@@ -1324,7 +1666,7 @@ Script::ReturnCode Script::add(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Lose item
  */
-Script::ReturnCode Script::lose(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::lose(ScriptNode* script, ScriptNode* current) {
     string type = getPropAsStr(current, "type");
     string subtype = getPropAsStr(current, "subtype");
     int quant = getPropAsInt(current, "quantity");
@@ -1347,7 +1689,7 @@ Script::ReturnCode Script::lose(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Heals a party member
  */
-Script::ReturnCode Script::heal(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::heal(ScriptNode* script, ScriptNode* current) {
     string type = getPropAsStr(current, "type");
     PartyMember *p = c->party->member(getPropAsInt(current, "player")-1);
 
@@ -1366,7 +1708,7 @@ Script::ReturnCode Script::heal(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Performs all of the visual/audio effects of casting a spell
  */
-Script::ReturnCode Script::castSpell(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::castSpell(ScriptNode* script, ScriptNode* current) {
     extern SpellEffectCallback spellEffectCallback;
     (*spellEffectCallback)('r', -1, SOUND_MAGIC);
     if (debug)
@@ -1378,7 +1720,7 @@ Script::ReturnCode Script::castSpell(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Apply damage to a player
  */
-Script::ReturnCode Script::damage(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::damage(ScriptNode* script, ScriptNode* current) {
     int player = getPropAsInt(current, "player") - 1;
     int pts = getPropAsInt(current, "pts");
     PartyMember *p;
@@ -1395,7 +1737,7 @@ Script::ReturnCode Script::damage(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Apply karma changes based on the action taken
  */
-Script::ReturnCode Script::karma(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::karma(ScriptNode* script, ScriptNode* current) {
     string action = getPropAsStr(current, "action");
 
     if (debug)
@@ -1440,15 +1782,15 @@ Script::ReturnCode Script::karma(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Set the currently playing music
  */
-Script::ReturnCode Script::music(xmlNodePtr script, xmlNodePtr current) {
-    if (xmlGetPropAsBool(current, "reset"))
+Script::ReturnCode Script::music(ScriptNode* script, ScriptNode* current) {
+    if (propAsBool(current, "reset"))
         musicPlayLocale();
     else {
         string type = getPropAsStr(current, "type");
 
-        if (xmlGetPropAsBool(current, "play"))
+        if (propAsBool(current, "play"))
             musicPlayLocale();
-        if (xmlGetPropAsBool(current, "stop"))
+        if (propAsBool(current, "stop"))
             musicStop();
         else if (type == "shopping")
             musicPlay(MUSIC_SHOPPING);
@@ -1462,7 +1804,7 @@ Script::ReturnCode Script::music(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Sets a variable
  */
-Script::ReturnCode Script::setVar(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::setVar(ScriptNode* script, ScriptNode* current) {
     string name = getPropAsStr(current, "name");
     string value = getPropAsStr(current, "value");
 
@@ -1484,7 +1826,7 @@ Script::ReturnCode Script::setVar(xmlNodePtr script, xmlNodePtr current) {
 /**
  * Display a different ztats screen
  */
-Script::ReturnCode Script::ztats(xmlNodePtr script, xmlNodePtr current) {
+Script::ReturnCode Script::ztats(ScriptNode* script, ScriptNode* current) {
     typedef std::map<string, StatsView, std::less<string> > StatsViewMap;
     static StatsViewMap view_map;
 
@@ -1506,7 +1848,7 @@ Script::ReturnCode Script::ztats(xmlNodePtr script, xmlNodePtr current) {
         view_map["mixtures"]    = STATS_MIXTURES;
     }
 
-    if (xmlPropExists(current, "screen")) {
+    if (propExists(current, "screen")) {
         string screen = getPropAsStr(current, "screen");
         StatsViewMap::iterator view;
 
@@ -1527,28 +1869,6 @@ Script::ReturnCode Script::ztats(xmlNodePtr script, xmlNodePtr current) {
     return RET_OK;
 }
 
-/**
- * Parses a math string's children into results so
- * there is only 1 equation remaining.
- *
- * ie. <math>5*<math>6/3</math></math>
- */
-void Script::mathParseChildren(xmlNodePtr math, string *result) {
-    xmlNodePtr current;
-    result->erase();
-
-    for (current = math->children; current; current = current->next) {
-        if (xmlNodeIsText(current)) {
-            *result = getContent(current);
-        }
-        else if (xmlStrcmp(current->name, (const xmlChar *)"math") == 0) {
-            string children_results;
-
-            mathParseChildren(current, &children_results);
-            *result = xu4_to_string(mathValue(children_results));
-        }
-    }
-}
 
 /**
  * Parses a string into left integer value, right integer value,
@@ -1728,6 +2048,7 @@ void Script::funcParse(const string & str, string *funcName, string *contents) {
     else funcName->erase();
 }
 
+
 void Script::talkToVendor(const string& goods) {
     // unload the previous script if it wasn't already unloaded
     if (getState() != Script::STATE_UNLOADED)
@@ -5,7 +5,6 @@
 #ifndef SCRIPT_H
 #define SCRIPT_H
 
-#include <list>
 #include <map>
 #include <string>
 #include <vector>
@@ -15,6 +14,10 @@
 
 using std::string;
 
+struct ScriptNode;
+struct ScriptText;
+struct ScriptMacro;
+
 /**
  * An xml-scripting class. It loads and runs xml scripts that
  * take information and interact with the game environment itself.
@@ -142,7 +145,7 @@ public:
     bool load(const string &filename, const string &baseId, const string &subNodeName = "", const string &subNodeId = "");
     void unload();
     void run(const string &script);
-    ReturnCode execute(xmlNodePtr script, xmlNodePtr currentItem = NULL, string *output = NULL);
+    ReturnCode execute(ScriptNode* script, ScriptNode* currentItem = NULL, string *output = NULL);
     void _continue();
 
     void resetState();
@@ -162,47 +165,51 @@ public:
     int getInputMaxLen();
 
 private:
+    ScriptNode* compile(xmlNodePtr node, ScriptNode* parent, bool children);
+    void        compileText(ScriptText* text, const string &source);
+    void        classifyMacro(const string &item, ScriptMacro* macro);
+    string      macroValue(const ScriptMacro &macro, ScriptNode* node);
     void        translate(string *script);
-    xmlNodePtr  find(xmlNodePtr node, const string &script, const string &choice = "", bool _default = false);
-    string      getPropAsStr(std::list<xmlNodePtr>& nodes, const string &prop, bool recursive);
-    string      getPropAsStr(xmlNodePtr node, const string &prop, bool recursive = false);
-    int         getPropAsInt(std::list<xmlNodePtr>& nodes, const string &prop, bool recursive);
-    int         getPropAsInt(xmlNodePtr node, const string &prop, bool recursive = false);
-    string      getContent(xmlNodePtr node);
+    void        translateText(const ScriptText &text, string *output);
+    void        expandMacros(string *text, ScriptNode* node);
+    ScriptNode* find(ScriptNode* node, const string &script, const string &choice = "", bool _default = false);
+    string      getPropAsStr(ScriptNode* const* nodes, size_t count, const string &prop, bool recursive);
+    string      getPropAsStr(std::vector<ScriptNode*>& nodes, const string &prop, bool recursive);
+    string      getPropAsStr(ScriptNode* node, const string &prop, bool recursive = false);
+    int         getPropAsInt(ScriptNode* node, const string &prop, bool recursive = false);
 
     /*
      * Action Functions
      */
-    ReturnCode pushContext(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode popContext(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode end(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode waitForKeypress(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode redirect(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode include(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode wait(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode forLoop(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode random(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode move(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode sleep(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode cursor(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode pay(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode _if(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode input(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode add(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode lose(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode heal(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode castSpell(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode damage(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode karma(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode music(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode setVar(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode setId(xmlNodePtr script, xmlNodePtr current);
-    ReturnCode ztats(xmlNodePtr script, xmlNodePtr current);
+    ReturnCode pushContext(ScriptNode* script, ScriptNode* current);
+    ReturnCode popContext(ScriptNode* script, ScriptNode* current);
+    ReturnCode end(ScriptNode* script, ScriptNode* current);
+    ReturnCode waitForKeypress(ScriptNode* script, ScriptNode* current);
+    ReturnCode redirect(ScriptNode* script, ScriptNode* current);
+    ReturnCode include(ScriptNode* script, ScriptNode* current);
+    ReturnCode wait(ScriptNode* script, ScriptNode* current);
+    ReturnCode forLoop(ScriptNode* script, ScriptNode* current);
+    ReturnCode random(ScriptNode* script, ScriptNode* current);
+    ReturnCode move(ScriptNode* script, ScriptNode* current);
+    ReturnCode sleep(ScriptNode* script, ScriptNode* current);
+    ReturnCode cursor(ScriptNode* script, ScriptNode* current);
+    ReturnCode pay(ScriptNode* script, ScriptNode* current);
+    ReturnCode _if(ScriptNode* script, ScriptNode* current);
+    ReturnCode input(ScriptNode* script, ScriptNode* current);
+    ReturnCode add(ScriptNode* script, ScriptNode* current);
+    ReturnCode lose(ScriptNode* script, ScriptNode* current);
+    ReturnCode heal(ScriptNode* script, ScriptNode* current);
+    ReturnCode castSpell(ScriptNode* script, ScriptNode* current);
+    ReturnCode damage(ScriptNode* script, ScriptNode* current);
+    ReturnCode karma(ScriptNode* script, ScriptNode* current);
+    ReturnCode music(ScriptNode* script, ScriptNode* current);
+    ReturnCode setVar(ScriptNode* script, ScriptNode* current);
+    ReturnCode setId(ScriptNode* script, ScriptNode* current);
+    ReturnCode ztats(ScriptNode* script, ScriptNode* current);
 
     /*
      * Math and comparison functions
      */
-    void mathParseChildren(xmlNodePtr math, string *result);
     int mathValue(const string &str);
     int math(int lval, int rval, string &op);
     bool mathParse(const string &str, int *lval, int *rval, string *op);
@@ -219,14 +226,14 @@ private:
 
 private:
     void removeCurrentVariable(const string &name);
-    xmlDocPtr vendorScriptDoc;
-    xmlNodePtr scriptNode;
+    ScriptNode* rootNode;           /**< The compiled scripts element */
+    ScriptNode* scriptNode;
     FILE *debug;
 
     State state;                    /**< The state the script is in */
-    xmlNodePtr currentScript;       /**< The currently running script */
-    xmlNodePtr currentItem;         /**< The current position in the script */
-    std::list<xmlNodePtr> translationContext;  /**< A list of nodes that make up our translation context */
+    ScriptNode* currentScript;      /**< The currently running script */
+    ScriptNode* currentItem;        /**< The current position in the script */
+    std::vector<ScriptNode*> translationContext;  /**< A list of nodes that make up our translation context */
     string target;                  /**< The name of a target script */
     InputType inputType;            /**< The type of input required */
     string inputName;               /**< The variable in which to place the input (by default, "input") */
@@ -188,6 +188,11 @@ bool Settings::read() {
     shakeInterval         = DEFAULT_SHAKE_INTERVAL;
     titleSpeedRandom      = DEFAULT_TITLE_SPEED_RANDOM;
     titleSpeedOther       = DEFAULT_TITLE_SPEED_OTHER;
+    prefetchBudget        = DEFAULT_PREFETCH_BUDGET;
+    imageBudget           = DEFAULT_IMAGE_BUDGET;
+    mapChunkCache         = DEFAULT_MAP_CHUNK_CACHE;
+    viewportW             = DEFAULT_VIEWPORT_W;
+    viewportH             = DEFAULT_VIEWPORT_H;
 
 #if 0
     pauseForEachMovement  = DEFAULT_PAUSE_FOR_EACH_MOVEMENT;
@@ -287,6 +292,16 @@ bool Settings::read() {
             titleSpeedRandom = (int) strtoul(buffer + strlen("titleSpeedRandom="), NULL, 0);
         else if (strstr(buffer, "titleSpeedOther=") == buffer)
             titleSpeedOther = (int) strtoul(buffer + strlen("titleSpeedOther="), NULL, 0);
+        else if (strstr(buffer, "prefetchBudget=") == buffer)
+            prefetchBudget = (int) strtoul(buffer + strlen("prefetchBudget="), NULL, 0);
+        else if (strstr(buffer, "imageBudget=") == buffer)
+            imageBudget = (int) strtoul(buffer + strlen("imageBudget="), NULL, 0);
+        else if (strstr(buffer, "mapChunkCache=") == buffer)
+            mapChunkCache = (int) strtoul(buffer + strlen("mapChunkCache="), NULL, 0);
+        else if (strstr(buffer, "viewportW=") == buffer)
+            viewportW = (int) strtoul(buffer + strlen("viewportW="), NULL, 0);
+        else if (strstr(buffer, "viewportH=") == buffer)
+            viewportH = (int) strtoul(buffer + strlen("viewportH="), NULL, 0);
 
         /* minor enhancement options */
         else if (strstr(buffer, "activePlayer=") == buffer)
@@ -399,7 +414,12 @@ bool Settings::write() {
             "shrineTime=%d\n"
             "shakeInterval=%d\n"
             "titleSpeedRandom=%d\n"
-            "titleSpeedOther=%d\n",
+            "titleSpeedOther=%d\n"
+            "prefetchBudget=%d\n"
+            "imageBudget=%d\n"
+            "mapChunkCache=%d\n"
+            "viewportW=%d\n"
+            "viewportH=%d\n",
             scale,
             fullscreen,
             screenGetFilterNames()[ filter ],
@@ -426,7 +446,12 @@ bool Settings::write() {
             shrineTime,
             shakeInterval,
             titleSpeedRandom,
-            titleSpeedOther);
+            titleSpeedOther,
+            prefetchBudget,
+            imageBudget,
+            mapChunkCache,
+            viewportW,
+            viewportH);
 
 #ifndef USE_BORON
     fprintf(settingsFile, "validateXml=%d\n", validateXml);
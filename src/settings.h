@@ -73,6 +73,11 @@
 #define DEFAULT_LOGGING                 ""
 #define DEFAULT_TITLE_SPEED_RANDOM      150
 #define DEFAULT_TITLE_SPEED_OTHER       30
+#define DEFAULT_PREFETCH_BUDGET         256
+#define DEFAULT_IMAGE_BUDGET            0
+#define DEFAULT_MAP_CHUNK_CACHE         8
+#define DEFAULT_VIEWPORT_W              11
+#define DEFAULT_VIEWPORT_H              11
 
 #define DEFAULT_PAUSE_FOR_EACH_TURN     100
 #define DEFAULT_PAUSE_FOR_EACH_MOVEMENT 10
@@ -143,6 +148,11 @@ public:
     bool                volumeFades;
     int                 titleSpeedRandom;
     int                 titleSpeedOther;
+    int                 prefetchBudget; // Kilobytes of map files.
+    int                 imageBudget;    // Kilobytes of images (0 = no limit).
+    int                 mapChunkCache;  // GPU map chunk buffers (4-16).
+    int                 viewportW;      // Map view tiles (odd, GPU only).
+    int                 viewportH;
     uint8_t             battleDiff;     // Used by Creature
     uint8_t             filter;         // Defined by screen
     uint8_t             lineOfSight;    // Defined by screen
@@ -9,6 +9,7 @@
 
 #include <allegro5/allegro_audio.h>
 #include <allegro5/allegro_acodec.h>
+#include <allegro5/allegro_memfile.h>
 
 #include "sound.h"
 
@@ -78,10 +79,6 @@ static ALLEGRO_SAMPLE_ID fxControl[FX_CONTROL_SLOTS];
 static uint32_t fxDuration[FX_CONTROL_SLOTS];
 static std::vector<ALLEGRO_SAMPLE *> sa_samples;
 
-#ifdef CONF_MODULE
-static ALLEGRO_FILE* moduleFile = NULL;
-#endif
-
 /*
  * Initialize sound & music service.
  */
@@ -149,12 +146,6 @@ void soundDelete(void)
         al_destroy_audio_stream(musicStream);
         musicStream = NULL;
     }
-#ifdef CONF_MODULE
-    if (moduleFile) {
-        al_fclose(moduleFile);
-        moduleFile = NULL;
-    }
-#endif
     if (fxMixer) {
         al_destroy_mixer(fxMixer);
         fxMixer = NULL;
@@ -188,6 +179,17 @@ static const char* audioExt(const CDIEntry* entry) {
     }
     return NULL;
 }
+
+/*
+ * Open a module entry as an ALLEGRO_FILE which reads directly from the
+ * mapped module.
+ */
+static ALLEGRO_FILE* moduleMemfile(const CDIEntry* ent) {
+    const uint8_t* data = xu4.config->moduleData(ent);
+    if (! data)
+        return NULL;
+    return al_open_memfile((void*) data, ent->bytes, "r");
+}
 #endif
 
 static bool sound_load(Sound sound) {
@@ -195,13 +197,9 @@ static bool sound_load(Sound sound) {
 #ifdef CONF_MODULE
         const CDIEntry* ent = config_soundFile(sound);
         if (ent) {
-            ALLEGRO_FILE* slice;
-            ALLEGRO_FILE* af = al_fopen(xu4.config->modulePath(), "rb");
+            ALLEGRO_FILE* af = moduleMemfile(ent);
             if (af) {
-                al_fseek(af, ent->offset, ALLEGRO_SEEK_SET);
-                slice = al_fopen_slice(af, ent->bytes, "r");
-                sa_samples[sound] = al_load_sample_f(slice, audioExt(ent));
-                al_fclose(slice);   // Does unwanted seek to slice end.
+                sa_samples[sound] = al_load_sample_f(af, audioExt(ent));
                 al_fclose(af);
             }
         }
@@ -300,17 +298,12 @@ static bool music_load(int music, float newGain) {
 #ifdef CONF_MODULE
     const CDIEntry* ent = config_musicFile(music);
     if (ent) {
-        if (! moduleFile)
-            moduleFile = al_fopen(xu4.config->modulePath(), "rb");
-
-        if (moduleFile) {
-            ALLEGRO_FILE* slice;
-            al_fseek(moduleFile, ent->offset, ALLEGRO_SEEK_SET);
-            slice = al_fopen_slice(moduleFile, ent->bytes, "r");
-            musicStream = al_load_audio_stream_f(slice, audioExt(ent), 4, 2048);
-
+        ALLEGRO_FILE* af = moduleMemfile(ent);
+        if (af) {
             // NOTE: Stream takes ownership of ALLEGRO_FILE.
-            // Since we pass a slice, we must still close moduleFile ourselves.
+            musicStream = al_load_audio_stream_f(af, audioExt(ent), 4, 2048);
+            if (! musicStream)
+                al_fclose(af);
         }
     }
 #else
@@ -0,0 +1,71 @@
+/*
+ * sound_headless.cpp
+ *
+ * Null audio backend.  Only the volume settings are maintained.
+ */
+
+#include "sound.h"
+#include "settings.h"
+#include "xu4.h"
+
+int soundInit(void) {
+    return 1;
+}
+
+void soundDelete(void) {
+}
+
+void soundPlay(Sound sound, bool onlyOnce, int specificDurationInTicks) {
+}
+
+void soundStop() {
+}
+
+void musicPlay(int track) {
+}
+
+void musicPlayLocale() {
+}
+
+void musicStop() {
+}
+
+void musicFadeOut(int msec) {
+}
+
+void musicFadeIn(int msec, bool loadFromMap) {
+}
+
+void musicSetVolume(int volume) {
+}
+
+int musicVolumeDec() {
+    if (xu4.settings->musicVol > 0)
+        --xu4.settings->musicVol;
+    return (xu4.settings->musicVol * 100 / MAX_VOLUME);  // percentage
+}
+
+int musicVolumeInc() {
+    if (xu4.settings->musicVol < MAX_VOLUME)
+        ++xu4.settings->musicVol;
+    return (xu4.settings->musicVol * 100 / MAX_VOLUME);  // percentage
+}
+
+bool musicToggle() {
+    return false;
+}
+
+void soundSetVolume(int volume) {
+}
+
+int soundVolumeDec() {
+    if (xu4.settings->soundVol > 0)
+        --xu4.settings->soundVol;
+    return (xu4.settings->soundVol * 100 / MAX_VOLUME);  // percentage
+}
+
+int soundVolumeInc() {
+    if (xu4.settings->soundVol < MAX_VOLUME)
+        ++xu4.settings->soundVol;
+    return (xu4.settings->soundVol * 100 / MAX_VOLUME);  // percentage
+}
@@ -26,6 +26,7 @@ static bool audioFunctional = false;
 static bool musicEnabled = false;
 static int currentTrack;
 static struct _Mix_Music* playing = NULL;
+static TimerId musicCheckTimer = 0;
 static std::vector<Mix_Chunk *> soundChunk;
 
 /*
@@ -79,7 +80,7 @@ int soundInit(void)
  * if it is supposed to be turned off.
  */
 static void music_callback(void *data) {
-    xu4.eventHandler->getTimer()->remove(&music_callback);
+    musicCheckTimer = 0;
 
     bool mplaying = Mix_PlayingMusic();
     if (musicEnabled) {
@@ -97,7 +98,7 @@ void soundDelete(void)
         return;
 
     //TRACE(*logger, "Uninitializing sound");
-    xu4.eventHandler->getTimer()->remove(&music_callback);
+    xu4.eventHandler->getTimer()->remove(musicCheckTimer);
 
     if (playing) {
         Mix_FreeMusic(playing);
@@ -274,7 +275,7 @@ bool musicToggle()
     if (! audioFunctional)
         return false;
 
-    xu4.eventHandler->getTimer()->remove(&music_callback);
+    xu4.eventHandler->getTimer()->remove(musicCheckTimer);
 
     musicEnabled = !musicEnabled;
     if (musicEnabled)
@@ -282,7 +283,9 @@ bool musicToggle()
     else
         musicFadeOut(1000);
 
-    xu4.eventHandler->getTimer()->add(&music_callback, xu4.settings->gameCyclesPerSecond);
+    musicCheckTimer = xu4.eventHandler->getTimer()->schedule(&music_callback,
+            NULL, xu4.settings->gameCyclesPerSecond << TIMER_FRAC_BITS,
+            TimedEvent::ONCE);
     return musicEnabled;
 }
 
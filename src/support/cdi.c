@@ -4,6 +4,7 @@
 
 #include <stdlib.h>
 #include "cdi.h"
+#include "fileMap.h"
 
 #if defined(__APPLE__)
 #include <libkern/OSByteOrder.h>
@@ -169,3 +170,124 @@ const CDIEntry* cdi_findFormat(const CDIEntry* toc, size_t count, uint32_t cdi)
     }
     return NULL;
 }
+
+/*
+  Read an entire file into a malloc'd buffer.
+  This is used when the file cannot be mapped.
+*/
+static uint8_t* cdi_readFile(const char* filename, size_t* psize)
+{
+    uint8_t* buf = NULL;
+    long len;
+    FILE* fp = fopen(filename, "rb");
+    if (! fp)
+        return NULL;
+    if (fseek(fp, 0, SEEK_END) == 0 && (len = ftell(fp)) > 0) {
+        buf = (uint8_t*) malloc(len);
+        if (buf) {
+            rewind(fp);
+            if (fread(buf, 1, len, fp) == (size_t) len) {
+                *psize = len;
+            } else {
+                free(buf);
+                buf = NULL;
+            }
+        }
+    }
+    fclose(fp);
+    return buf;
+}
+
+/*
+  Map a CDI package into memory and validate the header & table of contents.
+
+  The file is mapped read-only.  If it cannot be mapped it is read into
+  memory.  On big endian archetectures the file is always read into memory
+  so that the TOC and string table indices can be swapped in place.
+
+  \param map       Return struct for the mapping.
+  \param filename  Path to CDI package file.
+
+  \return Non-zero if successful.  On failure the map struct is zeroed.
+*/
+int cdi_mapPak(CDIMapping* map, const char* filename)
+{
+    const CDIEntry* head;
+    uint32_t end;
+
+    map->base = NULL;
+    map->size = 0;
+    map->toc = NULL;
+    map->handle = NULL;
+    map->mapped = 0;
+
+#ifndef __BIG_ENDIAN__
+    map->base = (const uint8_t*) fileMap_open(filename, &map->size,
+                                              &map->handle);
+    if (map->base)
+        map->mapped = 1;
+    else
+#endif
+    {
+        map->base = cdi_readFile(filename, &map->size);
+        if (! map->base)
+            return 0;
+    }
+
+    if (map->size < sizeof(CDIEntry))
+        goto fatal;
+    head = (const CDIEntry*) map->base;
+    if (head->cdi != DA7A_CONTAINER_CDI_PAK)
+        goto fatal;
+    map->header = *head;
+#ifdef __BIG_ENDIAN__
+    map->header.offset = bswap_32(map->header.offset);
+    map->header.bytes  = bswap_32(map->header.bytes);
+#endif
+    end = map->header.offset + map->header.bytes;
+    if (end < map->header.offset || end > map->size ||
+        (map->header.offset & 3))
+        goto fatal;
+
+    map->toc = (const CDIEntry*) (map->base + map->header.offset);
+#ifdef __BIG_ENDIAN__
+    {
+    CDIEntry* it  = (CDIEntry*) map->toc;
+    CDIEntry* tend = it + CDI_TOC_SIZE((&map->header));
+    for (; it != tend; ++it) {
+        it->offset = bswap_32(it->offset);
+        it->bytes  = bswap_32(it->bytes);
+    }
+    }
+#endif
+    return 1;
+
+fatal:
+    cdi_unmapPak(map);
+    return 0;
+}
+
+void cdi_unmapPak(CDIMapping* map)
+{
+    if (map->mapped)
+        fileMap_close(map->base, map->size, map->handle);
+    else
+        free((void*) map->base);
+    map->base = NULL;
+    map->size = 0;
+    map->toc = NULL;
+    map->handle = NULL;
+    map->mapped = 0;
+}
+
+/*
+  \return Pointer to the chunk data inside the mapping, or NULL if the entry
+          lies outside of the mapped file.
+*/
+const uint8_t* cdi_mappedChunk(const CDIMapping* map, const CDIEntry* ent)
+{
+    uint32_t end = ent->offset + ent->bytes;
+    if (end < ent->offset || end > map->size)
+        return NULL;
+    return map->base + ent->offset;
+}
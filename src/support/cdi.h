@@ -93,6 +93,16 @@ typedef struct {
     const char* strings;
 } CDIStringTable;
 
+/* A CDI package mapped into memory */
+typedef struct {
+    const uint8_t* base;
+    size_t size;
+    CDIEntry header;
+    const CDIEntry* toc;
+    void* handle;       // fileMap_open() handle.
+    int mapped;         // Non-zero if base is a read-only file mapping.
+} CDIMapping;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -104,6 +114,10 @@ const CDIEntry* cdi_findAppId(const CDIEntry* toc, size_t count, uint32_t id);
 const CDIEntry* cdi_findFormat(const CDIEntry* toc, size_t count, uint32_t cdi);
 CDIStringTable* cdi_initStringTable(CDIStringTable* table, const uint8_t* buf);
 
+int             cdi_mapPak(CDIMapping* map, const char* filename);
+void            cdi_unmapPak(CDIMapping* map);
+const uint8_t*  cdi_mappedChunk(const CDIMapping* map, const CDIEntry* ent);
+
 void cdi_swap16(uint16_t* vars, size_t count);
 void cdi_swap32(uint32_t* vars, size_t count);
 
@@ -23,6 +23,14 @@ static __inline__ uint64_t cpuCounter()
     __asm__ __volatile__ (".byte 0x0f, 0x31" : "=A" (c));
     return c;
 }
+#elif defined(__aarch64__)
+#define HAVE_CPU_COUNTER
+static __inline__ uint64_t cpuCounter()
+{
+    uint64_t c;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (c));
+    return c;
+}
 #elif defined(__powerpc__)
 #define HAVE_CPU_COUNTER
 static __inline__ uint64_t cpuCounter()
@@ -0,0 +1,90 @@
+/*
+  Read-only File Mapping
+*/
+
+#include "fileMap.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+  Map a file into memory for reading.  The pages are read-only; writing to
+  them will fault.
+
+  \param size    Set to the number of bytes mapped.
+  \param handle  Set to the value which must be passed to fileMap_close().
+
+  \return Pointer to the file contents, or NULL if the file could not be
+          opened or is empty.
+*/
+const void* fileMap_open(const char* filename, size_t* size, void** handle)
+{
+    const void* base = NULL;
+
+    *size = 0;
+    *handle = NULL;
+
+#ifdef _WIN32
+    {
+    HANDLE fh, mh;
+    LARGE_INTEGER len;
+    fh = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return NULL;
+    if (GetFileSizeEx(fh, &len) && len.QuadPart > 0) {
+        mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mh) {
+            base = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+            if (base) {
+                *size = (size_t) len.QuadPart;
+                *handle = mh;
+            } else
+                CloseHandle(mh);
+        }
+    }
+    CloseHandle(fh);
+    }
+#else
+    {
+    struct stat st;
+    void* mem;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mem != MAP_FAILED) {
+            base = mem;
+            *size = st.st_size;
+        }
+    }
+    close(fd);
+    }
+#endif
+
+    return base;
+}
+
+/*
+  Unmap memory returned by fileMap_open().
+*/
+void fileMap_close(const void* base, size_t size, void* handle)
+{
+    if (! base)
+        return;
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile(base);
+    CloseHandle((HANDLE) handle);
+#else
+    (void) handle;
+    munmap((void*) base, size);
+#endif
+}
@@ -0,0 +1,20 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+/*
+ * fileMap.h
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const void* fileMap_open(const char* filename, size_t* size, void** handle);
+void fileMap_close(const void* base, size_t size, void* handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // FILEMAP_H
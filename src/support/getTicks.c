@@ -2,6 +2,25 @@
  * getTicks - A cross platform timer function.
  */
 
+#ifdef HEADLESS
+/*
+ * Headless builds use a simulated clock which only advances when msecSleep()
+ * is called.  This makes replays deterministic and lets them run as fast as
+ * the CPU allows.
+ */
+static uint32_t getTicks_sim = 0;
+
+uint32_t getTicks()
+{
+    return getTicks_sim;
+}
+
+void msecSleep(uint32_t ms)
+{
+    getTicks_sim += ms;
+}
+#else
+
 #ifdef _WIN32
 #include <sys/types.h>
 #include <sys/timeb.h>
@@ -46,3 +65,4 @@ void msecSleep(uint32_t ms)
    nanosleep(&stime, 0);
 #endif
 }
+#endif
@@ -16,6 +16,318 @@
 #include <stdio.h>
 #include "image32.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE32_X86
+#include <immintrin.h>
+#define TARGET(T)   __attribute__((target(T)))
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define IMAGE32_NEON
+#include <arm_neon.h>
+#endif
+
+static inline uint8_t MIX(int A, int B, int alpha)
+{
+    return (int8_t) (A + ((B - A) * alpha / 255));
+}
+
+/*
+ * Pixel row kernels
+ *
+ * The scalar versions are the reference implementation; the SIMD versions
+ * must produce identical results.  For the blend, (B - A) * alpha / 255
+ * truncates towards zero, so it is computed as the unsigned quotient of
+ * |B - A| * alpha, which is exactly (p + (p >> 8) + 1) >> 8 for all
+ * p <= 255 * 255.
+ */
+
+typedef struct {
+    void (*blendRow)(uint32_t* dp, const uint32_t* sp, int count);
+    void (*fillRow)(uint32_t* dp, uint32_t color, int count);
+    void (*invertRow)(uint32_t* dp, int count);
+} Image32Kernels;
+
+#define RGB_MASK    0x00ffffff      // Byte order is R,G,B,A.
+
+static void blendRow_scalar(uint32_t* drow, const uint32_t* srow, int count)
+{
+    uint8_t* dp = (uint8_t*) drow;
+    const uint8_t* sp = (const uint8_t*) srow;
+    const uint8_t* send = (const uint8_t*) (srow + count);
+    int alpha;
+
+    while( sp != send ) {
+        alpha = sp[3];
+        dp[0] = MIX(dp[0], sp[0], alpha);
+        dp[1] = MIX(dp[1], sp[1], alpha);
+        dp[2] = MIX(dp[2], sp[2], alpha);
+        dp[3] = alpha;
+
+        dp += 4;
+        sp += 4;
+    }
+}
+
+static void fillRow_scalar(uint32_t* dp, uint32_t color, int count)
+{
+    uint32_t* dend = dp + count;
+    while (dp != dend)
+        *dp++ = color;
+}
+
+static void invertRow_scalar(uint32_t* dp, int count)
+{
+    uint32_t* dend = dp + count;
+    while (dp != dend)
+        *dp++ ^= RGB_MASK;
+}
+
+#ifdef IMAGE32_X86
+/*
+ * Blend the RGB of two pixels held as 16-bit channels.
+ */
+TARGET("sse2")
+static inline __m128i mix16_sse2(__m128i a, __m128i b)
+{
+    __m128i alpha, diff, neg, p, q;
+
+    alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, 0xff), 0xff);
+    diff  = _mm_sub_epi16(b, a);
+    neg   = _mm_srai_epi16(diff, 15);
+    p = _mm_mullo_epi16(_mm_sub_epi16(_mm_xor_si128(diff, neg), neg), alpha);
+    q = _mm_add_epi16(_mm_add_epi16(p, _mm_srli_epi16(p, 8)),
+                      _mm_set1_epi16(1));
+    q = _mm_srli_epi16(q, 8);
+    return _mm_add_epi16(a, _mm_sub_epi16(_mm_xor_si128(q, neg), neg));
+}
+
+TARGET("sse2")
+static void blendRow_sse2(uint32_t* dp, const uint32_t* sp, int count)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32(~RGB_MASK);
+    __m128i s, d, lo, hi;
+
+    for (; count >= 4; count -= 4, dp += 4, sp += 4) {
+        s = _mm_loadu_si128((const __m128i*) sp);
+        d = _mm_loadu_si128((const __m128i*) dp);
+        lo = mix16_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+        hi = mix16_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+        d = _mm_packus_epi16(lo, hi);
+        d = _mm_or_si128(_mm_andnot_si128(amask, d), _mm_and_si128(amask, s));
+        _mm_storeu_si128((__m128i*) dp, d);
+    }
+    if (count)
+        blendRow_scalar(dp, sp, count);
+}
+
+TARGET("sse2")
+static void fillRow_sse2(uint32_t* dp, uint32_t color, int count)
+{
+    const __m128i c4 = _mm_set1_epi32(color);
+    for (; count >= 4; count -= 4, dp += 4)
+        _mm_storeu_si128((__m128i*) dp, c4);
+    while (count--)
+        *dp++ = color;
+}
+
+TARGET("sse2")
+static void invertRow_sse2(uint32_t* dp, int count)
+{
+    const __m128i mask = _mm_set1_epi32(RGB_MASK);
+    __m128i d;
+    for (; count >= 4; count -= 4, dp += 4) {
+        d = _mm_loadu_si128((const __m128i*) dp);
+        _mm_storeu_si128((__m128i*) dp, _mm_xor_si128(d, mask));
+    }
+    invertRow_scalar(dp, count);
+}
+
+TARGET("avx2")
+static inline __m256i mix16_avx2(__m256i a, __m256i b)
+{
+    __m256i alpha, diff, neg, p, q;
+
+    alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(b, 0xff), 0xff);
+    diff  = _mm256_sub_epi16(b, a);
+    neg   = _mm256_srai_epi16(diff, 15);
+    p = _mm256_mullo_epi16(_mm256_sub_epi16(_mm256_xor_si256(diff, neg), neg),
+                           alpha);
+    q = _mm256_add_epi16(_mm256_add_epi16(p, _mm256_srli_epi16(p, 8)),
+                         _mm256_set1_epi16(1));
+    q = _mm256_srli_epi16(q, 8);
+    return _mm256_add_epi16(a, _mm256_sub_epi16(_mm256_xor_si256(q, neg), neg));
+}
+
+TARGET("avx2")
+static void blendRow_avx2(uint32_t* dp, const uint32_t* sp, int count)
+{
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i amask = _mm256_set1_epi32(~RGB_MASK);
+    __m256i s, d, lo, hi;
+
+    // Unpack & pack operate within 128-bit lanes so pixel order is kept.
+    for (; count >= 8; count -= 8, dp += 8, sp += 8) {
+        s = _mm256_loadu_si256((const __m256i*) sp);
+        d = _mm256_loadu_si256((const __m256i*) dp);
+        lo = mix16_avx2(_mm256_unpacklo_epi8(d, zero),
+                        _mm256_unpacklo_epi8(s, zero));
+        hi = mix16_avx2(_mm256_unpackhi_epi8(d, zero),
+                        _mm256_unpackhi_epi8(s, zero));
+        d = _mm256_packus_epi16(lo, hi);
+        d = _mm256_or_si256(_mm256_andnot_si256(amask, d),
+                            _mm256_and_si256(amask, s));
+        _mm256_storeu_si256((__m256i*) dp, d);
+    }
+    if (count)
+        blendRow_sse2(dp, sp, count);
+}
+
+TARGET("avx2")
+static void fillRow_avx2(uint32_t* dp, uint32_t color, int count)
+{
+    const __m256i c8 = _mm256_set1_epi32(color);
+    for (; count >= 8; count -= 8, dp += 8)
+        _mm256_storeu_si256((__m256i*) dp, c8);
+    while (count--)
+        *dp++ = color;
+}
+
+TARGET("avx2")
+static void invertRow_avx2(uint32_t* dp, int count)
+{
+    const __m256i mask = _mm256_set1_epi32(RGB_MASK);
+    __m256i d;
+    for (; count >= 8; count -= 8, dp += 8) {
+        d = _mm256_loadu_si256((const __m256i*) dp);
+        _mm256_storeu_si256((__m256i*) dp, _mm256_xor_si256(d, mask));
+    }
+    invertRow_scalar(dp, count);
+}
+#endif
+
+#ifdef IMAGE32_NEON
+static inline uint8x8_t mix8_neon(uint8x8_t a, uint8x8_t b, uint8x8_t alpha)
+{
+    uint16x8_t p, q;
+    uint8x8_t q8;
+
+    p = vmull_u8(vabd_u8(a, b), alpha);
+    q = vaddq_u16(vaddq_u16(p, vshrq_n_u16(p, 8)), vdupq_n_u16(1));
+    q8 = vshrn_n_u16(q, 8);
+    return vbsl_u8(vcgt_u8(b, a), vadd_u8(a, q8), vsub_u8(a, q8));
+}
+
+static void blendRow_neon(uint32_t* dp, const uint32_t* sp, int count)
+{
+    uint8x16x4_t s, d;
+    int i;
+
+    // Load de-interleaves the channels into separate R,G,B,A registers.
+    for (; count >= 16; count -= 16, dp += 16, sp += 16) {
+        s = vld4q_u8((const uint8_t*) sp);
+        d = vld4q_u8((const uint8_t*) dp);
+        for (i = 0; i < 3; ++i) {
+            d.val[i] = vcombine_u8(
+                mix8_neon(vget_low_u8(d.val[i]), vget_low_u8(s.val[i]),
+                          vget_low_u8(s.val[3])),
+                mix8_neon(vget_high_u8(d.val[i]), vget_high_u8(s.val[i]),
+                          vget_high_u8(s.val[3])));
+        }
+        d.val[3] = s.val[3];
+        vst4q_u8((uint8_t*) dp, d);
+    }
+    if (count)
+        blendRow_scalar(dp, sp, count);
+}
+
+static void fillRow_neon(uint32_t* dp, uint32_t color, int count)
+{
+    const uint32x4_t c4 = vdupq_n_u32(color);
+    for (; count >= 4; count -= 4, dp += 4)
+        vst1q_u32(dp, c4);
+    while (count--)
+        *dp++ = color;
+}
+
+static void invertRow_neon(uint32_t* dp, int count)
+{
+    const uint32x4_t mask = vdupq_n_u32(RGB_MASK);
+    for (; count >= 4; count -= 4, dp += 4)
+        vst1q_u32(dp, veorq_u32(vld1q_u32(dp), mask));
+    invertRow_scalar(dp, count);
+}
+#endif
+
+static Image32Kernels kern = {
+    blendRow_scalar, fillRow_scalar, invertRow_scalar
+};
+
+/**
+ * Choose the pixel kernels used by the drawing functions.
+ *
+ * \param simd  An Image32Simd value.  If the CPU does not support it then
+ *              scalar code is used.  IMAGE32_SIMD_AUTO picks the best
+ *              supported.
+ *
+ * \return The Image32Simd value actually selected.
+ */
+int image32_selectSimd(int simd)
+{
+    int avail = IMAGE32_SCALAR;
+
+#ifdef IMAGE32_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        avail = IMAGE32_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        avail = IMAGE32_SSE2;
+#elif defined(IMAGE32_NEON)
+    avail = IMAGE32_NEON;
+#endif
+
+    if (simd == IMAGE32_SIMD_AUTO)
+        simd = avail;
+    else if (simd > avail)
+        simd = IMAGE32_SCALAR;
+
+    switch (simd) {
+#ifdef IMAGE32_X86
+        case IMAGE32_SSE2:
+            kern.blendRow  = blendRow_sse2;
+            kern.fillRow   = fillRow_sse2;
+            kern.invertRow = invertRow_sse2;
+            break;
+        case IMAGE32_AVX2:
+            kern.blendRow  = blendRow_avx2;
+            kern.fillRow   = fillRow_avx2;
+            kern.invertRow = invertRow_avx2;
+            break;
+#endif
+#ifdef IMAGE32_NEON
+        case IMAGE32_NEON:
+            kern.blendRow  = blendRow_neon;
+            kern.fillRow   = fillRow_neon;
+            kern.invertRow = invertRow_neon;
+            break;
+#endif
+        default:
+            simd = IMAGE32_SCALAR;
+            kern.blendRow  = blendRow_scalar;
+            kern.fillRow   = fillRow_scalar;
+            kern.invertRow = invertRow_scalar;
+            break;
+    }
+    return simd;
+}
+
+const char* image32_simdName(int simd)
+{
+    static const char* names[] = { "scalar", "SSE2", "AVX2", "NEON", "auto" };
+    if (simd < IMAGE32_SCALAR || simd > IMAGE32_SIMD_AUTO)
+        return "unknown";
+    return names[simd];
+}
+
 /**
  * Intialize an image struct with pixels set to NULL and w & h to zero.
  */
@@ -83,8 +395,7 @@ void image32_fill(Image32* img, const RGBA* color)
 
     icol = *((uint32_t*) color);
 
-    while (dp != dend)
-        *dp++ = icol;
+    kern.fillRow(dp, icol, dend - dp);
 }
 
 /**
@@ -94,8 +405,6 @@ void image32_fillRect(Image32* img, int x, int y, int rw, int rh,
                       const RGBA* color)
 {
     uint32_t icol;
-    uint32_t* dp;
-    uint32_t* dend;
     uint32_t* drow = img->pixels + img->w * y + x;
 
     icol = *((uint32_t*) color);
@@ -111,19 +420,11 @@ void image32_fillRect(Image32* img, int x, int y, int rw, int rh,
         return;
 
     while (rh--) {
-        dp = drow;
-        dend = dp + rw;
-        while( dp != dend )
-            *dp++ = icol;
+        kern.fillRow(drow, icol, rw);
         drow += img->w;
     }
 }
 
-static inline uint8_t MIX(int A, int B, int alpha)
-{
-    return (int8_t) (A + ((B - A) * alpha / 255));
-}
-
 /**
  * Draw one image onto another.
  *
@@ -164,39 +465,14 @@ void image32_blit(Image32* dest, int dx, int dy, const Image32* src, int blend)
     drow = dest->pixels + dest->w * dy + dx;
 
     if (blend) {
-        uint8_t* dp;
-        const uint8_t* sp;
-        const uint8_t* send;
-        int alpha;
-
         while (blitH--) {
-            dp = (uint8_t*) drow;
-            sp = (const uint8_t*) srow;
-            send = (const uint8_t*) (srow + blitW);
-            while( sp != send ) {
-                alpha = sp[3];
-                dp[0] = MIX(dp[0], sp[0], alpha);
-                dp[1] = MIX(dp[1], sp[1], alpha);
-                dp[2] = MIX(dp[2], sp[2], alpha);
-                dp[3] = alpha;
-
-                dp += 4;
-                sp += 4;
-            }
+            kern.blendRow(drow, srow, blitW);
             drow += dest->w;
             srow += src->w;
         }
     } else {
-        uint32_t* dp;
-        const uint32_t* sp;
-        const uint32_t* send;
-
         while (blitH--) {
-            dp = drow;
-            sp = srow;
-            send = sp + blitW;
-            while( sp != send )
-                *dp++ = *sp++;
+            memcpy(drow, srow, blitW * sizeof(uint32_t));
             drow += dest->w;
             srow += src->w;
         }
@@ -243,45 +519,51 @@ void image32_blitRect(Image32* dest, int dx, int dy,
     drow = dest->pixels + dest->w * dy + dx;
 
     if (blend) {
-        uint8_t* dp;
-        const uint8_t* sp;
-        const uint8_t* send;
-        int alpha;
-
         while (sh--) {
-            dp = (uint8_t*) drow;
-            sp = (const uint8_t*) srow;
-            send = (const uint8_t*) (srow + sw);
-            while( sp != send ) {
-                alpha = sp[3];
-                dp[0] = MIX(dp[0], sp[0], alpha);
-                dp[1] = MIX(dp[1], sp[1], alpha);
-                dp[2] = MIX(dp[2], sp[2], alpha);
-                dp[3] = alpha;
-
-                dp += 4;
-                sp += 4;
-            }
+            kern.blendRow(drow, srow, sw);
             drow += dest->w;
             srow += src->w;
         }
     } else {
-        uint32_t* dp;
-        const uint32_t* sp;
-        const uint32_t* send;
-
         while (sh--) {
-            dp = drow;
-            sp = srow;
-            send = sp + sw;
-            while( sp != send )
-                *dp++ = *sp++;
+            memcpy(drow, srow, sw * sizeof(uint32_t));
             drow += dest->w;
             srow += src->w;
         }
     }
 }
 
+/**
+ * Copy a sub-rectangle of one image onto another, flipping it vertically.
+ */
+void image32_blitRectFlipV(Image32* dest, int dx, int dy,
+                           const Image32* src, int sx, int sy, int sw, int sh)
+{
+    uint32_t* drow;
+    const uint32_t* srow;
+
+    // Clip position and source rect to positive values.
+    CLIP_SUB(dx, sx, sw, src->w, dest->w)
+    CLIP_SUB(dy, sy, sh, src->h, dest->h)
+
+    srow = src->pixels + src->w * (sy + sh - 1) + sx;
+    drow = dest->pixels + dest->w * dy + dx;
+
+    while (sh--) {
+        memcpy(drow, srow, sw * sizeof(uint32_t));
+        drow += dest->w;
+        srow -= src->w;
+    }
+}
+
+/**
+ * Invert the RGB values of an image.  Alpha is unchanged.
+ */
+void image32_invertRGB(Image32* img)
+{
+    kern.invertRow(img->pixels, img->w * img->h);
+}
+
 #if 0
 /**
  * Load an image from a PPM file.
@@ -21,10 +21,20 @@ typedef struct {
     uint16_t w, h;
 } Image32;
 
+enum Image32Simd {
+    IMAGE32_SCALAR,
+    IMAGE32_SSE2,
+    IMAGE32_AVX2,
+    IMAGE32_NEON,
+    IMAGE32_SIMD_AUTO
+};
+
 #ifdef __cplusplus
 //extern "C" {
 #endif
 
+int      image32_selectSimd(int simd);
+const char* image32_simdName(int simd);
 void     image32_init(Image32*);
 int      image32_allocPixels(Image32*, uint16_t w, uint16_t h);
 void     image32_freePixels(Image32*);
@@ -37,6 +47,10 @@ void     image32_blit(Image32* dest, int dx, int dy,
 void     image32_blitRect(Image32* dest, int dx, int dy,
                           const Image32* src, int sx, int sy, int sw, int sh,
                           int blend);
+void     image32_blitRectFlipV(Image32* dest, int dx, int dy,
+                               const Image32* src, int sx, int sy,
+                               int sw, int sh);
+void     image32_invertRGB(Image32*);
 //void     image32_loadPPM(Image32*, const char *filename);
 void     image32_savePPM(const Image32*, const char *filename);
 
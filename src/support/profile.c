@@ -0,0 +1,236 @@
+/*
+ * profile.c
+ *
+ * Zone samples are stored in a ring of frames so that the timing of each
+ * individual frame over the last few seconds can be examined.  Bracket the
+ * work done in each main loop iteration with profile_frameBegin() and
+ * profile_frameEnd() (leaving out the frame sleep), and call
+ * profile_dumpTrace() to write the ring as a Chrome trace (chrome://tracing
+ * or ui.perfetto.dev).
+ *
+ * The number of C++ heap allocations (counted by profileAlloc.cpp) made
+ * during each frame and zone is also recorded.
+ */
+
+#ifdef ENABLE_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+#include "cpuCounter.h"
+#include "profile.h"
+
+#ifdef _WIN32
+#include <sys/types.h>
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
+
+#define PROFILE_FRAMES      512     // Must be a power of two.
+#define PROFILE_FRAME_ZONES 64      // Must not exceed 256.
+#define NO_HANDLE           0xffffffff
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    uint32_t allocs;        // Allocation count at start, then the delta.
+}
+ProfileSample;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint32_t number;
+    uint32_t allocs;
+    uint16_t used;
+    uint16_t dropped;
+    ProfileSample sample[PROFILE_FRAME_ZONES];
+}
+ProfileFrame;
+
+static struct {
+    uint64_t initCount;
+    uint64_t initUsec;
+    uint64_t budget;        // Frame budget in usec.
+    uint64_t worst;         // Longest frame in counter ticks.
+    uint32_t frameNum;
+    uint32_t slowFrames;
+    ProfileFrame frames[PROFILE_FRAMES];
+} prof;
+
+static uint64_t profile_usec(void)
+{
+#ifdef _WIN32
+    struct _timeb tb;
+    _ftime(&tb);
+    return (uint64_t) tb.time * 1000000 + tb.millitm * 1000;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+#ifdef HAVE_CPU_COUNTER
+#define COUNTER()   cpuCounter()
+#else
+#define COUNTER()   profile_usec()
+#endif
+
+#define CURRENT_FRAME   (prof.frames + (prof.frameNum & (PROFILE_FRAMES-1)))
+
+/*
+  \param budgetMsec     Frames taking longer than this are reported as slow.
+*/
+void profile_init(int budgetMsec)
+{
+    memset(&prof, 0, sizeof(prof));
+    prof.budget = (uint64_t) budgetMsec * 1000;
+    prof.initUsec  = profile_usec();
+    prof.initCount = COUNTER();
+}
+
+/*
+  Begin a new frame.  Any zones started before this are recorded in the
+  previous frame.
+*/
+void profile_frameBegin(void)
+{
+    ProfileFrame* fr = prof.frames + (++prof.frameNum & (PROFILE_FRAMES-1));
+    fr->start   = COUNTER();
+    fr->end     = 0;
+    fr->number  = prof.frameNum;
+    fr->allocs  = profile_allocCount();
+    fr->used    = 0;
+    fr->dropped = 0;
+}
+
+/*
+  Mark the end of the work done in the current frame.
+*/
+void profile_frameEnd(void)
+{
+    ProfileFrame* fr = CURRENT_FRAME;
+    uint64_t elapsed;
+
+    fr->end = COUNTER();
+    fr->allocs = profile_allocCount() - fr->allocs;
+    elapsed = fr->end - fr->start;
+    if (elapsed > prof.worst)
+        prof.worst = elapsed;
+}
+
+/*
+  Begin timing a zone in the current frame.
+
+  \param name   Zone name. This pointer must remain valid until the trace
+                is dumped.
+
+  \return Handle to pass to profile_end().
+*/
+uint32_t profile_begin(const char* name)
+{
+    ProfileFrame* fr = CURRENT_FRAME;
+    ProfileSample* sa;
+
+    if (fr->used == PROFILE_FRAME_ZONES) {
+        ++fr->dropped;
+        return NO_HANDLE;
+    }
+    sa = fr->sample + fr->used;
+    sa->name  = name;
+    sa->start = COUNTER();
+    sa->end   = 0;
+    sa->allocs = profile_allocCount();
+    return (prof.frameNum << 8) | fr->used++;
+}
+
+/*
+  Finish timing a zone.  A zone may span frames (e.g. a key handler that
+  waits for an animation) as long as its frame has not yet been recycled.
+*/
+void profile_end(uint32_t handle)
+{
+    ProfileFrame* fr;
+    uint32_t fn;
+    int i;
+
+    if (handle == NO_HANDLE)
+        return;
+    fn = handle >> 8;
+    i  = handle & 0xff;
+    fr = prof.frames + (fn & (PROFILE_FRAMES-1));
+    if ((fr->number & 0xffffff) == fn && i < fr->used) {
+        ProfileSample* sa = fr->sample + i;
+        sa->end = COUNTER();
+        sa->allocs = profile_allocCount() - sa->allocs;
+    }
+}
+
+/*
+  Write the frames in the ring buffer as a Chrome trace JSON file and print
+  a summary of frames that exceeded the budget.
+
+  \return Non-zero if the file was written.
+*/
+int profile_dumpTrace(const char* filename)
+{
+    const ProfileFrame* fr;
+    const ProfileSample* sa;
+    FILE* fp;
+    double tpu;             // Counter ticks per microsecond.
+    uint64_t usec, dur;
+    uint32_t n, first;
+    int i, sep;
+
+    usec = profile_usec() - prof.initUsec;
+    tpu = usec ? (double) (COUNTER() - prof.initCount) / usec : 1.0;
+    if (tpu <= 0.0)
+        tpu = 1.0;
+
+    fp = fopen(filename, "w");
+    if (! fp)
+        return 0;
+
+    first = (prof.frameNum >= PROFILE_FRAMES) ?
+                prof.frameNum - PROFILE_FRAMES + 1 : 1;
+    prof.slowFrames = 0;
+    sep = ' ';
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (n = first; n <= prof.frameNum; ++n) {
+        fr = prof.frames + (n & (PROFILE_FRAMES-1));
+        if (! fr->end)
+            continue;
+        dur = (uint64_t) ((fr->end - fr->start) / tpu);
+        if (prof.budget && dur > prof.budget)
+            ++prof.slowFrames;
+
+        fprintf(fp, "%c{\"name\":\"frame\",\"cat\":\"%s\",\"ph\":\"X\","
+                "\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f,"
+                "\"args\":{\"n\":%u,\"dropped\":%d,\"allocs\":%u}}\n",
+                sep, (prof.budget && dur > prof.budget) ? "slow" : "frame",
+                (fr->start - prof.initCount) / tpu,
+                (fr->end - fr->start) / tpu, n, fr->dropped, fr->allocs);
+        sep = ',';
+
+        for (i = 0, sa = fr->sample; i < fr->used; ++i, ++sa) {
+            if (! sa->end)
+                continue;
+            fprintf(fp, ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,"
+                    "\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"allocs\":%u}}\n",
+                    sa->name, (sa->start - prof.initCount) / tpu,
+                    (sa->end - sa->start) / tpu, sa->allocs);
+        }
+    }
+    fprintf(fp, "]}\n");
+    fclose(fp);
+
+    printf("profile: %u frames, %u of last %u over %d ms, worst %.2f ms\n",
+           prof.frameNum, prof.slowFrames, prof.frameNum - first + 1,
+           (int) (prof.budget / 1000), prof.worst / tpu * 0.001);
+    return 1;
+}
+
+#endif
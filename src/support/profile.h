@@ -0,0 +1,51 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+/*
+ * profile.h
+ * Per-frame zone profiler.
+ */
+
+#include <stdint.h>
+
+#ifdef ENABLE_PROFILE
+#define PROFILE_INIT(budget)    profile_init(budget);
+#define PROFILE_FRAME_BEGIN()   profile_frameBegin();
+#define PROFILE_FRAME_END()     profile_frameEnd();
+#define PROFILE_DUMP(file)      profile_dumpTrace(file);
+#define PROFILE_ZONE(name)      ProfileZone profZone_(name);
+#else
+#define PROFILE_INIT(budget)
+#define PROFILE_FRAME_BEGIN()
+#define PROFILE_FRAME_END()
+#define PROFILE_DUMP(file)
+#define PROFILE_ZONE(name)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void     profile_init(int budgetMsec);
+void     profile_frameBegin(void);
+void     profile_frameEnd(void);
+uint32_t profile_begin(const char* name);
+void     profile_end(uint32_t handle);
+int      profile_dumpTrace(const char* filename);
+uint32_t profile_allocCount(void);
+
+#ifdef __cplusplus
+}
+
+/*
+ * Records the time spent in a block of code.  The name must be a string
+ * constant.
+ */
+struct ProfileZone {
+    uint32_t handle;
+
+    ProfileZone(const char* name) { handle = profile_begin(name); }
+    ~ProfileZone() { profile_end(handle); }
+};
+#endif
+
+#endif // PROFILE_H
@@ -0,0 +1,60 @@
+/*
+ * profileAlloc.cpp
+ *
+ * Replaces the global operator new & delete to count heap allocations for
+ * the profiler.  This lets the trace show which zones allocate memory.
+ *
+ * Worker & loader threads allocate too, so the count is atomic.  Relaxed
+ * ordering is enough as it is only a statistic.
+ */
+
+#ifdef ENABLE_PROFILE
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "profile.h"
+
+static std::atomic<uint32_t> allocCount(0);
+
+extern "C" uint32_t profile_allocCount(void)
+{
+    return allocCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+    void* ptr;
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    ptr = malloc(size ? size : 1);
+    if (! ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) throw()
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) throw()
+{
+    free(ptr);
+}
+
+#endif
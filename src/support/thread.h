@@ -0,0 +1,88 @@
+#ifndef THREAD_H
+#define THREAD_H
+/*
+ * thread.h
+ *
+ * Minimal threads, mutexes & condition variables for POSIX and Win32.
+ * Only include this from source files; windows.h is rather noisy.
+ */
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+typedef HANDLE              Thread;
+typedef CRITICAL_SECTION    Mutex;
+typedef CONDITION_VARIABLE  MutexCond;
+typedef DWORD               ThreadReturn;
+#define THREAD_CALL         WINAPI
+
+typedef ThreadReturn (THREAD_CALL *ThreadFunc)(void*);
+
+#define mutex_init(mp)          InitializeCriticalSection(mp)
+#define mutex_free(mp)          DeleteCriticalSection(mp)
+#define mutex_lock(mp)          EnterCriticalSection(mp)
+#define mutex_unlock(mp)        LeaveCriticalSection(mp)
+#define condition_init(cp)      InitializeConditionVariable(cp)
+#define condition_free(cp)
+#define condition_wait(cp,mp)   SleepConditionVariableCS(cp,mp,INFINITE)
+#define condition_signal(cp)    WakeConditionVariable(cp)
+#define condition_broadcast(cp) WakeAllConditionVariable(cp)
+
+static inline int thread_create(Thread* th, ThreadFunc func, void* arg) {
+    *th = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *th ? 0 : -1;
+}
+
+static inline void thread_join(Thread th) {
+    WaitForSingleObject(th, INFINITE);
+    CloseHandle(th);
+}
+
+static inline int thread_cpuCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+}
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t           Thread;
+typedef pthread_mutex_t     Mutex;
+typedef pthread_cond_t      MutexCond;
+typedef void*               ThreadReturn;
+#define THREAD_CALL
+
+typedef ThreadReturn (THREAD_CALL *ThreadFunc)(void*);
+
+#define mutex_init(mp)          pthread_mutex_init(mp, NULL)
+#define mutex_free(mp)          pthread_mutex_destroy(mp)
+#define mutex_lock(mp)          pthread_mutex_lock(mp)
+#define mutex_unlock(mp)        pthread_mutex_unlock(mp)
+#define condition_init(cp)      pthread_cond_init(cp, NULL)
+#define condition_free(cp)      pthread_cond_destroy(cp)
+#define condition_wait(cp,mp)   pthread_cond_wait(cp, mp)
+#define condition_signal(cp)    pthread_cond_signal(cp)
+#define condition_broadcast(cp) pthread_cond_broadcast(cp)
+
+static inline int thread_create(Thread* th, ThreadFunc func, void* arg) {
+    return pthread_create(th, NULL, func, arg);
+}
+
+static inline void thread_join(Thread th) {
+    pthread_join(th, NULL);
+}
+
+static inline int thread_cpuCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n < 1) ? 1 : (int) n;
+}
+
+#endif
+
+#endif  // THREAD_H
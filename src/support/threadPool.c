@@ -0,0 +1,167 @@
+/*
+ * threadPool.c
+ * Worker threads for splitting a task into independent jobs.
+ */
+
+#include <stdlib.h>
+#include "thread.h"
+#include "threadPool.h"
+
+#define MAX_WORKERS 16
+
+struct ThreadPool {
+    Mutex mutex;
+    MutexCond wake;         // Signals workers that a batch is ready.
+    MutexCond done;         // Signals the caller that the batch is finished.
+    Mutex runLock;          // Serializes threadPool_run() callers.
+    ThreadPoolJob func;
+    void* user;
+    int nextJob;
+    int jobCount;
+    int pending;            // Jobs of the batch which have not finished.
+    unsigned int batch;
+    int quit;
+    int workerCount;
+    Thread workers[MAX_WORKERS];
+};
+
+/*
+  Run jobs of the current batch until none are left.
+  The pool mutex must be locked.
+*/
+static void threadPool_work(struct ThreadPool* tp)
+{
+    ThreadPoolJob func = tp->func;
+    void* user = tp->user;
+    int job;
+
+    while (tp->nextJob < tp->jobCount) {
+        job = tp->nextJob++;
+        mutex_unlock(&tp->mutex);
+        func(user, job);
+        mutex_lock(&tp->mutex);
+        if (--tp->pending == 0)
+            condition_signal(&tp->done);
+    }
+}
+
+static ThreadReturn THREAD_CALL threadPool_worker(void* arg)
+{
+    struct ThreadPool* tp = (struct ThreadPool*) arg;
+    unsigned int seen = 0;
+
+    mutex_lock(&tp->mutex);
+    for (;;) {
+        while (tp->batch == seen && ! tp->quit)
+            condition_wait(&tp->wake, &tp->mutex);
+        if (tp->quit)
+            break;
+        seen = tp->batch;
+        threadPool_work(tp);
+    }
+    mutex_unlock(&tp->mutex);
+    return 0;
+}
+
+/*
+  \param workers    Number of threads to start.  If negative, one less than
+                    the number of CPUs is used (the calling thread also does
+                    work in threadPool_run).
+
+  \return Pointer to pool or NULL if no worker threads could be started.
+*/
+struct ThreadPool* threadPool_create(int workers)
+{
+    struct ThreadPool* tp;
+
+    if (workers < 0)
+        workers = thread_cpuCount() - 1;
+    if (workers > MAX_WORKERS)
+        workers = MAX_WORKERS;
+    if (workers < 1)
+        return NULL;
+
+    tp = (struct ThreadPool*) calloc(1, sizeof(struct ThreadPool));
+    if (! tp)
+        return NULL;
+
+    mutex_init(&tp->mutex);
+    mutex_init(&tp->runLock);
+    condition_init(&tp->wake);
+    condition_init(&tp->done);
+
+    for (; tp->workerCount < workers; ++tp->workerCount) {
+        if (thread_create(tp->workers + tp->workerCount,
+                          threadPool_worker, tp) != 0)
+            break;
+    }
+    if (tp->workerCount == 0) {
+        threadPool_free(tp);
+        return NULL;
+    }
+    return tp;
+}
+
+void threadPool_free(struct ThreadPool* tp)
+{
+    int i;
+
+    if (! tp)
+        return;
+
+    mutex_lock(&tp->mutex);
+    tp->quit = 1;
+    condition_broadcast(&tp->wake);
+    mutex_unlock(&tp->mutex);
+
+    for (i = 0; i < tp->workerCount; ++i)
+        thread_join(tp->workers[i]);
+
+    condition_free(&tp->done);
+    condition_free(&tp->wake);
+    mutex_free(&tp->runLock);
+    mutex_free(&tp->mutex);
+    free(tp);
+}
+
+int threadPool_workers(const struct ThreadPool* tp)
+{
+    return tp ? tp->workerCount : 0;
+}
+
+/*
+  Call func for each job number from 0 to jobCount-1 and wait for them all
+  to complete.  The jobs may run concurrently in any order, with the calling
+  thread doing its share of them.
+
+  If tp is NULL then the jobs are run in order by the calling thread.
+*/
+void threadPool_run(struct ThreadPool* tp, ThreadPoolJob func, void* user,
+                    int jobCount)
+{
+    int i;
+
+    if (! tp || jobCount < 2) {
+        for (i = 0; i < jobCount; ++i)
+            func(user, i);
+        return;
+    }
+
+    mutex_lock(&tp->runLock);
+    mutex_lock(&tp->mutex);
+
+    tp->func     = func;
+    tp->user     = user;
+    tp->nextJob  = 0;
+    tp->jobCount = jobCount;
+    tp->pending  = jobCount;
+    ++tp->batch;
+    condition_broadcast(&tp->wake);
+
+    threadPool_work(tp);
+    while (tp->pending)
+        condition_wait(&tp->done, &tp->mutex);
+
+    mutex_unlock(&tp->mutex);
+    mutex_unlock(&tp->runLock);
+}
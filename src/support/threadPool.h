@@ -0,0 +1,25 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+/*
+ * threadPool.h
+ */
+
+struct ThreadPool;
+
+typedef void (*ThreadPoolJob)(void* user, int job);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ThreadPool* threadPool_create(int workers);
+void threadPool_free(struct ThreadPool*);
+int  threadPool_workers(const struct ThreadPool*);
+void threadPool_run(struct ThreadPool*, ThreadPoolJob, void* user,
+                    int jobCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // THREADPOOL_H
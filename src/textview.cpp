@@ -29,11 +29,11 @@ TextView::TextView(int x, int y, int columns, int rows)
     if (charset == NULL)
         charset = xu4.imageMgr->get(BKGD_CHARSET)->image;
 
-    xu4.eventHandler->getTimer()->add(&cursorTimer, /*SCR_CYCLE_PER_SECOND*/4, this);
+    cursorTimerId = xu4.eventHandler->getTimer()->add(&cursorTimer, /*SCR_CYCLE_PER_SECOND*/4, this);
 }
 
 TextView::~TextView() {
-    xu4.eventHandler->getTimer()->remove(&cursorTimer, this);
+    xu4.eventHandler->getTimer()->remove(cursorTimerId);
 }
 
 void TextView::reinit() {
@@ -14,6 +14,7 @@
 #define CHAR_WIDTH 8
 #define CHAR_HEIGHT 8
 
+#include "event.h"
 #include "view.h"
 #include "image.h"
 
@@ -71,6 +72,7 @@ protected:
     bool cursorFollowsText;     /**< whether the cursor is moved past the last character written */
     int cursorX, cursorY;       /**< current position of cursor */
     int cursorPhase;            /**< the rotation state of the cursor */
+    TimerId cursorTimerId;      /**< handle of the cursor blink timer */
     uint8_t colorBG;
     uint8_t colorFG;
     static Image *charset;      /**< image containing font */
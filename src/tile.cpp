@@ -171,6 +171,9 @@ void Tile::loadImage() {
                  anim->transforms[0]->var.scroll.vid) {
             anim = NULL;
         }
+
+        if (anim && image && ! animFrames)
+            animFrames = anim->renderFrames(this);
 #endif
     }
 }
@@ -182,6 +185,8 @@ void Tile::deleteImage()
         delete image;
         image = NULL;
     }
+    delete animFrames;
+    animFrames = NULL;
     scale = SCALED_BASE;
 #endif
 }
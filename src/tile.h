@@ -174,6 +174,7 @@ public:
     const TileRule *rule; /**< The rules that govern the behavior of this tile */
     Image *image;       /**< The original image for this tile (with all of its frames) */
     TileAnim *anim;     /**< The tile animation for this tile */
+    Image *animFrames;  /**< Pre-rendered frames of anim (see TileAnim::renderFrames) */
     uint8_t directionCount;
     uint8_t directions[7];  /**< Directions used = frames (if present) */
 };
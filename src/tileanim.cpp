@@ -12,6 +12,90 @@
 #include "xu4.h"
 
 
+#define PCOLOR_VARIANTS     8
+
+static void advanceScroll(TileAnimTransform* tf, const Tile* tile)
+{
+    if (tf->var.scroll.increment == 0)
+        tf->var.scroll.increment = tile->getScale();
+
+    int offset = screenState()->currentCycle * 4 / SCR_CYCLE_PER_SECOND * tile->getScale();
+    if (tf->var.scroll.lastOffset != offset) {
+        tf->var.scroll.lastOffset = offset;
+        tf->var.scroll.current += tf->var.scroll.increment;
+        if (tf->var.scroll.current >= tile->getHeight())
+            tf->var.scroll.current = 0;
+    }
+}
+
+/*
+ * Scroll the tile frame down by 'current' pixels and draw it at row dy.
+ */
+static void drawScrolled(Image* dest, int dy, const Tile* tile, int frame,
+                         int current)
+{
+    const Image* tileImage = tile->getImage();
+    int th = tile->getHeight();
+
+    tileImage->drawSubRectOn(dest, 0, dy + current,
+            0, th * frame,
+            tile->getWidth(), th - current);
+    if (current != 0) {
+        tileImage->drawSubRectOn(dest, 0, dy,
+                0, (th * frame) + th - current,
+                tile->getWidth(), current);
+    }
+}
+
+static inline bool inColorRange(const TileAnimTransform* tf,
+                                const RGBA& col)
+{
+    const RGBA& start = tf->var.pcolor.start;
+    const RGBA& end   = tf->var.pcolor.end;
+    return (col.r >= start.r && col.r <= end.r &&
+            col.g >= start.g && col.g <= end.g &&
+            col.b >= start.b && col.b <= end.b);
+}
+
+/*
+ * Replace the pixels within the color range with random colors.
+ */
+static void randomizePixels(const TileAnimTransform* tf, Image* dest, int dy,
+                            const Tile* tile, int frame)
+{
+    const Image *tileImage = tile->getImage();
+    int scale = tile->getScale();
+    int x = tf->var.pcolor.x * scale;
+    int y = tf->var.pcolor.y * scale;
+    int w = tf->var.pcolor.w * scale;
+    int h = tf->var.pcolor.h * scale;
+    RGBA start = tf->var.pcolor.start;
+    RGBA end   = tf->var.pcolor.end;
+    RGBA diff  = end;
+
+    diff.r -= start.r;
+    diff.g -= start.g;
+    diff.b -= start.b;
+#if 0
+    printf( "PC color %d,%d,%d\n", start.r, start.g, start.b );
+    printf( "   end   %d,%d,%d\n", end.r, end.g, end.b );
+    printf( "   diff  %d,%d,%d\n", diff.r, diff.g, diff.b );
+#endif
+
+    for (int j = y; j < y + h; j++) {
+        for (int i = x; i < x + w; i++) {
+            RGBA pixelAt;
+            tileImage->getPixel(i, j + (frame * tile->getHeight()), pixelAt);
+            if (inColorRange(tf, pixelAt)) {
+                dest->putPixel(i, dy + j, start.r + xu4_random(diff.r),
+                                          start.g + xu4_random(diff.g),
+                                          start.b + xu4_random(diff.b),
+                                          pixelAt.a);
+            }
+        }
+    }
+}
+
 void TileAnimTransform::draw(Image* dest, const Tile* tile,
                              const MapTile& mapTile)
 {
@@ -29,27 +113,8 @@ void TileAnimTransform::draw(Image* dest, const Tile* tile,
         break;
 
     case ATYPE_SCROLL:
-    {
-        if (var.scroll.increment == 0)
-            var.scroll.increment = tile->getScale();
-
-        int offset = screenState()->currentCycle * 4 / SCR_CYCLE_PER_SECOND * tile->getScale();
-        if (var.scroll.lastOffset != offset) {
-            var.scroll.lastOffset = offset;
-            var.scroll.current += var.scroll.increment;
-            if (var.scroll.current >= tile->getHeight())
-                var.scroll.current = 0;
-        }
-
-        tile->getImage()->drawSubRectOn(dest, 0, var.scroll.current,
-                0, tile->getHeight() * mapTile.frame,
-                tile->getWidth(), tile->getHeight() - var.scroll.current);
-        if (var.scroll.current != 0) {
-            tile->getImage()->drawSubRectOn(dest, 0, 0,
-                    0, (tile->getHeight() * mapTile.frame) + tile->getHeight() - var.scroll.current,
-                    tile->getWidth(), var.scroll.current);
-        }
-    }
+        advanceScroll(this, tile);
+        drawScrolled(dest, 0, tile, mapTile.frame, var.scroll.current);
         break;
 
     case ATYPE_FRAME:
@@ -83,43 +148,122 @@ void TileAnimTransform::draw(Image* dest, const Tile* tile,
         break;
 #endif
     case ATYPE_PIXEL_COLOR:
-    {
-        const Image *tileImage = tile->getImage();
+        randomizePixels(this, dest, 0, tile, mapTile.frame);
+        break;
+    }
+}
+
+/*
+ * Return the number of variants of each tile frame which
+ * TileAnim::renderFrames() will pre-render for this transform.
+ */
+int TileAnimTransform::cacheVariants(const Tile* tile)
+{
+    switch(animType) {
+    case ATYPE_INVERT:
+        return 1;
+    case ATYPE_SCROLL:
+        if (var.scroll.increment == 0)
+            var.scroll.increment = tile->getScale();
+        return (tile->getHeight() + var.scroll.increment - 1) /
+               var.scroll.increment;
+    case ATYPE_PIXEL_COLOR:
+        return PCOLOR_VARIANTS;
+    }
+    return 0;
+}
+
+/*
+ * Draw a complete tile frame with a variant of this transform applied at
+ * row dy of dest.
+ */
+void TileAnimTransform::render(Image* dest, int dy, const Tile* tile,
+                               int frame, int variant)
+{
+    if (animType == ATYPE_SCROLL) {
+        drawScrolled(dest, dy, tile, frame, variant * var.scroll.increment);
+        return;
+    }
+
+    tile->getImage()->drawSubRectOn(dest, 0, dy,
+            0, frame * tile->getHeight(),
+            tile->getWidth(), tile->getHeight());
+
+    if (animType == ATYPE_INVERT) {
         int scale = tile->getScale();
-        int x = var.pcolor.x * scale;
-        int y = var.pcolor.y * scale;
-        int w = var.pcolor.w * scale;
-        int h = var.pcolor.h * scale;
-        RGBA start = var.pcolor.start;
-        RGBA end   = var.pcolor.end;
-        RGBA diff  = end;
-
-        diff.r -= start.r;
-        diff.g -= start.g;
-        diff.b -= start.b;
-#if 0
-        printf( "PC color %d,%d,%d\n", start.r, start.g, start.b );
-        printf( "   end   %d,%d,%d\n", end.r, end.g, end.b );
-        printf( "   diff  %d,%d,%d\n", diff.r, diff.g, diff.b );
-#endif
+        int x = var.invert.x * scale;
+        int y = var.invert.y * scale;
+
+        tile->getImage()->drawSubRectInvertedOn(dest, x, dy + y,
+                x, (tile->getHeight() * frame) + y,
+                var.invert.w * scale, var.invert.h * scale);
+    } else if (animType == ATYPE_PIXEL_COLOR) {
+        randomizePixels(this, dest, dy, tile, frame);
+    }
+}
+
+/*
+ * Draw this transform from the Tile::animFrames made by renderFrames().
+ * If whole is true then the entire tile is drawn, otherwise only the area
+ * that the transform changes.
+ *
+ * \param first  Index of the first animFrames frame for this transform.
+ */
+void TileAnimTransform::drawCached(Image* dest, const Tile* tile,
+                                   const MapTile& mapTile, int first,
+                                   bool whole)
+{
+    const Image* frames = tile->animFrames;
+    int scale = tile->getScale();
+    int th = tile->getHeight();
+    int x, y, w, h;
+    int sy = (first + mapTile.frame * cacheVariants(tile)) * th;
+
+    switch(animType) {
+    case ATYPE_INVERT:
+        x = var.invert.x * scale;
+        y = var.invert.y * scale;
+        w = var.invert.w * scale;
+        h = var.invert.h * scale;
+        break;
+
+    case ATYPE_SCROLL:
+        advanceScroll(this, tile);
+        sy += var.scroll.current / var.scroll.increment * th;
+        whole = true;
+        break;
+
+    case ATYPE_PIXEL_COLOR:
+        sy += xu4_random(PCOLOR_VARIANTS) * th;
+        x = var.pcolor.x * scale;
+        y = var.pcolor.y * scale;
+        w = var.pcolor.w * scale;
+        h = var.pcolor.h * scale;
+        break;
+
+    default:
+        return;
+    }
 
+    if (whole)
+        frames->drawSubRectOn(dest, 0, 0, 0, sy, tile->getWidth(), th);
+    else if (animType == ATYPE_PIXEL_COLOR) {
+        // Copy only the randomized pixels so that those an earlier
+        // transform drew outside the color range are kept.
+        const Image* tileImage = tile->getImage();
+        int ty = mapTile.frame * th;
+        RGBA col;
         for (int j = y; j < y + h; j++) {
             for (int i = x; i < x + w; i++) {
-                RGBA pixelAt;
-                tileImage->getPixel(i, j + (mapTile.frame * tile->getHeight()), pixelAt);
-                if (pixelAt.r >= start.r && pixelAt.r <= end.r &&
-                    pixelAt.g >= start.g && pixelAt.g <= end.g &&
-                    pixelAt.b >= start.b && pixelAt.b <= end.b) {
-                    dest->putPixel(i, j, start.r + xu4_random(diff.r),
-                                         start.g + xu4_random(diff.g),
-                                         start.b + xu4_random(diff.b),
-                                         pixelAt.a);
+                tileImage->getPixel(i, ty + j, col);
+                if (inColorRange(this, col)) {
+                    frames->getPixel(i, sy + j, col);
+                    dest->putPixel(i, j, col.r, col.g, col.b, col.a);
                 }
             }
         }
-    }
-        break;
-    }
+    } else
+        frames->drawSubRectOn(dest, x, y, x, sy + y, w, h);
 }
 
 //--------------------------------------
@@ -149,10 +293,15 @@ void TileAnim::draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direc
     }
 
     bool drawn = false;
+    int first, next = 0;
     std::vector<TileAnimTransform *>::const_iterator it;
     foreach (it, transforms) {
         TileAnimTransform* trans = *it;
 
+        first = next;
+        if (tile->animFrames)
+            next += trans->cacheVariants(tile) * tile->getFrames();
+
         if (trans->context == ACON_FRAME) {
             if (mapTile.frame != trans->contextSelect)
                 continue;
@@ -162,17 +311,57 @@ void TileAnim::draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direc
         }
 
         if (! trans->random || xu4_random(100) < trans->random) {
-            if (! drawsTile(trans) && ! drawn) {
-                tile->getImage()->drawSubRectOn(dest, 0, 0, 0,
-                        mapTile.frame * tile->getHeight(),
-                        tile->getWidth(), tile->getHeight());
+            if (next != first) {
+                trans->drawCached(dest, tile, mapTile, first, ! drawn);
+            } else {
+                if (! drawsTile(trans) && ! drawn) {
+                    tile->getImage()->drawSubRectOn(dest, 0, 0, 0,
+                            mapTile.frame * tile->getHeight(),
+                            tile->getWidth(), tile->getHeight());
+                }
+                trans->draw(dest, tile, mapTile);
             }
-            trans->draw(dest, tile, mapTile);
             drawn = true;
         }
     }
 }
 
+/**
+ * Pre-render every frame of the transforms which can be cached, so that
+ * drawing them is a single blit.  This is only used for software rendering.
+ *
+ * Returns an image with the frames stacked vertically, in the order of the
+ * transforms, or NULL if no transforms can be cached.
+ */
+Image* TileAnim::renderFrames(const Tile* tile)
+{
+    std::vector<TileAnimTransform *>::const_iterator it;
+    int f, v, n;
+    int frames = tile->getFrames();
+    int th = tile->getHeight();
+    int total = 0;
+
+    foreach (it, transforms)
+        total += (*it)->cacheVariants(tile);
+    if (! total)
+        return NULL;
+
+    Image* img = Image::create(tile->getWidth(), th * frames * total);
+    int wasBlending = Image::enableBlend(0);
+    int row = 0;
+
+    foreach (it, transforms) {
+        n = (*it)->cacheVariants(tile);
+        for (f = 0; f < frames; ++f) {
+            for (v = 0; v < n; ++v, ++row)
+                (*it)->render(img, row * th, tile, f, v);
+        }
+    }
+
+    Image::enableBlend(wasBlending);
+    return img;
+}
+
 //--------------------------------------
 
 TileAnimSet::~TileAnimSet()
@@ -80,6 +80,10 @@ struct TileAnimTransform {
         random = context = contextSelect = 0;
     }
     void draw(Image* dest, const Tile* tile, const MapTile& mapTile);
+    int  cacheVariants(const Tile* tile);
+    void render(Image* dest, int dy, const Tile* tile, int frame, int variant);
+    void drawCached(Image* dest, const Tile* tile, const MapTile& mapTile,
+                    int first, bool whole);
 };
 
 /**
@@ -93,6 +97,7 @@ public:
     ~TileAnim();
 
     void draw(Image *dest, const Tile *tile, const MapTile &mapTile, Direction dir);
+    Image* renderFrames(const Tile* tile);
 
     std::vector<TileAnimTransform *> transforms;
     Symbol name;
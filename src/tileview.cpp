@@ -20,9 +20,21 @@
 #include "u4.h"
 #include "xu4.h"
 
-using std::vector;
 
 TileView::TileView(int x, int y, int columns, int rows) : View(x, y, columns * TILE_WIDTH, rows * TILE_HEIGHT) {
+    init(columns, rows);
+}
+
+/*
+ * Create a view which fits columns x rows tiles into a fixed pixel area.
+ * Only the GPU renderer can scale tiles, so the software renderer requires
+ * pixelW & pixelH to match the tile dimensions.
+ */
+TileView::TileView(int x, int y, int columns, int rows, int pixelW, int pixelH) : View(x, y, pixelW, pixelH) {
+    init(columns, rows);
+}
+
+void TileView::init(int columns, int rows) {
     this->columns = columns;
     this->rows = rows;
     tileWidth  = TILE_WIDTH;
@@ -37,11 +49,17 @@ TileView::TileView(int x, int y, int columns, int rows) : View(x, y, columns * T
     scale = 2.0f / float(columns);
     effectCount = 0;
     memset(effect, 0, sizeof(effect));      // Sets method to VE_FREE.
+#else
+    cells = new TileViewCell[columns * rows];
+    invalidate();
 #endif
 }
 
 TileView::~TileView() {
     delete animated;
+#ifndef GPU_RENDER
+    delete[] cells;
+#endif
 }
 
 void TileView::reinit() {
@@ -55,6 +73,9 @@ void TileView::reinit() {
     }
     SCALED_VAR
     animated = Image::create(SCALED(tileWidth), SCALED(tileHeight));
+#ifndef GPU_RENDER
+    invalidate();
+#endif
 }
 
 void TileView::loadTile(const MapTile &mapTile)
@@ -105,15 +126,14 @@ void TileView::drawTile(const MapTile &mapTile, int x, int y) {
     }
 }
 
-void TileView::drawTile(vector<MapTile> &tiles, int x, int y) {
+void TileView::drawTile(const TileStack &tiles, int x, int y) {
     ASSERT(x < columns, "x value of %d out of range", x);
     ASSERT(y < rows, "y value of %d out of range", y);
-    int layer = 0;
     SCALED_VAR
 
-    for (vector<MapTile>::reverse_iterator t = tiles.rbegin();
-            t != tiles.rend();
-            ++t, ++layer)
+    for (const MapTile* t = tiles.tiles + tiles.count - 1;
+            t >= tiles.tiles;
+            --t)
     {
         const MapTile& frontTile = *t;
         const Tile *frontTileType = tileset->get(frontTile.id);
@@ -196,6 +216,91 @@ void TileView::drawFocus(int x, int y) {
     }
 }
 
+#ifndef GPU_RENDER
+#define CELL_VALID      0x01
+#define CELL_VISIBLE    0x02
+#define CELL_FOCUS      0x04
+
+void TileView::clear() {
+    View::clear();
+    invalidate();
+}
+
+void TileView::highlight(int x, int y, int width, int height) {
+    View::highlight(x, y, width, height);
+    invalidate();
+}
+
+void TileView::unhighlight() {
+    View::unhighlight();
+    invalidate();
+}
+
+/*
+ * Compare what is to be drawn in a cell with what was drawn there by the
+ * previous call and remember it.  Cells holding a TileAnim tile are always
+ * considered changed, as are all cells while the view is highlighted (the
+ * highlight is re-inverted by each update).
+ *
+ * \param tiles   Tile stack to draw, or NULL if the cell is blacked out.
+ * \param focus   True if the focus rectangle is to be shown on the cell.
+ *
+ * \return True if the cell must be redrawn.
+ */
+bool TileView::cellChanged(int x, int y, const TileStack* tiles, bool focus) {
+    TileViewCell* cell = cells + y * columns + x;
+    int flags = CELL_VALID;
+    bool changed;
+    int i;
+
+    if (tiles)
+        flags |= CELL_VISIBLE;
+    if (focus)
+        flags |= CELL_FOCUS;
+
+    changed = highlighted || (cell->flags != flags);
+    cell->flags = flags;
+    if (! tiles)
+        return changed;
+
+    if (! changed && cell->tiles.count == tiles->count) {
+        const MapTile* a = cell->tiles.tiles;
+        const MapTile* b = tiles->tiles;
+        for (i = 0; i < tiles->count; ++i, ++a, ++b) {
+            if (a->id != b->id || a->frame != b->frame)
+                break;
+        }
+        if (i == tiles->count) {
+            // Unchanged, but animated tiles differ from frame to frame.
+            for (i = 0; i < tiles->count; ++i) {
+                const Tile* tile = tileset->get(tiles->tiles[i].id);
+                if (tile && tile->getAnim())
+                    return true;
+            }
+            return false;
+        }
+    }
+
+    cell->tiles = *tiles;
+    return true;
+}
+
+/*
+ * Force all cells to be redrawn.  This must be called whenever something
+ * other than cellChanged() & drawTile() draws into the view area.
+ */
+void TileView::invalidate() {
+    TileViewCell* it  = cells;
+    TileViewCell* end = cells + columns * rows;
+    for (; it != end; ++it)
+        it->flags = 0;
+}
+
+void TileView::invalidateCell(int x, int y) {
+    cells[y * columns + x].flags = 0;
+}
+#endif
+
 #ifdef GPU_RENDER
 static void stopEffectAnim(VisualEffect* it) {
     if (it->anim != ANIM_UNUSED) {
@@ -308,25 +413,22 @@ void TileView::removeEffect(int id) {
 /*
  * \param cx        View center X.
  * \param cy        View center Y.
- * \param uvTable   Texture coordinate min & max indexed by VisualId.
  */
-void TileView::updateEffects(float cx, float cy, const float* uvTable) {
+void TileView::updateEffects(float cx, float cy) {
     const int TRIS_MAP_FX = 1;
     const float halfTile = VIEW_TILE_SIZE * -0.5f;
 
     if (effectCount) {
         const Animator* fxAnim = &xu4.eventHandler->fxAnim;
         float* animPos;
-        float* attr = gpu_beginTris(xu4.gpu, TRIS_MAP_FX);
-        float rect[4];
         float scaleY = scale * aspect;
+        float* attr = gpu_beginSprites(xu4.gpu, TRIS_MAP_FX,
+                                       scale  * VIEW_TILE_SIZE,
+                                       scaleY * VIEW_TILE_SIZE);
         int uvIndex;
         VisualEffect* it = effect;
         VisualEffect* end = it + effectCount;
 
-        rect[2] = scale  * VIEW_TILE_SIZE;
-        rect[3] = scaleY * VIEW_TILE_SIZE;
-
         for (; it != end; ++it) {
             switch (it->method) {
                 case VE_SPRITE_FLOURISH:
@@ -344,9 +446,10 @@ void TileView::updateEffects(float cx, float cy, const float* uvTable) {
                     uvIndex = VID_INDEX(it->vid);
 draw:
                     // Similar to emitSprite() in screen.cpp.
-                    rect[0] = scale  * (halfTile + (it->pos[0] - cx));
-                    rect[1] = scaleY * (halfTile + (cy - it->pos[1]));
-                    attr = gpu_emitQuad(attr, rect, uvTable + uvIndex*4);
+                    attr = gpu_emitSprite(attr,
+                                    scale  * (halfTile + (it->pos[0] - cx)),
+                                    scaleY * (halfTile + (cy - it->pos[1])),
+                                    uvIndex, 0.0f);
                     break;
             }
         }
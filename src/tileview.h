@@ -5,8 +5,6 @@
 #ifndef TILEVIEW_H
 #define TILEVIEW_H
 
-#include <vector>
-
 #include "anim.h"
 #include "coords.h"
 #include "types.h"
@@ -31,6 +29,14 @@ struct VisualEffect {
     VisualId vid;
     AnimId anim;
 };
+#else
+/*
+ * What was last drawn in a TileView cell by the software renderer.
+ */
+struct TileViewCell {
+    TileStack tiles;
+    uint8_t flags;
+};
 #endif
 
 /**
@@ -44,25 +50,32 @@ struct VisualEffect {
 class TileView : public View {
 public:
     TileView(int x, int y, int columns, int rows);
+    TileView(int x, int y, int columns, int rows, int pixelW, int pixelH);
     virtual ~TileView();
 
     void reinit();
     void drawTile(const MapTile &mapTile, int x, int y);
-    void drawTile(std::vector<MapTile> &tiles, int x, int y);
+    void drawTile(const TileStack &tiles, int x, int y);
     void drawFocus(int x, int y);
     void loadTile(const MapTile &mapTile);
+    void clear();
 
 #ifdef GPU_RENDER
-    void clear();
     int showEffect(const Coords &coords, TileId tile,
                    AnimId moveAnim = ANIM_UNUSED);
     VisualEffect* useEffect(int id, TileId tile, float x, float y);
     void removeEffect(int id);
-    void updateEffects(float cx, float cy, const float* uvTable);
+    void updateEffects(float cx, float cy);
 
     int* scissor;
     float aspect;
     float scale;
+#else
+    virtual void highlight(int x, int y, int width, int height);
+    virtual void unhighlight();
+    bool cellChanged(int x, int y, const TileStack* tiles, bool focus);
+    void invalidate();
+    void invalidateCell(int x, int y);
 #endif
 
     int columns, rows;
@@ -73,7 +86,12 @@ public:
 #ifdef GPU_RENDER
     int effectCount;
     VisualEffect effect[VE_MAX];
+#else
+    TileViewCell* cells;    /**< Dirty cell cache (columns * rows) */
 #endif
+
+private:
+    void init(int columns, int rows);
 };
 
 #endif /* TILEVIEW_H */
@@ -97,4 +97,27 @@ public:
     bool freezeAnimation;
 };
 
+#define TILE_STACK_MAX  16
+
+/**
+ * The MapTiles drawn at a single map location, from top to bottom.
+ * The tiles are stored inline so that a stack can be filled each frame
+ * without any memory allocation.  Tiles pushed once it is full are ignored.
+ */
+struct TileStack {
+    TileStack() : count(0) {}
+
+    void clear()                        { count = 0; }
+    bool empty() const                  { return count == 0; }
+    int  size() const                   { return count; }
+    const MapTile& front() const        { return tiles[0]; }
+    void push_back(const MapTile& t) {
+        if (count < TILE_STACK_MAX)
+            tiles[count++] = t;
+    }
+
+    MapTile tiles[TILE_STACK_MAX];
+    int count;
+};
+
 #endif
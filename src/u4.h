@@ -50,6 +50,10 @@
 #define VIEWPORT_W 11
 #define VIEWPORT_H 11
 
+/* limits of the viewportW & viewportH settings (GPU rendering only) */
+#define VIEWPORT_MAX_W 63
+#define VIEWPORT_MAX_H 39
+
 /* screen border size (in pixels) */
 #define BORDER_WIDTH 8
 #define BORDER_HEIGHT 8
@@ -5,10 +5,18 @@
 #include <cctype>
 #include <cstring>
 #include <cstdlib>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #include "u4file.h"
 #include "unzip.h"
 #include "debug.h"
+#include "fileMap.h"
 
 using std::map;
 using std::string;
@@ -34,12 +42,16 @@ private:
 };
 
 /**
- * A specialization of U4FILE that reads files out of zip archives
- * automatically.
+ * A specialization of U4FILE that reads from a block of memory.
+ * This is either memory owned by the caller (which must outlive the
+ * U4FILE), a memory mapped file, or a whole zip entry inflated at once.
+ * Seeking is free and span() gives direct access to the bytes.
  */
-class U4FILE_zip : public U4FILE {
+class U4FILE_mem : public U4FILE {
 public:
-    static U4FILE *open(const string &fname, const U4ZipPackage *package);
+    static U4FILE *open(const void* data, size_t size);
+    static U4FILE *openMapped(const char* fname);
+    static U4FILE *openZip(const string &fname, const U4ZipPackage *package);
 
     virtual void close();
     virtual int seek(long offset, int whence);
@@ -48,9 +60,20 @@ public:
     virtual int getc();
     virtual int putc(int c);
     virtual long length();
+    virtual const uint8_t* span(long count);
 
 private:
-    unzFile zfile;
+    enum Owner {
+        MEM_USER,
+        MEM_MALLOC,
+        MEM_MMAP
+    };
+
+    const uint8_t *data;
+    long size;
+    long pos;
+    int owner;
+    void* mapHandle;
 };
 
 /**
@@ -205,12 +228,6 @@ bool u4isUpgradeInstalled() {
     return upgradeFlags & UPG_INST;
 }
 
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <sys/stat.h>
-#endif
-
 /**
  * Returns true if the file exists and is readable by the user.
  */
@@ -357,6 +374,14 @@ U4ZipPackageMgr::~U4ZipPackageMgr() {
         delete *i;
 }
 
+/**
+ * Return a pointer to the next count bytes and advance past them, or NULL
+ * if the file does not provide direct access.
+ */
+const uint8_t* U4FILE::span(long) {
+    return NULL;
+}
+
 int U4FILE::getshort() {
     int byteLow = getc();
     return byteLow | (getc() << 8);
@@ -407,12 +432,48 @@ long U4FILE_stdio::length() {
     return len;
 }
 
+U4FILE *U4FILE_mem::open(const void* data, size_t size) {
+    U4FILE_mem *u4f = new U4FILE_mem;
+    u4f->data = (const uint8_t*) data;
+    u4f->size = size;
+    u4f->pos = 0;
+    u4f->owner = MEM_USER;
+    return u4f;
+}
+
+/**
+ * Memory map a file for reading.  Returns NULL if the file cannot be
+ * mapped (e.g. it is empty).
+ */
+U4FILE *U4FILE_mem::openMapped(const char* fname) {
+    U4FILE_mem *u4f;
+    const void* base;
+    size_t len;
+    void* handle;
+
+    base = fileMap_open(fname, &len, &handle);
+    if (! base)
+        return NULL;
+
+    u4f = new U4FILE_mem;
+    u4f->data = (const uint8_t*) base;
+    u4f->size = len;
+    u4f->pos = 0;
+    u4f->owner = MEM_MMAP;
+    u4f->mapHandle = handle;
+    return u4f;
+}
+
 /**
- * Opens a file from within a zip archive.
+ * Opens a file from within a zip archive.  The whole entry is inflated
+ * at once so that seeking does not need to re-read the stream.
  */
-U4FILE *U4FILE_zip::open(const string &fname, const U4ZipPackage *package) {
-    U4FILE_zip *u4f;
+U4FILE *U4FILE_mem::openZip(const string &fname, const U4ZipPackage *package) {
+    U4FILE_mem *u4f;
+    unz_file_info info;
+    uint8_t* buf;
     unzFile f;
+    int n;
 
     f = unzOpen(package->getFilename().c_str());
     if (!f)
@@ -420,81 +481,98 @@ U4FILE *U4FILE_zip::open(const string &fname, const U4ZipPackage *package) {
 
     string pathname = package->getInternalPath() + package->translate(fname);
 
-    if (unzLocateFile(f, pathname.c_str(), 2) == UNZ_END_OF_LIST_OF_FILE) {
+    if (unzLocateFile(f, pathname.c_str(), 2) != UNZ_OK ||
+        unzGetCurrentFileInfo(f, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK ||
+        unzOpenCurrentFile(f) != UNZ_OK) {
         unzClose(f);
         return NULL;
     }
-    unzOpenCurrentFile(f);
 
-    u4f = new U4FILE_zip;
-    u4f->zfile = f;
+    buf = (uint8_t*) malloc(info.uncompressed_size ? info.uncompressed_size : 1);
+    if (! buf) {
+        unzCloseCurrentFile(f);
+        unzClose(f);
+        return NULL;
+    }
+    n = unzReadCurrentFile(f, buf, info.uncompressed_size);
+    unzCloseCurrentFile(f);
+    unzClose(f);
+    if (n != (int) info.uncompressed_size) {
+        free(buf);
+        return NULL;
+    }
 
+    u4f = new U4FILE_mem;
+    u4f->data = buf;
+    u4f->size = info.uncompressed_size;
+    u4f->pos = 0;
+    u4f->owner = MEM_MALLOC;
     return u4f;
 }
 
-void U4FILE_zip::close() {
-    unzClose(zfile);
+void U4FILE_mem::close() {
+    switch (owner) {
+    case MEM_MALLOC:
+        free((void*) data);
+        break;
+    case MEM_MMAP:
+        fileMap_close(data, size, mapHandle);
+        break;
+    }
+    data = NULL;
 }
 
-int U4FILE_zip::seek(long offset, int whence) {
-    char *buf;
-    long pos;
-
-    ASSERT(whence != SEEK_END, "seeking with whence == SEEK_END not allowed with zipfiles");
-    pos = unztell(zfile);
-    if (whence == SEEK_CUR)
-        offset = pos + offset;
-    if (offset == pos)
-        return 0;
-    if (offset < pos) {
-        unzCloseCurrentFile(zfile);
-        unzOpenCurrentFile(zfile);
-        pos = 0;
+int U4FILE_mem::seek(long offset, int whence) {
+    switch (whence) {
+    case SEEK_CUR:
+        offset += pos;
+        break;
+    case SEEK_END:
+        offset += size;
+        break;
     }
-    ASSERT(offset - pos > 0, "error in U4FILE_zip::seek");
-    buf = new char[offset - pos];
-    unzReadCurrentFile(zfile, buf, offset - pos);
-    delete [] buf;
+    if (offset < 0 || offset > size)
+        return -1;
+    pos = offset;
     return 0;
 }
 
-long U4FILE_zip::tell() {
-    return unztell(zfile);
+long U4FILE_mem::tell() {
+    return pos;
 }
 
-size_t U4FILE_zip::read(void *ptr, size_t size, size_t nmemb) {
-    size_t retval = unzReadCurrentFile(zfile, ptr, size * nmemb);
-    if (retval > 0)
-        retval = retval / size;
-
-    return retval;
+size_t U4FILE_mem::read(void *ptr, size_t size, size_t nmemb) {
+    size_t avail = this->size - pos;
+    if (! size)
+        return 0;
+    if (nmemb > avail / size)
+        nmemb = avail / size;
+    memcpy(ptr, data + pos, size * nmemb);
+    pos += size * nmemb;
+    return nmemb;
 }
 
-int U4FILE_zip::getc() {
-    int retval;
-    unsigned char c;
-
-    if (unzReadCurrentFile(zfile, &c, 1) > 0)
-        retval = c;
-    else
-        retval = EOF;
-
-    return retval;
+int U4FILE_mem::getc() {
+    if (pos < size)
+        return data[pos++];
+    return EOF;
 }
 
-int U4FILE_zip::putc(int c) {
-    ASSERT(0, "zipfiles must be read-only!");
-    return c;
+int U4FILE_mem::putc(int) {
+    return EOF;
 }
 
-long U4FILE_zip::length() {
-    unz_file_info fileinfo;
+long U4FILE_mem::length() {
+    return size;
+}
 
-    unzGetCurrentFileInfo(zfile, &fileinfo,
-                          NULL, 0,
-                          NULL, 0,
-                          NULL, 0);
-    return fileinfo.uncompressed_size;
+const uint8_t* U4FILE_mem::span(long count) {
+    const uint8_t* ptr;
+    if (count < 0 || count > size - pos)
+        return NULL;
+    ptr = data + pos;
+    pos += count;
+    return ptr;
 }
 
 /**
@@ -521,7 +599,7 @@ U4FILE *u4fopen(const string &fname) {
      */
     const vector<U4ZipPackage *> &packages = u4zip_instance->packages;
     for (std::vector<U4ZipPackage *>::const_reverse_iterator j = packages.rbegin(); j != packages.rend(); j++) {
-        u4f = U4FILE_zip::open(fname, *j);
+        u4f = U4FILE_mem::openZip(fname, *j);
         if (u4f) {
             if (verbose) {
                 printf("%s found in %s\n", fname.c_str(),
@@ -554,7 +632,9 @@ U4FILE *u4fopen(const string &fname) {
     }
 
     if (!pathname.empty()) {
-        u4f = U4FILE_stdio::open(pathname.c_str());
+        u4f = U4FILE_mem::openMapped(pathname.c_str());
+        if (! u4f)
+            u4f = U4FILE_stdio::open(pathname.c_str());
         if (verbose && u4f != NULL)
             printf("%s successfully opened\n", pathname.c_str());
     }
@@ -570,11 +650,19 @@ U4FILE *u4fopen_stdio(const char* fname) {
     return U4FILE_stdio::open(fname);
 }
 
+/**
+ * Wraps a block of memory in a U4FILE.  The memory is not copied and must
+ * remain valid until the U4FILE is closed.
+ */
+U4FILE *u4fopen_mem(const void* data, size_t size) {
+    return U4FILE_mem::open(data, size);
+}
+
 /**
  * Opens a file from a zipfile and wraps it in a U4FILE.
  */
 U4FILE *u4fopen_zip(const string &fname, U4ZipPackage *package) {
-    return U4FILE_zip::open(fname, package);
+    return U4FILE_mem::openZip(fname, package);
 }
 
 /**
@@ -616,6 +704,22 @@ long u4flength(U4FILE *f) {
     return f->length();
 }
 
+/**
+ * Return a pointer to the next count bytes of a file and advance past them.
+ * If the file does not provide direct access then the bytes are read into
+ * buf (which may be NULL to only accept direct access).
+ *
+ * Returns NULL if fewer than count bytes remain.
+ */
+const uint8_t* u4fspan(U4FILE *f, long count, void *buf) {
+    const uint8_t* ptr = f->span(count);
+    if (! ptr && buf) {
+        if (f->read(buf, 1, count) == size_t(count))
+            ptr = (const uint8_t*) buf;
+    }
+    return ptr;
+}
+
 /**
  * Read a series of zero terminated strings from a file.  The strings
  * are read from the given offset, or the current file position if
@@ -630,6 +734,26 @@ vector<string> u4read_stringtable(U4FILE *f, long offset, int nstrings) {
 
     if (offset != -1)
         f->seek(offset, SEEK_SET);
+
+    // Scan the strings in place when the file has direct access.
+    const uint8_t* start = f->span(0);
+    if (start) {
+        const char* it  = (const char*) start;
+        const char* end = it + (f->length() - f->tell());
+        const char* term;
+
+        strs.reserve(nstrings);
+        for (i = 0; i < nstrings; i++) {
+            term = (const char*) memchr(it, '\0', end - it);
+            if (! term)
+                term = end;
+            strs.push_back(string(it, term));
+            it = (term == end) ? end : term + 1;
+        }
+        f->seek(it - (const char*) start, SEEK_CUR);
+        return strs;
+    }
+
     for (i = 0; i < nstrings; i++) {
         char c;
         buffer.erase();
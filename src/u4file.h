@@ -5,6 +5,7 @@
 #ifndef U4FILE_H
 #define U4FILE_H
 
+#include <stdint.h>
 #include <map>
 #include <string>
 #include <vector>
@@ -51,6 +52,7 @@ public:
     virtual int getc() = 0;
     virtual int putc(int c) = 0;
     virtual long length() = 0;
+    virtual const uint8_t* span(long count);
 
     int getshort();
 };
@@ -84,6 +86,7 @@ bool u4isUpgradeAvailable();
 bool u4isUpgradeInstalled();
 U4FILE *u4fopen(const std::string &fname);
 U4FILE *u4fopen_stdio(const char* fname);
+U4FILE *u4fopen_mem(const void* data, size_t size);
 U4FILE *u4fopen_zip(const std::string &fname, U4ZipPackage *package);
 void u4fclose(U4FILE *f);
 int u4fseek(U4FILE *f, long offset, int whence);
@@ -93,6 +96,7 @@ int u4fgetc(U4FILE *f);
 int u4fgetshort(U4FILE *f);
 int u4fputc(int c, U4FILE *f);
 long u4flength(U4FILE *f);
+const uint8_t* u4fspan(U4FILE *f, long count, void *buf);
 std::vector<std::string> u4read_stringtable(U4FILE *f, long offset, int nstrings);
 
 std::string u4find_path(const char* fname,
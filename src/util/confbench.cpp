@@ -0,0 +1,158 @@
+// Compare loading the module configuration from text against loading the
+// serialized form stored in the module, and evaluating a script command
+// from text against running the block cached by Config::scriptEvalArg().
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <boron/boron.h>
+
+#include "cdi.h"
+
+#define EX_USAGE    64  /* command line usage error */
+#define EX_DATAERR  65  /* data format error */
+#define EX_NOINPUT  66  /* cannot open input */
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void reportError(UThread* ut) {
+    UBuffer str;
+    ur_strInit(&str, UR_ENC_UTF8, 0);
+    ur_toText(ut, ur_exception(ut), &str);
+    ur_strTermNull(&str);
+    fprintf(stderr, "%s\n", str.ptr.c);
+    ur_strFree(&str);
+}
+
+static void printTime(const char* name, double sec, int loops) {
+    printf("  %-22s %10.1f\n", name, sec * 1e6 / loops);
+}
+
+int main(int argc, char** argv) {
+    const char* modFile = "Ultima-IV.mod";
+    const char* command = "select [weapons 1 armor 2 food 3] 'food";
+    CDIMapping pak;
+    const CDIEntry* ent;
+    const uint8_t* chunk;
+    UEnvParameters param;
+    UThread* ut;
+    UBuffer text;
+    UCell cell;
+    UCell* res;
+    UIndex blkN;
+    double start, textTime, binTime;
+    int cmdLen = strlen(command);
+    int i, loops = 200;
+
+    if (argc > 1) {
+        if (argv[1][0] == '-') {
+            fprintf(stderr, "Usage: %s [<module>] [<loops>]\n", argv[0]);
+            return EX_USAGE;
+        }
+        modFile = argv[1];
+        if (argc > 2)
+            loops = atoi(argv[2]);
+    }
+    if (loops < 1)
+        loops = 1;
+
+    if (! cdi_mapPak(&pak, modFile)) {
+        fprintf(stderr, "Cannot open module %s\n", modFile);
+        return EX_NOINPUT;
+    }
+    ent = cdi_findAppId(pak.toc, CDI_TOC_SIZE((&pak.header)),
+                        CDI32('C','O','N','F'));
+    chunk = ent ? cdi_mappedChunk(&pak, ent) : NULL;
+    if (! chunk) {
+        fprintf(stderr, "Module CONF not found\n");
+        return EX_DATAERR;
+    }
+
+    ut = boron_makeEnv(boron_envParam(&param));
+    if (! ut) {
+        fprintf(stderr, "boron_makeEnv failed\n");
+        return EX_USAGE;
+    }
+
+    // Recreate the config text from the serialized form.
+    res = ur_stackTop(ut);
+    if (ur_unserialize(ut, chunk, chunk + ent->bytes, res) != UR_OK) {
+        reportError(ut);
+        return EX_DATAERR;
+    }
+    ur_strInit(&text, UR_ENC_UTF8, 0);
+    ur_toText(ut, res, &text);
+    ur_recycle(ut);
+
+    printf("CONF %u bytes serialized, %d bytes as text\n",
+           ent->bytes, text.used);
+    printf("  %-22s %10s\n", "Method", "Usec");
+
+    // The first pass is the cold start the game sees.
+    start = seconds();
+    if (! ur_tokenize(ut, text.ptr.c, text.ptr.c + text.used, &cell)) {
+        reportError(ut);
+        return EX_DATAERR;
+    }
+    textTime = seconds() - start;
+    ur_recycle(ut);
+
+    start = seconds();
+    ur_unserialize(ut, chunk, chunk + ent->bytes, res);
+    binTime = seconds() - start;
+    ur_recycle(ut);
+
+    printTime("Text config (cold)", textTime, 1);
+    printTime("Serialized (cold)", binTime, 1);
+
+    start = seconds();
+    for (i = 0; i < loops; ++i) {
+        ur_tokenize(ut, text.ptr.c, text.ptr.c + text.used, &cell);
+        ur_recycle(ut);
+    }
+    textTime = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < loops; ++i) {
+        ur_unserialize(ut, chunk, chunk + ent->bytes, res);
+        ur_recycle(ut);
+    }
+    binTime = seconds() - start;
+
+    printTime("Text config", textTime, loops);
+    printTime("Serialized", binTime, loops);
+
+    // Script command evaluation.
+    loops *= 100;
+
+    start = seconds();
+    for (i = 0; i < loops; ++i) {
+        if (! boron_evalUtf8(ut, command, cmdLen)) {
+            reportError(ut);
+            return EX_DATAERR;
+        }
+    }
+    textTime = seconds() - start;
+
+    blkN = ur_tokenize(ut, command, command + cmdLen, &cell);
+    boron_bindDefault(ut, blkN);
+    ur_hold(blkN);
+
+    start = seconds();
+    for (i = 0; i < loops; ++i)
+        boron_doBlock(ut, &cell, ur_stackTop(ut));
+    binTime = seconds() - start;
+
+    printTime("Text command", textTime, loops);
+    printTime("Cached block", binTime, loops);
+
+    ur_strFree(&text);
+    boron_freeEnv(ut);
+    cdi_unmapPak(&pak);
+    return 0;
+}
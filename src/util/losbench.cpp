@@ -0,0 +1,208 @@
+// Compare the speed & output of the line of sight functions.
+//
+// With no arguments random grids are used, otherwise the view is placed at
+// every position of the given Ultima IV map files (WORLD.MAP, *.ULT, *.CON).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// The benchmark does its own timing without the profiler library.
+#undef ENABLE_PROFILE
+#include "los.cpp"
+
+#define EX_USAGE    64  /* command line usage error */
+#define EX_NOINPUT  66  /* cannot open input */
+
+// Forest, mountains, secret door & brick wall.
+static bool opaqueTile(uint8_t t) {
+    return t == 0x06 || t == 0x08 || t == 0x49 || t == 0x7f;
+}
+
+struct Grids {
+    int w, h, count;
+    std::vector<uint8_t>  cells;    // count * w * h
+    std::vector<uint64_t> rows;     // count * h
+};
+
+static void addGrid(Grids& g, const uint8_t* cells) {
+    size_t n = g.cells.size();
+    g.cells.insert(g.cells.end(), cells, cells + g.w * g.h);
+    g.rows.resize(size_t(g.count + 1) * g.h);
+    los_pack(&g.cells[n], &g.rows[size_t(g.count) * g.h], g.w, g.h);
+    ++g.count;
+}
+
+static void randomGrids(Grids& g, int count) {
+    std::vector<uint8_t> cells(g.w * g.h);
+    uint32_t seed = 1;
+    int i, density;
+
+    while (count--) {
+        seed = seed * 1103515245 + 12345;
+        density = (seed >> 16) % 60;
+        for (i = 0; i < g.w * g.h; ++i) {
+            seed = seed * 1103515245 + 12345;
+            cells[i] = ((seed >> 16) % 100) < uint32_t(density);
+        }
+        addGrid(g, &cells[0]);
+    }
+}
+
+/*
+ * Read a map file and add the view around every position on it.
+ * Return false if the file cannot be read.
+ */
+static bool mapGrids(Grids& g, const char* file) {
+    const char* ext = strrchr(file, '.');
+    std::vector<uint8_t> tiles;
+    std::vector<uint8_t> cells(g.w * g.h);
+    uint8_t* cp;
+    int mw, mh, offset, x, y, vx, vy, mx, my;
+    bool wrap = false;
+    FILE* fp;
+
+    if (ext && strcasecmp(ext, ".map") == 0) {
+        mw = mh = 256;
+        offset = 0;
+        wrap = true;
+    } else if (ext && strcasecmp(ext, ".con") == 0) {
+        mw = mh = 11;
+        offset = 64;
+    } else {
+        mw = mh = 32;
+        offset = 0;
+    }
+
+    fp = fopen(file, "rb");
+    if (! fp)
+        return false;
+    tiles.resize(mw * mh);
+    fseek(fp, offset, SEEK_SET);
+    if (fread(&tiles[0], 1, tiles.size(), fp) != tiles.size()) {
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    if (wrap) {
+        // WORLD.MAP is stored as 8x8 chunks of 32x32 tiles.
+        std::vector<uint8_t> chunked(tiles);
+        for (y = 0; y < mh; ++y) {
+            for (x = 0; x < mw; ++x) {
+                tiles[y * mw + x] = chunked[((y / 32) * 8 + x / 32) * 1024 +
+                                            (y % 32) * 32 + x % 32];
+            }
+        }
+    }
+
+    for (y = 0; y < mh; ++y) {
+        for (x = 0; x < mw; ++x) {
+            cp = &cells[0];
+            for (vy = 0; vy < g.h; ++vy) {
+                for (vx = 0; vx < g.w; ++vx) {
+                    mx = x + vx - g.w / 2;
+                    my = y + vy - g.h / 2;
+                    if (wrap) {
+                        mx = (mx + mw) % mw;
+                        my = (my + mh) % mh;
+                    } else if (mx < 0 || my < 0 || mx >= mw || my >= mh) {
+                        *cp++ = 0;
+                        continue;
+                    }
+                    *cp++ = opaqueTile(tiles[my * mw + mx]);
+                }
+            }
+            addGrid(g, &cells[0]);
+        }
+    }
+    return true;
+}
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Run the byte & bitboard versions of an algorithm over all the grids.
+ * Return the number of grids for which they differ.
+ */
+static int compare(const char* name, const Grids& g,
+                   void (*byteFunc)(const uint8_t*, uint8_t*, int, int),
+                   void (*bitsFunc)(const uint64_t*, uint64_t*, int, int)) {
+    const int cellCount = g.w * g.h;
+    std::vector<uint8_t> byteOut(size_t(g.count) * cellCount);
+    std::vector<uint64_t> bitsOut(size_t(g.count) * g.h);
+    std::vector<uint8_t> unpacked(cellCount);
+    double start, byteTime, bitsTime;
+    int i, diff = 0;
+
+    start = seconds();
+    for (i = 0; i < g.count; ++i)
+        byteFunc(&g.cells[size_t(i) * cellCount],
+                 &byteOut[size_t(i) * cellCount], g.w, g.h);
+    byteTime = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < g.count; ++i)
+        bitsFunc(&g.rows[size_t(i) * g.h], &bitsOut[size_t(i) * g.h],
+                 g.w, g.h);
+    bitsTime = seconds() - start;
+
+    for (i = 0; i < g.count; ++i) {
+        los_unpack(&bitsOut[size_t(i) * g.h], &unpacked[0], g.w, g.h);
+        if (memcmp(&unpacked[0], &byteOut[size_t(i) * cellCount], cellCount))
+            ++diff;
+    }
+
+    printf("  %-9s %10.1f %10.1f %8d\n", name,
+           byteTime * 1e9 / g.count, bitsTime * 1e9 / g.count, diff);
+    return diff;
+}
+
+int main(int argc, char** argv) {
+    Grids g;
+    int i, diff = 0;
+
+    g.w = g.h = 11;
+    g.count = 0;
+
+    i = 1;
+    if (argc > 2 && strcmp(argv[1], "-v") == 0) {
+        if (sscanf(argv[2], "%dx%d", &g.w, &g.h) != 2 ||
+            g.w < 3 || g.h < 3 || g.w > LOS_MAX_W || g.h > LOS_MAX_H ||
+            ! (g.w & g.h & 1)) {
+            fprintf(stderr, "Invalid view size %s\n", argv[2]);
+            return EX_USAGE;
+        }
+        i = 3;
+    } else if (argc > 1 && argv[1][0] == '-') {
+        fprintf(stderr, "Usage: %s [-v <width>x<height>] [map files]\n",
+                argv[0]);
+        return EX_USAGE;
+    }
+
+    if (i == argc) {
+        randomGrids(g, 100000);
+        printf("%d random %dx%d grids\n", g.count, g.w, g.h);
+    } else {
+        int mapCount = argc - i;
+        for (; i < argc; ++i) {
+            if (! mapGrids(g, argv[i])) {
+                fprintf(stderr, "Cannot read %s\n", argv[i]);
+                return EX_NOINPUT;
+            }
+        }
+        printf("%d %dx%d views from %d maps\n", g.count, g.w, g.h, mapCount);
+    }
+
+    printf("  %-9s %10s %10s %8s\n", "Mode", "Byte ns", "Bits ns", "Differ");
+    diff += compare("DOS", g, los_dos, los_bitsDOS);
+    if (g.w <= 11 && g.h <= 11)
+        diff += compare("Enhanced", g, los_enhanced, los_bitsEnhanced);
+
+    return diff ? 1 : 0;
+}
@@ -0,0 +1,420 @@
+// Compare the speed & output of the LZW decoders against the reference
+// decoders they replaced (util/lzwref.cpp).
+//
+// Files are U4 LZW (title.ega, tree.ega, etc.) unless they follow the -5
+// option, which marks U5 LZW files (with the 4 byte size header).  With no
+// files, generated 320x200 4-bit images are encoded and decoded both ways.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "lzw/lzw.h"
+#include "lzw/u6decode.h"
+extern "C" {
+#include "lzw/hash.h"
+}
+
+namespace LzwRef {
+long u4Decompress(unsigned char* compressedMem, long compressedSize,
+                  unsigned char** decompressedMem);
+int u5Decompress(unsigned char *source, long source_length,
+                 unsigned char *destination, long destination_length);
+}
+
+#define EX_USAGE    64  /* command line usage error */
+#define EX_DATAERR  65  /* data format error */
+#define EX_NOINPUT  66  /* cannot open input */
+#define EX_SOFTWARE 70  /* internal software error */
+
+typedef std::vector<uint8_t> Buffer;
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readFile(const char* file, Buffer& buf) {
+    FILE* fp = fopen(file, "rb");
+    if (! fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    buf.resize(ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    size_t n = buf.empty() ? 0 : fread(&buf[0], 1, buf.size(), fp);
+    fclose(fp);
+    return n == buf.size();
+}
+
+/*
+ * The same checks as the old mightBeValidCompressedFile() and
+ * U6Decode::is_valid_lzw_file().
+ */
+static bool validU4(const Buffer& comp) {
+    long bits = long(comp.size()) * 8;
+    return (bits % 12 == 0 || (bits - 4) % 12 == 0) && (comp[0] >> 4) == 0;
+}
+
+static bool validU5(const Buffer& comp) {
+    return comp[3] == 0 && comp[4] == 0 && (comp[5] & 1);
+}
+
+//----------------------------------------------------------------------------
+// Encoders for the generated images.
+
+struct BitWriter {
+    Buffer out;
+    long bits;
+
+    BitWriter() : bits(0) {}
+
+    // U4 codewords are 12 bits, most significant bit first.
+    void put12(int code) {
+        if (bits & 7) {
+            out.back() |= code >> 8;
+            out.push_back(code & 0xff);
+        } else {
+            out.push_back(code >> 4);
+            out.push_back((code & 15) << 4);
+        }
+        bits += 12;
+    }
+
+    // U5 codewords are 9 to 12 bits, least significant bit first.
+    void putLSB(int code, int size) {
+        for (int i = 0; i < size; ++i, ++bits) {
+            if ((bits >> 3) >= long(out.size()))
+                out.push_back(0);
+            if ((code >> i) & 1)
+                out.back() |= 1 << (bits & 7);
+        }
+    }
+};
+
+/*
+ * Encode the way Ultima 4 does, with the dictionary as a hash table of
+ * (prefix codeword, root) pairs.
+ */
+struct U4Dict {
+    int prefix[0x1000];
+    int root[0x1000];
+    bool used[0x1000];
+    int entries;
+
+    void clear() {
+        memset(used, 0, sizeof(used));
+        entries = 0;
+    }
+
+    // Return the slot of the (w, c) pair or where it would be added.
+    int slot(int w, int c) const {
+        int hc = probe1(c, w);
+        if (hc <= 0xff || (used[hc] && (prefix[hc] != w || root[hc] != c))) {
+            hc = probe2(c, w);
+            while (hc <= 0xff ||
+                   (used[hc] && (prefix[hc] != w || root[hc] != c)))
+                hc = probe3(hc);
+        }
+        return hc;
+    }
+
+    // Return true if the dictionary is full.
+    bool add(int hc, int w, int c) {
+        used[hc] = true;
+        prefix[hc] = w;
+        root[hc] = c;
+        return ++entries > 0xccc;
+    }
+};
+
+static void encodeU4(const Buffer& data, Buffer& comp) {
+    U4Dict dict;
+    BitWriter bw;
+    size_t i;
+    int w, c, hc;
+    bool full = false;
+
+    dict.clear();
+    w = data[0];
+    for (i = 1; i < data.size(); ++i) {
+        c = data[i];
+        hc = dict.slot(w, c);
+        if (dict.used[hc]) {
+            w = hc;
+            continue;
+        }
+
+        bw.put12(w);
+        if (full) {
+            // The decoder adds its last entry for w, clears the dictionary
+            // and reads the next codeword as a root.  The entry after that
+            // pairs the root with the first character of the next string.
+            dict.clear();
+            full = false;
+            bw.put12(c);
+            if (++i >= data.size()) {
+                comp.swap(bw.out);
+                return;
+            }
+            w = c;
+            c = data[i];
+            dict.add(dict.slot(w, c), w, c);
+        } else {
+            full = dict.add(hc, w, c);
+        }
+        w = c;
+    }
+    bw.put12(w);
+    comp.swap(bw.out);
+}
+
+/*
+ * Encode the way Ultima 5 does, with variable size codewords, 0x100 to
+ * clear the dictionary and 0x101 to end.
+ */
+static void encodeU5(const Buffer& data, Buffer& comp) {
+    std::vector<int> child;
+    BitWriter bw;
+    int next = 0, size = 0, limit = 0;
+    int w, k;
+    size_t i;
+
+    for (i = 0; i < 4; ++i)
+        bw.out.push_back(data.size() >> (i * 8));
+    bw.bits = 32;
+
+#define U5_RESET \
+    child.assign(0x1000 * 256, -1); \
+    next = 0x102; \
+    size = 9; \
+    limit = 0x200
+
+    U5_RESET;
+    bw.putLSB(0x100, size);
+    w = data[0];
+    for (i = 1; i < data.size(); ++i) {
+        int c = data[i];
+        k = child[w * 256 + c];
+        if (k >= 0) {
+            w = k;
+            continue;
+        }
+        bw.putLSB(w, size);
+        // The decoder adds each entry one codeword later than this.
+        child[w * 256 + c] = next++;
+        if (next > limit && size < 12) {
+            ++size;
+            limit *= 2;
+        }
+        if (next >= 0xfff) {
+            bw.putLSB(0x100, size);
+            U5_RESET;
+        }
+        w = c;
+    }
+    bw.putLSB(w, size);
+    bw.putLSB(0x101, size);
+    comp.swap(bw.out);
+}
+
+/*
+ * Make a 320x200 4-bit image of blocks, diagonal lines & noise.
+ */
+static void makeImage(Buffer& img, uint32_t seed) {
+    img.resize(32000);
+    for (size_t i = 0; i < img.size(); ++i) {
+        int x = i % 160;
+        int y = i / 160;
+        uint8_t c = ((x / 6) ^ (y / 9)) & 1 ? 0x11 : 0x88;
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 13 == 0)
+            c = (seed >> 20) & 0xff;
+        if (((x + y) & 15) == 0)
+            c = 0xff;
+        img[i] = c;
+    }
+}
+
+//----------------------------------------------------------------------------
+
+struct Result {
+    long rawLen;
+    double refTime;
+    double newTime;
+    double knownTime;   // U4 only
+    bool same;
+};
+
+static void benchU4(Buffer& comp, int loops, Result& res) {
+    uint8_t* ref;
+    uint8_t* out;
+    double start;
+    long refLen, len;
+    int i;
+
+    refLen = LzwRef::u4Decompress(&comp[0], comp.size(), &ref);
+    len = lzwDecompressAlloc(&comp[0], comp.size(), &out);
+    res.rawLen = refLen;
+    res.same = (refLen > 0 && len == refLen && memcmp(ref, out, len) == 0);
+    if (len > 0)
+        free(out);
+
+    // The game knows the image size, so also decode into a fixed buffer.
+    if (res.same) {
+        out = (uint8_t*) malloc(refLen);
+        len = lzwDecompress(&comp[0], comp.size(), out, refLen);
+        res.same = (len == refLen && memcmp(ref, out, len) == 0);
+        free(out);
+    }
+    if (refLen > 0)
+        free(ref);
+
+    start = seconds();
+    for (i = 0; i < loops; ++i) {
+        if (LzwRef::u4Decompress(&comp[0], comp.size(), &ref) > 0)
+            free(ref);
+    }
+    res.refTime = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < loops; ++i) {
+        if (lzwDecompressAlloc(&comp[0], comp.size(), &out) >= 0)
+            free(out);
+    }
+    res.newTime = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < loops; ++i) {
+        out = (uint8_t*) malloc(refLen);
+        lzwDecompress(&comp[0], comp.size(), out, refLen);
+        free(out);
+    }
+    res.knownTime = seconds() - start;
+}
+
+static void benchU5(Buffer& comp, int loops, Result& res) {
+    Buffer ref, out;
+    double start;
+    long srcLen = comp.size() - 4;
+    int i, refStatus, status;
+
+    // The reference decoder reads up to two bytes past the end.
+    comp.resize(comp.size() + 2, 0);
+
+    res.rawLen = comp[0] | (comp[1] << 8) | (comp[2] << 16) | (comp[3] << 24);
+    res.knownTime = 0.0;
+    ref.resize(res.rawLen);
+    out.resize(res.rawLen);
+
+    refStatus = LzwRef::u5Decompress(&comp[4], srcLen,
+                                     &ref[0], res.rawLen);
+    status = U6Decode::lzw_decompress(&comp[4], srcLen,
+                                      &out[0], res.rawLen);
+    res.same = (refStatus == EXIT_SUCCESS && status == EXIT_SUCCESS &&
+                ref == out);
+
+    start = seconds();
+    for (i = 0; i < loops; ++i)
+        LzwRef::u5Decompress(&comp[4], srcLen, &ref[0], res.rawLen);
+    res.refTime = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < loops; ++i)
+        U6Decode::lzw_decompress(&comp[4], srcLen,
+                                 &out[0], res.rawLen);
+    res.newTime = seconds() - start;
+}
+
+static void printResult(const char* name, const char* type, size_t compLen,
+                        const Result& res, int loops) {
+    double usec = 1e6 / loops;
+    printf("%-20s %s %6zu %6ld %9.1f %9.1f", name, type, compLen, res.rawLen,
+           res.refTime * usec, res.newTime * usec);
+    if (res.knownTime > 0.0)
+        printf(" %9.1f", res.knownTime * usec);
+    else
+        printf(" %9s", "-");
+    printf("  %s\n", res.same ? "same" : "DIFFERENT");
+}
+
+static void printHeader() {
+    printf("%-20s %s %6s %6s %9s %9s %9s\n", "File", "LZW", "Comp", "Raw",
+           "Ref us", "New us", "Sized us");
+}
+
+int main(int argc, char** argv) {
+    Buffer comp;
+    Result res;
+    int loops = 200;
+    int fileCount = 0;
+    int diffCount = 0;
+    bool u5 = false;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            loops = atoi(argv[++i]);
+            if (loops < 1)
+                loops = 1;
+        } else if (strcmp(argv[i], "-5") == 0) {
+            u5 = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [-l <loops>] [<file> ...] "
+                            "[-5 <u5-file> ...]\n", argv[0]);
+            return EX_USAGE;
+        } else {
+            if (! readFile(argv[i], comp) || comp.size() < 6) {
+                fprintf(stderr, "Cannot read %s\n", argv[i]);
+                return EX_NOINPUT;
+            }
+            if (u5 ? ! validU5(comp) : ! validU4(comp)) {
+                fprintf(stderr, "%s is not a U%d LZW file\n", argv[i],
+                        u5 ? 5 : 4);
+                return EX_DATAERR;
+            }
+            if (! fileCount)
+                printHeader();
+            ++fileCount;
+
+            const char* name = strrchr(argv[i], '/');
+            name = name ? name + 1 : argv[i];
+            if (u5) {
+                benchU5(comp, loops, res);
+                printResult(name, "U5", comp.size(), res, loops);
+            } else {
+                benchU4(comp, loops, res);
+                printResult(name, "U4", comp.size(), res, loops);
+            }
+            if (! res.same)
+                ++diffCount;
+        }
+    }
+
+    if (! fileCount) {
+        Buffer img;
+        char name[16];
+
+        printHeader();
+        for (uint32_t seed = 1; seed < 9; ++seed) {
+            makeImage(img, seed);
+            snprintf(name, sizeof(name), "generated-%u", seed);
+
+            encodeU4(img, comp);
+            benchU4(comp, loops, res);
+            res.same = res.same && res.rawLen == long(img.size());
+            printResult(name, "U4", comp.size(), res, loops);
+            if (! res.same)
+                ++diffCount;
+
+            encodeU5(img, comp);
+            benchU5(comp, loops, res);
+            printResult(name, "U5", comp.size(), res, loops);
+            if (! res.same)
+                ++diffCount;
+        }
+    }
+
+    return diffCount ? EX_SOFTWARE : 0;
+}
@@ -0,0 +1,469 @@
+/*
+ *  lzwref.cpp - Reference LZW decoders for lzwbench
+ *
+ *  Copyright (C) 2002, 2005  Marc Winterrowd
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * These are the decoders which lzw/lzw.c and lzw/u6decode.cpp replaced.
+ * They are moved into a namespace and some comments are trimmed, but they
+ * work exactly as before.  The U4 decoder runs twice (once to find the size
+ * and once to output) and both build each string on a stack one character
+ * at a time.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "lzw/hash.h"
+}
+
+namespace LzwRef {
+
+long u4Decompress(unsigned char* compressedMem, long compressedSize,
+                  unsigned char** decompressedMem);
+int u5Decompress(unsigned char *source, long source_length,
+                 unsigned char *destination, long destination_length);
+
+/* --------------------------------------------------------------------------------------
+   Ultima 4
+   -------------------------------------------------------------------------------------- */
+
+typedef void (*WRITE_DECOMP)(unsigned char root, unsigned char *destination, long* position);
+
+typedef struct _lzwDictionaryEntry
+{
+    unsigned char root;
+    int codeword;
+    unsigned char occupied;
+} lzwDictionaryEntry;
+
+/* read the next 12-bit codeword from the compressed data */
+static int getNextCodeword(long* bitsRead, unsigned char *compressedMem)
+{
+    int codeword = (compressedMem[(*bitsRead)/8] << 8) + compressedMem[(*bitsRead)/8+1];
+    codeword = codeword >> (4-((*bitsRead)%8));
+    codeword = codeword & 0xfff;
+    (*bitsRead) += 12;
+
+    return(codeword);
+}
+
+/* increment position pointer, but do not write root to memory */
+static void discardRoot(unsigned char root, unsigned char *destination, long* position)
+{
+    (*position)++;
+}
+
+/* output a root to memory */
+static void outputRoot(unsigned char root, unsigned char *destination, long* position)
+{
+    destination[*position] = root;
+    (*position)++;
+}
+
+/* pushes the string associated with codeword onto the stack */
+static void getString(int codeword, lzwDictionaryEntry *dictionary, unsigned char *stack, int *elementsInStack)
+{
+    unsigned char root;
+    int currentCodeword = codeword;
+
+    while (currentCodeword > 0xff)
+    {
+        root = dictionary[currentCodeword].root;
+        currentCodeword = dictionary[currentCodeword].codeword;
+        stack[*elementsInStack] = root;
+        (*elementsInStack)++;
+    }
+
+    /* push the root at the leaf */
+    stack[*elementsInStack] = (unsigned char)currentCodeword;
+    (*elementsInStack)++;
+}
+
+static unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDictionaryEntry* dictionary)
+{
+    if (hashCode > 0xff)   /* hash codes must not be roots */
+    {
+        unsigned char c1, c2 = 0, c3 = 0;
+
+        if (dictionary[hashCode].occupied)
+        {
+            /* hash table position is occupied */
+            c1 = 1;
+            /* is our (root,codeword) pair already in the hash table? */
+            c2 = dictionary[hashCode].root == root;
+            c3 = dictionary[hashCode].codeword == codeword;
+        }
+        else
+        {
+            /* hash table position is free */
+            c1 = 0;
+        }
+
+        return((!c1) || (c1 && c2 && c3));
+    }
+    else
+    {
+        return(0);
+    }
+}
+
+static int getNewHashCode (unsigned char root, int codeword, lzwDictionaryEntry *dictionary)
+{
+    int hashCode;
+
+    /* probe 1 */
+    hashCode = probe1(root, codeword);
+    if (hashPosFound(hashCode, root, codeword, dictionary)) {
+        return(hashCode);
+    }
+    /* probe 2 */
+    hashCode = probe2(root, codeword);
+    if (hashPosFound(hashCode, root, codeword, dictionary)) {
+        return(hashCode);
+    }
+    /* probe 3 */
+    do {
+        hashCode = probe3(hashCode);
+    }
+    while (! hashPosFound(hashCode, root, codeword, dictionary));
+
+    return(hashCode);
+}
+
+static long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
+{
+    int i;
+
+    /* re-initialize the dictionary when there are more than 0xccc entries */
+    const int maxDictEntries = 0xccc;
+
+    const int lzwStackSize = 0x8000;
+    const int lzwDictionarySize = 0x1000;
+
+    int old_code;
+    int new_code;
+    unsigned char character;
+
+    long bitsRead = 0;
+    long bytesWritten = 0;
+
+    int newpos;
+    unsigned char unknownCodeword;
+
+    /* initialize the dictionary and the stack */
+    lzwDictionaryEntry *lzwDictionary = (lzwDictionaryEntry *) malloc(sizeof(lzwDictionaryEntry) * lzwDictionarySize);
+    int codewordsInDictionary = 0;
+    unsigned char *lzwStack = (unsigned char *) malloc(sizeof(unsigned char) * lzwStackSize);
+    int elementsInStack = 0;
+
+    /* clear the dictionary */
+    memset(lzwDictionary, 0, sizeof(lzwDictionaryEntry) * lzwDictionarySize);
+    for (i = 0; i < 0x100; i++)
+    {
+        lzwDictionary[i].occupied = 1;
+    }
+
+    if (bitsRead + 12 <= compressedSize * 8)
+    {
+        old_code = getNextCodeword(&bitsRead, compressedMem);
+        character = (unsigned char)old_code;
+        outFunc(character, decompressedMem, &bytesWritten);
+
+        while (bitsRead + 12 <= compressedSize * 8)
+        {
+            new_code = getNextCodeword(&bitsRead, compressedMem);
+
+            if (lzwDictionary[new_code].occupied)
+            {
+                unknownCodeword = 0;
+                getString(new_code,lzwDictionary,lzwStack,&elementsInStack);
+            }
+            else
+            {
+                unknownCodeword = 1;
+                lzwStack[elementsInStack] = character;
+                elementsInStack++;
+                getString(old_code,lzwDictionary,lzwStack,&elementsInStack);
+            }
+
+            character = lzwStack[elementsInStack-1];
+
+            while (elementsInStack > 0)
+            {
+                outFunc(lzwStack[elementsInStack-1], decompressedMem, &bytesWritten);
+                elementsInStack--;
+            }
+
+            newpos = getNewHashCode(character,old_code,lzwDictionary);
+
+            lzwDictionary[newpos].root = character;
+            lzwDictionary[newpos].codeword = old_code;
+            lzwDictionary[newpos].occupied = 1;
+            codewordsInDictionary++;
+
+            if (unknownCodeword && (newpos != new_code))
+            {
+                free(lzwStack);
+                free(lzwDictionary);
+                return(-1);
+            }
+
+            if (codewordsInDictionary > maxDictEntries)
+            {
+                codewordsInDictionary = 0;
+                memset(lzwDictionary, 0, sizeof(lzwDictionaryEntry) * lzwDictionarySize);
+                for (i = 0; i < 0x100; i++)
+                {
+                    lzwDictionary[i].occupied = 1;
+                }
+
+                if (bitsRead + 12 <= compressedSize * 8)
+                {
+                    new_code = getNextCodeword(&bitsRead, compressedMem);
+                    character = (unsigned char)new_code;
+                    outFunc(character, decompressedMem, &bytesWritten);
+                }
+                else
+                {
+                    free(lzwStack);
+                    free(lzwDictionary);
+                    return(bytesWritten);
+                }
+            }
+
+            old_code = new_code;
+        }
+    }
+    free(lzwStack);
+    free(lzwDictionary);
+
+    return(bytesWritten);
+}
+
+/*
+ * Decompress the same way as the old decompress_u4_memory().
+ * Returns the decompressed size or -1 on error.
+ */
+long u4Decompress(unsigned char* compressedMem, long compressedSize,
+                  unsigned char** decompressedMem)
+{
+    long size = generalizedDecompress(&discardRoot, compressedMem, NULL, compressedSize);
+    if (size <= 0)
+        return(-1);
+
+    *decompressedMem = (unsigned char *) malloc(size);
+    memset(*decompressedMem, 0, size);
+    return(generalizedDecompress(&outputRoot, compressedMem, *decompressedMem, compressedSize));
+}
+
+/* --------------------------------------------------------------------------------------
+   Ultima 5 (& 6)
+   -------------------------------------------------------------------------------------- */
+
+using std::vector;
+
+class Dict {
+public:
+    void init() {
+        contains = 0x102;
+    }
+
+    void add(unsigned char root, int codeword) {
+        dict.resize(contains+1);
+        dict[contains].root = root;
+        dict[contains].codeword = codeword;
+        contains++;
+    }
+
+    unsigned char get_root(int codeword) {
+        return (dict[codeword].root);
+    }
+
+    int get_codeword(int codeword) {
+        return (dict[codeword].codeword);
+    }
+
+private:
+    struct dict_entry {
+        unsigned char root;
+        int codeword;
+    };
+
+    vector<dict_entry> dict;
+    int contains;
+};
+
+class Stack {
+public:
+    bool is_empty() {
+        return stack.size() == 0;
+    }
+
+    bool is_full() {
+        return stack.size() == stack_size;
+    }
+
+    void push(unsigned char element) {
+        if (!is_full()) {
+            stack.push_back(element);
+        }
+    }
+
+    unsigned char pop() {
+        unsigned char element;
+
+        if (!is_empty()) {
+            element = stack.back();
+            stack.pop_back();
+        }
+        else {
+            element = 0;
+        }
+        return element;
+    }
+
+    unsigned char gettop() {
+        if (!is_empty())
+            return stack.back();
+        else
+            return 0;
+    }
+
+private:
+    static const unsigned int stack_size = 10000;
+
+    vector<unsigned char> stack;
+};
+
+static Dict dict;
+
+static int get_next_codeword (long& bits_read, unsigned char *source, int codeword_size) {
+    unsigned char b0,b1,b2;
+    int codeword;
+
+    b0 = source[bits_read/8];
+    b1 = source[bits_read/8+1];
+    b2 = source[bits_read/8+2];
+
+    codeword = ((b2 << 16) + (b1 << 8) + b0);
+    codeword = codeword >> (bits_read % 8);
+    codeword &= (1 << codeword_size) - 1;
+
+    bits_read += codeword_size;
+    return (codeword);
+}
+
+static void output_root(unsigned char root, unsigned char *destination, long& position) {
+    destination[position] = root;
+    position++;
+}
+
+static void get_string(Stack &stack, int codeword) {
+    unsigned char root;
+    int current_codeword;
+
+    current_codeword = codeword;
+
+    while (current_codeword > 0xff) {
+        root = dict.get_root(current_codeword);
+        current_codeword = dict.get_codeword(current_codeword);
+        stack.push(root);
+    }
+
+    // push the root at the leaf
+    stack.push((unsigned char)current_codeword);
+}
+
+int u5Decompress(unsigned char *source, long source_length, unsigned char *destination, long destination_length) {
+    const int max_codeword_length = 12;
+
+    bool end_marker_reached = false;
+    int codeword_size = 9;
+    long bits_read = 0;
+    int next_free_codeword = 0x102;
+    int dictionary_size = 0x200;
+
+    long bytes_written = 0;
+
+    int cW;
+    int pW = 0;
+    unsigned char C;
+
+    while (! end_marker_reached) {
+        cW = get_next_codeword(bits_read, source, codeword_size);
+        switch (cW) {
+        case 0x100:
+            codeword_size = 9;
+            next_free_codeword = 0x102;
+            dictionary_size = 0x200;
+            dict.init();
+            cW = get_next_codeword(bits_read, source, codeword_size);
+            output_root((unsigned char)cW, destination, bytes_written);
+            break;
+        case 0x101:
+            end_marker_reached = true;
+            break;
+        default:
+            if (cW < next_free_codeword) {
+                Stack stack;
+                get_string(stack, cW);
+                C = stack.gettop();
+                while (!stack.is_empty()) {
+                    output_root(stack.pop(), destination, bytes_written);
+                }
+                dict.add(C,pW);
+                next_free_codeword++;
+                if (next_free_codeword >= dictionary_size) {
+                    if (codeword_size < max_codeword_length) {
+                        codeword_size += 1;
+                        dictionary_size *= 2;
+                    }
+                }
+            }
+            else {
+                Stack stack;
+                get_string(stack, pW);
+                C = stack.gettop();
+                while (!stack.is_empty()) {
+                    output_root(stack.pop(), destination, bytes_written);
+                }
+                output_root(C, destination, bytes_written);
+
+                if (cW != next_free_codeword) {
+                    return(EXIT_FAILURE);
+                }
+                dict.add(C,pW);
+                next_free_codeword++;
+                if (next_free_codeword >= dictionary_size) {
+                    if (codeword_size < max_codeword_length) {
+                        codeword_size += 1;
+                        dictionary_size *= 2;
+                    }
+                }
+            }
+            break;
+        }
+        pW = cW;
+    }
+    return(EXIT_SUCCESS);
+}
+
+}
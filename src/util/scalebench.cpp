@@ -0,0 +1,156 @@
+// Measure the throughput of the image scalers.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "image.cpp"
+#include "scale.cpp"
+
+// Stubs for the game symbols used by image.cpp & scale.cpp.
+XU4GameServices xu4;
+ScreenState* screenState() {
+    static ScreenState state;
+    return &state;
+}
+void print_trace(FILE*) {}
+
+#define EX_USAGE    64  /* command line usage error */
+
+static const char* const filterNames[] = {
+    "point", "2xBi", "2xSaI", "Scale2x"
+};
+
+/*
+ * Fill the image with blocks & diagonal lines of a few colors so that the
+ * edge detecting scalers take all their branches.
+ */
+static void makeTestImage(Image* img) {
+    static const uint32_t palette[4] = {
+        0xff000000, 0xff2060e0, 0xff40c040, 0xffe0e0e0
+    };
+    uint32_t seed = 1;
+    uint32_t* dp = img->pixels;
+    int x, y, c;
+
+    for (y = 0; y < img->height(); ++y) {
+        for (x = 0; x < img->width(); ++x) {
+            seed = seed * 1103515245 + 12345;
+            if (((x + y) & 7) == 0)
+                c = 3;
+            else if ((seed >> 16) % 11 == 0)
+                c = (seed >> 20) & 3;
+            else
+                c = ((x >> 2) ^ (y >> 3)) & 1;
+            *dp++ = palette[c];
+        }
+    }
+}
+
+/*
+ * Scale the same way as screenScale().
+ */
+static Image* scaleChain(int filter, Image* src, int scale, int n) {
+    Scaler filterScaler = scalerGet(filter);
+    Image* dest = NULL;
+    Image* pass;
+
+    while (scale % 2 == 0) {
+        pass = filterScaler(src, 2, n);
+        delete dest;
+        src = dest = pass;
+        scale /= 2;
+    }
+    if (scale == 3 && scaler3x(filter)) {
+        pass = filterScaler(src, 3, n);
+        delete dest;
+        src = dest = pass;
+        scale /= 3;
+    }
+    if (scale != 1) {
+        pass = scalePoint(src, scale, n);
+        delete dest;
+        dest = pass;
+    }
+    return dest;
+}
+
+static double seconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Return the scaled output rate in megapixels per second.
+ */
+static double benchmark(int filter, Image* src, int scale, int n) {
+    const double minTime = 0.25;
+    double start, elapsed;
+    int64_t pixels = 0;
+    Image* dest;
+
+    start = seconds();
+    do {
+        dest = scaleChain(filter, src, scale, n);
+        pixels += int64_t(dest->width()) * dest->height();
+        delete dest;
+        elapsed = seconds() - start;
+    } while (elapsed < minTime);
+
+    return double(pixels) / elapsed * 1e-6;
+}
+
+int main(int argc, char** argv) {
+    struct ThreadPool* pool;
+    Image* tiles;
+    Image* screen;
+    int workers = -1;
+    int filter, scale;
+    double t1, tN;
+
+    if (argc > 1) {
+        if (argc != 3 || strcmp(argv[1], "-t") != 0) {
+            fprintf(stderr, "Usage: %s [-t <worker-threads>]\n", argv[0]);
+            return EX_USAGE;
+        }
+        workers = atoi(argv[2]);
+    }
+
+    pool = threadPool_create(workers);
+    printf("Worker threads: %d (+1 caller)\n", threadPool_workers(pool));
+
+    // A 256 tile set and a full screen image.
+    tiles = Image::create(16, 16 * 256);
+    screen = Image::create(320, 200);
+    makeTestImage(tiles);
+    makeTestImage(screen);
+
+    printf("%-8s %5s %12s %12s %12s %12s\n", "Filter", "Scale",
+           "Tiles MP/s", "(threaded)", "Screen MP/s", "(threaded)");
+
+    for (filter = ScreenFilter_point; filter <= ScreenFilter_Scale2x;
+         ++filter) {
+        for (scale = 2; scale <= 5; ++scale) {
+            printf("%-8s %5d", filterNames[filter], scale);
+
+            xu4.threadPool = NULL;
+            t1 = benchmark(filter, tiles, scale, 256);
+            xu4.threadPool = pool;
+            tN = benchmark(filter, tiles, scale, 256);
+            printf(" %12.1f %12.1f", t1, tN);
+
+            xu4.threadPool = NULL;
+            t1 = benchmark(filter, screen, scale, 1);
+            xu4.threadPool = pool;
+            tN = benchmark(filter, screen, scale, 1);
+            printf(" %12.1f %12.1f\n", t1, tN);
+            fflush(stdout);
+        }
+    }
+
+    delete tiles;
+    delete screen;
+    threadPool_free(pool);
+    return 0;
+}
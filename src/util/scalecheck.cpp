@@ -0,0 +1,195 @@
+// Check that the image scalers produce the same pixels as the reference
+// scalers they replaced (util/scaleref.cpp).
+//
+// Each filter is run at scales 2-5 on several generated images, both on
+// the calling thread and on the worker pool.  The first differing pixel of
+// each case is reported.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "image.cpp"
+#include "scale.cpp"
+#include "scaleref.cpp"
+
+// Stubs for the game symbols used by image.cpp & scale.cpp.
+XU4GameServices xu4;
+ScreenState* screenState() {
+    static ScreenState state;
+    return &state;
+}
+void print_trace(FILE*) {}
+
+#define EX_USAGE    64  /* command line usage error */
+#define EX_SOFTWARE 70  /* internal software error */
+
+static const char* const filterNames[] = {
+    "point", "2xBi", "2xSaI", "Scale2x"
+};
+
+struct TestImage {
+    const char* name;
+    int w, h, n;
+    int colors;
+};
+
+/*
+ * The tile sets are scaled as n separate frames, so their heights must be
+ * a multiple of n.  Few colors give the edge detecting scalers runs of
+ * equal pixels; many colors exercise the blends.
+ */
+static const TestImage testImages[] = {
+    { "tiles",  16, 16 * 256, 256,  4 },
+    { "screen", 320, 200,     1,    4 },
+    { "noise",  37, 29,       1,    256 },
+    { "frames", 8, 8 * 7,     7,    3 },
+    { "line",   33, 1,        1,    4 },
+    { "pixel",  1, 1,         1,    2 }
+};
+
+/*
+ * Fill the image with blocks & diagonal lines from a palette so that the
+ * edge detecting scalers take all their branches.  The alpha varies too so
+ * that it is checked along with the color channels.
+ */
+static void makeTestImage(Image* img, int colors, uint32_t seed) {
+    uint32_t* dp = img->pixels;
+    uint32_t palette[256];
+    int x, y, c;
+
+    for (c = 0; c < colors; ++c) {
+        seed = seed * 1103515245 + 12345;
+        palette[c] = (seed >> 8) ^ (seed << 16);
+    }
+    palette[0] |= 0xff000000;
+
+    for (y = 0; y < img->height(); ++y) {
+        for (x = 0; x < img->width(); ++x) {
+            seed = seed * 1103515245 + 12345;
+            if (((x + y) & 7) == 0)
+                c = colors - 1;
+            else if ((seed >> 16) % 5 == 0)
+                c = (seed >> 20) % colors;
+            else
+                c = ((x >> 2) ^ (y >> 3)) & 1;
+            *dp++ = palette[c % colors];
+        }
+    }
+}
+
+/*
+ * Scale the same way as screenScale().
+ */
+static Image* scaleChain(Scaler (*getScaler)(int), Scaler pointScaler,
+                         int filter, Image* src, int scale, int n) {
+    Scaler filterScaler = getScaler(filter);
+    Image* dest = NULL;
+    Image* pass;
+
+    while (scale % 2 == 0) {
+        pass = filterScaler(src, 2, n);
+        delete dest;
+        src = dest = pass;
+        scale /= 2;
+    }
+    if (scale == 3 && scaler3x(filter)) {
+        pass = filterScaler(src, 3, n);
+        delete dest;
+        src = dest = pass;
+        scale /= 3;
+    }
+    if (scale != 1) {
+        pass = pointScaler(src, scale, n);
+        delete dest;
+        dest = pass;
+    }
+    return dest;
+}
+
+/*
+ * Return true if the images match.  Otherwise the first difference is
+ * printed.
+ */
+static bool compareImages(const Image* ref, const Image* img,
+                          const char* label) {
+    int x, y;
+
+    if (ref->width() != img->width() || ref->height() != img->height()) {
+        printf("%s: size %dx%d, expected %dx%d\n", label,
+               img->width(), img->height(), ref->width(), ref->height());
+        return false;
+    }
+
+    for (y = 0; y < ref->height(); ++y) {
+        for (x = 0; x < ref->width(); ++x) {
+            uint32_t a = ref->pixels[y * ref->width() + x];
+            uint32_t b = img->pixels[y * img->width() + x];
+            if (a != b) {
+                printf("%s: pixel %d,%d is %08x, expected %08x\n",
+                       label, x, y, b, a);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    struct ThreadPool* pool;
+    const TestImage* ti;
+    const TestImage* end = testImages +
+                           sizeof(testImages) / sizeof(testImages[0]);
+    Image* src;
+    Image* ref;
+    Image* img;
+    char label[64];
+    int workers = -1;
+    int filter, scale, threaded;
+    int cases = 0;
+    int failed = 0;
+
+    if (argc > 1) {
+        if (argc != 3 || strcmp(argv[1], "-t") != 0) {
+            fprintf(stderr, "Usage: %s [-t <worker-threads>]\n", argv[0]);
+            return EX_USAGE;
+        }
+        workers = atoi(argv[2]);
+    }
+
+    pool = threadPool_create(workers);
+
+    for (ti = testImages; ti != end; ++ti) {
+        src = Image::create(ti->w, ti->h);
+        makeTestImage(src, ti->colors, ti - testImages + 1);
+
+        for (filter = ScreenFilter_point; filter <= ScreenFilter_Scale2x;
+             ++filter) {
+            for (scale = 2; scale <= 5; ++scale) {
+                ref = scaleChain(ScaleRef::scalerGet, ScaleRef::scalePoint,
+                                 filter, src, scale, ti->n);
+
+                for (threaded = 0; threaded < 2; ++threaded) {
+                    xu4.threadPool = threaded ? pool : NULL;
+                    img = scaleChain(scalerGet, scalePoint,
+                                     filter, src, scale, ti->n);
+
+                    snprintf(label, sizeof(label), "%s %s x%d%s", ti->name,
+                             filterNames[filter], scale,
+                             threaded ? " threaded" : "");
+                    if (! compareImages(ref, img, label))
+                        ++failed;
+                    ++cases;
+                    delete img;
+                }
+                delete ref;
+            }
+        }
+        delete src;
+    }
+
+    threadPool_free(pool);
+
+    printf("%d cases, %d failed\n", cases, failed);
+    return failed ? EX_SOFTWARE : 0;
+}
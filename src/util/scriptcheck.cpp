@@ -0,0 +1,459 @@
+// Check that the compiled vendor script interpreter (script_xml.cpp) behaves
+// exactly like the original one (util/scriptref.cpp).
+//
+// Every vendor in vendorScript.xml is run through both interpreters with the
+// same party and the same randomly chosen answers.  The screen text, debug
+// trace and resulting save game of each session must be identical.
+//
+// It must be run from a directory where the conf files can be found.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <libxml/parser.h>
+
+#include "camp.h"
+#include "city.h"
+#include "config.h"
+#include "context.h"
+#include "conversation.h"
+#include "debug.h"
+#include "error.h"
+#include "event.h"
+#include "filesystem.h"
+#include "game.h"
+#include "location.h"
+#include "party.h"
+#include "savegame.h"
+#include "screen.h"
+#include "settings.h"
+#include "sound.h"
+#include "spell.h"
+#include "stats.h"
+#include "tile.h"
+#include "tileset.h"
+#include "types.h"
+#include "u4.h"
+#include "u4file.h"
+#include "utils.h"
+#include "weapon.h"
+#include "xml.h"
+#include "xu4.h"
+
+#define EX_USAGE    64  /* command line usage error */
+#define EX_SOFTWARE 70  /* internal software error */
+
+bool verbose = false;
+XU4GameServices xu4;
+
+//--------------------------------------
+// Stand-ins for the game context & user interface which record what the
+// interpreters do in the session transcript.
+
+static std::string transcript;
+
+static void record(const char* fmt, ...) {
+    char buf[4096];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    transcript += buf;
+}
+
+struct CheckFatal {};
+
+static void checkFatal(const char* fmt, ...) {
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    record("<fatal %s>", buf);
+    throw CheckFatal();
+}
+
+static void checkWarning(const char* fmt, ...) {
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    record("<warning %s>", buf);
+}
+
+static void checkMessage(const char* fmt, ...) {
+    char buf[4096];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    transcript += buf;
+}
+
+static void checkCursorOn()     { record("<cursor on>"); }
+static void checkCursorOff()    { record("<cursor off>"); }
+static void checkUpdateScreen() { record("<update>"); }
+static void checkMusicPlay(int music) { record("<music %d>", music); }
+static void checkMusicLocale()  { record("<music locale>"); }
+static void checkMusicStop()    { record("<music stop>"); }
+static void checkMusicFade(int msec) { record("<music fade %d>", msec); }
+
+static void checkSpellEffect(int spell, int player, Sound sound) {
+    record("<spell %c %d %d>", spell, player, (int) sound);
+}
+
+struct CheckEvents {
+    static bool wait_msecs(unsigned int msec) {
+        record("<wait %u>", msec);
+        return false;
+    }
+};
+
+struct CheckInn {
+    void beginCombat() { record("<sleep>"); }
+};
+
+struct CheckStats {
+    void setView(StatsView view) { record("<view %d>", (int) view); }
+    void resetReagentsMenu() { record("<reagents menu>"); }
+};
+
+// The game context with a StatsArea stand-in.  Party also uses the real
+// context, so the transport is shared with it.
+struct CheckContext {
+    Party* party;
+    SaveGame* saveGame;
+    Location* location;
+    int line, col;
+    CheckStats* stats;
+    int windDirection;
+    TransportContext& transportContext;
+
+    CheckContext(Context* ctx) : transportContext(ctx->transportContext) {}
+};
+
+static CheckContext* checkCtx;
+
+//--------------------------------------
+// The two interpreters.  Their references to the global context & user
+// interface are redirected to the stand-ins above.
+
+#define c                   checkCtx
+#define errorFatal          checkFatal
+#define errorWarning        checkWarning
+#define screenMessage       checkMessage
+#define screenEnableCursor  checkCursorOn
+#define screenDisableCursor checkCursorOff
+#define gameUpdateScreen    checkUpdateScreen
+#define musicPlay           checkMusicPlay
+#define musicPlayLocale     checkMusicLocale
+#define musicStop           checkMusicStop
+#define musicFadeOut        checkMusicFade
+#define EventHandler        CheckEvents
+#define CombatController    CheckInn
+#define InnController       CheckInn
+
+namespace ScriptNew {
+#include "script_xml.cpp"
+SpellEffectCallback spellEffectCallback = checkSpellEffect;
+}
+
+namespace ScriptRef {
+#include "scriptref.cpp"
+SpellEffectCallback spellEffectCallback = checkSpellEffect;
+}
+
+#undef c
+#undef errorFatal
+#undef errorWarning
+#undef screenMessage
+#undef screenEnableCursor
+#undef screenDisableCursor
+#undef gameUpdateScreen
+#undef musicPlay
+#undef musicPlayLocale
+#undef musicStop
+#undef musicFadeOut
+#undef EventHandler
+#undef CombatController
+#undef InnController
+
+//--------------------------------------
+
+static uint32_t seed;
+
+static int rnd(int n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static void appendSaveGame(const SaveGame& sg) {
+    record("\n[gold %d food %d transport %d", sg.gold, sg.food, sg.transport);
+    for (int i = 0; i < 8; ++i)
+        record(" w%d a%d r%d", sg.weapons[i], sg.armor[i], sg.reagents[i]);
+    for (int i = 0; i < sg.members; ++i)
+        record(" p%d:%d/%d:%c", i, sg.players[i].hp, sg.players[i].hpMax,
+               sg.players[i].status);
+    record(" karma");
+    for (int i = 0; i < 8; ++i)
+        record(" %d", sg.karma[i]);
+    record(" items %d]\n", sg.items);
+}
+
+static void appendDebugTrace() {
+    static const char* traceFile = "debug/script.txt";
+    FILE* fp = fopen(traceFile, "r");
+    if (fp) {
+        char buf[4096];
+        size_t n;
+        transcript += "--- debug\n";
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+            transcript.append(buf, n);
+        fclose(fp);
+        remove(traceFile);
+    }
+}
+
+/*
+ * Run a session with a vendor and return the transcript.  The party and
+ * the answers given are chosen randomly from the session number.
+ */
+template<class S>
+static std::string runVendor(const char* goods, const char* vendor,
+                             uint32_t session) {
+    SaveGame sg;
+    SaveGamePlayerRecord avatar;
+    CheckStats stats;
+    CheckContext ctx(c);
+    int i;
+
+    memset(&avatar, 0, sizeof(avatar));
+    strcpy(avatar.name, "Tester");
+    avatar.hp = avatar.hpMax = 200;
+    sg.init(&avatar);
+
+    seed = session;
+    xu4_srandom(session);
+
+    sg.members = 1 + rnd(8);
+    for (i = 0; i < sg.members; ++i) {
+        SaveGamePlayerRecord& rec = sg.players[i];
+        rec = avatar;
+        rec.hpMax  = 100 + rnd(700);
+        rec.hp     = rnd(rec.hpMax + 1);
+        rec.status = (StatusType) "GPSD"[rnd(4)];
+        rec.weapon = (WeaponType) rnd(8);
+        rec.armor  = (ArmorType) rnd(4);
+    }
+    sg.gold = rnd(4) ? rnd(2000) : rnd(30);
+    sg.food = rnd(9000);
+    for (i = 0; i < 8; ++i) {
+        sg.weapons[i]  = rnd(5);
+        sg.armor[i]    = rnd(3);
+        sg.reagents[i] = rnd(10);
+        sg.karma[i]    = rnd(100);
+    }
+
+    City city;
+    city.type = Map::CITY;
+    Location loc(Coords(1, 2, 0), &city, VIEW_NORMAL, CTX_CITY, NULL, NULL);
+
+    c->saveGame = &sg;
+    c->location = &loc;
+    c->party = new Party(&sg);
+
+    ctx.party     = c->party;
+    ctx.saveGame  = &sg;
+    ctx.location  = &loc;
+    ctx.line      = 0;
+    ctx.col       = 0;
+    ctx.stats     = &stats;
+    ctx.windDirection = DIR_NORTH;
+    checkCtx = &ctx;
+
+    transcript.clear();
+    appendSaveGame(sg);
+
+    S* s = new S;
+    try {
+        s->load("vendorScript.xml", goods, "vendor", vendor);
+        s->run("intro");
+
+        for (int steps = 0; s->getState() != S::STATE_DONE; ++steps) {
+            if (steps == 80) {
+                record("<too many inputs>");
+                break;
+            }
+            if (s->getState() != S::STATE_INPUT) {
+                record("<stuck in state %d>", s->getState());
+                break;
+            }
+
+            string name = s->getInputName();
+            switch (s->getInputType()) {
+            case S::INPUT_CHOICE: {
+                string ch = s->getChoices();
+                int k = rnd(ch.size() + 1);
+                if (k == (int) ch.size() || isspace(ch[k]))
+                    k = 0;
+                record("<choice %s '%s' %d>", name.c_str(), ch.c_str(), ch[k]);
+                s->setVar(name, string(1, ch[k]));
+            }
+                break;
+            case S::INPUT_KEYPRESS:
+                record("<key>");
+                break;
+            case S::INPUT_NUMBER: {
+                int n = rnd(3) ? rnd(12) : rnd(200);
+                record("<number %s %d max %d>", name.c_str(), n,
+                     s->getInputMaxLen());
+                s->setVar(name, n);
+            }
+                break;
+            case S::INPUT_STRING: {
+                static const char* answers[] = {
+                    "", "yes", "no", "y", "n", "ale", "food", "sleepy", "xyz"
+                };
+                const char* str = answers[rnd(9)];
+                record("<string %s '%s'>", name.c_str(), str);
+                if (*str)
+                    s->setVar(name, str);
+                else
+                    s->unsetVar(name);
+            }
+                break;
+            case S::INPUT_PLAYER: {
+                int p = rnd(sg.members + 1) - 1;
+                record("<player %s %d>", name.c_str(), p);
+                if (p < 0)
+                    s->unsetVar(name);
+                else {
+                    char num[16];
+                    sprintf(num, "%d", p + 1);
+                    s->setVar(name, num);
+                }
+            }
+                break;
+            default:
+                record("<input type %d>", s->getInputType());
+                break;
+            }
+            ctx.line++;
+            s->_continue();
+        }
+    } catch (CheckFatal&) {
+    }
+    appendSaveGame(sg);
+    s->unload();
+    delete s;
+    appendDebugTrace();
+
+    delete c->party;
+    c->party = NULL;
+    c->saveGame = NULL;
+    c->location = NULL;
+    checkCtx = NULL;
+    return transcript;
+}
+
+static void reportDifference(const std::string& ref, const std::string& out) {
+    size_t i, len = ref.size() < out.size() ? ref.size() : out.size();
+    for (i = 0; i < len; ++i) {
+        if (ref[i] != out[i])
+            break;
+    }
+    size_t start = (i > 40) ? i - 40 : 0;
+    printf("  first difference at byte %d\n", (int) i);
+    printf("  reference: ...%s\n", ref.substr(start, 80).c_str());
+    printf("  compiled:  ...%s\n", out.substr(start, 80).c_str());
+}
+
+struct Vendor {
+    string goods;
+    string id;
+};
+
+static std::vector<Vendor> listVendors() {
+    std::vector<Vendor> list;
+    xmlDocPtr doc = xmlParse("vendorScript.xml");
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    for (xmlNodePtr sn = root->xmlChildrenNode; sn; sn = sn->next) {
+        if (xmlNodeIsText(sn) || xmlStrcmp(sn->name, (const xmlChar*) "script"))
+            continue;
+        for (xmlNodePtr vn = sn->xmlChildrenNode; vn; vn = vn->next) {
+            if (xmlNodeIsText(vn) ||
+                xmlStrcmp(vn->name, (const xmlChar*) "vendor"))
+                continue;
+            Vendor v;
+            v.goods = xmlGetPropAsString(sn, "id");
+            v.id    = xmlGetPropAsString(vn, "id");
+            list.push_back(v);
+        }
+    }
+    xmlFreeDoc(doc);
+    return list;
+}
+
+int main(int argc, char** argv) {
+    int rounds = 50;
+    int i, r;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [-r rounds]\n", argv[0]);
+            return EX_USAGE;
+        }
+    }
+
+    u4fsetup();
+    notify_init(&xu4.notifyBus, 8);
+    xu4.settings = new Settings;
+    xu4.settings->init(NULL);
+    xu4.settings->validateXml = false;
+    xu4.config = configInit("Ultima-IV.mod");
+    Tile::initSymbols(xu4.config);
+    c = new Context;
+
+    std::vector<Vendor> vendors = listVendors();
+    long sessions = 0, failed = 0;
+
+    for (i = 0; i < (int) vendors.size(); ++i) {
+        const char* goods = vendors[i].goods.c_str();
+        const char* id = vendors[i].id.c_str();
+        int diff = 0;
+
+        for (r = 0; r < rounds; ++r) {
+            uint32_t session = (i + 1) * 100000 + r;
+            std::string ref = runVendor<ScriptRef::Script>(goods, id, session);
+            std::string out = runVendor<ScriptNew::Script>(goods, id, session);
+            if (ref != out) {
+                if (! diff) {
+                    printf("%s %s (session %u):\n", goods, id, session);
+                    reportDifference(ref, out);
+                }
+                ++diff;
+            }
+        }
+        sessions += rounds;
+        failed += diff;
+    }
+
+    printf("%ld vendors, %ld sessions, %ld differ\n",
+           (long) vendors.size(), sessions, failed);
+
+    delete c;
+    c = NULL;
+    configFree(xu4.config);
+    delete xu4.settings;
+    notify_free(&xu4.notifyBus);
+    return failed ? EX_SOFTWARE : 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Check that the SIMD image32 kernels draw exactly the same pixels as the
+ * scalar reference code.
+ *
+ * The blend is tested for every dest, src & alpha byte combination and the
+ * other functions with random images at widths which exercise the tails of
+ * the SIMD loops.
+ */
+
+#include <stdlib.h>
+#include "image32.c"
+
+#define EX_SOFTWARE 70  /* internal software error */
+
+typedef void (*DrawFunc)(Image32* dest, const Image32* src, int n);
+
+static uint32_t seed = 1;
+
+static uint32_t randomPixel(void)
+{
+    uint32_t a, b;
+    seed = seed * 1103515245 + 12345;
+    a = seed >> 16;
+    seed = seed * 1103515245 + 12345;
+    b = seed >> 16;
+    return (a << 16) | b;
+}
+
+static void randomImage(Image32* img)
+{
+    uint32_t* it  = img->pixels;
+    uint32_t* end = it + img->w * img->h;
+    for (; it != end; ++it)
+        *it = randomPixel();
+}
+
+/*
+ * Fill dest with every dest byte value across the row and src with every
+ * src byte value down the column, both using the same alpha.
+ */
+static void blendInputs(Image32* dest, Image32* src, int alpha)
+{
+    uint32_t* dp = dest->pixels;
+    uint32_t* sp = src->pixels;
+    RGBA* col;
+    int x, y;
+
+    for (y = 0; y < 256; ++y) {
+        for (x = 0; x < 256; ++x) {
+            col = (RGBA*) dp++;
+            rgba_setp(col, x, x ^ 0xaa, 255 - x, y);
+            col = (RGBA*) sp++;
+            rgba_setp(col, y, 255 - y, y ^ 0x55, alpha);
+        }
+    }
+}
+
+static void drawBlend(Image32* dest, const Image32* src, int n)
+{
+    (void) n;
+    image32_blit(dest, 0, 0, src, 1);
+}
+
+static void drawBlendRect(Image32* dest, const Image32* src, int n)
+{
+    image32_blitRect(dest, n % 5, n % 3, src, n % 7, 1, n, src->h - 1, 1);
+}
+
+static void drawFillRect(Image32* dest, const Image32* src, int n)
+{
+    image32_fillRect(dest, n % 5, 2, n, dest->h - 2, (const RGBA*) src->pixels);
+}
+
+static void drawFill(Image32* dest, const Image32* src, int n)
+{
+    (void) n;
+    image32_fill(dest, (const RGBA*) (src->pixels + 1));
+}
+
+static void drawInvert(Image32* dest, const Image32* src, int n)
+{
+    (void) src;
+    (void) n;
+    image32_invertRGB(dest);
+}
+
+/*
+ * Draw with the scalar and SIMD kernels from the same inputs and return the
+ * number of pixels which differ.  The first difference is printed if report
+ * is non-zero.
+ */
+static long compareDraw(int simd, DrawFunc draw, const Image32* dest,
+                        const Image32* src, Image32* ref, Image32* out, int n,
+                        int report)
+{
+    const uint32_t* rp;
+    const uint32_t* op;
+    long diff = 0;
+    int i, count;
+
+    image32_duplicatePixels(ref, dest);
+    image32_duplicatePixels(out, dest);
+
+    image32_selectSimd(IMAGE32_SCALAR);
+    draw(ref, src, n);
+    image32_selectSimd(simd);
+    draw(out, src, n);
+
+    rp = ref->pixels;
+    op = out->pixels;
+    count = ref->w * ref->h;
+    for (i = 0; i < count; ++i) {
+        if (rp[i] != op[i]) {
+            if (report && ! diff)
+                printf("  first difference at pixel %d,%d: %08x != %08x\n",
+                       i % ref->w, i / ref->w, op[i], rp[i]);
+            ++diff;
+        }
+    }
+
+    image32_freePixels(ref);
+    image32_freePixels(out);
+    return diff;
+}
+
+static long checkSimd(int simd)
+{
+    static const struct {
+        const char* name;
+        DrawFunc draw;
+    } tests[] = {
+        { "blendRect", drawBlendRect },
+        { "fillRect",  drawFillRect },
+        { "fill",      drawFill },
+        { "invertRGB", drawInvert }
+    };
+    Image32 dest, src, ref, out;
+    long diff, total = 0;
+    int alpha, t, w;
+
+    image32_allocPixels(&dest, 256, 256);
+    image32_allocPixels(&src, 256, 256);
+
+    diff = 0;
+    for (alpha = 0; alpha < 256; ++alpha) {
+        blendInputs(&dest, &src, alpha);
+        diff += compareDraw(simd, drawBlend, &dest, &src, &ref, &out, 0,
+                            ! diff);
+    }
+    printf("  %-10s %ld\n", "blend", diff);
+    total += diff;
+
+    image32_freePixels(&dest);
+    image32_freePixels(&src);
+
+    for (t = 0; t < 4; ++t) {
+        diff = 0;
+        for (w = 1; w <= 67; ++w) {
+            image32_allocPixels(&dest, w + 6, 9);
+            image32_allocPixels(&src, w + 8, 9);
+            randomImage(&dest);
+            randomImage(&src);
+            diff += compareDraw(simd, tests[t].draw, &dest, &src,
+                                &ref, &out, w, ! diff);
+            image32_freePixels(&dest);
+            image32_freePixels(&src);
+        }
+        printf("  %-10s %ld\n", tests[t].name, diff);
+        total += diff;
+    }
+    return total;
+}
+
+int main(void)
+{
+    int best = image32_selectSimd(IMAGE32_SIMD_AUTO);
+    int simd;
+    long diff = 0;
+
+    printf("Pixels differing from %s:\n", image32_simdName(IMAGE32_SCALAR));
+
+    for (simd = IMAGE32_SSE2; simd <= IMAGE32_NEON; ++simd) {
+        if (image32_selectSimd(simd) != simd)
+            continue;
+        printf("%s\n", image32_simdName(simd));
+        diff += checkSimd(simd);
+    }
+    if (best == IMAGE32_SCALAR)
+        printf("No SIMD kernels are supported on this CPU.\n");
+
+    return diff ? EX_SOFTWARE : 0;
+}
@@ -64,15 +64,11 @@ int main(int argc, char *argv[]) {
     fread(indata, 1, inlen, infile);
 
     if (strcmp(alg, "lzw") == 0) {
-        outlen = lzwGetDecompressedSize(indata, inlen);
-
-        outdata = (unsigned char *)malloc(outlen);
-        if (!outdata) {
-            perror("malloc");
-            exit(1);
+        outlen = lzwDecompressAlloc(indata, inlen, &outdata);
+        if (outlen < 0) {
+            printf("Invalid LZW data.\n");
+            return(EXIT_FAILURE);
         }
-
-        lzwDecompress(indata, outdata, inlen);
     }
 
     else if (strcmp(alg, "rle") == 0) {
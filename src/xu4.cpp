@@ -12,15 +12,18 @@
 #include <cstring>
 #include <ctime>
 #include "xu4.h"
+#include "assetloader.h"
 #include "config.h"
 #include "debug.h"
 #include "error.h"
 #include "game.h"
 #include "intro.h"
+#include "profile.h"
 #include "progress_bar.h"
 #include "screen.h"
 #include "settings.h"
 #include "sound.h"
+#include "threadPool.h"
 #include "utils.h"
 
 #if defined(MACOSX)
@@ -41,6 +44,7 @@ enum OptionsFlag {
     OPT_VERBOSE    = 8,
     OPT_RECORD     = 0x10,
     OPT_REPLAY     = 0x20,
+    OPT_UNCAPPED   = 0x40,
     OPT_TEST_SAVE  = 0x80
 };
 
@@ -109,6 +113,10 @@ int parseOptions(Options* opt, int argc, char** argv) {
             opt->flags |= OPT_NO_AUDIO;
             opt->used  |= OPT_NO_AUDIO;
         }
+        else if (strEqual(argv[i], "--uncapped"))
+        {
+            opt->flags |= OPT_UNCAPPED;
+        }
         else if (strEqualAlt(argv[i], "-h", "--help"))
         {
             printf("xu4: Ultima IV Recreated\n"
@@ -130,6 +138,7 @@ int parseOptions(Options* opt, int argc, char** argv) {
             "  -p, --profile <string>  Use another set of settings and save files.\n"
             "  -q, --quiet             Disable audio.\n"
             "  -s, --scale <int>       Specify display scaling factor (1-5).\n"
+            "      --uncapped          Do not limit the frame rate (for benchmarks).\n"
             "  -v, --verbose           Enable verbose console output.\n"
 #ifdef DEBUG
             "\nDEBUG Options:\n"
@@ -196,6 +205,12 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
     /* Setup the message bus early to make it available to other services. */
     notify_init(&gs->notifyBus, 8);
 
+    /* Start the workers used to split up image processing. */
+    gs->threadPool = threadPool_create(-1);
+
+    /* Start the thread which reads images & maps in the background. */
+    gs->assets = new AssetLoader;
+
     /* initialize the settings */
     gs->settings = new Settings;
     gs->settings->init(opt->profile);
@@ -211,7 +226,7 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
     Debug::initGlobal("debug/global.txt");
 
     gs->config = configInit(opt->module ? opt->module : "Ultima-IV.mod");
-    screenInit();
+    screenInit((opt->flags & OPT_UNCAPPED) ? true : false);
     Tile::initSymbols(gs->config);
 
     if (! (opt->flags & OPT_NO_AUDIO))
@@ -220,6 +235,8 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
     gs->eventHandler = new EventHandler(1000/gs->settings->gameCyclesPerSecond,
                             1000/gs->settings->screenAnimationFramesPerSecond);
 
+    PROFILE_INIT(1000/gs->settings->screenAnimationFramesPerSecond)
+
 #ifdef DEBUG
     if (opt->flags & OPT_REPLAY) {
         uint32_t seed = gs->eventHandler->replay(opt->recordFile);
@@ -243,12 +260,15 @@ void servicesInit(XU4GameServices* gs, Options* opt) {
 }
 
 void servicesFree(XU4GameServices* gs) {
+    PROFILE_DUMP("xu4-profile.json")
     delete gs->game;
     delete gs->intro;
     delete gs->saveGame;
     delete gs->eventHandler;
     soundDelete();
     screenDelete();
+    delete gs->assets;
+    threadPool_free(gs->threadPool);
     configFree(gs->config);
     delete gs->settings;
     notify_free(&gs->notifyBus);
@@ -2,6 +2,9 @@
  * xu4.h
  */
 
+#ifndef XU4_H
+#define XU4_H
+
 #include "notify.h"
 
 enum NotifySender {
@@ -10,7 +13,8 @@ enum NotifySender {
     SENDER_PARTY,       // PartyEvent*
     SENDER_AURA,        // Aura*
     SENDER_MENU,        // MenuEvent*
-    SENDER_SETTINGS     // Settings*
+    SENDER_SETTINGS,    // Settings*
+    SENDER_ASSET        // AssetEvent*
 };
 
 class Settings;
@@ -22,6 +26,8 @@ class EventHandler;
 struct SaveGame;
 class IntroController;
 class GameController;
+struct ThreadPool;
+class AssetLoader;
 
 enum XU4GameStage {
     StageExitGame,
@@ -42,6 +48,8 @@ struct XU4GameServices {
     SaveGame* saveGame;
     IntroController* intro;
     GameController* game;
+    ThreadPool* threadPool;
+    AssetLoader* assets;
     const char* errorMessage;
     int stage;
 };
@@ -51,3 +59,5 @@ extern XU4GameServices xu4;
 #define gs_listen(msk,func,user)    notify_listen(&xu4.notifyBus,msk,func,user)
 #define gs_unplug(id)               notify_unplug(&xu4.notifyBus,id)
 #define gs_emitMessage(sid,data)    notify_emit(&xu4.notifyBus,sid,data);
+
+#endif  // XU4_H